@@ -0,0 +1,96 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Counts heap allocations made on each thread, by replacing the
+//			global operator new
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "AllocationCounter.h"
+#include <new>
+#include <stdlib.h>
+
+// Per thread so counting is just an increment, and one thread's allocations don't show up in
+// another's count
+static thread_local uint64 s_cThreadAllocations = 0;
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Allocations made on this thread so far
+//-----------------------------------------------------------------------------
+uint64 GetThreadAllocationCount()
+{
+	return s_cThreadAllocations;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Count an allocation and make it, NULL if there's no memory
+//-----------------------------------------------------------------------------
+static void *CountedAlloc( size_t cubSize )
+{
+	++s_cThreadAllocations;
+	return malloc( cubSize ? cubSize : 1 );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Replacements for the global operator new and delete.  The array
+//			and nothrow forms would forward here anyway on most runtimes, but
+//			that isn't guaranteed, so they're replaced too.
+//-----------------------------------------------------------------------------
+void *operator new( size_t cubSize )
+{
+	void *pMem = CountedAlloc( cubSize );
+	if ( !pMem )
+		throw std::bad_alloc();
+	return pMem;
+}
+
+void *operator new[]( size_t cubSize )
+{
+	void *pMem = CountedAlloc( cubSize );
+	if ( !pMem )
+		throw std::bad_alloc();
+	return pMem;
+}
+
+void *operator new( size_t cubSize, const std::nothrow_t & ) noexcept
+{
+	return CountedAlloc( cubSize );
+}
+
+void *operator new[]( size_t cubSize, const std::nothrow_t & ) noexcept
+{
+	return CountedAlloc( cubSize );
+}
+
+void operator delete( void *pMem ) noexcept
+{
+	free( pMem );
+}
+
+void operator delete[]( void *pMem ) noexcept
+{
+	free( pMem );
+}
+
+void operator delete( void *pMem, size_t ) noexcept
+{
+	free( pMem );
+}
+
+void operator delete[]( void *pMem, size_t ) noexcept
+{
+	free( pMem );
+}
+
+void operator delete( void *pMem, const std::nothrow_t & ) noexcept
+{
+	free( pMem );
+}
+
+void operator delete[]( void *pMem, const std::nothrow_t & ) noexcept
+{
+	free( pMem );
+}
@@ -0,0 +1,21 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Counts heap allocations made on each thread, so code that shouldn't
+//			allocate can be checked
+//
+//=============================================================================
+
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+// How many times operator new has been called on this thread.  Take the difference across a
+// block of code to see how many allocations it made:
+//
+//		uint64 cAllocationsBefore = GetThreadAllocationCount();
+//		...
+//		uint64 cAllocations = GetThreadAllocationCount() - cAllocationsBefore;
+//
+// Only allocations through operator new are counted, not malloc.
+uint64 GetThreadAllocationCount();
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,495 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Takes players from a new connection to being let in, checking their
+//			auth tickets a bounded number at a time
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "AuthPipeline.h"
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Ask Steam about a ticket
+//-----------------------------------------------------------------------------
+EAuthValidation CSteamAuthValidator::BeginValidation( CSteamID steamID, const void *pubTicket, uint32 cubTicket, uint64 ulTickCount )
+{
+	if ( !SteamGameServer() )
+		return k_EAuthValidationRejected;
+
+	if ( SteamGameServer()->BeginAuthSession( pubTicket, (int)cubTicket, steamID ) != k_EBeginAuthSessionResultOK )
+		return k_EAuthValidationRejected;
+
+	return k_EAuthValidationPending;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Tell Steam the player is gone
+//-----------------------------------------------------------------------------
+void CSteamAuthValidator::EndValidation( CSteamID steamID )
+{
+	if ( SteamGameServer() )
+		SteamGameServer()->EndAuthSession( steamID );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CSimulatedAuthValidator::CSimulatedAuthValidator( uint32 unLatencyMilliseconds, uint32 unJitterMilliseconds, uint32 unFailPercent, uint32 unSeed )
+{
+	m_unLatencyMilliseconds = unLatencyMilliseconds;
+	m_unJitterMilliseconds = unJitterMilliseconds;
+	m_unFailPercent = unFailPercent;
+	m_ulRandomState = unSeed;
+	m_vecPendingAnswers.reserve( AUTH_MAX_VALIDATIONS_IN_FLIGHT );
+	m_vecDueAnswers.reserve( AUTH_MAX_VALIDATIONS_IN_FLIGHT );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Next number under unRange from our random stream (splitmix64)
+//-----------------------------------------------------------------------------
+uint32 CSimulatedAuthValidator::RandomInt( uint32 unRange )
+{
+	uint64 z = ( m_ulRandomState += 0x9e3779b97f4a7c15ull );
+	z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+	z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebull;
+	return (uint32)( ( z ^ ( z >> 31 ) ) >> 32 ) % unRange;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Decide now what the answer will be, and when it comes
+//-----------------------------------------------------------------------------
+EAuthValidation CSimulatedAuthValidator::BeginValidation( CSteamID steamID, const void *pubTicket, uint32 cubTicket, uint64 ulTickCount )
+{
+	PendingAnswer_t answer;
+	answer.m_ulDueTick = ulTickCount + m_unLatencyMilliseconds + RandomInt( m_unJitterMilliseconds + 1 );
+	answer.m_steamID = steamID;
+	answer.m_bAccepted = RandomInt( 100 ) >= m_unFailPercent;
+	m_vecPendingAnswers.push_back( answer );
+	return k_EAuthValidationPending;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Drop any answer still coming for a player
+//-----------------------------------------------------------------------------
+void CSimulatedAuthValidator::EndValidation( CSteamID steamID )
+{
+	for ( uint32 i = 0; i < m_vecPendingAnswers.size(); ++i )
+	{
+		if ( m_vecPendingAnswers[i].m_steamID == steamID )
+		{
+			m_vecPendingAnswers[i] = m_vecPendingAnswers.back();
+			m_vecPendingAnswers.pop_back();
+			return;
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Hand over the answers that are due.  They're taken off our list
+//			first, the pipeline calls back into EndValidation as it goes.
+//-----------------------------------------------------------------------------
+void CSimulatedAuthValidator::RunFrame( uint64 ulTickCount, CAuthPipeline *pPipeline )
+{
+	m_vecDueAnswers.clear();
+	for ( uint32 i = 0; i < m_vecPendingAnswers.size(); )
+	{
+		if ( m_vecPendingAnswers[i].m_ulDueTick <= ulTickCount )
+		{
+			m_vecDueAnswers.push_back( m_vecPendingAnswers[i] );
+			m_vecPendingAnswers[i] = m_vecPendingAnswers.back();
+			m_vecPendingAnswers.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	for ( uint32 i = 0; i < m_vecDueAnswers.size(); ++i )
+		pPipeline->OnValidationResult( m_vecDueAnswers[i].m_steamID, m_vecDueAnswers[i].m_bAccepted, ulTickCount );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Clear all the counts
+//-----------------------------------------------------------------------------
+void AuthPipelineStats_t::Reset()
+{
+	m_cConnections = 0;
+	m_cRateLimited = 0;
+	m_cDuplicates = 0;
+	m_cAccepted = 0;
+	m_cRejected = 0;
+	m_cTimedOut = 0;
+	m_cAbandoned = 0;
+	m_cMaxInFlight = 0;
+	m_cMaxQueued = 0;
+	m_TicketMilliseconds.Reset();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Add in another pipeline's counts
+//-----------------------------------------------------------------------------
+void AuthPipelineStats_t::Merge( const AuthPipelineStats_t &other )
+{
+	m_cConnections += other.m_cConnections;
+	m_cRateLimited += other.m_cRateLimited;
+	m_cDuplicates += other.m_cDuplicates;
+	m_cAccepted += other.m_cAccepted;
+	m_cRejected += other.m_cRejected;
+	m_cTimedOut += other.m_cTimedOut;
+	m_cAbandoned += other.m_cAbandoned;
+	m_cMaxInFlight = MAX( m_cMaxInFlight, other.m_cMaxInFlight );
+	m_cMaxQueued = MAX( m_cMaxQueued, other.m_cMaxQueued );
+	m_TicketMilliseconds.Merge( other.m_TicketMilliseconds );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CAuthPipeline::CAuthPipeline()
+{
+	m_pValidator = NULL;
+	m_pListener = NULL;
+	m_pTimers = NULL;
+	m_unFirstFree = k_unInvalidIndex;
+	m_cPending = 0;
+	m_cInFlight = 0;
+	m_cQueued = 0;
+	m_ulLastPruneTick = 0;
+	m_Stats.Reset();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Set aside every entry we'll need, all on the free list
+//-----------------------------------------------------------------------------
+void CAuthPipeline::Init( uint32 unMaxPending, IAuthValidator *pValidator, IAuthPipelineListener *pListener, CTimerWheel *pTimers )
+{
+	m_pValidator = pValidator;
+	m_pListener = pListener;
+	m_pTimers = pTimers;
+
+	m_vecEntries.resize( unMaxPending );
+	for ( uint32 i = 0; i < unMaxPending; ++i )
+	{
+		m_vecEntries[i].m_eState = k_EPendingAuthFree;
+		m_vecEntries[i].m_hConn = k_HSteamNetConnection_Invalid;
+		m_vecEntries[i].m_ulTicketTick = 0;
+		m_vecEntries[i].m_unGeneration = 0;
+		m_vecEntries[i].m_unNextFree = i + 1 < unMaxPending ? i + 1 : k_unInvalidIndex;
+		m_vecEntries[i].m_hTimeout = k_hTimerInvalid;
+	}
+	m_unFirstFree = unMaxPending ? 0 : k_unInvalidIndex;
+	m_cPending = 0;
+	m_cInFlight = 0;
+	m_cQueued = 0;
+	m_mapSteamIDToEntry.Init( unMaxPending );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Token bucket per address.  Local addresses are always let through,
+//			as are connections the transport couldn't give an address for.
+//-----------------------------------------------------------------------------
+bool CAuthPipeline::BAllowConnectionFrom( const SteamNetworkingIPAddr &addrRemote, uint64 ulTickCount )
+{
+	if ( addrRemote.IsIPv6AllZeros() || addrRemote.IsLocalHost() )
+		return true;
+
+	std::pair< uint64, uint64 > key;
+	memcpy( &key.first, &addrRemote.m_ipv6[0], sizeof( key.first ) );
+	memcpy( &key.second, &addrRemote.m_ipv6[8], sizeof( key.second ) );
+
+	std::map< std::pair< uint64, uint64 >, RateBucket_t >::iterator iter = m_mapRateBuckets.find( key );
+	if ( iter == m_mapRateBuckets.end() )
+	{
+		RateBucket_t bucket;
+		bucket.m_flTokens = AUTH_RATE_LIMIT_BURST;
+		bucket.m_ulLastTick = ulTickCount;
+		iter = m_mapRateBuckets.insert( std::make_pair( key, bucket ) ).first;
+	}
+
+	RateBucket_t &bucket = iter->second;
+	bucket.m_flTokens = MIN( (float)AUTH_RATE_LIMIT_BURST, bucket.m_flTokens + ( ulTickCount - bucket.m_ulLastTick ) * AUTH_RATE_LIMIT_PER_SECOND / 1000.0f );
+	bucket.m_ulLastTick = ulTickCount;
+	if ( bucket.m_flTokens < 1.0f )
+	{
+		++m_Stats.m_cRateLimited;
+		return false;
+	}
+
+	bucket.m_flTokens -= 1.0f;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Take an entry off the free list for a new connection, and start
+//			its clock
+//-----------------------------------------------------------------------------
+uint32 CAuthPipeline::AddConnection( HSteamNetConnection hConn, uint64 ulTickCount )
+{
+	uint32 unIndex = m_unFirstFree;
+	if ( unIndex == k_unInvalidIndex )
+		return k_unInvalidIndex;
+
+	PendingAuth_t &entry = m_vecEntries[unIndex];
+	m_unFirstFree = entry.m_unNextFree;
+	entry.m_eState = k_EPendingAuthAwaitingTicket;
+	entry.m_hConn = hConn;
+	entry.m_steamID = CSteamID();
+	entry.m_ulTicketTick = 0;
+	++entry.m_unGeneration;
+	++m_cPending;
+	++m_Stats.m_cConnections;
+
+	entry.m_hTimeout = m_pTimers->Arm( ulTickCount + AUTH_TIMEOUT_MILLISECONDS, this, unIndex );
+
+	return unIndex;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Logon a connection's user data points at, if it's still the
+//			connection's
+//-----------------------------------------------------------------------------
+uint32 CAuthPipeline::FindConnection( HSteamNetConnection hConn, int64 nUserData ) const
+{
+	if ( nUserData > -2 )
+		return k_unInvalidIndex;
+
+	int64 nIndex = -2 - nUserData;
+	if ( nIndex >= (int64)m_vecEntries.size() )
+		return k_unInvalidIndex;
+
+	const PendingAuth_t &entry = m_vecEntries[(uint32)nIndex];
+	if ( entry.m_eState == k_EPendingAuthFree || entry.m_hConn != hConn )
+		return k_unInvalidIndex;
+
+	return (uint32)nIndex;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: A ticket arrived.  It goes straight to the validator if there's
+//			room and nothing ahead of it, otherwise it's copied and queued.
+//-----------------------------------------------------------------------------
+bool CAuthPipeline::BOnTicketReceived( uint32 unIndex, CSteamID steamID, const void *pubTicket, uint32 cubTicket, uint64 ulTickCount )
+{
+	if ( unIndex >= m_vecEntries.size() )
+		return false;
+	if ( m_vecEntries[unIndex].m_eState != k_EPendingAuthAwaitingTicket )
+		return true;
+
+	if ( m_mapSteamIDToEntry.Find( steamID ) != CSteamIDSlotMap::k_unInvalidSlot )
+	{
+		++m_Stats.m_cDuplicates;
+		return false;
+	}
+
+	PendingAuth_t &entry = m_vecEntries[unIndex];
+	entry.m_steamID = steamID;
+	entry.m_ulTicketTick = ulTickCount;
+	m_mapSteamIDToEntry.Insert( steamID, unIndex );
+
+	cubTicket = MIN( cubTicket, (uint32)AUTH_MAX_TICKET_BYTES );
+	if ( m_cInFlight < AUTH_MAX_VALIDATIONS_IN_FLIGHT && !m_cQueued )
+	{
+		StartValidation( unIndex, pubTicket, cubTicket, ulTickCount );
+		return true;
+	}
+
+	entry.m_eState = k_EPendingAuthQueued;
+	entry.m_vecTicket.assign( (const uint8 *)pubTicket, (const uint8 *)pubTicket + cubTicket );
+
+	PendingAuthRef_t ref;
+	ref.m_unIndex = unIndex;
+	ref.m_unGeneration = entry.m_unGeneration;
+	m_dequeQueued.push_back( ref );
+	++m_cQueued;
+	m_Stats.m_cMaxQueued = MAX( m_Stats.m_cMaxQueued, m_cQueued );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Hand a ticket to the validator, finishing now if it answers now
+//-----------------------------------------------------------------------------
+void CAuthPipeline::StartValidation( uint32 unIndex, const void *pubTicket, uint32 cubTicket, uint64 ulTickCount )
+{
+	PendingAuth_t &entry = m_vecEntries[unIndex];
+	entry.m_eState = k_EPendingAuthValidating;
+	++m_cInFlight;
+	m_Stats.m_cMaxInFlight = MAX( m_Stats.m_cMaxInFlight, m_cInFlight );
+
+	EAuthValidation eValidation = m_pValidator->BeginValidation( entry.m_steamID, pubTicket, cubTicket, ulTickCount );
+	if ( eValidation == k_EAuthValidationAccepted )
+		Finish( unIndex, k_EAuthResultAccepted, ulTickCount );
+	else if ( eValidation == k_EAuthValidationRejected )
+		Finish( unIndex, k_EAuthResultRejected, ulTickCount );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: The validator answered
+//-----------------------------------------------------------------------------
+void CAuthPipeline::OnValidationResult( CSteamID steamID, bool bAccepted, uint64 ulTickCount )
+{
+	uint32 unIndex = m_mapSteamIDToEntry.Find( steamID );
+	if ( unIndex == CSteamIDSlotMap::k_unInvalidSlot || m_vecEntries[unIndex].m_eState != k_EPendingAuthValidating )
+		return;
+
+	Finish( unIndex, bAccepted ? k_EAuthResultAccepted : k_EAuthResultRejected, ulTickCount );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Forget a logon and tell the listener how it went.  Only a player
+//			we let in keeps their validation, the server ends it when they leave.
+//-----------------------------------------------------------------------------
+void CAuthPipeline::Finish( uint32 unIndex, EAuthResult eResult, uint64 ulTickCount )
+{
+	PendingAuth_t &entry = m_vecEntries[unIndex];
+	if ( entry.m_eState == k_EPendingAuthValidating )
+	{
+		--m_cInFlight;
+		if ( eResult != k_EAuthResultAccepted )
+			m_pValidator->EndValidation( entry.m_steamID );
+	}
+	else if ( entry.m_eState == k_EPendingAuthQueued )
+	{
+		--m_cQueued;
+	}
+
+	switch ( eResult )
+	{
+	case k_EAuthResultAccepted:
+		++m_Stats.m_cAccepted;
+		m_Stats.m_TicketMilliseconds.AddSample( ulTickCount - entry.m_ulTicketTick );
+		break;
+	case k_EAuthResultRejected:
+		++m_Stats.m_cRejected;
+		m_Stats.m_TicketMilliseconds.AddSample( ulTickCount - entry.m_ulTicketTick );
+		break;
+	case k_EAuthResultTimedOut:
+		++m_Stats.m_cTimedOut;
+		break;
+	}
+
+	HSteamNetConnection hConn = entry.m_hConn;
+	CSteamID steamID = entry.m_steamID;
+	Free( unIndex );
+
+	if ( m_pListener )
+		m_pListener->OnAuthFinished( hConn, steamID, eResult );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: A connection went away part way through logging on
+//-----------------------------------------------------------------------------
+void CAuthPipeline::RemoveConnection( uint32 unIndex )
+{
+	if ( unIndex >= m_vecEntries.size() )
+		return;
+
+	PendingAuth_t &entry = m_vecEntries[unIndex];
+	if ( entry.m_eState == k_EPendingAuthFree )
+		return;
+
+	if ( entry.m_eState == k_EPendingAuthValidating )
+	{
+		--m_cInFlight;
+		m_pValidator->EndValidation( entry.m_steamID );
+	}
+	else if ( entry.m_eState == k_EPendingAuthQueued )
+	{
+		--m_cQueued;
+	}
+
+	++m_Stats.m_cAbandoned;
+	Free( unIndex );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Put an entry back on the free list and stop its clock.  Records
+//			of it still in the queue are skipped when they come up.
+//-----------------------------------------------------------------------------
+void CAuthPipeline::Free( uint32 unIndex )
+{
+	PendingAuth_t &entry = m_vecEntries[unIndex];
+	m_pTimers->Cancel( entry.m_hTimeout );
+	entry.m_hTimeout = k_hTimerInvalid;
+	m_mapSteamIDToEntry.Remove( entry.m_steamID, unIndex );
+	entry.m_eState = k_EPendingAuthFree;
+	entry.m_hConn = k_HSteamNetConnection_Invalid;
+	entry.m_steamID = CSteamID();
+	entry.m_vecTicket.clear();
+	entry.m_unNextFree = m_unFirstFree;
+	m_unFirstFree = unIndex;
+	--m_cPending;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Collect answers, then start as many queued tickets as there's
+//			room for this frame
+//-----------------------------------------------------------------------------
+void CAuthPipeline::RunFrame( uint64 ulTickCount )
+{
+	m_pValidator->RunFrame( ulTickCount, this );
+
+	uint32 cStarted = 0;
+	while ( !m_dequeQueued.empty() && m_cInFlight < AUTH_MAX_VALIDATIONS_IN_FLIGHT && cStarted < AUTH_MAX_VALIDATIONS_STARTED_PER_FRAME )
+	{
+		PendingAuthRef_t ref = m_dequeQueued.front();
+		m_dequeQueued.pop_front();
+		if ( !BIsCurrent( ref ) || m_vecEntries[ref.m_unIndex].m_eState != k_EPendingAuthQueued )
+			continue;
+
+		--m_cQueued;
+		++cStarted;
+		const std::vector< uint8 > &vecTicket = m_vecEntries[ref.m_unIndex].m_vecTicket;
+		StartValidation( ref.m_unIndex, vecTicket.empty() ? NULL : &vecTicket[0], (uint32)vecTicket.size(), ulTickCount );
+	}
+
+	// Forget addresses that have earned back their whole burst, they're the same as new
+	if ( ulTickCount - m_ulLastPruneTick >= AUTH_RATE_LIMIT_PRUNE_MILLISECONDS )
+	{
+		m_ulLastPruneTick = ulTickCount;
+		std::map< std::pair< uint64, uint64 >, RateBucket_t >::iterator iter = m_mapRateBuckets.begin();
+		while ( iter != m_mapRateBuckets.end() )
+		{
+			if ( iter->second.m_flTokens + ( ulTickCount - iter->second.m_ulLastTick ) * AUTH_RATE_LIMIT_PER_SECOND / 1000.0f >= AUTH_RATE_LIMIT_BURST )
+				m_mapRateBuckets.erase( iter++ );
+			else
+				++iter;
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: A logon has taken too long.  Finishing it cancels the timer, which
+//			has already fired, so that's forgotten first.
+//-----------------------------------------------------------------------------
+void CAuthPipeline::OnTimerExpired( uint64 ulContext, uint64 ulTickCount )
+{
+	uint32 unIndex = (uint32)ulContext;
+	if ( unIndex >= m_vecEntries.size() || m_vecEntries[unIndex].m_eState == k_EPendingAuthFree )
+		return;
+
+	m_vecEntries[unIndex].m_hTimeout = k_hTimerInvalid;
+	Finish( unIndex, k_EAuthResultTimedOut, ulTickCount );
+}
@@ -0,0 +1,302 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Takes players from a new connection to being let in, checking their
+//			auth tickets a bounded number at a time
+//
+//=============================================================================
+
+#ifndef AUTHPIPELINE_H
+#define AUTHPIPELINE_H
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "SteamIDSlotMap.h"
+#include "TickProfiler.h"
+#include "TimerWheel.h"
+#include "steam/steamnetworkingtypes.h"
+
+class CAuthPipeline;
+
+// Longest a connection has from being accepted to being let in, sending its ticket included
+#define AUTH_TIMEOUT_MILLISECONDS 10000
+
+// Most tickets being checked at once, the rest wait their turn.  Steam's back end (or whatever
+// else checks them) answers a storm of logons no faster for being sent them all at once.
+#define AUTH_MAX_VALIDATIONS_IN_FLIGHT 32
+
+// Most waiting tickets started each frame, so a storm doesn't all land on one frame
+#define AUTH_MAX_VALIDATIONS_STARTED_PER_FRAME 16
+
+// New connections one address can make: a burst this big, then this many a second.  Local
+// connections, which everything in a load test is, aren't limited.
+#define AUTH_RATE_LIMIT_BURST 8
+#define AUTH_RATE_LIMIT_PER_SECOND 2
+
+// How often addresses that have gone quiet are forgotten
+#define AUTH_RATE_LIMIT_PRUNE_MILLISECONDS 10000
+
+// Biggest ticket we take, the same as the message carrying it holds
+#define AUTH_MAX_TICKET_BYTES 1024
+
+// What a validator made of a ticket
+enum EAuthValidation
+{
+	k_EAuthValidationPending,		// The answer comes later, through CAuthPipeline::OnValidationResult
+	k_EAuthValidationAccepted,
+	k_EAuthValidationRejected,
+};
+
+// How a logon ended
+enum EAuthResult
+{
+	k_EAuthResultAccepted,
+	k_EAuthResultRejected,
+	k_EAuthResultTimedOut,
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Checks players' auth tickets for a CAuthPipeline
+//-----------------------------------------------------------------------------
+class IAuthValidator
+{
+public:
+	virtual ~IAuthValidator() {}
+
+	// Start checking a player's ticket
+	virtual EAuthValidation BeginValidation( CSteamID steamID, const void *pubTicket, uint32 cubTicket, uint64 ulTickCount ) = 0;
+
+	// Forget a player, whether they're still being checked or have been let in
+	virtual void EndValidation( CSteamID steamID ) = 0;
+
+	// Hand the pipeline any answers that are ready, for validators that don't get theirs
+	// through Steam callbacks
+	virtual void RunFrame( uint64 ulTickCount, CAuthPipeline *pPipeline ) {}
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Checks tickets with Steam.  Answers come in ValidateAuthTicketResponse_t
+//			callbacks, which the server passes on to the pipeline.
+//-----------------------------------------------------------------------------
+class CSteamAuthValidator : public IAuthValidator
+{
+public:
+	EAuthValidation BeginValidation( CSteamID steamID, const void *pubTicket, uint32 cubTicket, uint64 ulTickCount );
+	void EndValidation( CSteamID steamID );
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Takes everyone at their word.  Nobody outside the process can reach
+//			an in-process transport, and there's no Steam to check them with.
+//-----------------------------------------------------------------------------
+class CTrustingAuthValidator : public IAuthValidator
+{
+public:
+	EAuthValidation BeginValidation( CSteamID steamID, const void *pubTicket, uint32 cubTicket, uint64 ulTickCount ) { return k_EAuthValidationAccepted; }
+	void EndValidation( CSteamID steamID ) {}
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Stands in for a back end that takes a while to answer, for load
+//			testing logons without Steam.  Seeded, so a run can be repeated.
+//-----------------------------------------------------------------------------
+class CSimulatedAuthValidator : public IAuthValidator
+{
+public:
+	// Answers take unLatencyMilliseconds plus up to unJitterMilliseconds more, and
+	// unFailPercent of tickets are rejected
+	CSimulatedAuthValidator( uint32 unLatencyMilliseconds, uint32 unJitterMilliseconds, uint32 unFailPercent, uint32 unSeed );
+
+	EAuthValidation BeginValidation( CSteamID steamID, const void *pubTicket, uint32 cubTicket, uint64 ulTickCount );
+	void EndValidation( CSteamID steamID );
+	void RunFrame( uint64 ulTickCount, CAuthPipeline *pPipeline );
+
+private:
+	uint32 RandomInt( uint32 unRange );
+
+	struct PendingAnswer_t
+	{
+		uint64 m_ulDueTick;
+		CSteamID m_steamID;
+		bool m_bAccepted;
+	};
+
+	uint32 m_unLatencyMilliseconds;
+	uint32 m_unJitterMilliseconds;
+	uint32 m_unFailPercent;
+	uint64 m_ulRandomState;
+
+	// Answers not handed over yet, never more than the pipeline has in flight
+	std::vector< PendingAnswer_t > m_vecPendingAnswers;
+	std::vector< PendingAnswer_t > m_vecDueAnswers;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Told how each logon ended.  Called from inside the pipeline, once
+//			it has forgotten the logon.
+//-----------------------------------------------------------------------------
+class IAuthPipelineListener
+{
+public:
+	virtual void OnAuthFinished( HSteamNetConnection hConn, CSteamID steamID, EAuthResult eResult ) = 0;
+};
+
+
+// What a pipeline has done since it was last reset
+struct AuthPipelineStats_t
+{
+	uint64 m_cConnections;			// Connections that started logging on
+	uint64 m_cRateLimited;			// Connections turned away for coming too fast from one address
+	uint64 m_cDuplicates;			// Tickets turned away for a Steam ID that's already logging on
+	uint64 m_cAccepted;
+	uint64 m_cRejected;
+	uint64 m_cTimedOut;
+	uint64 m_cAbandoned;			// Connections that closed before they finished logging on
+	uint32 m_cMaxInFlight;			// Most tickets being checked at once
+	uint32 m_cMaxQueued;			// Most tickets waiting their turn at once
+	CCycleHistogram m_TicketMilliseconds;	// From a ticket arriving to its answer, for answered tickets
+
+	void Reset();
+	void Merge( const AuthPipelineStats_t &other );
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Pending logons for one server, from accepting the connection to
+//			letting the player in or turning them away.  Found by the index
+//			they're given when accepted, which the server tags their connection
+//			with, or by the Steam ID in their ticket.  Tickets are checked at
+//			most AUTH_MAX_VALIDATIONS_IN_FLIGHT at a time and the rest wait in
+//			order, and any logon taking longer than AUTH_TIMEOUT_MILLISECONDS
+//			is timed out by a timer on the server's wheel.  Sized once for the
+//			most players the server holds.
+//-----------------------------------------------------------------------------
+class CAuthPipeline : public ITimerListener
+{
+public:
+	// Value AddConnection() returns when it has no room
+	static const uint32 k_unInvalidIndex = 0xFFFFFFFF;
+
+	CAuthPipeline();
+
+	// Make room for unMaxPending logons at once, told to pListener.  Tickets are checked
+	// with pValidator, and logons timed out on pTimers, neither of which we own.
+	void Init( uint32 unMaxPending, IAuthValidator *pValidator, IAuthPipelineListener *pListener, CTimerWheel *pTimers );
+
+	// Check tickets with something else from now on.  Only between logons.
+	void SetValidator( IAuthValidator *pValidator ) { m_pValidator = pValidator; }
+	IAuthValidator *GetValidator() { return m_pValidator; }
+
+	// Whether another connection from an address is within its rate, taking one if it is
+	bool BAllowConnectionFrom( const SteamNetworkingIPAddr &addrRemote, uint64 ulTickCount );
+
+	// Start a logon for a connection we've accepted, returning the index it can be found
+	// by, or k_unInvalidIndex if we have no room
+	uint32 AddConnection( HSteamNetConnection hConn, uint64 ulTickCount );
+
+	// Index of the logon a connection tagged with nUserData belongs to, or k_unInvalidIndex
+	uint32 FindConnection( HSteamNetConnection hConn, int64 nUserData ) const;
+
+	// Connection user data carrying a logon's index, always negative so it can't be
+	// mistaken for a player slot
+	static int64 GetConnectionUserData( uint32 unIndex ) { return -2 - (int64)unIndex; }
+
+	// A logon's connection sent its ticket.  Starts checking it, or queues it if too many
+	// are being checked, and ignores it if the logon already sent one.  False if another
+	// logon has the same Steam ID, in which case nothing changes and it's up to the caller.
+	// The answer can come before this returns.
+	bool BOnTicketReceived( uint32 unIndex, CSteamID steamID, const void *pubTicket, uint32 cubTicket, uint64 ulTickCount );
+
+	// A validator's answer for a Steam ID.  Ignored if nobody with it is being checked.
+	void OnValidationResult( CSteamID steamID, bool bAccepted, uint64 ulTickCount );
+
+	// A logon's connection closed before it finished.  Nobody is told.
+	void RemoveConnection( uint32 unIndex );
+
+	// Collect answers and start queued tickets
+	void RunFrame( uint64 ulTickCount );
+
+	// A logon's timeout came due, ulContext is its index
+	void OnTimerExpired( uint64 ulContext, uint64 ulTickCount );
+
+	// How many logons are under way
+	uint32 GetPendingCount() const { return m_cPending; }
+
+	const AuthPipelineStats_t &GetStats() const { return m_Stats; }
+	void ResetStats() { m_Stats.Reset(); }
+
+private:
+	enum EPendingAuthState
+	{
+		k_EPendingAuthFree,
+		k_EPendingAuthAwaitingTicket,
+		k_EPendingAuthQueued,
+		k_EPendingAuthValidating,
+	};
+
+	struct PendingAuth_t
+	{
+		EPendingAuthState m_eState;
+		HSteamNetConnection m_hConn;
+		CSteamID m_steamID;
+		uint64 m_ulTicketTick;
+		uint32 m_unGeneration;		// Bumped each time the entry is reused, so stale queue records can be told apart
+		uint32 m_unNextFree;
+		TimerHandle_t m_hTimeout;
+		std::vector< uint8 > m_vecTicket;	// Only filled while queued, keeps its capacity for the next logon
+	};
+
+	// An entry as it was when a record of it was queued
+	struct PendingAuthRef_t
+	{
+		uint32 m_unIndex;
+		uint32 m_unGeneration;
+	};
+
+	struct RateBucket_t
+	{
+		float m_flTokens;
+		uint64 m_ulLastTick;
+	};
+
+	bool BIsCurrent( const PendingAuthRef_t &ref ) const { return m_vecEntries[ref.m_unIndex].m_unGeneration == ref.m_unGeneration && m_vecEntries[ref.m_unIndex].m_eState != k_EPendingAuthFree; }
+
+	// Hand a ticket to the validator
+	void StartValidation( uint32 unIndex, const void *pubTicket, uint32 cubTicket, uint64 ulTickCount );
+
+	// Forget a logon and tell the listener how it ended
+	void Finish( uint32 unIndex, EAuthResult eResult, uint64 ulTickCount );
+
+	// Put an entry back on the free list
+	void Free( uint32 unIndex );
+
+	IAuthValidator *m_pValidator;
+	IAuthPipelineListener *m_pListener;
+	CTimerWheel *m_pTimers;
+
+	std::vector< PendingAuth_t > m_vecEntries;
+	uint32 m_unFirstFree;
+	uint32 m_cPending;
+	uint32 m_cInFlight;
+	uint32 m_cQueued;
+
+	// Entries with a ticket, by Steam ID
+	CSteamIDSlotMap m_mapSteamIDToEntry;
+
+	// Tickets waiting their turn, oldest first
+	std::deque< PendingAuthRef_t > m_dequeQueued;
+
+	// Each address's connection allowance, keyed on its IPv6 (or mapped IPv4) address
+	std::map< std::pair< uint64, uint64 >, RateBucket_t > m_mapRateBuckets;
+	uint64 m_ulLastPruneTick;
+
+	AuthPipelineStats_t m_Stats;
+};
+
+#endif // AUTHPIPELINE_H
@@ -0,0 +1,235 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Reading and writing values a few bits at a time, and quantizing
+//			floats to fit in them
+//
+//=============================================================================
+
+#ifndef BITBUFFER_H
+#define BITBUFFER_H
+
+//-----------------------------------------------------------------------------
+// Purpose: Number of bits needed to hold every value from 0 to unRange
+//-----------------------------------------------------------------------------
+constexpr uint32 BitsForRange( uint64 unRange )
+{
+	uint32 cBits = 0;
+	while ( unRange )
+	{
+		++cBits;
+		unRange >>= 1;
+	}
+	return cBits;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Map a float in [flMin, flMax] onto cBits bits, rounding to the
+//			nearest step.  Out of range values (and NaN) are clamped.  The top
+//			code is left unused so the range has an even number of steps and
+//			its midpoint, zero for symmetric ranges, comes back exactly.
+//-----------------------------------------------------------------------------
+inline uint32 QuantizeFloat( float flValue, float flMin, float flMax, uint32 cBits )
+{
+	uint32 unSteps = ( 1u << cBits ) - 2;
+	if ( !( flValue > flMin ) )
+		return 0;
+	if ( flValue >= flMax )
+		return unSteps;
+	return (uint32)( ( flValue - flMin ) * ( (float)unSteps / ( flMax - flMin ) ) + 0.5f );
+}
+
+inline float DequantizeFloat( uint32 unValue, float flMin, float flMax, uint32 cBits )
+{
+	uint32 unSteps = ( 1u << cBits ) - 2;
+	return flMin + (float)MIN( unValue, unSteps ) * ( ( flMax - flMin ) / (float)unSteps );
+}
+
+// Most a value inside the range can change by going through QuantizeFloat and DequantizeFloat
+inline float GetQuantizationError( float flMin, float flMax, uint32 cBits )
+{
+	return ( flMax - flMin ) / (float)( ( 1u << cBits ) - 2 ) * 0.5f;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes bits into a caller supplied buffer, lowest bit first.  Runs
+//			off the end are caught and flagged rather than written.
+//-----------------------------------------------------------------------------
+class CBitWriter
+{
+public:
+	CBitWriter( uint8 *pubData, uint32 cubData )
+	{
+		m_pubData = pubData;
+		m_cubData = cubData;
+		m_iByte = 0;
+		m_ulScratch = 0;
+		m_cScratchBits = 0;
+		m_bOverflowed = false;
+	}
+
+	// Write the low cBits (at most 32) of unValue
+	void WriteBits( uint32 unValue, uint32 cBits )
+	{
+		if ( cBits < 32 )
+			unValue &= ( 1u << cBits ) - 1;
+		m_ulScratch |= (uint64)unValue << m_cScratchBits;
+		m_cScratchBits += cBits;
+		while ( m_cScratchBits >= 8 )
+		{
+			WriteScratchByte();
+		}
+	}
+
+	void WriteBool( bool bValue ) { WriteBits( bValue ? 1 : 0, 1 ); }
+
+	void WriteUint64( uint64 ulValue )
+	{
+		WriteBits( (uint32)ulValue, 32 );
+		WriteBits( (uint32)( ulValue >> 32 ), 32 );
+	}
+
+	// Write an integer clamped to [nMin, nMax], using just enough bits for the range
+	void WriteClampedInt( int64 nValue, int64 nMin, int64 nMax )
+	{
+		nValue = MAX( nMin, MIN( nValue, nMax ) );
+		WriteBits( (uint32)( nValue - nMin ), BitsForRange( (uint64)( nMax - nMin ) ) );
+	}
+
+	void WriteQuantizedFloat( float flValue, float flMin, float flMax, uint32 cBits )
+	{
+		WriteBits( QuantizeFloat( flValue, flMin, flMax, cBits ), cBits );
+	}
+
+	// Fill cBits with zeroes, for a record that isn't present but still takes up its space
+	void WriteZeroBits( uint32 cBits )
+	{
+		for ( ; cBits > 32; cBits -= 32 )
+			WriteBits( 0, 32 );
+		WriteBits( 0, cBits );
+	}
+
+	// Pad with zeroes to the next whole byte, the buffer is complete after this
+	void ByteAlign()
+	{
+		if ( m_cScratchBits )
+			WriteScratchByte();
+	}
+
+	uint32 GetBytesWritten() { return m_iByte; }
+	bool BOverflowed() { return m_bOverflowed; }
+
+private:
+	void WriteScratchByte()
+	{
+		if ( m_iByte < m_cubData )
+			m_pubData[m_iByte++] = (uint8)m_ulScratch;
+		else
+			m_bOverflowed = true;
+		m_ulScratch >>= 8;
+		m_cScratchBits = m_cScratchBits > 8 ? m_cScratchBits - 8 : 0;
+	}
+
+	uint8 *m_pubData;
+	uint32 m_cubData;
+	uint32 m_iByte;
+
+	// Bits written but not yet flushed to the buffer
+	uint64 m_ulScratch;
+	uint32 m_cScratchBits;
+
+	bool m_bOverflowed;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Reads back what CBitWriter wrote.  Reading past the end returns
+//			zeroes and flags the reader as overflowed.
+//-----------------------------------------------------------------------------
+class CBitReader
+{
+public:
+	CBitReader( const uint8 *pubData, uint32 cubData )
+	{
+		m_pubData = pubData;
+		m_cubData = cubData;
+		m_iByte = 0;
+		m_ulScratch = 0;
+		m_cScratchBits = 0;
+		m_bOverflowed = false;
+	}
+
+	// Read cBits (at most 32)
+	uint32 ReadBits( uint32 cBits )
+	{
+		while ( m_cScratchBits < cBits )
+		{
+			uint8 ubByte = 0;
+			if ( m_iByte < m_cubData )
+				ubByte = m_pubData[m_iByte++];
+			else
+				m_bOverflowed = true;
+			m_ulScratch |= (uint64)ubByte << m_cScratchBits;
+			m_cScratchBits += 8;
+		}
+
+		uint32 unValue = (uint32)m_ulScratch;
+		if ( cBits < 32 )
+			unValue &= ( 1u << cBits ) - 1;
+		m_ulScratch >>= cBits;
+		m_cScratchBits -= cBits;
+		return unValue;
+	}
+
+	bool ReadBool() { return ReadBits( 1 ) != 0; }
+
+	uint64 ReadUint64()
+	{
+		uint64 ulLow = ReadBits( 32 );
+		return ulLow | ( (uint64)ReadBits( 32 ) << 32 );
+	}
+
+	// Read an integer written by WriteClampedInt with the same range, clamped again in case the
+	// writer wasn't
+	int64 ReadClampedInt( int64 nMin, int64 nMax )
+	{
+		int64 nValue = nMin + (int64)ReadBits( BitsForRange( (uint64)( nMax - nMin ) ) );
+		return MIN( nValue, nMax );
+	}
+
+	float ReadQuantizedFloat( float flMin, float flMax, uint32 cBits )
+	{
+		return DequantizeFloat( ReadBits( cBits ), flMin, flMax, cBits );
+	}
+
+	void SkipBits( uint32 cBits )
+	{
+		for ( ; cBits > 32; cBits -= 32 )
+			ReadBits( 32 );
+		ReadBits( cBits );
+	}
+
+	// Skip the padding up to the next whole byte
+	void ByteAlign()
+	{
+		m_ulScratch >>= m_cScratchBits % 8;
+		m_cScratchBits -= m_cScratchBits % 8;
+	}
+
+	uint32 GetBytesRead() { return m_iByte - m_cScratchBits / 8; }
+	bool BOverflowed() { return m_bOverflowed; }
+
+private:
+	const uint8 *m_pubData;
+	uint32 m_cubData;
+	uint32 m_iByte;
+
+	// Bits read from the buffer but not yet returned
+	uint64 m_ulScratch;
+	uint32 m_cScratchBits;
+
+	bool m_bOverflowed;
+};
+
+#endif // BITBUFFER_H
@@ -0,0 +1,195 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Offline benchmark of the ship collision broadphase
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "CollisionBenchmark.h"
+#include "MatchGameEngine.h"
+#include "SpaceWarServer.h"
+#include <chrono>
+
+// How long to simulate each match size for
+#define COLLISION_BENCHMARK_FRAMES 240
+#define COLLISION_BENCHMARK_TICKS_PER_FRAME 16
+
+// Viewport the benchmark matches run in
+#define COLLISION_BENCHMARK_VIEWPORT_WIDTH 1024
+#define COLLISION_BENCHMARK_VIEWPORT_HEIGHT 768
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Small deterministic random number generator, so both copies of a
+//			match start out the same
+//-----------------------------------------------------------------------------
+static uint32 CollisionBenchmarkRandom( uint32 *punSeed )
+{
+	*punSeed = *punSeed * 1664525 + 1013904223;
+	return *punSeed >> 8;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: A match worth of ships, without the server around them
+//-----------------------------------------------------------------------------
+class CCollisionBenchmarkMatch
+{
+public:
+	CCollisionBenchmarkMatch( uint32 unShips, bool bUseGrid );
+	~CCollisionBenchmarkMatch();
+
+	// Simulate a frame, returns how long the collision check took in microseconds
+	double RunFrame( uint64 ulTickCount );
+
+	// Does the other match have exactly the same ships, photon beams and hits as us?
+	bool BMatches( CCollisionBenchmarkMatch &other );
+
+private:
+	CMatchGameEngine m_GameEngine;
+	CVectorEntityStatePool m_EntityStatePool;
+	CCollisionGrid m_CollisionGrid;
+	bool m_bUseGrid;
+	std::vector< CShip * > m_vecpShips;
+	std::vector< ClientSpaceWarUpdateData_t > m_vecShipInput;
+	std::vector< bool > m_vecExplodingShips;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor, scatters ships around the viewport all holding down fire
+//-----------------------------------------------------------------------------
+CCollisionBenchmarkMatch::CCollisionBenchmarkMatch( uint32 unShips, bool bUseGrid )
+	: m_GameEngine( COLLISION_BENCHMARK_VIEWPORT_WIDTH, COLLISION_BENCHMARK_VIEWPORT_HEIGHT )
+{
+	m_bUseGrid = bUseGrid;
+	m_CollisionGrid.Init( (float)COLLISION_BENCHMARK_VIEWPORT_WIDTH, (float)COLLISION_BENCHMARK_VIEWPORT_HEIGHT, COLLISION_GRID_CELL_SIZE );
+
+	uint32 unSeed = unShips;
+	m_vecShipInput.resize( unShips );
+	for ( uint32 i = 0; i < unShips; ++i )
+	{
+		float xPos = (float)( CollisionBenchmarkRandom( &unSeed ) % COLLISION_BENCHMARK_VIEWPORT_WIDTH );
+		float yPos = (float)( CollisionBenchmarkRandom( &unSeed ) % COLLISION_BENCHMARK_VIEWPORT_HEIGHT );
+		float flRotation = (float)( CollisionBenchmarkRandom( &unSeed ) % 628 ) / 100.0f;
+
+		CShip *pShip = new CShip( &m_GameEngine, true, xPos, yPos, GetPlayerColor( i ), &m_EntityStatePool );
+		pShip->SetInitialRotation( flRotation );
+		m_vecpShips.push_back( pShip );
+
+		// Everyone fires, some turn and thrust so the photon beams spread out, and some have
+		// shields so both outcomes of a hit get exercised
+		ClientSpaceWarUpdateData_t &input = m_vecShipInput[i];
+		memset( &input, 0, sizeof( input ) );
+		input.SetFirePressed( true );
+		input.SetTurnLeftPressed( i % 3 == 1 );
+		input.SetTurnRightPressed( i % 3 == 2 );
+		input.SetForwardThrustersPressed( i % 2 == 0 );
+		input.SetShieldStrength( i % 4 == 0 ? 255 : 0 );
+	}
+
+	m_vecExplodingShips.assign( unShips, false );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor
+//-----------------------------------------------------------------------------
+CCollisionBenchmarkMatch::~CCollisionBenchmarkMatch()
+{
+	for ( uint32 i = 0; i < m_vecpShips.size(); ++i )
+		delete m_vecpShips[i];
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Simulate a frame.  Hit ships aren't blown up, so the load stays the
+//			same for the whole run.
+//-----------------------------------------------------------------------------
+double CCollisionBenchmarkMatch::RunFrame( uint64 ulTickCount )
+{
+	m_GameEngine.SetGameTickCount( ulTickCount );
+
+	for ( uint32 i = 0; i < m_vecpShips.size(); ++i )
+	{
+		m_vecpShips[i]->OnReceiveClientUpdate( &m_vecShipInput[i] );
+		m_vecpShips[i]->RunFrame();
+	}
+
+	m_vecExplodingShips.assign( m_vecpShips.size(), false );
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	CSpaceWarServer::CheckForShipCollisions( &m_vecpShips[0], (uint32)m_vecpShips.size(), m_bUseGrid ? &m_CollisionGrid : NULL, m_vecExplodingShips );
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration< double, std::micro >( end - start ).count();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Compare everything a client would see, plus who got hit
+//-----------------------------------------------------------------------------
+bool CCollisionBenchmarkMatch::BMatches( CCollisionBenchmarkMatch &other )
+{
+	if ( m_vecpShips.size() != other.m_vecpShips.size() || m_vecExplodingShips != other.m_vecExplodingShips )
+		return false;
+
+	for ( uint32 i = 0; i < m_vecpShips.size(); ++i )
+	{
+		ServerShipUpdateData_t updateData, otherUpdateData;
+		memset( &updateData, 0, sizeof( updateData ) );
+		memset( &otherUpdateData, 0, sizeof( otherUpdateData ) );
+		m_vecpShips[i]->BuildServerUpdate( &updateData );
+		other.m_vecpShips[i]->BuildServerUpdate( &otherUpdateData );
+		if ( memcmp( &updateData, &otherUpdateData, sizeof( updateData ) ) != 0 )
+			return false;
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Run the benchmark for each match size
+//-----------------------------------------------------------------------------
+bool RunCollisionBenchmark()
+{
+	bool bAllMatched = true;
+	char rgchBuffer[256];
+
+	OutputDebugString( "Ships   All pairs (us/frame)   Grid (us/frame)   Speedup\n" );
+
+	for ( uint32 unShips = 4; unShips <= MAX_PLAYERS_PER_SERVER_LIMIT; unShips *= 2 )
+	{
+		CCollisionBenchmarkMatch allPairsMatch( unShips, false );
+		CCollisionBenchmarkMatch gridMatch( unShips, true );
+
+		double flAllPairsMicroseconds = 0.0;
+		double flGridMicroseconds = 0.0;
+		bool bMatched = true;
+
+		uint64 ulTickCount = 1000;
+		for ( uint32 iFrame = 0; iFrame < COLLISION_BENCHMARK_FRAMES && bMatched; ++iFrame )
+		{
+			ulTickCount += COLLISION_BENCHMARK_TICKS_PER_FRAME;
+			flAllPairsMicroseconds += allPairsMatch.RunFrame( ulTickCount );
+			flGridMicroseconds += gridMatch.RunFrame( ulTickCount );
+			bMatched = allPairsMatch.BMatches( gridMatch );
+		}
+
+		if ( !bMatched )
+		{
+			sprintf_safe( rgchBuffer, "%5u   grid and all pairs results differ\n", unShips );
+			OutputDebugString( rgchBuffer );
+			bAllMatched = false;
+			continue;
+		}
+
+		sprintf_safe( rgchBuffer, "%5u   %20.1f   %15.1f   %6.1fx\n", unShips,
+			flAllPairsMicroseconds / COLLISION_BENCHMARK_FRAMES, flGridMicroseconds / COLLISION_BENCHMARK_FRAMES,
+			flGridMicroseconds > 0.0 ? flAllPairsMicroseconds / flGridMicroseconds : 0.0 );
+		OutputDebugString( rgchBuffer );
+	}
+
+	return bAllMatched;
+}
@@ -0,0 +1,15 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Offline benchmark of the ship collision broadphase
+//
+//=============================================================================
+
+#ifndef COLLISIONBENCHMARK_H
+#define COLLISIONBENCHMARK_H
+
+// Simulate matches of 4 up to MAX_PLAYERS_PER_SERVER_LIMIT ships twice, once checking collisions
+// with the grid and once checking every pair, and report the time each took.  Returns false if
+// the two ever disagree.
+bool RunCollisionBenchmark();
+
+#endif // COLLISIONBENCHMARK_H
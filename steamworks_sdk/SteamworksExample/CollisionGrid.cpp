@@ -0,0 +1,289 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Uniform grid broadphase for vector entity collisions
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "CollisionGrid.h"
+#include "VectorEntity.h"
+#include <algorithm>
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CCollisionGrid::CCollisionGrid()
+{
+	m_flWidth = 0.0f;
+	m_flHeight = 0.0f;
+	m_flMinCellSize = 0.0f;
+	m_flCellWidth = 0.0f;
+	m_flCellHeight = 0.0f;
+	m_unCellsWide = 0;
+	m_unCellsHigh = 0;
+	m_flMaxCellRadius = 0.0f;
+	m_pStatePool = NULL;
+	m_unUpdatePass = 0;
+	m_unQuery = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Set the area covered and the cell size
+//-----------------------------------------------------------------------------
+void CCollisionGrid::Init( float flWidth, float flHeight, float flMinCellSize )
+{
+	if ( flWidth == m_flWidth && flHeight == m_flHeight && flMinCellSize == m_flMinCellSize && !m_vecCellHead.empty() )
+		return;
+
+	Clear();
+
+	m_flWidth = flWidth;
+	m_flHeight = flHeight;
+	m_flMinCellSize = flMinCellSize;
+
+	// Whole number of cells across so the neighbors of an edge cell line up with the cells on
+	// the opposite edge, each at least the minimum size
+	m_unCellsWide = MAX( 1u, (uint32)( flWidth / flMinCellSize ) );
+	m_unCellsHigh = MAX( 1u, (uint32)( flHeight / flMinCellSize ) );
+	m_flCellWidth = MAX( flWidth / m_unCellsWide, flMinCellSize );
+	m_flCellHeight = MAX( flHeight / m_unCellsHigh, flMinCellSize );
+	m_flMaxCellRadius = flMinCellSize / 2.0f;
+
+	m_vecCellHead.assign( m_unCellsWide * m_unCellsHigh + 1, VECTORENTITY_INVALID_SLOT );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Size the per slot and per owner arrays up front
+//-----------------------------------------------------------------------------
+void CCollisionGrid::Reserve( uint32 unSlots, uint32 unOwners )
+{
+	m_vecSlotCell.reserve( unSlots );
+	m_vecSlotNext.reserve( unSlots );
+	m_vecSlotPrev.reserve( unSlots );
+	m_vecSlotOwner.reserve( unSlots );
+	m_vecSlotUpdatePass.reserve( unSlots );
+	m_vecTrackedSlots.reserve( unSlots );
+	m_vecCandidateOwners.reserve( unOwners );
+	m_vecOwnerQuery.reserve( unOwners );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Start a pass of updates
+//-----------------------------------------------------------------------------
+void CCollisionGrid::BeginUpdate()
+{
+	++m_unUpdatePass;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Place or move the entity in the grid
+//-----------------------------------------------------------------------------
+void CCollisionGrid::UpdateEntity( CVectorEntity *pEntity, uint32 unOwner )
+{
+	CVectorEntityStatePool *pPool = pEntity->GetStatePool();
+	if ( !m_pStatePool )
+		m_pStatePool = pPool;
+
+	if ( pPool != m_pStatePool )
+	{
+		OutputDebugString( "Entities in a collision grid must share a state pool\n" );
+		return;
+	}
+
+	uint32 iSlot = pEntity->GetStateSlot();
+	if ( iSlot >= m_vecSlotCell.size() )
+	{
+		uint32 unSlots = pPool->GetSlotCount();
+		m_vecSlotCell.resize( unSlots, VECTORENTITY_INVALID_SLOT );
+		m_vecSlotNext.resize( unSlots, VECTORENTITY_INVALID_SLOT );
+		m_vecSlotPrev.resize( unSlots, VECTORENTITY_INVALID_SLOT );
+		m_vecSlotOwner.resize( unSlots, 0 );
+		m_vecSlotUpdatePass.resize( unSlots, 0 );
+	}
+
+	if ( unOwner >= m_vecOwnerQuery.size() )
+		m_vecOwnerQuery.resize( unOwner + 1, 0 );
+
+	uint32 iCell;
+	if ( pPool->m_vecCollisionRadius[iSlot] > m_flMaxCellRadius )
+		iCell = m_unCellsWide * m_unCellsHigh;
+	else
+		iCell = GetCellForPosition( pPool->m_vecXPos[iSlot], pPool->m_vecYPos[iSlot] );
+
+	if ( m_vecSlotCell[iSlot] == VECTORENTITY_INVALID_SLOT )
+	{
+		m_vecTrackedSlots.push_back( iSlot );
+		LinkSlot( iSlot, iCell );
+	}
+	else if ( m_vecSlotCell[iSlot] != iCell )
+	{
+		UnlinkSlot( iSlot );
+		LinkSlot( iSlot, iCell );
+	}
+
+	m_vecSlotOwner[iSlot] = unOwner;
+	m_vecSlotUpdatePass[iSlot] = m_unUpdatePass;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Remove anything that wasn't updated this pass
+//-----------------------------------------------------------------------------
+void CCollisionGrid::EndUpdate()
+{
+	uint32 unKept = 0;
+	for ( uint32 i = 0; i < m_vecTrackedSlots.size(); ++i )
+	{
+		uint32 iSlot = m_vecTrackedSlots[i];
+		if ( m_vecSlotUpdatePass[iSlot] == m_unUpdatePass )
+		{
+			m_vecTrackedSlots[unKept++] = iSlot;
+		}
+		else
+		{
+			UnlinkSlot( iSlot );
+			m_vecSlotCell[iSlot] = VECTORENTITY_INVALID_SLOT;
+		}
+	}
+	m_vecTrackedSlots.resize( unKept );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Get the owners of every entry that might collide with the entity
+//-----------------------------------------------------------------------------
+const std::vector< uint32 > &CCollisionGrid::GetCandidateOwners( CVectorEntity *pEntity )
+{
+	m_vecCandidateOwners.clear();
+	++m_unQuery;
+
+	if ( m_vecCellHead.empty() || pEntity->GetStatePool() != m_pStatePool )
+		return m_vecCandidateOwners;
+
+	uint32 iSlot = pEntity->GetStateSlot();
+	if ( m_pStatePool->m_vecCollisionRadius[iSlot] > m_flMaxCellRadius )
+	{
+		// Too big for the cell size to bound it, everything is a candidate
+		for ( uint32 i = 0; i < m_vecTrackedSlots.size(); ++i )
+		{
+			uint32 unOwner = m_vecSlotOwner[ m_vecTrackedSlots[i] ];
+			if ( m_vecOwnerQuery[unOwner] != m_unQuery )
+			{
+				m_vecOwnerQuery[unOwner] = m_unQuery;
+				m_vecCandidateOwners.push_back( unOwner );
+			}
+		}
+	}
+	else
+	{
+		uint32 iCell = GetCellForPosition( m_pStatePool->m_vecXPos[iSlot], m_pStatePool->m_vecYPos[iSlot] );
+		uint32 iCellX = iCell % m_unCellsWide;
+		uint32 iCellY = iCell / m_unCellsWide;
+
+		// The 3x3 block of cells around us, wrapping at the edges.  With fewer than three cells
+		// across the wrapped neighbors repeat, so only visit as many as there are.
+		uint32 unColumns = MIN( 3u, m_unCellsWide );
+		uint32 unRows = MIN( 3u, m_unCellsHigh );
+		for ( uint32 y = 0; y < unRows; ++y )
+		{
+			uint32 iRow = ( iCellY + m_unCellsHigh - 1 + y ) % m_unCellsHigh;
+			for ( uint32 x = 0; x < unColumns; ++x )
+			{
+				uint32 iColumn = ( iCellX + m_unCellsWide - 1 + x ) % m_unCellsWide;
+				AddCellOwners( iRow * m_unCellsWide + iColumn );
+			}
+		}
+
+		AddCellOwners( m_unCellsWide * m_unCellsHigh );
+	}
+
+	std::sort( m_vecCandidateOwners.begin(), m_vecCandidateOwners.end() );
+	return m_vecCandidateOwners;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Cell for a position
+//-----------------------------------------------------------------------------
+uint32 CCollisionGrid::GetCellForPosition( float flXPos, float flYPos )
+{
+	// Written so NaN lands in cell 0 too
+	uint32 iCellX = flXPos > 0.0f ? MIN( (uint32)( flXPos / m_flCellWidth ), m_unCellsWide - 1 ) : 0;
+	uint32 iCellY = flYPos > 0.0f ? MIN( (uint32)( flYPos / m_flCellHeight ), m_unCellsHigh - 1 ) : 0;
+	return iCellY * m_unCellsWide + iCellX;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Remove a slot from its cell list
+//-----------------------------------------------------------------------------
+void CCollisionGrid::UnlinkSlot( uint32 iSlot )
+{
+	uint32 iNext = m_vecSlotNext[iSlot];
+	uint32 iPrev = m_vecSlotPrev[iSlot];
+
+	if ( iPrev != VECTORENTITY_INVALID_SLOT )
+		m_vecSlotNext[iPrev] = iNext;
+	else
+		m_vecCellHead[ m_vecSlotCell[iSlot] ] = iNext;
+
+	if ( iNext != VECTORENTITY_INVALID_SLOT )
+		m_vecSlotPrev[iNext] = iPrev;
+
+	m_vecSlotNext[iSlot] = VECTORENTITY_INVALID_SLOT;
+	m_vecSlotPrev[iSlot] = VECTORENTITY_INVALID_SLOT;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Add a slot to a cell list
+//-----------------------------------------------------------------------------
+void CCollisionGrid::LinkSlot( uint32 iSlot, uint32 iCell )
+{
+	uint32 iHead = m_vecCellHead[iCell];
+	m_vecSlotNext[iSlot] = iHead;
+	m_vecSlotPrev[iSlot] = VECTORENTITY_INVALID_SLOT;
+	if ( iHead != VECTORENTITY_INVALID_SLOT )
+		m_vecSlotPrev[iHead] = iSlot;
+	m_vecCellHead[iCell] = iSlot;
+	m_vecSlotCell[iSlot] = iCell;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Add the owners of everything in a cell to the query results
+//-----------------------------------------------------------------------------
+void CCollisionGrid::AddCellOwners( uint32 iCell )
+{
+	for ( uint32 iSlot = m_vecCellHead[iCell]; iSlot != VECTORENTITY_INVALID_SLOT; iSlot = m_vecSlotNext[iSlot] )
+	{
+		uint32 unOwner = m_vecSlotOwner[iSlot];
+		if ( m_vecOwnerQuery[unOwner] != m_unQuery )
+		{
+			m_vecOwnerQuery[unOwner] = m_unQuery;
+			m_vecCandidateOwners.push_back( unOwner );
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Empty the grid
+//-----------------------------------------------------------------------------
+void CCollisionGrid::Clear()
+{
+	for ( uint32 i = 0; i < m_vecTrackedSlots.size(); ++i )
+	{
+		uint32 iSlot = m_vecTrackedSlots[i];
+		m_vecSlotCell[iSlot] = VECTORENTITY_INVALID_SLOT;
+		m_vecSlotNext[iSlot] = VECTORENTITY_INVALID_SLOT;
+		m_vecSlotPrev[iSlot] = VECTORENTITY_INVALID_SLOT;
+	}
+	m_vecTrackedSlots.clear();
+	m_vecCellHead.assign( m_vecCellHead.size(), VECTORENTITY_INVALID_SLOT );
+}
@@ -0,0 +1,120 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Uniform grid broadphase for vector entity collisions
+//
+//=============================================================================
+
+#ifndef COLLISIONGRID_H
+#define COLLISIONGRID_H
+
+#include <vector>
+
+class CVectorEntity;
+class CVectorEntityStatePool;
+
+//-----------------------------------------------------------------------------
+// Purpose: Buckets entities into square-ish cells covering the viewport so a
+//			collision check only has to look at entities in the same or a
+//			neighboring cell.  Neighbors wrap at the edges of the viewport the
+//			same way entity positions do in CVectorEntity::RunFrame.
+//
+//			Entries are keyed by state pool slot and tagged with an owner index
+//			chosen by the caller (the player slot of the ship that owns the
+//			entity on the server).  Queries return owners, not entities, and
+//			the caller runs the real narrow-phase test against each owner.
+//
+//			The grid is updated incrementally: each tick the caller brackets
+//			a pass of UpdateEntity() calls with BeginUpdate()/EndUpdate().  Only
+//			entries that changed cell are relinked, and entries that weren't
+//			updated are removed.
+//
+//			Cells are at least the given minimum size across, so any two
+//			entities whose collision radii sum to no more than that size are
+//			always found from each other's neighborhood.  Entities with a
+//			larger radius are kept on a separate list that every query checks.
+//-----------------------------------------------------------------------------
+class CCollisionGrid
+{
+public:
+	// Constructor
+	CCollisionGrid();
+
+	// Set the area covered and the minimum cell size, does nothing if they haven't changed,
+	// otherwise empties the grid
+	void Init( float flWidth, float flHeight, float flMinCellSize );
+
+	// Make room for entries in the first unSlots state pool slots from up to unOwners owners, so
+	// updates and queries within that don't grow any arrays
+	void Reserve( uint32 unSlots, uint32 unOwners );
+
+	// Start a pass of updates
+	void BeginUpdate();
+
+	// Place or move the entity in the grid, tagged with the given owner
+	void UpdateEntity( CVectorEntity *pEntity, uint32 unOwner );
+
+	// Finish a pass of updates, removing any entry that wasn't updated since BeginUpdate()
+	void EndUpdate();
+
+	// Get the owners of every entry that might collide with the given entity, in ascending
+	// order with no duplicates.  The vector is reused by the next query.
+	const std::vector< uint32 > &GetCandidateOwners( CVectorEntity *pEntity );
+
+	// Number of entries currently in the grid
+	uint32 GetEntryCount() { return (uint32)m_vecTrackedSlots.size(); }
+
+private:
+	// Cell an entity at the given position falls in, positions outside the viewport clamp to the edge cells
+	uint32 GetCellForPosition( float flXPos, float flYPos );
+
+	// Remove a slot from whatever cell list it is on
+	void UnlinkSlot( uint32 iSlot );
+
+	// Add a slot to the head of a cell list
+	void LinkSlot( uint32 iSlot, uint32 iCell );
+
+	// Add the owners of every entry on a cell list to the query results
+	void AddCellOwners( uint32 iCell );
+
+	// Empty the grid
+	void Clear();
+
+	// Area covered and cell layout
+	float m_flWidth;
+	float m_flHeight;
+	float m_flMinCellSize;
+	float m_flCellWidth;
+	float m_flCellHeight;
+	uint32 m_unCellsWide;
+	uint32 m_unCellsHigh;
+
+	// Entities with a radius over half a cell go on the oversize list instead of a cell
+	float m_flMaxCellRadius;
+
+	// Pool the entries' slots index into, all entities in one grid must share a pool
+	CVectorEntityStatePool *m_pStatePool;
+
+	// First slot in each cell, cell m_unCellsWide * m_unCellsHigh is the oversize list
+	std::vector< uint32 > m_vecCellHead;
+
+	// Per pool slot: cell it is linked into, neighbors in that cell's list, owner and the
+	// pass it was last updated in
+	std::vector< uint32 > m_vecSlotCell;
+	std::vector< uint32 > m_vecSlotNext;
+	std::vector< uint32 > m_vecSlotPrev;
+	std::vector< uint32 > m_vecSlotOwner;
+	std::vector< uint32 > m_vecSlotUpdatePass;
+
+	// Slots currently linked into the grid
+	std::vector< uint32 > m_vecTrackedSlots;
+
+	// Current update pass
+	uint32 m_unUpdatePass;
+
+	// Query results, and the query each owner was last added in (to skip duplicates)
+	std::vector< uint32 > m_vecCandidateOwners;
+	std::vector< uint32 > m_vecOwnerQuery;
+	uint32 m_unQuery;
+};
+
+#endif // COLLISIONGRID_H
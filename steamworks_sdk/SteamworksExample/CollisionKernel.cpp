@@ -0,0 +1,76 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Circle overlap tests used by the collision phase
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "CollisionKernel.h"
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#define COLLISION_KERNEL_AVX2
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define COLLISION_KERNEL_SSE2
+#endif
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Test one circle against a batch of circles
+//-----------------------------------------------------------------------------
+uint32 CollideCircleBatch( float flXPos, float flYPos, float flRadius,
+	const float *pflXPos, const float *pflYPos, const float *pflRadius, uint32 unCount )
+{
+	if ( unCount > COLLISION_BATCH_MAX )
+	{
+		OutputDebugString( "CollideCircleBatch called with too many circles\n" );
+		unCount = COLLISION_BATCH_MAX;
+	}
+
+	uint32 unHits = 0;
+	uint32 i = 0;
+
+	// Each lane does exactly what BCirclesOverlap does: delta, squared distance, sum of radii,
+	// then sum > 0 && distance^2 < sum^2
+#if defined( COLLISION_KERNEL_AVX2 )
+	const __m256 vecXPos = _mm256_set1_ps( flXPos );
+	const __m256 vecYPos = _mm256_set1_ps( flYPos );
+	const __m256 vecRadius = _mm256_set1_ps( flRadius );
+	const __m256 vecZero = _mm256_setzero_ps();
+	for ( ; i + 8 <= unCount; i += 8 )
+	{
+		__m256 vecDeltaX = _mm256_sub_ps( _mm256_loadu_ps( pflXPos + i ), vecXPos );
+		__m256 vecDeltaY = _mm256_sub_ps( _mm256_loadu_ps( pflYPos + i ), vecYPos );
+		__m256 vecDistanceSqr = _mm256_add_ps( _mm256_mul_ps( vecDeltaX, vecDeltaX ), _mm256_mul_ps( vecDeltaY, vecDeltaY ) );
+		__m256 vecRadiusSum = _mm256_add_ps( vecRadius, _mm256_loadu_ps( pflRadius + i ) );
+		__m256 vecHit = _mm256_and_ps( _mm256_cmp_ps( vecRadiusSum, vecZero, _CMP_GT_OQ ),
+			_mm256_cmp_ps( vecDistanceSqr, _mm256_mul_ps( vecRadiusSum, vecRadiusSum ), _CMP_LT_OQ ) );
+		unHits |= (uint32)_mm256_movemask_ps( vecHit ) << i;
+	}
+#elif defined( COLLISION_KERNEL_SSE2 )
+	const __m128 vecXPos = _mm_set1_ps( flXPos );
+	const __m128 vecYPos = _mm_set1_ps( flYPos );
+	const __m128 vecRadius = _mm_set1_ps( flRadius );
+	const __m128 vecZero = _mm_setzero_ps();
+	for ( ; i + 4 <= unCount; i += 4 )
+	{
+		__m128 vecDeltaX = _mm_sub_ps( _mm_loadu_ps( pflXPos + i ), vecXPos );
+		__m128 vecDeltaY = _mm_sub_ps( _mm_loadu_ps( pflYPos + i ), vecYPos );
+		__m128 vecDistanceSqr = _mm_add_ps( _mm_mul_ps( vecDeltaX, vecDeltaX ), _mm_mul_ps( vecDeltaY, vecDeltaY ) );
+		__m128 vecRadiusSum = _mm_add_ps( vecRadius, _mm_loadu_ps( pflRadius + i ) );
+		__m128 vecHit = _mm_and_ps( _mm_cmpgt_ps( vecRadiusSum, vecZero ),
+			_mm_cmplt_ps( vecDistanceSqr, _mm_mul_ps( vecRadiusSum, vecRadiusSum ) ) );
+		unHits |= (uint32)_mm_movemask_ps( vecHit ) << i;
+	}
+#endif
+
+	// Whatever is left over (or everything, without SIMD)
+	for ( ; i < unCount; ++i )
+	{
+		if ( BCirclesOverlap( flXPos, flYPos, flRadius, pflXPos[i], pflYPos[i], pflRadius[i] ) )
+			unHits |= 1u << i;
+	}
+
+	return unHits;
+}
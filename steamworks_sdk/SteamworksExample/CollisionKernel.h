@@ -0,0 +1,35 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Circle overlap tests used by the collision phase
+//
+//=============================================================================
+
+#ifndef COLLISIONKERNEL_H
+#define COLLISIONKERNEL_H
+
+// Radius to give a circle that should never collide with anything (collision detection
+// disabled, or an empty slot in a batch)
+#define COLLISION_RADIUS_DISABLED -1.0e30f
+
+// Most circles one call to CollideCircleBatch can test, one bit each in the result
+#define COLLISION_BATCH_MAX 32
+
+//-----------------------------------------------------------------------------
+// Purpose: Do two circles overlap?  Compares squared distances, so no sqrt,
+//			and a circle with a negative radius never overlaps anything.
+//-----------------------------------------------------------------------------
+inline bool BCirclesOverlap( float flXPos0, float flYPos0, float flRadius0, float flXPos1, float flYPos1, float flRadius1 )
+{
+	float flDeltaX = flXPos1 - flXPos0;
+	float flDeltaY = flYPos1 - flYPos0;
+	float flRadius = flRadius0 + flRadius1;
+	return flRadius > 0.0f && flDeltaX * flDeltaX + flDeltaY * flDeltaY < flRadius * flRadius;
+}
+
+// Test one circle against up to COLLISION_BATCH_MAX packed circles, bit i of the result is set if
+// circle i overlaps it.  Same result as calling BCirclesOverlap on each, using SSE2 or AVX2 when
+// the compiler targets them.
+uint32 CollideCircleBatch( float flXPos, float flYPos, float flRadius,
+	const float *pflXPos, const float *pflYPos, const float *pflRadius, uint32 unCount );
+
+#endif // COLLISIONKERNEL_H
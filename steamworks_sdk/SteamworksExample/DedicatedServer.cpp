@@ -0,0 +1,257 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Main file for the headless SpaceWar dedicated server.  It runs the
+//			same CSpaceWarServer as the game, under CHeadlessGameEngine, without
+//			the client, SDL, OpenGL or OpenAL.
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "HeadlessGameEngine.h"
+#include "MatchHost.h"
+#include "LoadGenerator.h"
+#include "ReplayLog.h"
+#include <chrono>
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Helper to display critical errors, there's nowhere but stderr to show them
+//-----------------------------------------------------------------------------
+int Alert( const char *lpCaption, const char *lpText )
+{
+	fprintf( stderr, "Message: '%s', Detail: '%s'\n", lpCaption, lpText );
+	return 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Read the integer following a command line parameter, or 0 if it isn't there
+//-----------------------------------------------------------------------------
+static uint32 GetCommandLineUint( const char *pchCmdLine, const char *pchParam )
+{
+	const char *pchValue = strstr( pchCmdLine, pchParam );
+	if ( !pchValue )
+		return 0;
+
+	int nValue = atoi( pchValue + strlen( pchParam ) );
+	return nValue > 0 ? (uint32)nValue : 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Read the word following a command line parameter, false if it isn't there
+//-----------------------------------------------------------------------------
+static bool GetCommandLineString( const char *pchCmdLine, const char *pchParam, char *pchValue, uint32 cchValue )
+{
+	const char *pchStart = strstr( pchCmdLine, pchParam );
+	if ( !pchStart )
+		return false;
+
+	pchStart += strlen( pchParam );
+	uint32 cchWord = (uint32)strcspn( pchStart, " " );
+	if ( !cchWord || cchWord >= cchValue )
+		return false;
+
+	memcpy( pchValue, pchStart, cchWord );
+	pchValue[cchWord] = '\0';
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Log the tick profile of every match since the last one and the
+//			rates players are being sent updates at, and write them to the
+//			stats file if there is one.  The file is replaced whole, so
+//			whoever reads it never sees half a report.
+//-----------------------------------------------------------------------------
+static void DumpTickProfile( CSpaceWarMatchHost *pMatchHost, const char *pchStatsFile )
+{
+	CTickProfiler profile;
+	pMatchHost->GetTickProfile( &profile, true );
+
+	std::string strReport;
+	profile.AppendReport( strReport );
+	pMatchHost->AppendSnapshotRateReport( strReport, true );
+
+	const ServerDetailsPublisherStats_t &detailsStats = pMatchHost->GetServerDetailsStats();
+	char rgchBuffer[256];
+	sprintf_safe( rgchBuffer, "Server details: %llu flushes   %llu values   %llu Steam calls   %llu calls avoided\n",
+		(unsigned long long)detailsStats.m_cFlushes, (unsigned long long)detailsStats.m_cRequested,
+		(unsigned long long)detailsStats.m_cPublished, (unsigned long long)detailsStats.GetAvoidedCount() );
+	strReport += rgchBuffer;
+	pMatchHost->ResetServerDetailsStats();
+	OutputDebugString( strReport.c_str() );
+
+	if ( !pchStatsFile )
+		return;
+
+	char rgchTempFile[1024];
+	sprintf_safe( rgchTempFile, "%s.tmp", pchStatsFile );
+	FILE *pFile = fopen( rgchTempFile, "wb" );
+	if ( !pFile )
+	{
+		OutputDebugString( "Couldn't write the stats file\n" );
+		return;
+	}
+	bool bWritten = fwrite( strReport.c_str(), 1, strReport.size(), pFile ) == strReport.size();
+	bWritten = fclose( pFile ) == 0 && bWritten;
+
+#ifdef _WIN32
+	// rename won't replace a file on Windows
+	remove( pchStatsFile );
+#endif
+	if ( !bWritten || rename( rgchTempFile, pchStatsFile ) != 0 )
+	{
+		OutputDebugString( "Couldn't write the stats file\n" );
+		remove( rgchTempFile );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Main loop, runs the matches until we're signalled to stop.  Every
+//			unProfileSeconds, if that's not 0, dumps the tick profile.
+//-----------------------------------------------------------------------------
+static void RunDedicatedServerLoop( CHeadlessGameEngine *pGameEngine, CSpaceWarMatchHost *pMatchHost, uint32 unProfileSeconds, const char *pchStatsFile )
+{
+	uint64 ulLastProfileDump = pGameEngine->GetGameTickCount();
+	while ( !pGameEngine->BShuttingDown() )
+	{
+		pGameEngine->UpdateGameTickCount();
+
+		// Run a frame of every match
+		pMatchHost->RunFrame();
+
+		if ( unProfileSeconds && pGameEngine->GetGameTickCount() - ulLastProfileDump >= unProfileSeconds * 1000ull )
+		{
+			ulLastProfileDump = pGameEngine->GetGameTickCount();
+			DumpTickProfile( pMatchHost, pchStatsFile );
+		}
+
+		// Sleep to limit frame rate
+		while ( pGameEngine->BSleepForFrameRateLimit( MAX_CLIENT_AND_SERVER_FPS ) )
+		{
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Real main entry point for the dedicated server
+//-----------------------------------------------------------------------------
+static int RealMain( const char *pchCmdLine )
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// -record <file> records the matches to replay logs, see CSpaceWarMatchHost::BStartRecording
+	char rgchRecordFile[1024];
+	bool bRecord = GetCommandLineString( pchCmdLine, "-record ", rgchRecordFile, sizeof( rgchRecordFile ) );
+
+	// -loadtest <N> plays N bots against local servers instead, the same as the game's -loadtest,
+	// with -workers <N> ticking the servers on N threads, -netprofile <preset|file> and
+	// -netseed <N> impairing the network and -authms <N> and -authfail <percent> standing in
+	// for Steam checking tickets
+	char rgchNetProfile[1024];
+	if ( strstr( pchCmdLine, "-loadtest " ) )
+		return RunLoadGenerator( GetCommandLineUint( pchCmdLine, "-loadtest " ), GetCommandLineUint( pchCmdLine, "-maxplayers " ),
+			GetCommandLineUint( pchCmdLine, "-loadseconds " ), strstr( pchCmdLine, "-scriptedinput" ) != NULL,
+			GetCommandLineString( pchCmdLine, "-record ", rgchRecordFile, sizeof( rgchRecordFile ) ) ? rgchRecordFile : NULL,
+			GetCommandLineUint( pchCmdLine, "-workers " ),
+			GetCommandLineString( pchCmdLine, "-netprofile ", rgchNetProfile, sizeof( rgchNetProfile ) ) ? rgchNetProfile : NULL,
+			GetCommandLineUint( pchCmdLine, "-netseed " ), GetCommandLineUint( pchCmdLine, "-authms " ),
+			GetCommandLineUint( pchCmdLine, "-authfail " ) ) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	// -replay <file> re-simulates a recorded match and checks it plays out the same, add
+	// -fastforward to only read through its snapshots
+	char rgchReplayFile[1024];
+	if ( GetCommandLineString( pchCmdLine, "-replay ", rgchReplayFile, sizeof( rgchReplayFile ) ) )
+		return RunReplay( rgchReplayFile, !strstr( pchCmdLine, "-fastforward" ) ) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	// -matchhost <N> runs N matches in this process (default is one), -workers <N> sets the
+	// number of threads ticking them (default is one per core, or just one for a single match)
+	// and -maxplayers <N> sets the player cap of each match
+	uint32 unMatches = MAX( GetCommandLineUint( pchCmdLine, "-matchhost " ), 1u );
+	uint32 unWorkers = GetCommandLineUint( pchCmdLine, "-workers " );
+	if ( !unWorkers && unMatches == 1 )
+		unWorkers = 1;
+	uint32 unMaxPlayers = GetCommandLineUint( pchCmdLine, "-maxplayers " );
+	if ( !unMaxPlayers )
+		unMaxPlayers = MAX_PLAYERS_PER_SERVER;
+
+	// -detailsms <N> publishes whatever has changed in our server details every N ms, rather
+	// than every SERVER_DETAILS_REFRESH_MILLISECONDS
+	uint32 unDetailsMilliseconds = GetCommandLineUint( pchCmdLine, "-detailsms " );
+
+	// -profile <seconds> logs where the frames' time went and the players' snapshot rates every
+	// so many seconds, and -statsfile <file> keeps the latest of those reports in a file for
+	// anything watching the server
+	uint32 unProfileSeconds = GetCommandLineUint( pchCmdLine, "-profile " );
+	char rgchStatsFile[1024];
+	bool bStatsFile = GetCommandLineString( pchCmdLine, "-statsfile ", rgchStatsFile, sizeof( rgchStatsFile ) );
+	if ( bStatsFile && !unProfileSeconds )
+		unProfileSeconds = 10;
+
+	CHeadlessGameEngine *pGameEngine = new CHeadlessGameEngine();
+
+	// The match host owns the SteamGameServer connection, even for a single match, and
+	// marks us as a dedicated server
+	CSpaceWarMatchHost *pMatchHost = new CSpaceWarMatchHost( pGameEngine, unMatches, unWorkers, unMaxPlayers );
+	if ( unDetailsMilliseconds )
+		pMatchHost->SetServerDetailsInterval( unDetailsMilliseconds );
+
+	int nResult = EXIT_SUCCESS;
+	if ( !pMatchHost->GetMatchCount() )
+	{
+		Alert( "Fatal Error", "Dedicated server could not start any matches (SteamGameServer_Init() failed).\n" );
+		nResult = EXIT_FAILURE;
+	}
+	else if ( bRecord && !pMatchHost->BStartRecording( rgchRecordFile ) )
+	{
+		Alert( "Fatal Error", "Dedicated server could not create its replay logs.\n" );
+		nResult = EXIT_FAILURE;
+	}
+	else
+	{
+		char rgchBuffer[128];
+		sprintf_safe( rgchBuffer, "Dedicated server ready in %.1f ms\n",
+			std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - start ).count() );
+		OutputDebugString( rgchBuffer );
+
+		// This call will block and run until we're signalled to stop
+		RunDedicatedServerLoop( pGameEngine, pMatchHost, unProfileSeconds, bStatsFile ? rgchStatsFile : NULL );
+
+		OutputDebugString( "Dedicated server shutting down\n" );
+	}
+
+	delete pMatchHost;
+	delete pGameEngine;
+
+	return nResult;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Main entry point for the program
+//-----------------------------------------------------------------------------
+int main( int argc, const char **argv )
+{
+	char szCmdLine[1024];
+	char *pszStart = szCmdLine;
+	char * const pszEnd = szCmdLine + V_ARRAYSIZE(szCmdLine);
+	*szCmdLine = '\0';
+	for ( int i = 1; i < argc; i++ )
+	{
+		const char *parm = argv[i];
+		while ( *parm && (pszStart < pszEnd) )
+		{
+			*pszStart++ = *parm++;
+		}
+		if ( pszStart >= pszEnd )
+			break;
+		if ( i < argc-1 )
+			*pszStart++ = ' ';
+	}
+	// The last argument isn't followed by a space, end the string after it
+	*( pszStart < pszEnd ? pszStart : pszEnd - 1 ) = '\0';
+	return RealMain( szCmdLine );
+}
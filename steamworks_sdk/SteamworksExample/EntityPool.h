@@ -0,0 +1,160 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Fixed-capacity pools for vector entities, so ships, photon beams and
+//			debris are carved out of memory set aside up front rather than
+//			allocated from the heap every time one spawns
+//
+//=============================================================================
+
+#ifndef ENTITYPOOL_H
+#define ENTITYPOOL_H
+
+#include <new>
+
+//-----------------------------------------------------------------------------
+// Purpose: A slab with room for a fixed number of T, and a free list threaded
+//			through the slots that aren't in use.  Entities are constructed in
+//			place in a slot from Alloc() and destroyed with Free():
+//
+//				CShip *pShip = new ( m_ShipPool.Alloc() ) CShip( ... );
+//				...
+//				m_ShipPool.Free( pShip );
+//
+//			Alloc() returns NULL once the pool is full, so callers that could
+//			run out have to check before constructing.  Everything has to be
+//			freed before the pool goes away, the pool doesn't know which slots
+//			hold live entities.
+//-----------------------------------------------------------------------------
+template< class T >
+class CEntityPool
+{
+public:
+	// Constructor, the pool has no room until Init()
+	CEntityPool()
+	{
+		m_pubSlab = NULL;
+		m_bOwnsSlab = false;
+		m_unCapacity = 0;
+		m_unActive = 0;
+		m_pFreeList = NULL;
+	}
+
+	// Destructor
+	~CEntityPool()
+	{
+		if ( m_unActive )
+			OutputDebugString( "Entity pool destroyed with entities still in use\n" );
+
+		if ( m_bOwnsSlab )
+			::operator delete( m_pubSlab );
+	}
+
+	// Set aside room for unCapacity entities, this is the only allocation the pool makes
+	void Init( uint32 unCapacity )
+	{
+		if ( m_pubSlab )
+		{
+			OutputDebugString( "Entity pool initialized twice\n" );
+			return;
+		}
+
+		m_bOwnsSlab = true;
+		InitFreeList( (uint8 *)::operator new( (size_t)unCapacity * sizeof( T ) ), unCapacity );
+	}
+
+	// Get memory for one entity, NULL if the pool is full
+	void *Alloc()
+	{
+		FreeSlot_t *pSlot = m_pFreeList;
+		if ( !pSlot )
+			return NULL;
+
+		m_pFreeList = pSlot->m_pNext;
+		++m_unActive;
+		return pSlot;
+	}
+
+	// Destroy an entity from Alloc() and return its slot to the pool
+	void Free( T *pEntity )
+	{
+		if ( !pEntity )
+			return;
+
+		uint8 *pubEntity = (uint8 *)pEntity;
+		if ( pubEntity < m_pubSlab || pubEntity >= m_pubSlab + (size_t)m_unCapacity * sizeof( T ) )
+		{
+			OutputDebugString( "Freeing an entity that didn't come from this pool\n" );
+			return;
+		}
+
+		pEntity->~T();
+
+		FreeSlot_t *pSlot = (FreeSlot_t *)pubEntity;
+		pSlot->m_pNext = m_pFreeList;
+		m_pFreeList = pSlot;
+		--m_unActive;
+	}
+
+	// Most entities the pool can hold
+	uint32 GetCapacity() { return m_unCapacity; }
+
+	// Entities currently allocated from the pool
+	uint32 GetActiveCount() { return m_unActive; }
+
+protected:
+	// Thread the free list through storage for unCapacity entities
+	void InitFreeList( uint8 *pubSlab, uint32 unCapacity )
+	{
+		m_pubSlab = pubSlab;
+		m_unCapacity = unCapacity;
+		m_unActive = 0;
+
+		// Hand slots out lowest address first
+		m_pFreeList = NULL;
+		for ( uint32 i = unCapacity; i > 0; --i )
+		{
+			FreeSlot_t *pSlot = (FreeSlot_t *)( pubSlab + (size_t)( i - 1 ) * sizeof( T ) );
+			pSlot->m_pNext = m_pFreeList;
+			m_pFreeList = pSlot;
+		}
+	}
+
+private:
+	// Pools hand out addresses inside themselves, they can't be copied
+	CEntityPool( const CEntityPool & );
+	CEntityPool &operator=( const CEntityPool & );
+
+	// An unused slot holds the next unused slot
+	struct FreeSlot_t
+	{
+		FreeSlot_t *m_pNext;
+	};
+	static_assert( sizeof( T ) >= sizeof( FreeSlot_t ), "Entity too small to hold a free list link" );
+
+	uint8 *m_pubSlab;
+	bool m_bOwnsSlab;
+	uint32 m_unCapacity;
+	uint32 m_unActive;
+	FreeSlot_t *m_pFreeList;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: A pool whose slots are part of the object holding it, for entities
+//			that always come in a known number (a ship's photon beams).  Creating
+//			the owner doesn't allocate anything for the pool.
+//-----------------------------------------------------------------------------
+template< class T, uint32 CAPACITY >
+class CFixedEntityPool : public CEntityPool< T >
+{
+public:
+	CFixedEntityPool()
+	{
+		this->InitFreeList( m_rgubStorage, CAPACITY );
+	}
+
+private:
+	alignas( T ) uint8 m_rgubStorage[ CAPACITY * sizeof( T ) ];
+};
+
+#endif // ENTITYPOOL_H
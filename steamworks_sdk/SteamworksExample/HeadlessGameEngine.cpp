@@ -0,0 +1,95 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Game engine for the headless dedicated server.  It has a real
+//			clock and a fixed virtual viewport, and nothing else: no window,
+//			no rendering, no input and no audio.
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "HeadlessGameEngine.h"
+#include <signal.h>
+#include <chrono>
+#include <thread>
+
+// Set from the signal handler, there can only be one process to shut down
+static volatile sig_atomic_t s_bSignalledShutdown = 0;
+
+
+//-----------------------------------------------------------------------------
+// Purpose: SIGINT/SIGTERM handler, ask the main loop to exit cleanly
+//-----------------------------------------------------------------------------
+static void HandleShutdownSignal( int nSignal )
+{
+	(void)nSignal;
+	s_bSignalledShutdown = 1;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Milliseconds on the monotonic clock since the first call
+//-----------------------------------------------------------------------------
+static uint64 GetMonotonicMilliseconds()
+{
+	static const std::chrono::steady_clock::time_point s_start = std::chrono::steady_clock::now();
+	return (uint64)std::chrono::duration_cast< std::chrono::milliseconds >( std::chrono::steady_clock::now() - s_start ).count();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Debug output goes to stderr, the same as the SDL build
+//-----------------------------------------------------------------------------
+void OutputDebugString( const char *pchMsg )
+{
+	fprintf( stderr, "%s", pchMsg );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor.  The clock starts one millisecond in, entities use a
+//			zero tick count to mean "never".
+//-----------------------------------------------------------------------------
+CHeadlessGameEngine::CHeadlessGameEngine( int32 nViewportWidth, int32 nViewportHeight )
+	: CMatchGameEngine( nViewportWidth, nViewportHeight )
+{
+	m_bShuttingDown = false;
+
+	signal( SIGINT, HandleShutdownSignal );
+	signal( SIGTERM, HandleShutdownSignal );
+
+	SetGameTickCount( GetMonotonicMilliseconds() + 1 );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Move the clock to now
+//-----------------------------------------------------------------------------
+void CHeadlessGameEngine::UpdateGameTickCount()
+{
+	SetGameTickCount( GetMonotonicMilliseconds() + 1 );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Frame rate limiting.  There's nothing to draw, so unlike the
+//			client engines we never busy wait, we sleep until the frame is due.
+//-----------------------------------------------------------------------------
+bool CHeadlessGameEngine::BSleepForFrameRateLimit( uint32 ulMaxFrameRate )
+{
+	uint64 ulDesiredFrameMilliseconds = 1000 / MAX( ulMaxFrameRate, 1u );
+	uint64 ulMillisecondsElapsed = GetMonotonicMilliseconds() + 1 - GetGameTickCount();
+	if ( ulMillisecondsElapsed >= ulDesiredFrameMilliseconds )
+		return false;
+
+	std::this_thread::sleep_for( std::chrono::milliseconds( ulDesiredFrameMilliseconds - ulMillisecondsElapsed ) );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Have we been asked to shut down?
+//-----------------------------------------------------------------------------
+bool CHeadlessGameEngine::BShuttingDown()
+{
+	return m_bShuttingDown || s_bSignalledShutdown;
+}
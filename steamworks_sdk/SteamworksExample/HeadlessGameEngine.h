@@ -0,0 +1,38 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Game engine for the headless dedicated server.  It has a real
+//			clock and a fixed virtual viewport, and nothing else: no window,
+//			no rendering, no input and no audio.
+//
+//=============================================================================
+
+#ifndef HEADLESSGAMEENGINE_H
+#define HEADLESSGAMEENGINE_H
+
+#include "MatchGameEngine.h"
+
+// Size of the playfield a headless server simulates in, the same as the client's default window
+#define HEADLESS_VIEWPORT_WIDTH 1024
+#define HEADLESS_VIEWPORT_HEIGHT 768
+
+class CHeadlessGameEngine : public CMatchGameEngine
+{
+public:
+	// Constructor, SIGINT and SIGTERM ask the engine to shut down
+	CHeadlessGameEngine( int32 nViewportWidth = HEADLESS_VIEWPORT_WIDTH, int32 nViewportHeight = HEADLESS_VIEWPORT_HEIGHT );
+
+	// Read the monotonic clock, in milliseconds since the engine started
+	void UpdateGameTickCount();
+
+	// Sleep off whatever is left of the frame, returns true while there is still time to wait
+	bool BSleepForFrameRateLimit( uint32 ulMaxFrameRate );
+
+	// Shut down on request or on a signal
+	bool BShuttingDown();
+	void Shutdown() { m_bShuttingDown = true; }
+
+private:
+	bool m_bShuttingDown;
+};
+
+#endif // HEADLESSGAMEENGINE_H
@@ -0,0 +1,342 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Moves vector entities forward one frame: gravity, rotation,
+//			velocity, position and wrapping around the screen
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "IntegrationKernel.h"
+#include "VectorEntityStatePool.h"
+#include "VectorEntity.h"
+#include <math.h>
+#include <string.h>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define INTEGRATION_KERNEL_SSE2
+#endif
+
+// Slots integrated together
+#define INTEGRATION_LANES 4
+
+// Rotation is kept within one turn either way
+#define FULL_ROTATION ( 2.0f*PI_VALUE )
+
+//-----------------------------------------------------------------------------
+// Purpose: Where INTEGRATION_LANES consecutive slots' state lives.  Either
+//			straight into the pool's arrays, or into a scratch block for the
+//			last few slots.
+//-----------------------------------------------------------------------------
+struct IntegrationLanes_t
+{
+	float *m_pflXPos;
+	float *m_pflYPos;
+	float *m_pflXPosLastFrame;
+	float *m_pflYPosLastFrame;
+	float *m_pflXVelocity;
+	float *m_pflYVelocity;
+	float *m_pflMaximumVelocity;
+	float *m_pflXAccel;
+	float *m_pflYAccel;
+	float *m_pflXAccelLastFrame;
+	float *m_pflYAccelLastFrame;
+	float *m_pflRotationDeltaNextFrame;
+	float *m_pflRotationDeltaLastFrame;
+	float *m_pflAccumulatedRotation;
+};
+
+// Scratch copy of a partial block of slots
+struct IntegrationBlock_t
+{
+	float m_rgflXPos[INTEGRATION_LANES];
+	float m_rgflYPos[INTEGRATION_LANES];
+	float m_rgflXPosLastFrame[INTEGRATION_LANES];
+	float m_rgflYPosLastFrame[INTEGRATION_LANES];
+	float m_rgflXVelocity[INTEGRATION_LANES];
+	float m_rgflYVelocity[INTEGRATION_LANES];
+	float m_rgflMaximumVelocity[INTEGRATION_LANES];
+	float m_rgflXAccel[INTEGRATION_LANES];
+	float m_rgflYAccel[INTEGRATION_LANES];
+	float m_rgflXAccelLastFrame[INTEGRATION_LANES];
+	float m_rgflYAccelLastFrame[INTEGRATION_LANES];
+	float m_rgflRotationDeltaNextFrame[INTEGRATION_LANES];
+	float m_rgflRotationDeltaLastFrame[INTEGRATION_LANES];
+	float m_rgflAccumulatedRotation[INTEGRATION_LANES];
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Point lanes at the pool's arrays starting at a slot
+//-----------------------------------------------------------------------------
+static void SetLanesToPool( IntegrationLanes_t *pLanes, CVectorEntityStatePool *pPool, uint32 iSlot )
+{
+	pLanes->m_pflXPos = &pPool->m_vecXPos[iSlot];
+	pLanes->m_pflYPos = &pPool->m_vecYPos[iSlot];
+	pLanes->m_pflXPosLastFrame = &pPool->m_vecXPosLastFrame[iSlot];
+	pLanes->m_pflYPosLastFrame = &pPool->m_vecYPosLastFrame[iSlot];
+	pLanes->m_pflXVelocity = &pPool->m_vecXVelocity[iSlot];
+	pLanes->m_pflYVelocity = &pPool->m_vecYVelocity[iSlot];
+	pLanes->m_pflMaximumVelocity = &pPool->m_vecMaximumVelocity[iSlot];
+	pLanes->m_pflXAccel = &pPool->m_vecXAccel[iSlot];
+	pLanes->m_pflYAccel = &pPool->m_vecYAccel[iSlot];
+	pLanes->m_pflXAccelLastFrame = &pPool->m_vecXAccelLastFrame[iSlot];
+	pLanes->m_pflYAccelLastFrame = &pPool->m_vecYAccelLastFrame[iSlot];
+	pLanes->m_pflRotationDeltaNextFrame = &pPool->m_vecRotationDeltaNextFrame[iSlot];
+	pLanes->m_pflRotationDeltaLastFrame = &pPool->m_vecRotationDeltaLastFrame[iSlot];
+	pLanes->m_pflAccumulatedRotation = &pPool->m_vecAccumulatedRotation[iSlot];
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Point lanes at a scratch block
+//-----------------------------------------------------------------------------
+static void SetLanesToBlock( IntegrationLanes_t *pLanes, IntegrationBlock_t *pBlock )
+{
+	pLanes->m_pflXPos = pBlock->m_rgflXPos;
+	pLanes->m_pflYPos = pBlock->m_rgflYPos;
+	pLanes->m_pflXPosLastFrame = pBlock->m_rgflXPosLastFrame;
+	pLanes->m_pflYPosLastFrame = pBlock->m_rgflYPosLastFrame;
+	pLanes->m_pflXVelocity = pBlock->m_rgflXVelocity;
+	pLanes->m_pflYVelocity = pBlock->m_rgflYVelocity;
+	pLanes->m_pflMaximumVelocity = pBlock->m_rgflMaximumVelocity;
+	pLanes->m_pflXAccel = pBlock->m_rgflXAccel;
+	pLanes->m_pflYAccel = pBlock->m_rgflYAccel;
+	pLanes->m_pflXAccelLastFrame = pBlock->m_rgflXAccelLastFrame;
+	pLanes->m_pflYAccelLastFrame = pBlock->m_rgflYAccelLastFrame;
+	pLanes->m_pflRotationDeltaNextFrame = pBlock->m_rgflRotationDeltaNextFrame;
+	pLanes->m_pflRotationDeltaLastFrame = pBlock->m_rgflRotationDeltaLastFrame;
+	pLanes->m_pflAccumulatedRotation = pBlock->m_rgflAccumulatedRotation;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Copy lanes between two sets of state, only the first unCount
+//-----------------------------------------------------------------------------
+static void CopyLanes( const IntegrationLanes_t &to, const IntegrationLanes_t &from, uint32 unCount )
+{
+	for ( uint32 i = 0; i < unCount; ++i )
+	{
+		to.m_pflXPos[i] = from.m_pflXPos[i];
+		to.m_pflYPos[i] = from.m_pflYPos[i];
+		to.m_pflXPosLastFrame[i] = from.m_pflXPosLastFrame[i];
+		to.m_pflYPosLastFrame[i] = from.m_pflYPosLastFrame[i];
+		to.m_pflXVelocity[i] = from.m_pflXVelocity[i];
+		to.m_pflYVelocity[i] = from.m_pflYVelocity[i];
+		to.m_pflMaximumVelocity[i] = from.m_pflMaximumVelocity[i];
+		to.m_pflXAccel[i] = from.m_pflXAccel[i];
+		to.m_pflYAccel[i] = from.m_pflYAccel[i];
+		to.m_pflXAccelLastFrame[i] = from.m_pflXAccelLastFrame[i];
+		to.m_pflYAccelLastFrame[i] = from.m_pflYAccelLastFrame[i];
+		to.m_pflRotationDeltaNextFrame[i] = from.m_pflRotationDeltaNextFrame[i];
+		to.m_pflRotationDeltaLastFrame[i] = from.m_pflRotationDeltaLastFrame[i];
+		to.m_pflAccumulatedRotation[i] = from.m_pflAccumulatedRotation[i];
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Integrate INTEGRATION_LANES slots.  Only lanes with their bit set in
+//			unActiveMask are written, and of those, gravity only applies to the
+//			ones with their bit set in unGravityMask.
+//
+//			The SIMD and scalar versions do exactly the same float operations
+//			in the same order, one binary only ever uses one of them.
+//-----------------------------------------------------------------------------
+static void IntegrateLanes( const IntegrationLanes_t &lanes, uint32 unActiveMask, uint32 unGravityMask, const IntegrationParams_t &params )
+{
+#if defined( INTEGRATION_KERNEL_SSE2 )
+	const __m128 vecActive = _mm_castsi128_ps( _mm_set_epi32( ( unActiveMask & 8 ) ? -1 : 0, ( unActiveMask & 4 ) ? -1 : 0, ( unActiveMask & 2 ) ? -1 : 0, ( unActiveMask & 1 ) ? -1 : 0 ) );
+	const __m128 vecGravity = _mm_castsi128_ps( _mm_set_epi32( ( unGravityMask & 8 ) ? -1 : 0, ( unGravityMask & 4 ) ? -1 : 0, ( unGravityMask & 2 ) ? -1 : 0, ( unGravityMask & 1 ) ? -1 : 0 ) );
+	const __m128 vecZero = _mm_setzero_ps();
+	const __m128 vecElapsedSeconds = _mm_set1_ps( params.m_flElapsedSeconds );
+	const __m128 vecWidth = _mm_set1_ps( params.m_flViewportWidth );
+	const __m128 vecHeight = _mm_set1_ps( params.m_flViewportHeight );
+	const __m128 vecFullRotation = _mm_set1_ps( FULL_ROTATION );
+
+	// Keep whichever of new and old is right for each lane
+	#define SELECT_ACTIVE( vecNew, vecOld ) _mm_or_ps( _mm_and_ps( vecActive, vecNew ), _mm_andnot_ps( vecActive, vecOld ) )
+
+	__m128 vecXPos = _mm_loadu_ps( lanes.m_pflXPos );
+	__m128 vecYPos = _mm_loadu_ps( lanes.m_pflYPos );
+	__m128 vecXAccel = _mm_loadu_ps( lanes.m_pflXAccel );
+	__m128 vecYAccel = _mm_loadu_ps( lanes.m_pflYAccel );
+
+	// The sun pulls with a strength that falls off with the square of the distance.  Lanes without
+	// gravity get a zero pull, anything the math did in them (0/0 at the sun) is masked off.
+	__m128 vecXDelta = _mm_sub_ps( vecXPos, _mm_set1_ps( params.m_flXGravityCenter ) );
+	__m128 vecYDelta = _mm_sub_ps( vecYPos, _mm_set1_ps( params.m_flYGravityCenter ) );
+	__m128 vecDistanceSqr = _mm_add_ps( _mm_mul_ps( vecXDelta, vecXDelta ), _mm_mul_ps( vecYDelta, vecYDelta ) );
+	__m128 vecDistance = _mm_sqrt_ps( vecDistanceSqr );
+	__m128 vecFactor = _mm_min_ps( _mm_div_ps( _mm_set1_ps( GRAVITY_STRENGTH ), vecDistanceSqr ), _mm_set1_ps( GRAVITY_MAX_ACCELERATION ) );
+	vecXAccel = _mm_sub_ps( vecXAccel, _mm_and_ps( vecGravity, _mm_mul_ps( vecFactor, _mm_div_ps( vecXDelta, vecDistance ) ) ) );
+	vecYAccel = _mm_sub_ps( vecYAccel, _mm_and_ps( vecGravity, _mm_mul_ps( vecFactor, _mm_div_ps( vecYDelta, vecDistance ) ) ) );
+
+	// Accumulate the rotation, then take off whole turns so it doesn't grow and lose precision
+	__m128 vecRotationDelta = _mm_loadu_ps( lanes.m_pflRotationDeltaNextFrame );
+	__m128 vecRotation = _mm_add_ps( _mm_loadu_ps( lanes.m_pflAccumulatedRotation ), vecRotationDelta );
+	__m128 vecTurns = _mm_cvtepi32_ps( _mm_cvttps_epi32( _mm_div_ps( vecRotation, vecFullRotation ) ) );
+	vecRotation = _mm_sub_ps( vecRotation, _mm_mul_ps( vecTurns, vecFullRotation ) );
+
+	// Update velocity and clamp it to the maximum
+	__m128 vecXVelocity = _mm_add_ps( _mm_loadu_ps( lanes.m_pflXVelocity ), _mm_mul_ps( vecXAccel, vecElapsedSeconds ) );
+	__m128 vecYVelocity = _mm_add_ps( _mm_loadu_ps( lanes.m_pflYVelocity ), _mm_mul_ps( vecYAccel, vecElapsedSeconds ) );
+	__m128 vecMaximumVelocity = _mm_loadu_ps( lanes.m_pflMaximumVelocity );
+	__m128 vecVelocity = _mm_sqrt_ps( _mm_add_ps( _mm_mul_ps( vecXVelocity, vecXVelocity ), _mm_mul_ps( vecYVelocity, vecYVelocity ) ) );
+	__m128 vecTooFast = _mm_cmpgt_ps( vecVelocity, vecMaximumVelocity );
+	__m128 vecRatio = _mm_div_ps( vecMaximumVelocity, vecVelocity );
+	vecXVelocity = _mm_or_ps( _mm_and_ps( vecTooFast, _mm_mul_ps( vecXVelocity, vecRatio ) ), _mm_andnot_ps( vecTooFast, vecXVelocity ) );
+	vecYVelocity = _mm_or_ps( _mm_and_ps( vecTooFast, _mm_mul_ps( vecYVelocity, vecRatio ) ), _mm_andnot_ps( vecTooFast, vecYVelocity ) );
+
+	// Move, and wrap around the edges of the screen
+	__m128 vecNewXPos = _mm_add_ps( vecXPos, _mm_mul_ps( vecXVelocity, vecElapsedSeconds ) );
+	__m128 vecNewYPos = _mm_add_ps( vecYPos, _mm_mul_ps( vecYVelocity, vecElapsedSeconds ) );
+	vecNewXPos = _mm_sub_ps( vecNewXPos, _mm_and_ps( _mm_cmpgt_ps( vecNewXPos, vecWidth ), vecWidth ) );
+	vecNewXPos = _mm_add_ps( vecNewXPos, _mm_and_ps( _mm_cmplt_ps( vecNewXPos, vecZero ), vecWidth ) );
+	vecNewYPos = _mm_sub_ps( vecNewYPos, _mm_and_ps( _mm_cmpgt_ps( vecNewYPos, vecHeight ), vecHeight ) );
+	vecNewYPos = _mm_add_ps( vecNewYPos, _mm_and_ps( _mm_cmplt_ps( vecNewYPos, vecZero ), vecHeight ) );
+
+	_mm_storeu_ps( lanes.m_pflXPosLastFrame, SELECT_ACTIVE( vecXPos, _mm_loadu_ps( lanes.m_pflXPosLastFrame ) ) );
+	_mm_storeu_ps( lanes.m_pflYPosLastFrame, SELECT_ACTIVE( vecYPos, _mm_loadu_ps( lanes.m_pflYPosLastFrame ) ) );
+	_mm_storeu_ps( lanes.m_pflXPos, SELECT_ACTIVE( vecNewXPos, vecXPos ) );
+	_mm_storeu_ps( lanes.m_pflYPos, SELECT_ACTIVE( vecNewYPos, vecYPos ) );
+	_mm_storeu_ps( lanes.m_pflXVelocity, SELECT_ACTIVE( vecXVelocity, _mm_loadu_ps( lanes.m_pflXVelocity ) ) );
+	_mm_storeu_ps( lanes.m_pflYVelocity, SELECT_ACTIVE( vecYVelocity, _mm_loadu_ps( lanes.m_pflYVelocity ) ) );
+
+	// Clear acceleration, child classes should keep reseting it as appropriate each frame
+	_mm_storeu_ps( lanes.m_pflXAccelLastFrame, SELECT_ACTIVE( vecXAccel, _mm_loadu_ps( lanes.m_pflXAccelLastFrame ) ) );
+	_mm_storeu_ps( lanes.m_pflYAccelLastFrame, SELECT_ACTIVE( vecYAccel, _mm_loadu_ps( lanes.m_pflYAccelLastFrame ) ) );
+	_mm_storeu_ps( lanes.m_pflXAccel, SELECT_ACTIVE( vecZero, _mm_loadu_ps( lanes.m_pflXAccel ) ) );
+	_mm_storeu_ps( lanes.m_pflYAccel, SELECT_ACTIVE( vecZero, _mm_loadu_ps( lanes.m_pflYAccel ) ) );
+
+	_mm_storeu_ps( lanes.m_pflRotationDeltaLastFrame, SELECT_ACTIVE( vecRotationDelta, _mm_loadu_ps( lanes.m_pflRotationDeltaLastFrame ) ) );
+	_mm_storeu_ps( lanes.m_pflRotationDeltaNextFrame, SELECT_ACTIVE( vecZero, vecRotationDelta ) );
+	_mm_storeu_ps( lanes.m_pflAccumulatedRotation, SELECT_ACTIVE( vecRotation, _mm_loadu_ps( lanes.m_pflAccumulatedRotation ) ) );
+
+	#undef SELECT_ACTIVE
+#else
+	for ( uint32 i = 0; i < INTEGRATION_LANES; ++i )
+	{
+		if ( !( unActiveMask & ( 1 << i ) ) )
+			continue;
+
+		float flXPos = lanes.m_pflXPos[i];
+		float flYPos = lanes.m_pflYPos[i];
+		float flXAccel = lanes.m_pflXAccel[i];
+		float flYAccel = lanes.m_pflYAccel[i];
+
+		// The sun pulls with a strength that falls off with the square of the distance
+		if ( unGravityMask & ( 1 << i ) )
+		{
+			float flXDelta = flXPos - params.m_flXGravityCenter;
+			float flYDelta = flYPos - params.m_flYGravityCenter;
+			float flDistanceSqr = flXDelta*flXDelta + flYDelta*flYDelta;
+			float flDistance = sqrtf( flDistanceSqr );
+			float flFactor = MIN( GRAVITY_STRENGTH / flDistanceSqr, GRAVITY_MAX_ACCELERATION );
+			flXAccel -= flFactor * ( flXDelta / flDistance );
+			flYAccel -= flFactor * ( flYDelta / flDistance );
+		}
+
+		// Accumulate the rotation, then take off whole turns so it doesn't grow and lose precision
+		float flRotationDelta = lanes.m_pflRotationDeltaNextFrame[i];
+		float flRotation = lanes.m_pflAccumulatedRotation[i] + flRotationDelta;
+		float flTurns = (float)(int32)( flRotation / FULL_ROTATION );
+		flRotation -= flTurns * FULL_ROTATION;
+
+		// Update velocity and clamp it to the maximum
+		float flXVelocity = lanes.m_pflXVelocity[i] + flXAccel * params.m_flElapsedSeconds;
+		float flYVelocity = lanes.m_pflYVelocity[i] + flYAccel * params.m_flElapsedSeconds;
+		float flVelocity = sqrtf( flXVelocity*flXVelocity + flYVelocity*flYVelocity );
+		if ( flVelocity > lanes.m_pflMaximumVelocity[i] )
+		{
+			float flRatio = lanes.m_pflMaximumVelocity[i] / flVelocity;
+			flXVelocity = flXVelocity * flRatio;
+			flYVelocity = flYVelocity * flRatio;
+		}
+
+		// Move, and wrap around the edges of the screen
+		float flNewXPos = flXPos + flXVelocity * params.m_flElapsedSeconds;
+		float flNewYPos = flYPos + flYVelocity * params.m_flElapsedSeconds;
+		if ( flNewXPos > params.m_flViewportWidth )
+			flNewXPos -= params.m_flViewportWidth;
+		if ( flNewXPos < 0 )
+			flNewXPos += params.m_flViewportWidth;
+		if ( flNewYPos > params.m_flViewportHeight )
+			flNewYPos -= params.m_flViewportHeight;
+		if ( flNewYPos < 0 )
+			flNewYPos += params.m_flViewportHeight;
+
+		lanes.m_pflXPosLastFrame[i] = flXPos;
+		lanes.m_pflYPosLastFrame[i] = flYPos;
+		lanes.m_pflXPos[i] = flNewXPos;
+		lanes.m_pflYPos[i] = flNewYPos;
+		lanes.m_pflXVelocity[i] = flXVelocity;
+		lanes.m_pflYVelocity[i] = flYVelocity;
+
+		// Clear acceleration, child classes should keep reseting it as appropriate each frame
+		lanes.m_pflXAccelLastFrame[i] = flXAccel;
+		lanes.m_pflYAccelLastFrame[i] = flYAccel;
+		lanes.m_pflXAccel[i] = 0.0f;
+		lanes.m_pflYAccel[i] = 0.0f;
+
+		lanes.m_pflRotationDeltaLastFrame[i] = flRotationDelta;
+		lanes.m_pflRotationDeltaNextFrame[i] = 0.0f;
+		lanes.m_pflAccumulatedRotation[i] = flRotation;
+	}
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Integrate a range of slots in a pool
+//-----------------------------------------------------------------------------
+void IntegrateVectorEntities( CVectorEntityStatePool *pPool, uint32 iFirstSlot, uint32 unCount, const IntegrationParams_t &params )
+{
+	if ( iFirstSlot + unCount > pPool->GetSlotCount() )
+	{
+		OutputDebugString( "IntegrateVectorEntities called past the end of the pool\n" );
+		return;
+	}
+
+	const uint8 *pubFlags = unCount ? &pPool->m_vecFlags[iFirstSlot] : NULL;
+	IntegrationLanes_t lanes;
+	uint32 i = 0;
+	for ( ; i < unCount; i += INTEGRATION_LANES )
+	{
+		// Work out which lanes to integrate, and which of those gravity applies to
+		uint32 unLanes = MIN( unCount - i, (uint32)INTEGRATION_LANES );
+		uint32 unActiveMask = 0;
+		uint32 unGravityMask = 0;
+		for ( uint32 iLane = 0; iLane < unLanes; ++iLane )
+		{
+			uint8 unFlags = pubFlags[i + iLane];
+			if ( ( unFlags & ( VECTORENTITY_FLAG_IN_USE | VECTORENTITY_FLAG_SPAWNED | VECTORENTITY_FLAG_INTEGRATION_PAUSED ) ) != VECTORENTITY_FLAG_IN_USE )
+				continue;
+
+			unActiveMask |= 1 << iLane;
+			if ( unFlags & VECTORENTITY_FLAG_AFFECTED_BY_GRAVITY )
+				unGravityMask |= 1 << iLane;
+		}
+
+		if ( !unActiveMask )
+			continue;
+
+		if ( unLanes == INTEGRATION_LANES )
+		{
+			SetLanesToPool( &lanes, pPool, iFirstSlot + i );
+			IntegrateLanes( lanes, unActiveMask, unGravityMask, params );
+		}
+		else
+		{
+			// Too few slots left to load a whole block from the pool, integrate a copy of them
+			IntegrationLanes_t poolLanes;
+			IntegrationBlock_t block;
+			memset( &block, 0, sizeof( block ) );
+			SetLanesToPool( &poolLanes, pPool, iFirstSlot + i );
+			SetLanesToBlock( &lanes, &block );
+			CopyLanes( lanes, poolLanes, unLanes );
+			IntegrateLanes( lanes, unActiveMask, unGravityMask, params );
+			CopyLanes( poolLanes, lanes, unLanes );
+		}
+	}
+}
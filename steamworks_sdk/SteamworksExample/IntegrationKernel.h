@@ -0,0 +1,39 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Moves vector entities forward one frame: gravity, rotation,
+//			velocity, position and wrapping around the screen
+//
+//=============================================================================
+
+#ifndef INTEGRATIONKERNEL_H
+#define INTEGRATIONKERNEL_H
+
+class CVectorEntityStatePool;
+
+// Pull of the sun on entities flagged VECTORENTITY_FLAG_AFFECTED_BY_GRAVITY, divided by the
+// squared distance, and the most acceleration it can give
+#define GRAVITY_STRENGTH 5200000.0f
+#define GRAVITY_MAX_ACCELERATION 150.0f
+
+// Everything a frame of integration needs that isn't per entity
+struct IntegrationParams_t
+{
+	// Time the frame covers, already clamped so a slow frame doesn't launch anything
+	float m_flElapsedSeconds;
+
+	// Entities wrap around at the edges of the viewport
+	float m_flViewportWidth;
+	float m_flViewportHeight;
+
+	// Where gravity pulls towards (the sun, at the center of the viewport)
+	float m_flXGravityCenter;
+	float m_flYGravityCenter;
+};
+
+// Integrate the in-use slots in [iFirstSlot, iFirstSlot + unCount) of a pool, skipping any flagged
+// VECTORENTITY_FLAG_SPAWNED or VECTORENTITY_FLAG_INTEGRATION_PAUSED.  Runs 4 slots at a time with
+// SSE2 when the compiler targets it, and gives the same result for a slot whether it's integrated
+// alone or in a batch.
+void IntegrateVectorEntities( CVectorEntityStatePool *pPool, uint32 iFirstSlot, uint32 unCount, const IntegrationParams_t &params );
+
+#endif // INTEGRATIONKERNEL_H
@@ -0,0 +1,711 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Synthetic load test, bot clients playing against real SpaceWar
+//			servers in one process
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "LoadGenerator.h"
+#include "LoopbackTransport.h"
+#include "MatchGameEngine.h"
+#include "NetworkImpairment.h"
+#include "SpaceWarServer.h"
+#include "WorkStealingPool.h"
+#include "WorldSnapshot.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+
+// Servers listen on virtual ports from here up, one each
+#define LOAD_TEST_BASE_VIRTUAL_PORT 1
+
+// Viewport the load test servers run in
+#define LOAD_TEST_VIEWPORT_WIDTH 1024
+#define LOAD_TEST_VIEWPORT_HEIGHT 768
+
+// How far the simulated clock moves each frame, the rate the real client and server run at
+#define LOAD_TEST_FRAME_MILLISECONDS ( 1000 / MAX_CLIENT_AND_SERVER_FPS )
+
+// How long a bot gets to make it into a game before it counts as failed
+#define LOAD_TEST_CONNECT_TIMEOUT_MILLISECONDS 5000
+
+// How long a bot holds each input for, scripted inputs step through rgScriptedInputs at this rate
+// and random inputs have about this long between changes
+#define LOAD_TEST_INPUT_HOLD_MILLISECONDS 500
+
+// Inputs we stop waiting to see in a snapshot after this many, a newer one replaced them
+#define LOAD_TEST_MAX_PENDING_INPUTS 64
+
+// Looping pattern of buttons for scripted bots
+struct LoadTestInput_t
+{
+	bool m_bForward;
+	bool m_bTurnLeft;
+	bool m_bTurnRight;
+	bool m_bFire;
+};
+
+static const LoadTestInput_t rgScriptedInputs[] =
+{
+	{ true, false, false, false },
+	{ true, true, false, true },
+	{ false, true, false, true },
+	{ true, false, false, true },
+	{ true, false, true, false },
+	{ false, false, true, true },
+	{ false, false, false, true },
+	{ true, false, false, false },
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: What happened to the world updates a bot was sent
+//-----------------------------------------------------------------------------
+struct LoadTestWorldUpdateStats_t
+{
+	uint32 m_cReceived;
+	uint32 m_cStale;		// Older than, or the same as, one we already had
+	uint32 m_cNoBaseline;	// Delta against a snapshot we never got or have forgotten
+	uint32 m_cUndecodable;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Small deterministic random number generator
+//-----------------------------------------------------------------------------
+static uint32 LoadTestRandom( uint32 *punSeed )
+{
+	*punSeed = *punSeed * 1664525 + 1013904223;
+	return *punSeed >> 8;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Value below which the given percent of the sorted samples fall
+//-----------------------------------------------------------------------------
+static double GetPercentile( const std::vector< double > &vecSorted, double flPercent )
+{
+	if ( vecSorted.empty() )
+		return 0.0;
+	return vecSorted[ (size_t)( ( vecSorted.size() - 1 ) * flPercent / 100.0 ) ];
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: One synthetic player.  Talks to the server with the same messages
+//			and in the same order the real client does, but decides its inputs
+//			itself and draws nothing.
+//-----------------------------------------------------------------------------
+class CLoadTestBot
+{
+public:
+	enum EBotState
+	{
+		k_EBotConnecting,
+		k_EBotAuthenticating,
+		k_EBotPlaying,
+		k_EBotFailed,
+	};
+
+	// Messages go through pTransport, which is pLoopback or sits in front of it.  The loopback is
+	// what we connect and look at the connection through.
+	CLoadTestBot( ISpaceWarTransport *pTransport, CLoopbackTransport *pLoopback, IGameEngine *pEngine, uint32 iBot, bool bScriptedInput )
+	{
+		m_pTransport = pTransport;
+		m_pLoopback = pLoopback;
+		m_pGameEngine = pEngine;
+		m_steamID = CSteamID( 1000 + iBot, k_EUniversePublic, k_EAccountTypeIndividual );
+		m_hConn = k_HSteamNetConnection_Invalid;
+		m_eState = k_EBotFailed;
+		m_uShipIndex = 0;
+		m_unSeed = 0x5eed0000 + iBot;
+		m_bScriptedInput = bScriptedInput;
+		m_iScriptedInput = iBot % ARRAYSIZE( rgScriptedInputs );
+		memset( &m_Input, 0, sizeof( m_Input ) );
+		m_ulConnectTime = 0;
+		m_ulLastInputTime = 0;
+		m_ulLastInputChangeTime = 0;
+		m_unInputSequence = 0;
+		m_unLatestWorldSnapshot = WORLD_SNAPSHOT_NONE;
+		m_unLatestServerTime = 0;
+		m_unAckedWorldSnapshot = WORLD_SNAPSHOT_NONE;
+		memset( &m_WorldUpdateStats, 0, sizeof( m_WorldUpdateStats ) );
+	}
+
+	~CLoadTestBot()
+	{
+		if ( m_hConn != k_HSteamNetConnection_Invalid )
+			m_pTransport->CloseConnection( m_hConn, k_EDRClientDisconnect, NULL, false );
+	}
+
+	// Connect to the server listening on the given virtual port
+	void Connect( int nVirtualPort )
+	{
+		m_hConn = m_pLoopback->ConnectP2P( m_steamID, nVirtualPort );
+		m_eState = ( m_hConn != k_HSteamNetConnection_Invalid ) ? k_EBotConnecting : k_EBotFailed;
+		if ( m_eState == k_EBotConnecting )
+			m_pTransport->ConfigureConnectionLanes( m_hConn, k_ESpaceWarLaneCount, k_rgnSpaceWarLanePriorities, k_rgunSpaceWarLaneWeights );
+		m_ulConnectTime = m_pGameEngine->GetGameTickCount();
+	}
+
+	// Take whatever the server sent, then send our input and acks if it's time
+	void RunFrame( std::vector< double > &vecInputLatencies )
+	{
+		if ( m_eState == k_EBotFailed )
+			return;
+
+		ESteamNetworkingConnectionState eConnectionState = m_pLoopback->GetConnectionState( m_hConn );
+		if ( eConnectionState == k_ESteamNetworkingConnectionState_ClosedByPeer || eConnectionState == k_ESteamNetworkingConnectionState_None )
+		{
+			m_eState = k_EBotFailed;
+			return;
+		}
+
+		if ( m_eState != k_EBotPlaying && m_pGameEngine->GetGameTickCount() - m_ulConnectTime > LOAD_TEST_CONNECT_TIMEOUT_MILLISECONDS )
+		{
+			m_eState = k_EBotFailed;
+			return;
+		}
+
+		ReceiveNetworkData( vecInputLatencies );
+
+		if ( m_eState == k_EBotPlaying )
+			SendInput();
+	}
+
+	bool BPlaying() { return m_eState == k_EBotPlaying; }
+	bool BFailed() { return m_eState == k_EBotFailed; }
+	HSteamNetConnection GetConnection() { return m_hConn; }
+	const LoadTestWorldUpdateStats_t &GetWorldUpdateStats() { return m_WorldUpdateStats; }
+
+private:
+	void ReceiveNetworkData( std::vector< double > &vecInputLatencies )
+	{
+		SteamNetworkingMessage_t *msgs[32];
+		int numMessages = 0;
+		do
+		{
+			numMessages = m_pTransport->ReceiveMessagesOnConnection( m_hConn, msgs, (int)ARRAYSIZE( msgs ) );
+			for ( int idxMsg = 0; idxMsg < numMessages; idxMsg++ )
+			{
+				SteamNetworkingMessage_t *message = msgs[idxMsg];
+				if ( message->GetSize() >= sizeof( DWORD ) )
+				{
+					EMessage eMsg = (EMessage)LittleDWord( *(DWORD*)message->GetData() );
+					switch ( eMsg )
+					{
+					case k_EMsgServerSendInfo:
+						{
+							// Same as the real client, just with no ticket to send
+							MsgClientBeginAuthentication_t msg;
+							msg.SetToken( "", 0 );
+							msg.SetSteamID( m_steamID.ConvertToUint64() );
+							SendMessageToConnectionOnLane( m_pTransport, m_hConn, &msg, msg.GetMessageSize(), k_nSteamNetworkingSend_Reliable, k_ESpaceWarLaneControl, NULL );
+							m_eState = k_EBotAuthenticating;
+						}
+						break;
+
+					case k_EMsgServerPassAuthentication:
+						if ( message->GetSize() == sizeof( MsgServerPassAuthentication_t ) )
+						{
+							m_uShipIndex = ( (MsgServerPassAuthentication_t*)message->GetData() )->GetPlayerPosition();
+							m_eState = k_EBotPlaying;
+						}
+						break;
+
+					case k_EMsgServerFailAuthentication:
+						m_eState = k_EBotFailed;
+						break;
+
+					case k_EMsgServerUpdateWorldDelta:
+						if ( message->GetSize() >= sizeof( MsgServerUpdateWorldDelta_t ) )
+							OnReceiveServerUpdateDelta( (MsgServerUpdateWorldDelta_t*)message->GetData(), message->GetSize(), vecInputLatencies );
+						break;
+
+					default:
+						break;
+					}
+				}
+				message->Release();
+			}
+		} while ( numMessages == (int)ARRAYSIZE( msgs ) );
+	}
+
+	// Decode the update like the real client does, but all we want from it is how far our inputs
+	// got.  The clock here moves a frame at a time whatever the load, so an input's latency is
+	// counted in the server's simulation steps, from the world we were looking at when we sent it
+	// to the first one with it applied.
+	void OnReceiveServerUpdateDelta( MsgServerUpdateWorldDelta_t *pMsg, uint32 cubMsgSize, std::vector< double > &vecInputLatencies )
+	{
+		++m_WorldUpdateStats.m_cReceived;
+		uint32 unSequence = pMsg->GetSequence();
+		if ( unSequence <= m_unLatestWorldSnapshot )
+		{
+			++m_WorldUpdateStats.m_cStale;
+			return;
+		}
+
+		uint32 cubSnapshot = pMsg->GetSnapshotSize();
+		if ( cubSnapshot < GetPackedWorldSnapshotSize( 0, 0 ) || cubSnapshot > GetPackedWorldSnapshotSize( MAX_PLAYERS_PER_SERVER_LIMIT, MAX_PLAYERS_PER_SERVER_LIMIT ) )
+			return;
+
+		const uint8 *pubBaseline = NULL;
+		if ( pMsg->GetBaselineSequence() != WORLD_SNAPSHOT_NONE )
+		{
+			const std::vector< uint8 > *pvecBaseline = m_WorldSnapshots.FindSnapshot( pMsg->GetBaselineSequence() );
+			if ( !pvecBaseline || pvecBaseline->size() != cubSnapshot )
+			{
+				++m_WorldUpdateStats.m_cNoBaseline;
+				return;
+			}
+			pubBaseline = &(*pvecBaseline)[0];
+		}
+
+		m_vecWorldSnapshotBuffer.resize( cubSnapshot );
+		if ( !BDecodeWorldSnapshotDelta( pMsg->GetEncodedData(), cubMsgSize - sizeof( MsgServerUpdateWorldDelta_t ), pubBaseline, cubSnapshot, &m_vecWorldSnapshotBuffer[0] )
+			|| !BUnpackWorldSnapshot( &m_vecWorldSnapshotBuffer[0], cubSnapshot, m_vecUpdateWorldBuffer ) )
+		{
+			++m_WorldUpdateStats.m_cUndecodable;
+			return;
+		}
+
+		m_WorldSnapshots.AddSnapshot( unSequence, &m_vecWorldSnapshotBuffer[0], cubSnapshot );
+		m_unLatestWorldSnapshot = unSequence;
+
+		ServerSpaceWarUpdateData_t *pUpdateData = ( (MsgServerUpdateWorld_t *)&m_vecUpdateWorldBuffer[0] )->AccessUpdateData();
+		uint32 unServerTime = pUpdateData->GetServerTime();
+		m_unLatestServerTime = unServerTime;
+		if ( m_uShipIndex >= pUpdateData->GetPlayerSlotCount() )
+			return;
+
+		ServerPlayerUpdateData_t *pPlayer = pUpdateData->AccessPlayerUpdateData( m_uShipIndex );
+		if ( !pPlayer->GetActive() || !pPlayer->GetIncluded() )
+			return;
+
+		// The first snapshot carrying an input's sequence is when we could have seen it take effect
+		uint32 unAppliedSequence = pPlayer->AccessShipUpdateData()->GetInputSequence();
+		while ( !m_dequePendingInputs.empty() && (int32)( m_dequePendingInputs.front().first - unAppliedSequence ) <= 0 )
+		{
+			if ( m_dequePendingInputs.front().first == unAppliedSequence )
+				vecInputLatencies.push_back( (double)(int32)( unServerTime - m_dequePendingInputs.front().second ) / SIMULATION_STEP_MILLISECONDS );
+			m_dequePendingInputs.pop_front();
+		}
+	}
+
+	// Send our buttons and acks at the rate the real client does
+	void SendInput()
+	{
+		uint64 ulNow = m_pGameEngine->GetGameTickCount();
+		if ( ulNow - m_ulLastInputTime < 1000.0f/CLIENT_UPDATE_SEND_RATE )
+			return;
+		m_ulLastInputTime = ulNow;
+
+		if ( ulNow - m_ulLastInputChangeTime >= LOAD_TEST_INPUT_HOLD_MILLISECONDS )
+		{
+			m_ulLastInputChangeTime = ulNow;
+			if ( m_bScriptedInput )
+			{
+				m_Input = rgScriptedInputs[ m_iScriptedInput ];
+				m_iScriptedInput = ( m_iScriptedInput + 1 ) % ARRAYSIZE( rgScriptedInputs );
+			}
+			else
+			{
+				// Hold it a random amount longer next time, so the bots don't all change together
+				uint32 unBits = LoadTestRandom( &m_unSeed );
+				m_Input.m_bForward = ( unBits & 3 ) != 0;
+				m_Input.m_bTurnLeft = ( unBits & 12 ) == 4;
+				m_Input.m_bTurnRight = ( unBits & 12 ) == 8;
+				m_Input.m_bFire = ( unBits & 16 ) != 0;
+				m_ulLastInputChangeTime += LoadTestRandom( &m_unSeed ) % LOAD_TEST_INPUT_HOLD_MILLISECONDS;
+			}
+		}
+
+		MsgClientSendLocalUpdate_t msg;
+		memset( msg.AccessUpdateData(), 0, sizeof( ClientSpaceWarUpdateData_t ) );
+		msg.SetShipPosition( m_uShipIndex );
+		ClientSpaceWarUpdateData_t *pUpdateData = msg.AccessUpdateData();
+		pUpdateData->SetPlayerName( "Bot" );
+		pUpdateData->SetForwardThrustersPressed( m_Input.m_bForward );
+		pUpdateData->SetTurnLeftPressed( m_Input.m_bTurnLeft );
+		pUpdateData->SetTurnRightPressed( m_Input.m_bTurnRight );
+		pUpdateData->SetFirePressed( m_Input.m_bFire );
+		pUpdateData->SetInputSequence( ++m_unInputSequence );
+		m_pTransport->SendMessageToConnection( m_hConn, &msg, sizeof( msg ), k_nSteamNetworkingSend_Unreliable, NULL );
+
+		// Until we've seen the world there's nothing to measure from
+		if ( m_unLatestWorldSnapshot != WORLD_SNAPSHOT_NONE )
+		{
+			m_dequePendingInputs.push_back( std::make_pair( m_unInputSequence, m_unLatestServerTime ) );
+			if ( m_dequePendingInputs.size() > LOAD_TEST_MAX_PENDING_INPUTS )
+				m_dequePendingInputs.pop_front();
+		}
+
+		if ( m_unLatestWorldSnapshot != m_unAckedWorldSnapshot )
+		{
+			MsgClientAckWorldSnapshot_t msgAck;
+			msgAck.SetSequence( m_unLatestWorldSnapshot );
+			m_pTransport->SendMessageToConnection( m_hConn, &msgAck, sizeof( msgAck ), k_nSteamNetworkingSend_Unreliable, NULL );
+			m_unAckedWorldSnapshot = m_unLatestWorldSnapshot;
+		}
+	}
+
+	ISpaceWarTransport *m_pTransport;
+	CLoopbackTransport *m_pLoopback;
+	IGameEngine *m_pGameEngine;
+	CSteamID m_steamID;
+	HSteamNetConnection m_hConn;
+	EBotState m_eState;
+	uint32 m_uShipIndex;
+
+	// Inputs
+	uint32 m_unSeed;
+	bool m_bScriptedInput;
+	uint32 m_iScriptedInput;
+	LoadTestInput_t m_Input;
+	uint64 m_ulConnectTime;
+	uint64 m_ulLastInputTime;
+	uint64 m_ulLastInputChangeTime;
+	uint32 m_unInputSequence;
+
+	// Inputs we've sent but not seen in a snapshot yet, with the server time of the world we were
+	// looking at when we sent them
+	std::deque< std::pair< uint32, uint32 > > m_dequePendingInputs;
+
+	// Snapshots, as the real client keeps them
+	CWorldSnapshotHistory m_WorldSnapshots;
+	uint32 m_unLatestWorldSnapshot;
+	uint32 m_unLatestServerTime;
+	uint32 m_unAckedWorldSnapshot;
+	std::vector< uint8 > m_vecWorldSnapshotBuffer;
+	std::vector< uint8 > m_vecUpdateWorldBuffer;
+	LoadTestWorldUpdateStats_t m_WorldUpdateStats;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: One server under test, with its own clock so it can be ticked on a
+//			worker thread while the others are ticked on theirs.  Also the job
+//			that ticks it.
+//-----------------------------------------------------------------------------
+class CLoadTestServer : public IPoolJob
+{
+public:
+	// pAuthValidator, if not NULL, checks the bots' tickets in place of just letting them in,
+	// and is deleted with us
+	CLoadTestServer( ISpaceWarTransport *pTransport, uint64 ulTickCount, int nVirtualPort, uint32 unMaxPlayers, IAuthValidator *pAuthValidator )
+		: m_GameEngine( LOAD_TEST_VIEWPORT_WIDTH, LOAD_TEST_VIEWPORT_HEIGHT )
+	{
+		m_ulTickCount = ulTickCount;
+		m_flFrameMicroseconds = 0.0;
+		m_GameEngine.SetGameTickCount( ulTickCount );
+		m_pServer = new CSpaceWarServer( &m_GameEngine, true, nVirtualPort, unMaxPlayers, pTransport );
+		m_pAuthValidator = pAuthValidator;
+		if ( m_pAuthValidator )
+			m_pServer->SetAuthValidator( m_pAuthValidator );
+	}
+
+	~CLoadTestServer()
+	{
+		delete m_pServer;
+		delete m_pAuthValidator;
+	}
+
+	// Run a frame at m_ulTickCount, timing it
+	void RunJob( uint32 iWorker )
+	{
+		m_GameEngine.SetGameTickCount( m_ulTickCount );
+
+		std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+		m_pServer->ReceiveNetworkData();
+		m_pServer->RunFrame();
+		std::chrono::steady_clock::time_point tEnd = std::chrono::steady_clock::now();
+		m_flFrameMicroseconds = std::chrono::duration< double, std::micro >( tEnd - tStart ).count();
+	}
+
+	CMatchGameEngine m_GameEngine;
+	CSpaceWarServer *m_pServer;
+	IAuthValidator *m_pAuthValidator;
+
+	// Clock to run the next frame at, and how long the last one took
+	uint64 m_ulTickCount;
+	double m_flFrameMicroseconds;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Run the load test
+//-----------------------------------------------------------------------------
+bool RunLoadGenerator( uint32 unBots, uint32 unMaxPlayersPerServer, uint32 unSeconds, bool bScriptedInput, const char *pchRecordFile, uint32 unWorkers,
+	const char *pchNetProfile, uint32 unNetSeed, uint32 unAuthMilliseconds, uint32 unAuthFailPercent )
+{
+	char rgchBuffer[256];
+
+	unBots = MAX( unBots, 1u );
+	if ( !unMaxPlayersPerServer )
+		unMaxPlayersPerServer = MAX_PLAYERS_PER_SERVER;
+	unMaxPlayersPerServer = MIN( unMaxPlayersPerServer, (uint32)MAX_PLAYERS_PER_SERVER_LIMIT );
+	if ( !unSeconds )
+		unSeconds = LOAD_TEST_DEFAULT_SECONDS;
+	uint32 unServers = ( unBots + unMaxPlayersPerServer - 1 ) / unMaxPlayersPerServer;
+
+	// A replay log holds one match, recording just one of the servers would quietly leave out the rest
+	if ( pchRecordFile && unServers > 1 )
+	{
+		sprintf_safe( rgchBuffer, "Can't record a replay log with more than one server, %u bots need %u servers of %u players\n",
+			unBots, unServers, unMaxPlayersPerServer );
+		OutputDebugString( rgchBuffer );
+		return false;
+	}
+
+	// Servers tick on the main thread between the bots' frames, or all at once on a pool
+	CWorkStealingPool *pPool = ( unWorkers > 1 && unServers > 1 ) ? new CWorkStealingPool( unWorkers ) : NULL;
+
+	sprintf_safe( rgchBuffer, "Load test: %u bots on %u servers of %u players, %u seconds, %s inputs, %u server threads\n",
+		unBots, unServers, unMaxPlayersPerServer, unSeconds, bScriptedInput ? "scripted" : "random", pPool ? pPool->GetWorkerCount() : 1 );
+	OutputDebugString( rgchBuffer );
+
+	// Everything is on one clock, moved on a frame at a time without waiting for the time to pass.
+	// The bots share this engine, each server has its own set to the same time.
+	CMatchGameEngine engine( LOAD_TEST_VIEWPORT_WIDTH, LOAD_TEST_VIEWPORT_HEIGHT );
+	uint64 ulTickCount = LOAD_TEST_FRAME_MILLISECONDS;
+	engine.SetGameTickCount( ulTickCount );
+
+	CLoopbackTransport transport;
+
+	// Everybody's messages go through the impairment stage if there is one, on the bots' clock
+	CImpairedTransport impairedTransport( &transport, &engine, unNetSeed );
+	ISpaceWarTransport *pTransport = &transport;
+	if ( pchNetProfile )
+	{
+		if ( !impairedTransport.BLoadScript( pchNetProfile ) )
+		{
+			delete pPool;
+			return false;
+		}
+		pTransport = &impairedTransport;
+
+		for ( uint32 i = 0; i < k_ENetworkImpairmentDirectionCount; ++i )
+		{
+			char rgchProfile[256];
+			FormatNetworkImpairmentProfile( impairedTransport.GetProfile( (ENetworkImpairmentDirection)i ), rgchProfile, sizeof( rgchProfile ) );
+			sprintf_safe( rgchBuffer, "Network %s: %s, seed %u\n", i == k_ENetworkImpairmentUp ? "up" : "down", rgchProfile, unNetSeed );
+			OutputDebugString( rgchBuffer );
+		}
+	}
+
+	// Each server checks tickets with its own stand-in back end, seeded from the network seed
+	bool bSimulatedAuth = unAuthMilliseconds || unAuthFailPercent;
+	if ( bSimulatedAuth )
+	{
+		sprintf_safe( rgchBuffer, "Auth: %u ms +%u ms jitter, %u%% rejected\n", unAuthMilliseconds, unAuthMilliseconds / 2, unAuthFailPercent );
+		OutputDebugString( rgchBuffer );
+	}
+
+	std::vector< CLoadTestServer * > vecpServers;
+	for ( uint32 i = 0; i < unServers; ++i )
+	{
+		IAuthValidator *pAuthValidator = bSimulatedAuth ? new CSimulatedAuthValidator( unAuthMilliseconds, unAuthMilliseconds / 2, unAuthFailPercent, unNetSeed * unServers + i ) : NULL;
+		vecpServers.push_back( new CLoadTestServer( pTransport, ulTickCount, LOAD_TEST_BASE_VIRTUAL_PORT + i, unMaxPlayersPerServer, pAuthValidator ) );
+	}
+	uint64 ulStartTickCount = ulTickCount;
+
+	if ( pchRecordFile && !vecpServers[0]->m_pServer->BStartRecording( pchRecordFile ) )
+	{
+		sprintf_safe( rgchBuffer, "Couldn't create replay log %s\n", pchRecordFile );
+		OutputDebugString( rgchBuffer );
+	}
+
+	std::vector< CLoadTestBot * > vecpBots;
+	for ( uint32 i = 0; i < unBots; ++i )
+	{
+		vecpBots.push_back( new CLoadTestBot( pTransport, &transport, &engine, i, bScriptedInput ) );
+		vecpBots.back()->Connect( LOAD_TEST_BASE_VIRTUAL_PORT + i / unMaxPlayersPerServer );
+	}
+
+	std::vector< double > vecServerFrameMicroseconds;
+	std::vector< double > vecInputLatencies;
+	uint64 ulEndTickCount = ulTickCount + (uint64)unSeconds * 1000;
+	uint64 ulMeasureStartTickCount = 0;
+	uint64 ulLogonsDoneTickCount = 0;
+	LoopbackConnectionStats_t statsStart;
+	memset( &statsStart, 0, sizeof( statsStart ) );
+
+	while ( ulTickCount < ulEndTickCount )
+	{
+		ulTickCount += LOAD_TEST_FRAME_MILLISECONDS;
+		engine.SetGameTickCount( ulTickCount );
+
+		pTransport->RunCallbacks();
+
+		for ( uint32 i = 0; i < unBots; ++i )
+			vecpBots[i]->RunFrame( vecInputLatencies );
+
+		// Each server only talks to its own bots, over its own connections, so they can all run at once
+		for ( uint32 i = 0; i < unServers; ++i )
+		{
+			vecpServers[i]->m_ulTickCount = ulTickCount;
+			if ( pPool )
+				pPool->QueueJob( i, vecpServers[i] );
+			else
+				vecpServers[i]->RunJob( 0 );
+		}
+		if ( pPool )
+			pPool->WaitForAll();
+
+		// Only count frames once everyone is in, connecting is cheap and would flatter the numbers
+		for ( uint32 i = 0; i < unServers && ulMeasureStartTickCount; ++i )
+			vecServerFrameMicroseconds.push_back( vecpServers[i]->m_flFrameMicroseconds );
+
+		// Logging on is over once every bot is in or has been turned away
+		if ( !ulLogonsDoneTickCount )
+		{
+			bool bAllDone = true;
+			for ( uint32 i = 0; i < unBots && bAllDone; ++i )
+				bAllDone = vecpBots[i]->BPlaying() || vecpBots[i]->BFailed();
+			if ( bAllDone )
+				ulLogonsDoneTickCount = ulTickCount;
+		}
+
+		if ( !ulMeasureStartTickCount )
+		{
+			bool bAllPlaying = true;
+			for ( uint32 i = 0; i < unBots && bAllPlaying; ++i )
+				bAllPlaying = vecpBots[i]->BPlaying();
+
+			if ( bAllPlaying || ulTickCount - LOAD_TEST_FRAME_MILLISECONDS > LOAD_TEST_CONNECT_TIMEOUT_MILLISECONDS )
+			{
+				ulMeasureStartTickCount = ulTickCount;
+				vecInputLatencies.clear();
+				for ( uint32 i = 0; i < unServers; ++i )
+					vecpServers[i]->m_pServer->ResetSimulationAllocationCount();
+				for ( uint32 i = 0; i < unBots; ++i )
+				{
+					LoopbackConnectionStats_t stats;
+					if ( transport.GetConnectionStats( vecpBots[i]->GetConnection(), &stats ) )
+					{
+						statsStart.m_cubSent += stats.m_cubSent;
+						statsStart.m_cubReceived += stats.m_cubReceived;
+					}
+				}
+				for ( uint32 i = 0; i < unServers; ++i )
+					vecpServers[i]->m_pServer->AccessTickProfiler().Reset();
+			}
+		}
+	}
+
+	// Bandwidth from the bots' side, what they sent is the server's upstream
+	uint32 unPlaying = 0;
+	LoopbackConnectionStats_t statsEnd;
+	memset( &statsEnd, 0, sizeof( statsEnd ) );
+	LoadTestWorldUpdateStats_t worldUpdateStats;
+	memset( &worldUpdateStats, 0, sizeof( worldUpdateStats ) );
+	for ( uint32 i = 0; i < unBots; ++i )
+	{
+		if ( vecpBots[i]->BPlaying() )
+			++unPlaying;
+
+		const LoadTestWorldUpdateStats_t &botStats = vecpBots[i]->GetWorldUpdateStats();
+		worldUpdateStats.m_cReceived += botStats.m_cReceived;
+		worldUpdateStats.m_cStale += botStats.m_cStale;
+		worldUpdateStats.m_cNoBaseline += botStats.m_cNoBaseline;
+		worldUpdateStats.m_cUndecodable += botStats.m_cUndecodable;
+
+		LoopbackConnectionStats_t stats;
+		if ( transport.GetConnectionStats( vecpBots[i]->GetConnection(), &stats ) )
+		{
+			statsEnd.m_cubSent += stats.m_cubSent;
+			statsEnd.m_cubReceived += stats.m_cubReceived;
+		}
+	}
+
+	// Once everyone is playing the simulation shouldn't touch the heap, ships, beams and debris
+	// all come out of pools
+	uint64 cSimulationAllocations = 0;
+	for ( uint32 i = 0; i < unServers; ++i )
+		cSimulationAllocations += vecpServers[i]->m_pServer->GetSimulationAllocationCount();
+
+	double flMeasuredSeconds = ulMeasureStartTickCount ? (double)( ulTickCount - ulMeasureStartTickCount ) / 1000.0 : 0.0;
+	double flBotSeconds = MAX( flMeasuredSeconds, 0.001 ) * unBots;
+
+	std::sort( vecServerFrameMicroseconds.begin(), vecServerFrameMicroseconds.end() );
+	std::sort( vecInputLatencies.begin(), vecInputLatencies.end() );
+
+	sprintf_safe( rgchBuffer, "Bots playing: %u of %u\n", unPlaying, unBots );
+	OutputDebugString( rgchBuffer );
+	sprintf_safe( rgchBuffer, "Server frame (us): p50 %.1f   p90 %.1f   p99 %.1f   max %.1f\n",
+		GetPercentile( vecServerFrameMicroseconds, 50 ), GetPercentile( vecServerFrameMicroseconds, 90 ),
+		GetPercentile( vecServerFrameMicroseconds, 99 ), vecServerFrameMicroseconds.empty() ? 0.0 : vecServerFrameMicroseconds.back() );
+	OutputDebugString( rgchBuffer );
+	sprintf_safe( rgchBuffer, "Per bot bandwidth (bytes/s): down %.0f   up %.0f\n",
+		(double)( statsEnd.m_cubReceived - statsStart.m_cubReceived ) / flBotSeconds, (double)( statsEnd.m_cubSent - statsStart.m_cubSent ) / flBotSeconds );
+	OutputDebugString( rgchBuffer );
+	sprintf_safe( rgchBuffer, "Input to snapshot latency (simulation steps): p50 %.0f   p90 %.0f   p99 %.0f   max %.0f   (%u samples)\n",
+		GetPercentile( vecInputLatencies, 50 ), GetPercentile( vecInputLatencies, 90 ),
+		GetPercentile( vecInputLatencies, 99 ), vecInputLatencies.empty() ? 0.0 : vecInputLatencies.back(), (uint32)vecInputLatencies.size() );
+	OutputDebugString( rgchBuffer );
+	sprintf_safe( rgchBuffer, "Simulation step allocations: %llu%s\n", cSimulationAllocations, cSimulationAllocations ? "   (should be 0)" : "" );
+	OutputDebugString( rgchBuffer );
+	sprintf_safe( rgchBuffer, "World updates: %u received   %u stale   %u missing baseline   %u undecodable\n",
+		worldUpdateStats.m_cReceived, worldUpdateStats.m_cStale, worldUpdateStats.m_cNoBaseline, worldUpdateStats.m_cUndecodable );
+	OutputDebugString( rgchBuffer );
+
+	if ( pchNetProfile )
+	{
+		for ( uint32 i = 0; i < k_ENetworkImpairmentDirectionCount; ++i )
+		{
+			NetworkImpairmentStats_t stats;
+			impairedTransport.GetStats( (ENetworkImpairmentDirection)i, &stats );
+			sprintf_safe( rgchBuffer, "Network %s messages: %llu sent   %llu dropped   %llu retransmitted   %llu reordered   %llu duplicated\n",
+				i == k_ENetworkImpairmentUp ? "up" : "down", stats.m_cMessages, stats.m_cDropped, stats.m_cRetransmitted, stats.m_cReordered, stats.m_cDuplicated );
+			OutputDebugString( rgchBuffer );
+		}
+	}
+
+	// How logging on went, from everyone connecting at once to everyone being in
+	AuthPipelineStats_t authStats;
+	authStats.Reset();
+	for ( uint32 i = 0; i < unServers; ++i )
+		authStats.Merge( vecpServers[i]->m_pServer->GetAuthStats() );
+	double flLogonSeconds = (double)( ( ulLogonsDoneTickCount ? ulLogonsDoneTickCount : ulTickCount ) - ulStartTickCount ) / 1000.0;
+	sprintf_safe( rgchBuffer, "Logons: %llu accepted   %llu rejected   %llu timed out   %llu rate limited   in %.2f s (%.0f/s)\n",
+		authStats.m_cAccepted, authStats.m_cRejected, authStats.m_cTimedOut, authStats.m_cRateLimited, flLogonSeconds,
+		flLogonSeconds > 0.0 ? authStats.m_cAccepted / flLogonSeconds : 0.0 );
+	OutputDebugString( rgchBuffer );
+	sprintf_safe( rgchBuffer, "Ticket to answer (ms): p50 %llu   p90 %llu   p99 %llu   max %llu   most in flight %u   most queued %u\n",
+		authStats.m_TicketMilliseconds.GetPercentile( 50 ), authStats.m_TicketMilliseconds.GetPercentile( 90 ),
+		authStats.m_TicketMilliseconds.GetPercentile( 99 ), authStats.m_TicketMilliseconds.GetMax(), authStats.m_cMaxInFlight, authStats.m_cMaxQueued );
+	OutputDebugString( rgchBuffer );
+
+	SteamNetworkingMicroseconds rgusecLaneQueueTimeMax[k_ESpaceWarLaneCount] = {};
+	for ( uint32 i = 0; i < unServers; ++i )
+	{
+		SteamNetworkingMicroseconds rgusecServer[k_ESpaceWarLaneCount];
+		vecpServers[i]->m_pServer->GetLaneQueueTimes( rgusecServer );
+		for ( uint32 iLane = 0; iLane < k_ESpaceWarLaneCount; ++iLane )
+			rgusecLaneQueueTimeMax[iLane] = MAX( rgusecLaneQueueTimeMax[iLane], rgusecServer[iLane] );
+	}
+	sprintf_safe( rgchBuffer, "Server lane queue time (ms): state max %.1f   control max %.1f   voice max %.1f\n",
+		rgusecLaneQueueTimeMax[k_ESpaceWarLaneState] / 1000.0, rgusecLaneQueueTimeMax[k_ESpaceWarLaneControl] / 1000.0,
+		rgusecLaneQueueTimeMax[k_ESpaceWarLaneVoice] / 1000.0 );
+	OutputDebugString( rgchBuffer );
+
+	// Where the servers' frames went, all of them together
+	CTickProfiler profile;
+	for ( uint32 i = 0; i < unServers; ++i )
+		profile.Merge( vecpServers[i]->m_pServer->AccessTickProfiler() );
+	std::string strReport;
+	profile.AppendReport( strReport );
+	for ( uint32 i = 0; i < unServers; ++i )
+		vecpServers[i]->m_pServer->AppendSnapshotRateReport( strReport, false );
+	OutputDebugString( strReport.c_str() );
+
+	// Servers first, so they can still tell their bots they're exiting
+	delete pPool;
+	for ( uint32 i = 0; i < unServers; ++i )
+		delete vecpServers[i];
+	for ( uint32 i = 0; i < unBots; ++i )
+		delete vecpBots[i];
+
+	return unPlaying == unBots && cSimulationAllocations == 0;
+}
@@ -0,0 +1,36 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Synthetic load test, bot clients playing against real SpaceWar
+//			servers in one process
+//
+//=============================================================================
+
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+// How long the load test plays for if it isn't told
+#define LOAD_TEST_DEFAULT_SECONDS 30
+
+// Connect unBots bots to as many servers of unMaxPlayersPerServer slots (0 for
+// MAX_PLAYERS_PER_SERVER) as they need, all over a CLoopbackTransport so it doesn't need Steam,
+// and have them play for unSeconds of game time (0 for LOAD_TEST_DEFAULT_SECONDS).
+// The bots follow the same connect, authenticate, input and ack flow as the real client, with
+// seeded random inputs or, if bScriptedInput, a fixed looping pattern.  The clock is simulated
+// so it runs as fast as the servers can go.  Reports the server frame time, the bandwidth each
+// bot used, how many simulation steps inputs took to show up in the bots' snapshots (the clock
+// doesn't slow down under load, so this is the delay the protocol and network add) and how many
+// heap allocations the simulation made once everyone was in.  Returns false if any bot failed
+// to get into a game or got dropped, or if the simulation allocated.  If pchRecordFile isn't
+// NULL the server records a replay log there, see RunReplay.  A log holds one match, so this
+// fails if the bots need more than one server.  With more than one server and unWorkers over
+// one, the servers tick in parallel on that many threads while the bots wait, otherwise they
+// tick on this thread.  If pchNetProfile isn't NULL every message goes through a CImpairedTransport
+// seeded with unNetSeed, running that preset or script file, see CImpairedTransport::BLoadScript.
+// If unAuthMilliseconds or unAuthFailPercent is set, each server checks the bots' tickets with a
+// CSimulatedAuthValidator taking that long (and up to half as long again) and rejecting that
+// percent of them, instead of letting everyone straight in.  Either way it reports how fast the
+// bots were logged on.
+bool RunLoadGenerator( uint32 unBots, uint32 unMaxPlayersPerServer, uint32 unSeconds, bool bScriptedInput, const char *pchRecordFile = NULL, uint32 unWorkers = 0,
+	const char *pchNetProfile = NULL, uint32 unNetSeed = 0, uint32 unAuthMilliseconds = 0, uint32 unAuthFailPercent = 0 );
+
+#endif // LOADGENERATOR_H
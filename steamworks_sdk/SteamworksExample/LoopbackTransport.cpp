@@ -0,0 +1,672 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: In-process SpaceWar transport, for running servers and clients in
+//			one process without Steam
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "LoopbackTransport.h"
+#include <algorithm>
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CLoopbackTransport::CLoopbackTransport()
+{
+	m_unNextHandle = 1;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor.  Anything still queued is freed, including messages
+//			that raced their connection closing.
+//-----------------------------------------------------------------------------
+CLoopbackTransport::~CLoopbackTransport()
+{
+	for ( size_t i = 0; i < m_vecpAllConnections.size(); ++i )
+	{
+		while ( Message_t *pMsg = m_vecpAllConnections[i]->m_queMessages.Pop() )
+			pMsg->Release();
+	}
+
+	for ( size_t i = 0; i < m_vecpAllConnections.size(); ++i )
+		delete m_vecpAllConnections[i];
+	for ( size_t i = 0; i < m_vecpAllPollGroups.size(); ++i )
+		delete m_vecpAllPollGroups[i];
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Free a message.  It and any buffer AllocateMessage made for it
+//			are one allocation, data the sender pointed it at is theirs to free.
+//-----------------------------------------------------------------------------
+void CLoopbackTransport::ReleaseMessage( SteamNetworkingMessage_t *pMsg )
+{
+	if ( pMsg->m_pfnFreeData )
+		pMsg->m_pfnFreeData( pMsg );
+	free( static_cast< Message_t * >( pMsg ) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Make a new end of a connection
+//-----------------------------------------------------------------------------
+CLoopbackTransport::Connection_t *CLoopbackTransport::CreateConnection( HSteamNetConnection hConn )
+{
+	Connection_t *pConnection = new Connection_t;
+	pConnection->m_hConn = hConn;
+	pConnection->m_pPeer.store( NULL );
+	pConnection->m_hListenSocket = k_HSteamListenSocket_Invalid;
+	pConnection->m_pPollGroup.store( NULL );
+	pConnection->m_eState.store( k_ESteamNetworkingConnectionState_None );
+	pConnection->m_eEndReason = k_ESteamNetConnectionEnd_Invalid;
+	pConnection->m_identityRemote.Clear();
+	pConnection->m_nUserData.store( -1 );
+	pConnection->m_nLanes.store( 1 );
+	pConnection->m_bWaiting.store( false );
+	pConnection->m_pNextQueued.store( NULL );
+	pConnection->m_nNextMessageNumber.store( 1 );
+	pConnection->m_cMessagesSent.store( 0 );
+	pConnection->m_cubSent.store( 0 );
+	pConnection->m_cMessagesReceived.store( 0 );
+	pConnection->m_cubReceived.store( 0 );
+
+	m_vecpAllConnections.push_back( pConnection );
+	m_Connections.Set( hConn, pConnection );
+	return pConnection;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: What Steam would say about our end of a connection
+//-----------------------------------------------------------------------------
+void CLoopbackTransport::FillConnectionInfo( Connection_t *pConnection, ESteamNetworkingConnectionState eState, SteamNetConnectionInfo_t *pInfo )
+{
+	memset( pInfo, 0, sizeof( *pInfo ) );
+	pInfo->m_identityRemote = pConnection->m_identityRemote;
+	pInfo->m_hListenSocket = pConnection->m_hListenSocket;
+	pInfo->m_eState = eState;
+	pInfo->m_eEndReason = pConnection->m_eEndReason;
+	pInfo->m_nUserData = pConnection->m_nUserData.load();
+	pInfo->m_addrRemote.SetIPv6LocalHost();
+	strncpy_safe( pInfo->m_szConnectionDescription, "loopback", sizeof( pInfo->m_szConnectionDescription ) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Move a connection to a new state, and queue the change for the
+//			listeners to hear about in RunCallbacks
+//-----------------------------------------------------------------------------
+void CLoopbackTransport::SetConnectionState( Connection_t *pConnection, ESteamNetworkingConnectionState eState )
+{
+	SteamNetConnectionStatusChangedCallback_t callback;
+	memset( &callback, 0, sizeof( callback ) );
+	callback.m_hConn = pConnection->m_hConn;
+	callback.m_eOldState = (ESteamNetworkingConnectionState)pConnection->m_eState.load();
+	FillConnectionInfo( pConnection, eState, &callback.m_info );
+	m_vecPendingStatusChanges.push_back( callback );
+
+	pConnection->m_eState.store( eState );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Make sure whoever receives on a connection's poll group will look
+//			at it.  A connection that was moved to another group since it was
+//			put on a list gets passed on when the old group comes to it.
+//-----------------------------------------------------------------------------
+void CLoopbackTransport::WakeConnection( Connection_t *pConnection )
+{
+	PollGroup_t *pPollGroup = pConnection->m_pPollGroup.load();
+	if ( pPollGroup && !pConnection->m_bWaiting.exchange( true ) )
+		pPollGroup->m_queWaiting.Push( pConnection );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Take messages queued for a connection, stamped with its user data
+//			as it is now
+//-----------------------------------------------------------------------------
+int CLoopbackTransport::TakeMessages( Connection_t *pConnection, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages )
+{
+	int64 nUserData = pConnection->m_nUserData.load();
+	int cMessages = 0;
+	while ( cMessages < nMaxMessages )
+	{
+		Message_t *pMsg = pConnection->m_queMessages.Pop();
+		if ( !pMsg )
+			break;
+		pMsg->m_nConnUserData = nUserData;
+		ppOutMessages[cMessages++] = pMsg;
+	}
+	return cMessages;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Start listening on a virtual port
+//-----------------------------------------------------------------------------
+HSteamListenSocket CLoopbackTransport::CreateListenSocketP2P( int nVirtualPort )
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+	for ( std::map< HSteamListenSocket, int >::iterator iter = m_mapListenSockets.begin(); iter != m_mapListenSockets.end(); ++iter )
+	{
+		if ( iter->second == nVirtualPort )
+			return k_HSteamListenSocket_Invalid;
+	}
+	if ( m_unNextHandle >= LOOPBACK_MAX_HANDLES )
+		return k_HSteamListenSocket_Invalid;
+
+	HSteamListenSocket hSocket = m_unNextHandle++;
+	m_mapListenSockets[ hSocket ] = nVirtualPort;
+	return hSocket;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Stop listening, which closes every connection accepted on the socket
+//-----------------------------------------------------------------------------
+bool CLoopbackTransport::CloseListenSocket( HSteamListenSocket hSocket )
+{
+	std::vector< HSteamNetConnection > vecConnections;
+	{
+		std::lock_guard< std::mutex > lock( m_Mutex );
+		if ( !m_mapListenSockets.erase( hSocket ) )
+			return false;
+
+		for ( size_t i = 0; i < m_vecpAllConnections.size(); ++i )
+		{
+			Connection_t *pConnection = m_vecpAllConnections[i];
+			if ( pConnection->m_hListenSocket == hSocket && m_Connections.Find( pConnection->m_hConn ) )
+				vecConnections.push_back( pConnection->m_hConn );
+		}
+	}
+
+	for ( size_t i = 0; i < vecConnections.size(); ++i )
+		CloseConnection( vecConnections[i], k_ESteamNetConnectionEnd_App_Generic, "Listen socket closed", false );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Connect to whoever is listening on a virtual port
+//-----------------------------------------------------------------------------
+HSteamNetConnection CLoopbackTransport::ConnectP2P( CSteamID steamIDLocal, int nVirtualPort )
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+	return ConnectToVirtualPort( steamIDLocal, nVirtualPort );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Connect to whoever is listening on a virtual port, as a Steam ID
+//			in the dev universe made from the handle our end gets, so nobody
+//			else has it
+//-----------------------------------------------------------------------------
+HSteamNetConnection CLoopbackTransport::ConnectP2P( const SteamNetworkingIdentity &identityRemote, int nRemoteVirtualPort )
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+	return ConnectToVirtualPort( CSteamID( m_unNextHandle, k_EUniverseDev, k_EAccountTypeIndividual ), nRemoteVirtualPort );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Make both ends of a connection to a virtual port, under the lock
+//-----------------------------------------------------------------------------
+HSteamNetConnection CLoopbackTransport::ConnectToVirtualPort( CSteamID steamIDLocal, int nVirtualPort )
+{
+	HSteamListenSocket hSocket = k_HSteamListenSocket_Invalid;
+	for ( std::map< HSteamListenSocket, int >::iterator iter = m_mapListenSockets.begin(); iter != m_mapListenSockets.end(); ++iter )
+	{
+		if ( iter->second == nVirtualPort )
+			hSocket = iter->first;
+	}
+	if ( hSocket == k_HSteamListenSocket_Invalid || m_unNextHandle + 2 > LOOPBACK_MAX_HANDLES )
+		return k_HSteamNetConnection_Invalid;
+
+	Connection_t *pLocal = CreateConnection( m_unNextHandle++ );
+	Connection_t *pRemote = CreateConnection( m_unNextHandle++ );
+
+	pLocal->m_pPeer.store( pRemote );
+	pLocal->m_identityRemote.SetLocalHost();
+	pLocal->m_eState.store( k_ESteamNetworkingConnectionState_Connecting );
+
+	// The listening end hears about it, and accepts or closes it
+	pRemote->m_pPeer.store( pLocal );
+	pRemote->m_hListenSocket = hSocket;
+	pRemote->m_identityRemote.SetSteamID( steamIDLocal );
+	SetConnectionState( pRemote, k_ESteamNetworkingConnectionState_Connecting );
+
+	return pLocal->m_hConn;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Accept a connection that's waiting on one of our listen sockets
+//-----------------------------------------------------------------------------
+EResult CLoopbackTransport::AcceptConnection( HSteamNetConnection hConn )
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+
+	Connection_t *pConnection = m_Connections.Find( hConn );
+	if ( !pConnection || pConnection->m_hListenSocket == k_HSteamListenSocket_Invalid )
+		return k_EResultInvalidParam;
+
+	Connection_t *pPeer = pConnection->m_pPeer.load();
+	if ( pConnection->m_eState.load() != k_ESteamNetworkingConnectionState_Connecting || !pPeer )
+		return k_EResultInvalidState;
+
+	SetConnectionState( pConnection, k_ESteamNetworkingConnectionState_Connected );
+	SetConnectionState( pPeer, k_ESteamNetworkingConnectionState_Connected );
+	return k_EResultOK;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Close our end of a connection.  The other end sees it closed by
+//			its peer, and can still receive what was sent before.
+//-----------------------------------------------------------------------------
+bool CLoopbackTransport::CloseConnection( HSteamNetConnection hPeer, int nReason, const char *pszDebug, bool bEnableLinger )
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+
+	Connection_t *pConnection = m_Connections.Find( hPeer );
+	if ( !pConnection )
+		return false;
+
+	Connection_t *pPeer = pConnection->m_pPeer.exchange( NULL );
+	if ( pPeer )
+	{
+		pPeer->m_pPeer.store( NULL );
+		pPeer->m_eEndReason = nReason;
+		SetConnectionState( pPeer, k_ESteamNetworkingConnectionState_ClosedByPeer );
+	}
+
+	// Anyone who looked us up before this can still send, the destructor frees what they do
+	m_Connections.Set( hPeer, NULL );
+	pConnection->m_pPollGroup.store( NULL );
+	pConnection->m_eState.store( k_ESteamNetworkingConnectionState_None );
+	while ( Message_t *pMsg = pConnection->m_queMessages.Pop() )
+		pMsg->Release();
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: What Steam would say about our end of a connection
+//-----------------------------------------------------------------------------
+bool CLoopbackTransport::GetConnectionInfo( HSteamNetConnection hConn, SteamNetConnectionInfo_t *pInfo )
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+
+	Connection_t *pConnection = m_Connections.Find( hConn );
+	if ( !pConnection )
+		return false;
+	if ( pInfo )
+		FillConnectionInfo( pConnection, (ESteamNetworkingConnectionState)pConnection->m_eState.load(), pInfo );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Make a poll group
+//-----------------------------------------------------------------------------
+HSteamNetPollGroup CLoopbackTransport::CreatePollGroup()
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+	if ( m_unNextHandle >= LOOPBACK_MAX_HANDLES )
+		return k_HSteamNetPollGroup_Invalid;
+
+	PollGroup_t *pPollGroup = new PollGroup_t;
+	pPollGroup->m_hPollGroup = m_unNextHandle++;
+	m_vecpAllPollGroups.push_back( pPollGroup );
+	m_PollGroups.Set( pPollGroup->m_hPollGroup, pPollGroup );
+	return pPollGroup->m_hPollGroup;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destroy a poll group, its connections go back to being received
+//			from on their own
+//-----------------------------------------------------------------------------
+bool CLoopbackTransport::DestroyPollGroup( HSteamNetPollGroup hPollGroup )
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+
+	PollGroup_t *pPollGroup = m_PollGroups.Find( hPollGroup );
+	if ( !pPollGroup )
+		return false;
+
+	m_PollGroups.Set( hPollGroup, NULL );
+	for ( size_t i = 0; i < m_vecpAllConnections.size(); ++i )
+	{
+		Connection_t *pConnection = m_vecpAllConnections[i];
+		if ( pConnection->m_pPollGroup.load() == pPollGroup )
+			pConnection->m_pPollGroup.store( NULL );
+	}
+
+	// Nobody receives on the group any more, so we're the only one taking from its list
+	while ( Connection_t *pConnection = pPollGroup->m_queWaiting.Pop() )
+	{
+		pConnection->m_bWaiting.store( false );
+		WakeConnection( pConnection );
+	}
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Move a connection into a poll group, or out of one with
+//			k_HSteamNetPollGroup_Invalid.  Its messages stay queued on it, so
+//			the new group gets them in order with nothing to move.
+//-----------------------------------------------------------------------------
+bool CLoopbackTransport::SetConnectionPollGroup( HSteamNetConnection hConn, HSteamNetPollGroup hPollGroup )
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+
+	Connection_t *pConnection = m_Connections.Find( hConn );
+	if ( !pConnection )
+		return false;
+
+	PollGroup_t *pPollGroup = NULL;
+	if ( hPollGroup != k_HSteamNetPollGroup_Invalid )
+	{
+		pPollGroup = m_PollGroups.Find( hPollGroup );
+		if ( !pPollGroup )
+			return false;
+	}
+
+	pConnection->m_pPollGroup.store( pPollGroup );
+	WakeConnection( pConnection );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Set the user data on our end of a connection.  Messages pick it up
+//			as they're received, so the ones already queued read the same.
+//-----------------------------------------------------------------------------
+bool CLoopbackTransport::SetConnectionUserData( HSteamNetConnection hPeer, int64 nUserData )
+{
+	Connection_t *pConnection = m_Connections.Find( hPeer );
+	if ( !pConnection )
+		return false;
+
+	pConnection->m_nUserData.store( nUserData );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Set how many lanes our end of a connection sends on.  Like Steam,
+//			the count can only go up.
+//-----------------------------------------------------------------------------
+EResult CLoopbackTransport::ConfigureConnectionLanes( HSteamNetConnection hConn, int nNumLanes, const int *pLanePriorities, const uint16 *pLaneWeights )
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+
+	Connection_t *pConnection = m_Connections.Find( hConn );
+	if ( !pConnection )
+		return k_EResultNoConnection;
+
+	if ( nNumLanes < pConnection->m_nLanes.load() || nNumLanes > 255 )
+		return k_EResultInvalidParam;
+	for ( int i = 0; pLaneWeights && i < nNumLanes; ++i )
+	{
+		if ( !pLaneWeights[i] )
+			return k_EResultInvalidParam;
+	}
+	if ( !pConnection->m_pPeer.load() )
+		return k_EResultInvalidState;
+
+	pConnection->m_nLanes.store( nNumLanes );
+	return k_EResultOK;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Real time status of our end of a connection.  Messages go straight
+//			to the other end, so nothing is ever pending and no lane has any
+//			queue time.
+//-----------------------------------------------------------------------------
+EResult CLoopbackTransport::GetConnectionRealTimeStatus( HSteamNetConnection hConn, SteamNetConnectionRealTimeStatus_t *pStatus, int nLanes, SteamNetConnectionRealTimeLaneStatus_t *pLanes )
+{
+	Connection_t *pConnection = m_Connections.Find( hConn );
+	if ( !pConnection || !pConnection->m_pPeer.load() )
+		return k_EResultNoConnection;
+
+	if ( nLanes < 0 || nLanes > pConnection->m_nLanes.load() )
+		return k_EResultInvalidParam;
+
+	if ( pStatus )
+	{
+		memset( pStatus, 0, sizeof( *pStatus ) );
+		pStatus->m_eState = (ESteamNetworkingConnectionState)pConnection->m_eState.load();
+		pStatus->m_flConnectionQualityLocal = 1.0f;
+		pStatus->m_flConnectionQualityRemote = 1.0f;
+	}
+	if ( pLanes )
+		memset( pLanes, 0, nLanes * sizeof( *pLanes ) );
+	return k_EResultOK;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Make a message to send, with its buffer (if any) in the same
+//			allocation
+//-----------------------------------------------------------------------------
+SteamNetworkingMessage_t *CLoopbackTransport::AllocateMessage( int cbAllocateBuffer )
+{
+	uint32 cbBuffer = (uint32)MAX( cbAllocateBuffer, 0 );
+	Message_t *pMsg = (Message_t *)malloc( sizeof( Message_t ) + cbBuffer );
+	memset( (void *)pMsg, 0, sizeof( Message_t ) );
+	if ( cbBuffer )
+		pMsg->m_pData = pMsg + 1;
+	pMsg->m_cbSize = (int)cbBuffer;
+	pMsg->m_pfnRelease = ReleaseMessage;
+	return pMsg;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Move a message into the other end's queue.  It's retargeted at the
+//			receiving end rather than copied, and released if it can't go.
+//-----------------------------------------------------------------------------
+int64 CLoopbackTransport::DeliverMessage( Message_t *pMsg )
+{
+	EResult eResult = k_EResultOK;
+	Connection_t *pConnection = m_Connections.Find( pMsg->m_conn );
+	Connection_t *pPeer = pConnection ? pConnection->m_pPeer.load() : NULL;
+	if ( !pConnection )
+		eResult = k_EResultInvalidParam;
+	else if ( !pPeer )
+		eResult = k_EResultNoConnection;
+	else if ( pConnection->m_eState.load() != k_ESteamNetworkingConnectionState_Connected )
+		eResult = k_EResultInvalidState;
+	else if ( (uint32)pMsg->m_cbSize > k_cbMaxSteamNetworkingSocketsMessageSizeSend )
+		eResult = k_EResultLimitExceeded;
+	else if ( pMsg->m_idxLane >= pConnection->m_nLanes.load() )
+		eResult = k_EResultInvalidParam;
+
+	if ( eResult != k_EResultOK )
+	{
+		pMsg->Release();
+		return -eResult;
+	}
+
+	pMsg->m_conn = pPeer->m_hConn;
+	pMsg->m_identityPeer = pPeer->m_identityRemote;
+	int64 nMessageNumber = pMsg->m_nMessageNumber = pConnection->m_nNextMessageNumber.fetch_add( 1, std::memory_order_relaxed );
+
+	// Once it's queued the receiver can take and free it at any time
+	uint32 cbMsg = (uint32)pMsg->m_cbSize;
+	pConnection->m_cMessagesSent.fetch_add( 1, std::memory_order_relaxed );
+	pConnection->m_cubSent.fetch_add( cbMsg, std::memory_order_relaxed );
+	pPeer->m_cMessagesReceived.fetch_add( 1, std::memory_order_relaxed );
+	pPeer->m_cubReceived.fetch_add( cbMsg, std::memory_order_relaxed );
+
+	pPeer->m_queMessages.Push( pMsg );
+	WakeConnection( pPeer );
+	return nMessageNumber;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Hand messages from AllocateMessage to the other ends of their
+//			connections
+//-----------------------------------------------------------------------------
+void CLoopbackTransport::SendMessages( int nMessages, SteamNetworkingMessage_t *const *pMessages, int64 *pOutMessageNumberOrResult )
+{
+	for ( int i = 0; i < nMessages; ++i )
+	{
+		int64 nResult = DeliverMessage( static_cast< Message_t * >( pMessages[i] ) );
+		if ( pOutMessageNumberOrResult )
+			pOutMessageNumberOrResult[i] = nResult;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Copy a message into the other end's queue
+//-----------------------------------------------------------------------------
+EResult CLoopbackTransport::SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber )
+{
+	if ( cbData > k_cbMaxSteamNetworkingSocketsMessageSizeSend )
+		return k_EResultLimitExceeded;
+
+	SteamNetworkingMessage_t *pMsg = AllocateMessage( (int)cbData );
+	memcpy( pMsg->m_pData, pData, cbData );
+	pMsg->m_conn = hConn;
+	pMsg->m_nFlags = nSendFlags;
+
+	int64 nResult = DeliverMessage( static_cast< Message_t * >( pMsg ) );
+	if ( nResult < 0 )
+		return (EResult)-nResult;
+
+	if ( pOutMessageNumber )
+		*pOutMessageNumber = nResult;
+	return k_EResultOK;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Take messages queued for a connection that isn't in a poll group
+//-----------------------------------------------------------------------------
+int CLoopbackTransport::ReceiveMessagesOnConnection( HSteamNetConnection hConn, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages )
+{
+	Connection_t *pConnection = m_Connections.Find( hConn );
+	if ( !pConnection )
+		return -1;
+	if ( pConnection->m_pPollGroup.load() )
+		return 0;
+	return TakeMessages( pConnection, ppOutMessages, nMaxMessages );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Take messages queued for any connection in a poll group, a
+//			connection at a time in the order they got them
+//-----------------------------------------------------------------------------
+int CLoopbackTransport::ReceiveMessagesOnPollGroup( HSteamNetPollGroup hPollGroup, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages )
+{
+	PollGroup_t *pPollGroup = m_PollGroups.Find( hPollGroup );
+	if ( !pPollGroup )
+		return -1;
+
+	int cMessages = 0;
+	while ( cMessages < nMaxMessages )
+	{
+		Connection_t *pConnection = pPollGroup->m_queWaiting.Pop();
+		if ( !pConnection )
+			break;
+
+		// Clear the flag before we look, so anything sent from here on wakes the connection again
+		pConnection->m_bWaiting.store( false );
+		if ( pConnection->m_pPollGroup.load() != pPollGroup )
+		{
+			WakeConnection( pConnection );
+			continue;
+		}
+
+		cMessages += TakeMessages( pConnection, ppOutMessages + cMessages, nMaxMessages - cMessages );
+
+		// We may have stopped short of everything it has
+		if ( cMessages == nMaxMessages )
+			WakeConnection( pConnection );
+	}
+	return cMessages;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Listeners
+//-----------------------------------------------------------------------------
+void CLoopbackTransport::AddListener( ISpaceWarTransportListener *pListener )
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+	m_vecListeners.push_back( pListener );
+}
+
+void CLoopbackTransport::RemoveListener( ISpaceWarTransportListener *pListener )
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+	m_vecListeners.erase( std::remove( m_vecListeners.begin(), m_vecListeners.end(), pListener ), m_vecListeners.end() );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Tell the listeners about status changes since the last call,
+//			including any they cause while we're telling them.  They're told
+//			outside the lock, so they can call back into us.
+//-----------------------------------------------------------------------------
+void CLoopbackTransport::RunCallbacks()
+{
+	for ( ;; )
+	{
+		std::vector< SteamNetConnectionStatusChangedCallback_t > vecStatusChanges;
+		std::vector< ISpaceWarTransportListener * > vecListeners;
+		{
+			std::lock_guard< std::mutex > lock( m_Mutex );
+			if ( m_vecPendingStatusChanges.empty() )
+				return;
+			vecStatusChanges.swap( m_vecPendingStatusChanges );
+			vecListeners = m_vecListeners;
+		}
+
+		for ( size_t i = 0; i < vecStatusChanges.size(); ++i )
+		{
+			for ( size_t j = 0; j < vecListeners.size(); ++j )
+				vecListeners[j]->OnConnectionStatusChanged( &vecStatusChanges[i] );
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: State of our end of a connection
+//-----------------------------------------------------------------------------
+ESteamNetworkingConnectionState CLoopbackTransport::GetConnectionState( HSteamNetConnection hConn )
+{
+	Connection_t *pConnection = m_Connections.Find( hConn );
+	if ( !pConnection )
+		return k_ESteamNetworkingConnectionState_None;
+	return (ESteamNetworkingConnectionState)pConnection->m_eState.load();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Traffic on our end of a connection
+//-----------------------------------------------------------------------------
+bool CLoopbackTransport::GetConnectionStats( HSteamNetConnection hConn, LoopbackConnectionStats_t *pStats )
+{
+	Connection_t *pConnection = m_Connections.Find( hConn );
+	if ( !pConnection )
+		return false;
+	pStats->m_cMessagesSent = pConnection->m_cMessagesSent.load( std::memory_order_relaxed );
+	pStats->m_cubSent = pConnection->m_cubSent.load( std::memory_order_relaxed );
+	pStats->m_cMessagesReceived = pConnection->m_cMessagesReceived.load( std::memory_order_relaxed );
+	pStats->m_cubReceived = pConnection->m_cubReceived.load( std::memory_order_relaxed );
+	return true;
+}
@@ -0,0 +1,317 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: In-process SpaceWar transport, for running servers and clients in
+//			one process without Steam
+//
+//=============================================================================
+
+#ifndef LOOPBACKTRANSPORT_H
+#define LOOPBACKTRANSPORT_H
+
+#include "SpaceWarTransport.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// Most handles one transport hands out across connections, listen sockets and poll groups.
+// Handles aren't reused, so this caps how many connections a transport can ever make.
+#define LOOPBACK_HANDLE_CHUNK_SIZE 1024
+#define LOOPBACK_HANDLE_CHUNKS 256
+#define LOOPBACK_MAX_HANDLES ( LOOPBACK_HANDLE_CHUNK_SIZE * LOOPBACK_HANDLE_CHUNKS )
+
+//-----------------------------------------------------------------------------
+// Purpose: Traffic one end of a loopback connection has sent and received
+//-----------------------------------------------------------------------------
+struct LoopbackConnectionStats_t
+{
+	uint64 m_cMessagesSent;
+	uint64 m_cubSent;
+	uint64 m_cMessagesReceived;
+	uint64 m_cubReceived;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Queue any number of threads can push onto and one thread pops
+//			from, without locking.  Items are linked through their own
+//			m_pNextQueued, so pushing never allocates.  An item pushed while
+//			the queue is being popped can be missed by that pop and picked up
+//			by the next one.
+//-----------------------------------------------------------------------------
+template < typename T >
+class CLoopbackQueue
+{
+public:
+	CLoopbackQueue() : m_pHead( &m_Stub ), m_pTail( &m_Stub ) { m_Stub.m_pNextQueued.store( NULL, std::memory_order_relaxed ); }
+
+	// Any thread
+	void Push( T *pItem )
+	{
+		pItem->m_pNextQueued.store( NULL, std::memory_order_relaxed );
+		T *pPrev = m_pHead.exchange( pItem, std::memory_order_seq_cst );
+		pPrev->m_pNextQueued.store( pItem, std::memory_order_seq_cst );
+	}
+
+	// Only ever one thread at a time, NULL if there's nothing we can take yet
+	T *Pop()
+	{
+		T *pTail = m_pTail;
+		T *pNext = pTail->m_pNextQueued.load( std::memory_order_seq_cst );
+		if ( pTail == &m_Stub )
+		{
+			if ( !pNext )
+				return NULL;
+			m_pTail = pTail = pNext;
+			pNext = pNext->m_pNextQueued.load( std::memory_order_seq_cst );
+		}
+
+		if ( pNext )
+		{
+			m_pTail = pNext;
+			return pTail;
+		}
+
+		// pTail looks like the last item, but someone may be partway through pushing after it
+		if ( pTail != m_pHead.load( std::memory_order_seq_cst ) )
+			return NULL;
+
+		// It is the last, put the stub behind it so we can take it without emptying the list
+		Push( &m_Stub );
+		pNext = pTail->m_pNextQueued.load( std::memory_order_seq_cst );
+		if ( !pNext )
+			return NULL;
+		m_pTail = pNext;
+		return pTail;
+	}
+
+private:
+	CLoopbackQueue( const CLoopbackQueue & );
+	CLoopbackQueue &operator=( const CLoopbackQueue & );
+
+	// Producers push at the head, the consumer pops at the tail
+	std::atomic< T * > m_pHead;
+	T *m_pTail;
+
+	// Always somewhere in the list, so it's never empty and a push never has to touch the tail
+	T m_Stub;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Handle to object lookup any thread can do without locking.  Only
+//			the transport's lock holder adds and removes entries, and objects
+//			stay allocated after they're removed, so a lookup that raced a
+//			removal still has something valid to look at.
+//-----------------------------------------------------------------------------
+template < typename T >
+class CLoopbackHandleTable
+{
+public:
+	CLoopbackHandleTable()
+	{
+		for ( uint32 i = 0; i < LOOPBACK_HANDLE_CHUNKS; ++i )
+			m_rgpChunks[i].store( NULL, std::memory_order_relaxed );
+	}
+
+	~CLoopbackHandleTable()
+	{
+		for ( uint32 i = 0; i < LOOPBACK_HANDLE_CHUNKS; ++i )
+			delete[] m_rgpChunks[i].load( std::memory_order_relaxed );
+	}
+
+	T *Find( uint32 unHandle ) const
+	{
+		if ( unHandle >= LOOPBACK_MAX_HANDLES )
+			return NULL;
+		std::atomic< T * > *pChunk = m_rgpChunks[ unHandle / LOOPBACK_HANDLE_CHUNK_SIZE ].load( std::memory_order_acquire );
+		return pChunk ? pChunk[ unHandle % LOOPBACK_HANDLE_CHUNK_SIZE ].load( std::memory_order_acquire ) : NULL;
+	}
+
+	// Under the transport's lock.  NULL removes the entry.
+	void Set( uint32 unHandle, T *pObject )
+	{
+		std::atomic< T * > *pChunk = m_rgpChunks[ unHandle / LOOPBACK_HANDLE_CHUNK_SIZE ].load( std::memory_order_relaxed );
+		if ( !pChunk )
+		{
+			pChunk = new std::atomic< T * >[ LOOPBACK_HANDLE_CHUNK_SIZE ];
+			for ( uint32 i = 0; i < LOOPBACK_HANDLE_CHUNK_SIZE; ++i )
+				pChunk[i].store( NULL, std::memory_order_relaxed );
+			m_rgpChunks[ unHandle / LOOPBACK_HANDLE_CHUNK_SIZE ].store( pChunk, std::memory_order_release );
+		}
+		pChunk[ unHandle % LOOPBACK_HANDLE_CHUNK_SIZE ].store( pObject, std::memory_order_release );
+	}
+
+private:
+	std::atomic< std::atomic< T * > * > m_rgpChunks[LOOPBACK_HANDLE_CHUNKS];
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Connects the two ends of each connection directly.  Sending moves
+//			the message straight into the other end's queue, so nothing is ever
+//			lost, reordered or delayed, reliable or not.  Messages sent with
+//			SendMessages aren't copied at all, the same message is handed to
+//			the other end, and whoever receives it owns it until they release
+//			it.
+//
+//			Sending and receiving don't lock, so servers and clients sharing a
+//			transport can each run on their own thread.  Each end of a
+//			connection has its own queue.  A poll group keeps a list of its
+//			connections that have messages waiting, which senders add to and
+//			the group's receiver takes from.  Everything else (connecting,
+//			accepting, closing, poll group changes, callbacks)
+//			takes a lock.  A connection's messages have to be received, and
+//			the connection closed, from one thread at a time, and a poll group
+//			received from by one thread at a time, which is how the server and
+//			the client already use them.
+//-----------------------------------------------------------------------------
+class CLoopbackTransport : public ISpaceWarTransport
+{
+public:
+	// Constructor
+	CLoopbackTransport();
+
+	// Destructor, frees any messages nobody received
+	~CLoopbackTransport();
+
+	// Connect to whoever is listening on the virtual port, as the given Steam ID.  Returns
+	// k_HSteamNetConnection_Invalid if nobody is.
+	HSteamNetConnection ConnectP2P( CSteamID steamIDLocal, int nVirtualPort );
+
+	// Current state of our end of a connection
+	ESteamNetworkingConnectionState GetConnectionState( HSteamNetConnection hConn );
+
+	// Traffic on our end of a connection, false if there's no such connection
+	bool GetConnectionStats( HSteamNetConnection hConn, LoopbackConnectionStats_t *pStats );
+
+	// ISpaceWarTransport.  Everyone is in this process, so the virtual port is all that says who
+	// a ConnectP2P reaches, and the connection comes from a made up Steam ID of its own.
+	HSteamListenSocket CreateListenSocketP2P( int nVirtualPort );
+	bool CloseListenSocket( HSteamListenSocket hSocket );
+	HSteamNetConnection ConnectP2P( const SteamNetworkingIdentity &identityRemote, int nRemoteVirtualPort );
+	EResult AcceptConnection( HSteamNetConnection hConn );
+	bool CloseConnection( HSteamNetConnection hPeer, int nReason, const char *pszDebug, bool bEnableLinger );
+	bool GetConnectionInfo( HSteamNetConnection hConn, SteamNetConnectionInfo_t *pInfo );
+	HSteamNetPollGroup CreatePollGroup();
+	bool DestroyPollGroup( HSteamNetPollGroup hPollGroup );
+	bool SetConnectionPollGroup( HSteamNetConnection hConn, HSteamNetPollGroup hPollGroup );
+	bool SetConnectionUserData( HSteamNetConnection hPeer, int64 nUserData );
+	EResult ConfigureConnectionLanes( HSteamNetConnection hConn, int nNumLanes, const int *pLanePriorities, const uint16 *pLaneWeights );
+	EResult GetConnectionRealTimeStatus( HSteamNetConnection hConn, SteamNetConnectionRealTimeStatus_t *pStatus, int nLanes, SteamNetConnectionRealTimeLaneStatus_t *pLanes );
+	EResult SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber );
+	int ReceiveMessagesOnConnection( HSteamNetConnection hConn, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages );
+	int ReceiveMessagesOnPollGroup( HSteamNetPollGroup hPollGroup, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages );
+	SteamNetworkingMessage_t *AllocateMessage( int cbAllocateBuffer );
+	void SendMessages( int nMessages, SteamNetworkingMessage_t *const *pMessages, int64 *pOutMessageNumberOrResult );
+	void AddListener( ISpaceWarTransportListener *pListener );
+	void RemoveListener( ISpaceWarTransportListener *pListener );
+	void RunCallbacks();
+	bool BIsInProcess() { return true; }
+
+private:
+	struct PollGroup_t;
+
+	// A message we allocated, with the link the queues chain it on.  Its buffer follows it.
+	struct Message_t : public SteamNetworkingMessage_t
+	{
+		std::atomic< Message_t * > m_pNextQueued;
+	};
+
+	// One end of a connection.  What can change while others are sending and receiving is
+	// atomic, the rest is only touched under the lock or never changes.
+	struct Connection_t
+	{
+		HSteamNetConnection m_hConn;
+
+		// Other end of the connection, NULL once either end has closed
+		std::atomic< Connection_t * > m_pPeer;
+
+		// Listen socket this end was accepted on, or k_HSteamListenSocket_Invalid for the end that connected
+		HSteamListenSocket m_hListenSocket;
+
+		// Poll group this end's messages are received through, or NULL
+		std::atomic< PollGroup_t * > m_pPollGroup;
+
+		std::atomic< int > m_eState;
+		int m_eEndReason;
+		SteamNetworkingIdentity m_identityRemote;
+
+		// Set by the owner of this end, -1 until they do.  Stamped on messages as they're received.
+		std::atomic< int64 > m_nUserData;
+
+		// Lanes this end can send on.  Nothing is ever queued, so priorities and weights don't matter.
+		std::atomic< int > m_nLanes;
+
+		// Messages for this end, oldest first
+		CLoopbackQueue< Message_t > m_queMessages;
+
+		// Is this end on its poll group's list of connections with messages waiting?  Whoever
+		// sets it puts it on the list, whoever takes it off the list clears it.
+		std::atomic< bool > m_bWaiting;
+		std::atomic< Connection_t * > m_pNextQueued;
+
+		std::atomic< int64 > m_nNextMessageNumber;
+		std::atomic< uint64 > m_cMessagesSent;
+		std::atomic< uint64 > m_cubSent;
+		std::atomic< uint64 > m_cMessagesReceived;
+		std::atomic< uint64 > m_cubReceived;
+	};
+
+	struct PollGroup_t
+	{
+		HSteamNetPollGroup m_hPollGroup;
+
+		// Connections in the group that may have messages waiting, in the order they got them
+		CLoopbackQueue< Connection_t > m_queWaiting;
+	};
+
+	// Make both ends of a connection to a virtual port, under the lock
+	HSteamNetConnection ConnectToVirtualPort( CSteamID steamIDLocal, int nVirtualPort );
+
+	// Make a new end of a connection, under the lock
+	Connection_t *CreateConnection( HSteamNetConnection hConn );
+
+	// Fill in the info Steam would have for our end of a connection
+	void FillConnectionInfo( Connection_t *pConnection, ESteamNetworkingConnectionState eState, SteamNetConnectionInfo_t *pInfo );
+
+	// Move a connection to a new state and queue the status change for the listeners, under the lock
+	void SetConnectionState( Connection_t *pConnection, ESteamNetworkingConnectionState eState );
+
+	// Put a connection on its poll group's waiting list, if it has a poll group and isn't on it already
+	void WakeConnection( Connection_t *pConnection );
+
+	// Take up to nMaxMessages of a connection's messages
+	int TakeMessages( Connection_t *pConnection, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages );
+
+	// Hand a message from AllocateMessage to the other end of its connection, returns its
+	// message number or a negative EResult
+	int64 DeliverMessage( Message_t *pMsg );
+
+	// Free a message we allocated
+	static void ReleaseMessage( SteamNetworkingMessage_t *pMsg );
+
+	// Held for everything but sending and receiving
+	std::mutex m_Mutex;
+
+	// Handles are unique across connections, listen sockets and poll groups
+	uint32 m_unNextHandle;
+
+	CLoopbackHandleTable< Connection_t > m_Connections;
+	CLoopbackHandleTable< PollGroup_t > m_PollGroups;
+
+	// Every connection end and poll group we've made, freed only when we are, since a thread
+	// that looked one up just before it was closed may still be using it
+	std::vector< Connection_t * > m_vecpAllConnections;
+	std::vector< PollGroup_t * > m_vecpAllPollGroups;
+
+	// Virtual port each listen socket is on
+	std::map< HSteamListenSocket, int > m_mapListenSockets;
+
+	// Status changes waiting for RunCallbacks
+	std::vector< SteamNetConnectionStatusChangedCallback_t > m_vecPendingStatusChanges;
+
+	std::vector< ISpaceWarTransportListener * > m_vecListeners;
+};
+
+#endif // LOOPBACKTRANSPORT_H
@@ -27,6 +27,12 @@
 #endif
 
 #include "SpaceWarClient.h"
+#include "MatchHost.h"
+#include "CollisionBenchmark.h"
+#include "SnapshotBenchmark.h"
+#include "LoadGenerator.h"
+#include "ReplayLog.h"
+#include "NetworkImpairment.h"
 
 //-----------------------------------------------------------------------------
 // Purpose: Wrapper around SteamAPI_WriteMiniDump which can be used directly 
@@ -115,13 +121,27 @@ bool ParseCommandLine( const char *pchCmdLine, const char **ppchServerAddress, c
 //-----------------------------------------------------------------------------
 // Purpose: Main loop code shared between all platforms
 //-----------------------------------------------------------------------------
-void RunGameLoop( IGameEngine *pGameEngine, const char *pchServerAddress, const char *pchLobbyID, bool bShowTimer )
+void RunGameLoop( IGameEngine *pGameEngine, const char *pchServerAddress, const char *pchLobbyID, bool bShowTimer, const char *pchNetProfile, uint32 unNetSeed )
 {
 	// Make sure it initialized ok
 	if ( pGameEngine->BReadyForUse() )
 	{
+		// With a network profile, what the client sends goes through an impairment stage first
+		CSteamNetworkingTransport *pSteamTransport = NULL;
+		CImpairedTransport *pImpairedTransport = NULL;
+		if ( pchNetProfile )
+		{
+			pSteamTransport = new CSteamNetworkingTransport( SteamNetworkingSockets(), SteamNetworkingUtils() );
+			pImpairedTransport = new CImpairedTransport( pSteamTransport, pGameEngine, unNetSeed );
+			if ( !pImpairedTransport->BLoadScript( pchNetProfile ) )
+			{
+				delete pImpairedTransport;
+				pImpairedTransport = NULL;
+			}
+		}
+
 		// Initialize the game
-		CSpaceWarClient *pGameClient = new CSpaceWarClient( pGameEngine );
+		CSpaceWarClient *pGameClient = new CSpaceWarClient( pGameEngine, pImpairedTransport );
 
 		pGameClient->SetShowTimer( bShowTimer );
 
@@ -156,6 +176,8 @@ void RunGameLoop( IGameEngine *pGameEngine, const char *pchServerAddress, const
 		}
 
 		delete pGameClient;
+		delete pImpairedTransport;
+		delete pSteamTransport;
 	}
 
 	// Cleanup the game engine
@@ -163,6 +185,76 @@ void RunGameLoop( IGameEngine *pGameEngine, const char *pchServerAddress, const
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Main loop when running as a host for many dedicated server matches
+//-----------------------------------------------------------------------------
+void RunMatchHostLoop( IGameEngine *pGameEngine, uint32 unMatches, uint32 unWorkers, uint32 unMaxPlayersPerMatch )
+{
+	if ( pGameEngine->BReadyForUse() )
+	{
+		CSpaceWarMatchHost *pMatchHost = new CSpaceWarMatchHost( pGameEngine, unMatches, unWorkers, unMaxPlayersPerMatch );
+
+		pGameEngine->SetBackgroundColor( 0, 0, 0, 0 );
+
+		while( !pGameEngine->BShuttingDown() )
+		{
+			if ( pGameEngine->StartFrame() )
+			{
+				pGameEngine->UpdateGameTickCount();
+
+				// Run a frame of every match
+				pMatchHost->RunFrame();
+				pGameEngine->EndFrame();
+
+				// Sleep to limit frame rate
+				while( pGameEngine->BSleepForFrameRateLimit( MAX_CLIENT_AND_SERVER_FPS ) )
+				{
+				}
+			}
+		}
+
+		delete pMatchHost;
+	}
+
+	// Cleanup the game engine
+	delete pGameEngine;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Read the integer following a command line parameter, or 0 if it isn't there
+//-----------------------------------------------------------------------------
+static uint32 GetCommandLineUint( const char *pchCmdLine, const char *pchParam )
+{
+	const char *pchValue = strstr( pchCmdLine, pchParam );
+	if ( !pchValue )
+		return 0;
+
+	int nValue = atoi( pchValue + strlen( pchParam ) );
+	return nValue > 0 ? (uint32)nValue : 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Read the word following a command line parameter, false if it isn't there
+//-----------------------------------------------------------------------------
+static bool GetCommandLineString( const char *pchCmdLine, const char *pchParam, char *pchValue, uint32 cchValue )
+{
+	const char *pchStart = strstr( pchCmdLine, pchParam );
+	if ( !pchStart )
+		return false;
+
+	pchStart += strlen( pchParam );
+	uint32 cchWord = (uint32)strcspn( pchStart, " " );
+	if ( !cchWord || cchWord >= cchValue )
+		return false;
+
+	memcpy( pchValue, pchStart, cchWord );
+	pchValue[cchWord] = '\0';
+	return true;
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Real main entry point for the program
 //-----------------------------------------------------------------------------
@@ -170,7 +262,39 @@ void RunGameLoop( IGameEngine *pGameEngine, const char *pchServerAddress, const
 
 static int RealMain( const char *pchCmdLine, HINSTANCE hInstance, int nCmdShow )
 {
-	
+	// -benchcollisions times the collision broadphase against the full scan and exits, it doesn't need Steam
+	if ( strstr( pchCmdLine, "-benchcollisions" ) )
+		return RunCollisionBenchmark() ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	// -benchsnapshots times packing world updates and checks they come back within their error bounds
+	if ( strstr( pchCmdLine, "-benchsnapshots" ) )
+		return RunSnapshotBenchmark() ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	// -loadtest <N> plays N bots against local servers over a loopback transport and reports how
+	// the servers held up.  -maxplayers <N> and -loadseconds <N> size the servers and the run,
+	// -scriptedinput has the bots all play the same pattern instead of random inputs,
+	// -record <file> records the first server to a replay log and -workers <N> ticks the servers
+	// on N threads at once.  -netprofile <preset|file> plays every connection over an impaired
+	// network, see CImpairedTransport::BLoadScript, seeded with -netseed <N>.  -authms <N> and
+	// -authfail <percent> have the servers check tickets with a stand-in back end that takes N ms
+	// and rejects that percent of them.
+	char rgchRecordFile[1024];
+	char rgchNetProfile[1024];
+	bool bNetProfile = GetCommandLineString( pchCmdLine, "-netprofile ", rgchNetProfile, sizeof( rgchNetProfile ) );
+	uint32 unNetSeed = GetCommandLineUint( pchCmdLine, "-netseed " );
+	if ( strstr( pchCmdLine, "-loadtest " ) )
+		return RunLoadGenerator( GetCommandLineUint( pchCmdLine, "-loadtest " ), GetCommandLineUint( pchCmdLine, "-maxplayers " ),
+			GetCommandLineUint( pchCmdLine, "-loadseconds " ), strstr( pchCmdLine, "-scriptedinput" ) != NULL,
+			GetCommandLineString( pchCmdLine, "-record ", rgchRecordFile, sizeof( rgchRecordFile ) ) ? rgchRecordFile : NULL,
+			GetCommandLineUint( pchCmdLine, "-workers " ), bNetProfile ? rgchNetProfile : NULL, unNetSeed,
+			GetCommandLineUint( pchCmdLine, "-authms " ), GetCommandLineUint( pchCmdLine, "-authfail " ) ) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	// -replay <file> re-simulates a recorded match and checks it plays out the same, add
+	// -fastforward to only read through its snapshots
+	char rgchReplayFile[1024];
+	if ( GetCommandLineString( pchCmdLine, "-replay ", rgchReplayFile, sizeof( rgchReplayFile ) ) )
+		return RunReplay( rgchReplayFile, !strstr( pchCmdLine, "-fastforward" ) ) ? EXIT_SUCCESS : EXIT_FAILURE;
+
 	if ( SteamAPI_RestartAppIfNecessary( k_uAppIdInvalid ) )
 	{
 		// if Steam is not running or the game wasn't started through Steam, SteamAPI_RestartAppIfNecessary starts the 
@@ -239,6 +363,15 @@ static int RealMain( const char *pchCmdLine, HINSTANCE hInstance, int nCmdShow )
 
 	bool bShowTimer = !!strstr( pchCmdLine, "-timer" );
 
+	// -matchhost <N> runs N dedicated server matches in this process instead of the game,
+	// -workers <N> sets the number of threads ticking them (default is one per core) and
+	// -maxplayers <N> sets the player cap of each match
+	uint32 unHostedMatches = GetCommandLineUint( pchCmdLine, "-matchhost " );
+	uint32 unMatchHostWorkers = GetCommandLineUint( pchCmdLine, "-workers " );
+	uint32 unMaxPlayersPerMatch = GetCommandLineUint( pchCmdLine, "-maxplayers " );
+	if ( !unMaxPlayersPerMatch )
+		unMaxPlayersPerMatch = MAX_PLAYERS_PER_SERVER;
+
 	// do a DRM self check
 	Steamworks_SelfCheck();
 
@@ -279,7 +412,10 @@ static int RealMain( const char *pchCmdLine, HINSTANCE hInstance, int nCmdShow )
 	SteamInput()->SetInputActionManifestFilePath( rgchFullPath );
 
 	// This call will block and run until the game exits
-	RunGameLoop( pGameEngine, pchServerAddress, pchLobbyID, bShowTimer );
+	if ( unHostedMatches )
+		RunMatchHostLoop( pGameEngine, unHostedMatches, unMatchHostWorkers, unMaxPlayersPerMatch );
+	else
+		RunGameLoop( pGameEngine, pchServerAddress, pchLobbyID, bShowTimer, bNetProfile ? rgchNetProfile : NULL, unNetSeed );
 
 	// Shutdown the SteamAPI
 	SteamAPI_Shutdown();
@@ -351,7 +487,8 @@ int main(int argc, const char **argv)
             *pszStart++ = ' ';
     }
     
-    szCmdLine[V_ARRAYSIZE(szCmdLine) - 1] = '\0';
+    // The last argument isn't followed by a space, end the string after it
+    *( pszStart < pszEnd ? pszStart : pszEnd - 1 ) = '\0';
     
     return RealMain( szCmdLine, 0, 0 );
 }
@@ -375,7 +512,8 @@ int main(int argc, const char **argv)
         if ( i < argc-1 )
             *pszStart++ = ' ';
     }
-    szCmdLine[V_ARRAYSIZE(szCmdLine) - 1] = '\0';
+    // The last argument isn't followed by a space, end the string after it
+    *( pszStart < pszEnd ? pszStart : pszEnd - 1 ) = '\0';
     return RealMain( szCmdLine, 0, 0 );
 }
 #endif
@@ -0,0 +1,76 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Per-match game engine used when a process hosts many game server
+//			matches.  Each match owns its own tick state so matches can be
+//			ticked on different threads at slightly different times.
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "MatchGameEngine.h"
+#include "SpaceWar.h"
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CMatchGameEngine::CMatchGameEngine( int32 nViewportWidth, int32 nViewportHeight )
+{
+	m_ulGameTickCount = 0;
+	m_ulPreviousGameTickCount = 0;
+	m_nViewportWidth = nViewportWidth;
+	m_nViewportHeight = nViewportHeight;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Move this match's clock forward.  The delta is measured from the last
+//			time this match ran, not from the host's last frame, so a match that
+//			got delayed behind a slow neighbor still integrates the right amount.
+//-----------------------------------------------------------------------------
+void CMatchGameEngine::SetGameTickCount( uint64 ulGameTickCount )
+{
+	// First tick of the match, don't report a huge delta since time zero
+	if ( m_ulGameTickCount == 0 )
+		m_ulGameTickCount = ulGameTickCount;
+
+	m_ulPreviousGameTickCount = m_ulGameTickCount;
+	m_ulGameTickCount = ulGameTickCount;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor.  The clock starts one step in rather than at zero,
+//			entities use a zero tick count to mean "never".
+//-----------------------------------------------------------------------------
+CSimulationEngine::CSimulationEngine( int32 nViewportWidth, int32 nViewportHeight )
+	: CMatchGameEngine( nViewportWidth, nViewportHeight )
+{
+	SetGameTickCount( SIMULATION_STEP_MILLISECONDS );
+	m_ulAccumulatedMilliseconds = 0;
+	m_unStepCount = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Bank real time towards the next steps.  A frame that took too long
+//			only catches up MAX_SIMULATION_CATCHUP_MILLISECONDS, the same limit
+//			entities used to put on their frame delta.
+//-----------------------------------------------------------------------------
+uint32 CSimulationEngine::AccumulateTime( uint64 ulMilliseconds )
+{
+	m_ulAccumulatedMilliseconds += MIN( ulMilliseconds, (uint64)MAX_SIMULATION_CATCHUP_MILLISECONDS );
+	uint32 unSteps = (uint32)( m_ulAccumulatedMilliseconds / SIMULATION_STEP_MILLISECONDS );
+	m_ulAccumulatedMilliseconds -= (uint64)unSteps * SIMULATION_STEP_MILLISECONDS;
+	return unSteps;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Move the clock forward one step
+//-----------------------------------------------------------------------------
+void CSimulationEngine::Step()
+{
+	SetGameTickCount( GetGameTickCount() + SIMULATION_STEP_MILLISECONDS );
+	++m_unStepCount;
+}
@@ -0,0 +1,111 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Per-match game engine used when a process hosts many game server
+//			matches.  Each match owns its own tick state so matches can be
+//			ticked on different threads at slightly different times.
+//
+//=============================================================================
+
+#ifndef MATCHGAMEENGINE_H
+#define MATCHGAMEENGINE_H
+
+#include "GameEngine.h"
+
+class CMatchGameEngine : public IGameEngine
+{
+public:
+	// Constructor, viewport size is fixed for the life of the match
+	CMatchGameEngine( int32 nViewportWidth, int32 nViewportHeight );
+
+	// Advance this match's clock to the given host tick count, computing the frame delta
+	// since the last time this match ran
+	void SetGameTickCount( uint64 ulGameTickCount );
+
+	// Tick state, owned per match
+	uint64 GetGameTickCount() { return m_ulGameTickCount; }
+	uint64 GetGameTicksFrameDelta() { return m_ulGameTickCount - m_ulPreviousGameTickCount; }
+	void UpdateGameTickCount() {}
+	bool BSleepForFrameRateLimit( uint32 ulMaxFrameRate ) { return false; }
+
+	// Viewport the server simulates in
+	int32 GetViewportWidth() { return m_nViewportWidth; }
+	int32 GetViewportHeight() { return m_nViewportHeight; }
+
+	// A match has no window, no input and no audio.  Everything below is a no-op.
+	bool BReadyForUse() { return true; }
+	bool BShuttingDown() { return false; }
+	void SetBackgroundColor( short a, short r, short g, short b ) {}
+	bool StartFrame() { return true; }
+	void EndFrame() {}
+	void Shutdown() {}
+	void MessagePump() {}
+	bool BDrawString( HGAMEFONT hFont, RECT rect, DWORD dwColor, DWORD dwFormat, const char *pchText ) { return true; }
+	HGAMEFONT HCreateFont( int nHeight, int nFontWeight, bool bItalic, const char * pchFont ) { return 0; }
+	HGAMETEXTURE HCreateTexture( byte *pData, uint32 uWidth, uint32 uHeight, ETEXTUREFORMAT eTextureFormat ) { return 0; }
+	bool UpdateTexture( HGAMETEXTURE texture, byte *pData, uint32 uWidth, uint32 uHeight, ETEXTUREFORMAT eTextureFormat ) { return false; }
+	bool BDrawLine( float xPos0, float yPos0, DWORD dwColor0, float xPos1, float yPos1, DWORD dwColor1 ) { return true; }
+	bool BFlushLineBuffer() { return true; }
+	bool BDrawPoint( float xPos, float yPos, DWORD dwColor ) { return true; }
+	bool BFlushPointBuffer() { return true; }
+	bool BDrawFilledRect( float xPos0, float yPos0, float xPos1, float yPos1, DWORD dwColor ) { return true; }
+	bool BDrawTexturedRect( float xPos0, float yPos0, float xPos1, float yPos1,
+		float u0, float v0, float u1, float v1, DWORD dwColor, HGAMETEXTURE hTexture ) { return true; }
+	bool BDrawTexturedQuad( float xPos0, float yPos0, float xPos1, float yPos1, float xPos2, float yPos2, float xPos3, float yPos3,
+		float u0, float v0, float u1, float v1, DWORD dwColor, HGAMETEXTURE hTexture ) { return true; }
+	bool BFlushQuadBuffer() { return true; }
+	bool BIsKeyDown( DWORD dwVK ) { return false; }
+	bool BGetFirstKeyDown( DWORD *pdwVK ) { return false; }
+	bool BIsSteamInputDeviceActive() { return false; }
+	bool BIsControllerActionActive( ECONTROLLERDIGITALACTION dwAction ) { return false; }
+	void FindActiveSteamInputDevice() {}
+	void GetControllerAnalogAction( ECONTROLLERANALOGACTION dwAction, float *x, float *y ) { *x = 0.0f; *y = 0.0f; }
+	void SetSteamControllerActionSet( ECONTROLLERACTIONSET dwActionSet ) {}
+	void ActivateSteamControllerActionSetLayer( ECONTROLLERACTIONSET dwActionSet ) {}
+	void DeactivateSteamControllerActionSetLayer( ECONTROLLERACTIONSET dwActionSet ) {}
+	bool BIsActionSetLayerActive( ECONTROLLERACTIONSET dwActionSetLayer ) { return false; }
+	const char *GetTextStringForControllerOriginDigital( ECONTROLLERACTIONSET dwActionSet, ECONTROLLERDIGITALACTION dwDigitalAction ) { return ""; }
+	const char *GetTextStringForControllerOriginAnalog( ECONTROLLERACTIONSET dwActionSet, ECONTROLLERANALOGACTION dwDigitalAction ) { return ""; }
+	void SetControllerColor( uint8 nColorR, uint8 nColorG, uint8 nColorB, unsigned int nFlags ) {}
+	void SetTriggerEffect( bool bEnabled ) {}
+	void TriggerControllerVibration( unsigned short nLeftSpeed, unsigned short nRightSpeed ) {}
+	void TriggerControllerHaptics( ESteamControllerPad ePad, unsigned short usOnMicroSec, unsigned short usOffMicroSec, unsigned short usRepeat ) {}
+	bool BGameEngineHasFocus() { return false; }
+	HGAMEVOICECHANNEL HCreateVoiceChannel() { return 0; }
+	void DestroyVoiceChannel( HGAMEVOICECHANNEL hChannel ) {}
+	bool AddVoiceData( HGAMEVOICECHANNEL hChannel, const uint8 *pVoiceData, uint32 uLength ) { return false; }
+
+private:
+	uint64 m_ulGameTickCount;
+	uint64 m_ulPreviousGameTickCount;
+	int32 m_nViewportWidth;
+	int32 m_nViewportHeight;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Headless engine a server's simulation runs under.  Its clock only
+//			moves when a step is run, and then by exactly
+//			SIMULATION_STEP_MILLISECONDS, so entities see the same frame delta
+//			and timers every step no matter how the steps are being driven.
+//-----------------------------------------------------------------------------
+class CSimulationEngine : public CMatchGameEngine
+{
+public:
+	CSimulationEngine( int32 nViewportWidth, int32 nViewportHeight );
+
+	// Bank real time that has passed, returns how many whole steps are now due
+	uint32 AccumulateTime( uint64 ulMilliseconds );
+
+	// Move the clock forward one step
+	void Step();
+
+	// Steps run since the simulation started
+	uint32 GetStepCount() { return m_unStepCount; }
+
+private:
+	// Real time banked that hasn't been stepped yet, always less than a step between frames
+	uint64 m_ulAccumulatedMilliseconds;
+	uint32 m_unStepCount;
+};
+
+#endif // MATCHGAMEENGINE_H
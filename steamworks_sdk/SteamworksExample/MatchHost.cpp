@@ -0,0 +1,266 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Runs many independent CSpaceWarServer matches in one process.  The
+//			host owns the process-wide SteamGameServer connection and ticks the
+//			matches in parallel on a work-stealing thread pool.
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "MatchHost.h"
+#include "MatchGameEngine.h"
+#include "SpaceWarServer.h"
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor for a single hosted match
+//-----------------------------------------------------------------------------
+CSpaceWarMatchHost::CMatch::CMatch( IGameEngine *pHostEngine, uint32 iMatch, uint32 unMaxPlayers )
+{
+	m_pGameEngine = new CMatchGameEngine( pHostEngine->GetViewportWidth(), pHostEngine->GetViewportHeight() );
+	m_pGameEngine->SetGameTickCount( pHostEngine->GetGameTickCount() );
+	m_pServer = new CSpaceWarServer( m_pGameEngine, true, MATCH_HOST_BASE_VIRTUAL_PORT + iMatch, unMaxPlayers );
+	m_iHomeWorker = iMatch;
+	m_ulHostTickCount = pHostEngine->GetGameTickCount();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor
+//-----------------------------------------------------------------------------
+CSpaceWarMatchHost::CMatch::~CMatch()
+{
+	delete m_pServer;
+	delete m_pGameEngine;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Tick the match on whichever worker picked it up
+//-----------------------------------------------------------------------------
+void CSpaceWarMatchHost::CMatch::RunJob( uint32 iWorker )
+{
+	m_iHomeWorker = iWorker;
+	m_pGameEngine->SetGameTickCount( m_ulHostTickCount );
+	m_pServer->ReceiveNetworkData();
+	m_pServer->RunFrame();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CSpaceWarMatchHost::CSpaceWarMatchHost( IGameEngine *pGameEngine, uint32 unMatches, uint32 unWorkers, uint32 unMaxPlayersPerMatch )
+{
+	m_pGameEngine = pGameEngine;
+	m_bConnectedToSteam = false;
+
+#ifdef USE_GS_AUTH_API
+	EServerMode eMode = eServerModeAuthenticationAndSecure;
+#else
+	// Don't let Steam do authentication
+	EServerMode eMode = eServerModeNoAuthentication;
+#endif
+
+	// One SteamGameServer for the whole process, the matches are told apart by their P2P virtual port
+	SteamErrMsg errMsg = { 0 };
+	if ( SteamGameServer_InitEx( INADDR_ANY, SPACEWAR_SERVER_PORT, SPACEWAR_MASTER_SERVER_UPDATER_PORT, eMode, SPACEWAR_SERVER_VERSION, &errMsg ) != k_ESteamAPIInitResult_OK )
+	{
+		OutputDebugString( "SteamGameServer_Init call failed: " );
+		OutputDebugString( errMsg );
+		OutputDebugString( "\n" );
+	}
+
+	if ( SteamGameServer() )
+	{
+		SteamGameServer()->SetModDir( "spacewar" );
+		SteamGameServer()->SetProduct( "SteamworksExample" );
+		SteamGameServer()->SetGameDescription( "Steamworks Example" );
+		SteamGameServer()->SetDedicatedServer( true );
+		SteamGameServer()->LogOnAnonymous();
+
+		SteamNetworkingUtils()->InitRelayNetworkAccess();
+
+		#ifdef USE_GS_AUTH_API
+			SteamGameServer()->SetAdvertiseServerActive( true );
+		#endif
+	}
+	else
+	{
+		OutputDebugString( "SteamGameServer() interface is invalid\n" );
+	}
+
+	m_pPool = new CWorkStealingPool( unWorkers );
+
+	// Matches can't listen for players without Steam, so there's no point starting any
+	if ( SteamGameServer() )
+	{
+		for ( uint32 i = 0; i < unMatches; ++i )
+			m_vecMatches.push_back( new CMatch( pGameEngine, i, unMaxPlayersPerMatch ) );
+	}
+
+	char rgchBuffer[128];
+	sprintf_safe( rgchBuffer, "Match host running %u matches on %u workers\n", GetMatchCount(), GetWorkerCount() );
+	OutputDebugString( rgchBuffer );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor
+//-----------------------------------------------------------------------------
+CSpaceWarMatchHost::~CSpaceWarMatchHost()
+{
+	// Stop the workers before tearing down the matches they run
+	delete m_pPool;
+	m_pPool = NULL;
+
+	for ( size_t i = 0; i < m_vecMatches.size(); ++i )
+		delete m_vecMatches[i];
+	m_vecMatches.clear();
+
+	if ( SteamGameServer() )
+		SteamGameServer()->LogOff();
+
+	SteamGameServer_Shutdown();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Record every match to its own replay log
+//-----------------------------------------------------------------------------
+bool CSpaceWarMatchHost::BStartRecording( const char *pchFileName )
+{
+	for ( size_t i = 0; i < m_vecMatches.size(); ++i )
+	{
+		char rgchFileName[1024];
+		if ( m_vecMatches.size() == 1 )
+			sprintf_safe( rgchFileName, "%s", pchFileName );
+		else
+			sprintf_safe( rgchFileName, "%s.%u", pchFileName, (uint32)i );
+
+		if ( !m_vecMatches[i]->m_pServer->BStartRecording( rgchFileName ) )
+			return false;
+	}
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Run a frame of every match
+//-----------------------------------------------------------------------------
+void CSpaceWarMatchHost::RunFrame()
+{
+	// Callbacks are dispatched to every match, so run them here on the main thread while
+	// no match is running
+	{
+		CTickProfileScope profile( m_TickProfiler, CTickProfiler::k_EPhaseRunCallbacks );
+		SteamGameServer_RunCallbacks();
+	}
+
+	// Our details hardly ever change, only gather them every so often
+	uint64 ulHostTickCount = m_pGameEngine->GetGameTickCount();
+	if ( SteamGameServer() && m_DetailsPublisher.BIsFlushDue( ulHostTickCount ) )
+	{
+		CTickProfileScope profile( m_TickProfiler, CTickProfiler::k_EPhaseServerDetails );
+		SendUpdatedServerDetailsToSteam();
+	}
+
+	// Matches don't share any state with each other, so they can all run at once
+	for ( size_t i = 0; i < m_vecMatches.size(); ++i )
+	{
+		CMatch *pMatch = m_vecMatches[i];
+		pMatch->m_ulHostTickCount = ulHostTickCount;
+		m_pPool->QueueJob( pMatch->m_iHomeWorker, pMatch );
+	}
+
+	m_pPool->WaitForAll();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Merge our profile and every match's.  The matches only run inside
+//			RunFrame, so between frames nothing else is touching them.
+//-----------------------------------------------------------------------------
+void CSpaceWarMatchHost::GetTickProfile( CTickProfiler *pProfile, bool bReset )
+{
+	pProfile->Reset();
+	pProfile->Merge( m_TickProfiler );
+	if ( bReset )
+		m_TickProfiler.Reset();
+
+	for ( size_t i = 0; i < m_vecMatches.size(); ++i )
+	{
+		CTickProfiler &matchProfiler = m_vecMatches[i]->m_pServer->AccessTickProfiler();
+		pProfile->Merge( matchProfiler );
+		if ( bReset )
+			matchProfiler.Reset();
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Each match's snapshot rate report, headed by the match if there's
+//			more than one
+//-----------------------------------------------------------------------------
+void CSpaceWarMatchHost::AppendSnapshotRateReport( std::string &str, bool bPerClient )
+{
+	for ( size_t i = 0; i < m_vecMatches.size(); ++i )
+	{
+		if ( m_vecMatches.size() > 1 )
+		{
+			char rgchBuffer[64];
+			sprintf_safe( rgchBuffer, "Match %u ", (uint32)i );
+			str += rgchBuffer;
+		}
+		m_vecMatches[i]->m_pServer->AppendSnapshotRateReport( str, bPerClient );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Tell Steam about the whole process as one server.  Everything goes
+//			through the publisher, which only calls Steam for what's changed.
+//-----------------------------------------------------------------------------
+void CSpaceWarMatchHost::SendUpdatedServerDetailsToSteam()
+{
+	char rgchServerName[128];
+	sprintf_safe( rgchServerName, "Spacewar! (%u matches)", GetMatchCount() );
+
+	uint32 unMaxPlayers = 0;
+	for ( size_t i = 0; i < m_vecMatches.size(); ++i )
+		unMaxPlayers += m_vecMatches[i]->m_pServer->GetMaxPlayers();
+
+	m_DetailsPublisher.SetMaxPlayerCount( unMaxPlayers );
+	m_DetailsPublisher.SetPasswordProtected( false );
+	m_DetailsPublisher.SetServerName( rgchServerName );
+	m_DetailsPublisher.SetBotPlayerCount( 0 );
+	m_DetailsPublisher.SetMapName( "MilkyWay" );
+
+	for ( size_t i = 0; i < m_vecMatches.size(); ++i )
+		m_vecMatches[i]->m_pServer->SendUpdatedPlayerDetailsToSteam( &m_DetailsPublisher );
+
+	m_DetailsPublisher.Flush( SteamGameServer(), m_pGameEngine->GetGameTickCount() );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Take any action we need to on Steam notifying us we are now logged in
+//-----------------------------------------------------------------------------
+void CSpaceWarMatchHost::OnSteamServersConnected( SteamServersConnected_t *pLogonSuccess )
+{
+	OutputDebugString( "Match host connected to Steam successfully\n" );
+	m_bConnectedToSteam = true;
+
+	// Steam may have forgotten what we told it before, tell it everything next time
+	m_DetailsPublisher.RepublishAll();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Called when an attempt to login to Steam fails
+//-----------------------------------------------------------------------------
+void CSpaceWarMatchHost::OnSteamServersConnectFailure( SteamServerConnectFailure_t *pConnectFailure )
+{
+	m_bConnectedToSteam = false;
+	OutputDebugString( "Match host failed to connect to Steam\n" );
+}
@@ -0,0 +1,112 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Runs many independent CSpaceWarServer matches in one process.  The
+//			host owns the process-wide SteamGameServer connection and ticks the
+//			matches in parallel on a work-stealing thread pool.
+//
+//=============================================================================
+
+#ifndef MATCHHOST_H
+#define MATCHHOST_H
+
+#include <vector>
+
+#include "GameEngine.h"
+#include "SpaceWar.h"
+#include "WorkStealingPool.h"
+#include "TickProfiler.h"
+#include "ServerDetailsPublisher.h"
+
+class CSpaceWarServer;
+class CMatchGameEngine;
+
+// First P2P virtual port used by hosted matches, match N listens on the base + N
+#define MATCH_HOST_BASE_VIRTUAL_PORT 0
+
+class CSpaceWarMatchHost
+{
+public:
+	// Constructor, 0 workers means one per hardware thread
+	CSpaceWarMatchHost( IGameEngine *pGameEngine, uint32 unMatches, uint32 unWorkers = 0, uint32 unMaxPlayersPerMatch = MAX_PLAYERS_PER_SERVER );
+
+	// Destructor
+	~CSpaceWarMatchHost();
+
+	// Run Steam callbacks, then run a frame of every match
+	void RunFrame();
+
+	// Record every match to a replay log, see CSpaceWarServer::BStartRecording.  With more than
+	// one match, match N records to pchFileName with .N on the end.
+	bool BStartRecording( const char *pchFileName );
+
+	// Everything every match has profiled since the last reset, along with the callbacks and
+	// server details we run for them, merged into pProfile.  bReset starts a new period.
+	void GetTickProfile( CTickProfiler *pProfile, bool bReset );
+
+	// Append every match's snapshot rate report, see CSpaceWarServer::AppendSnapshotRateReport
+	void AppendSnapshotRateReport( std::string &str, bool bPerClient );
+
+	// How often we publish our server details, SERVER_DETAILS_REFRESH_MILLISECONDS unless set
+	void SetServerDetailsInterval( uint32 unMilliseconds ) { m_DetailsPublisher.SetFlushInterval( unMilliseconds ); }
+
+	// What publishing our server details has cost, and saved, since it was last reset
+	const ServerDetailsPublisherStats_t &GetServerDetailsStats() const { return m_DetailsPublisher.GetStats(); }
+	void ResetServerDetailsStats() { m_DetailsPublisher.ResetStats(); }
+
+	// data accessors
+	uint32 GetMatchCount() { return (uint32)m_vecMatches.size(); }
+	uint32 GetWorkerCount() { return m_pPool->GetWorkerCount(); }
+	uint64 GetStolenMatchCount() { return m_pPool->GetStolenJobCount(); }
+
+private:
+	//-----------------------------------------------------------------------------
+	// Purpose: One match, which is also the job that ticks it
+	//-----------------------------------------------------------------------------
+	class CMatch : public IPoolJob
+	{
+	public:
+		CMatch( IGameEngine *pHostEngine, uint32 iMatch, uint32 unMaxPlayers );
+		~CMatch();
+
+		void RunJob( uint32 iWorker );
+
+		CMatchGameEngine *m_pGameEngine;
+		CSpaceWarServer *m_pServer;
+
+		// Worker we queue to next frame.  Updated to whoever last ran us, so a match that
+		// got stolen stays with the thief rather than bouncing back to an overloaded worker
+		uint32 m_iHomeWorker;
+
+		// Host tick count to run this frame at
+		uint64 m_ulHostTickCount;
+	};
+
+	// Tell Steam about our aggregate server details
+	void SendUpdatedServerDetailsToSteam();
+
+	// Tells us when we have successfully connected to Steam
+	STEAM_GAMESERVER_CALLBACK( CSpaceWarMatchHost, OnSteamServersConnected, SteamServersConnected_t );
+
+	// Tells us when there was a failure to connect to Steam
+	STEAM_GAMESERVER_CALLBACK( CSpaceWarMatchHost, OnSteamServersConnectFailure, SteamServerConnectFailure_t );
+
+	// Engine we are running under, supplies the host clock
+	IGameEngine *m_pGameEngine;
+
+	// Are we connected to Steam?
+	bool m_bConnectedToSteam;
+
+	// Workers that run the matches
+	CWorkStealingPool *m_pPool;
+
+	// The matches we are hosting
+	std::vector< CMatch * > m_vecMatches;
+
+	// Times the phases we run for all the matches
+	CTickProfiler m_TickProfiler;
+
+	// What we've told Steam about the whole process
+	CServerDetailsPublisher m_DetailsPublisher;
+};
+
+#endif // MATCHHOST_H
@@ -24,11 +24,13 @@ enum EMessage
 	k_EMsgServerExiting = k_EMsgServerBegin+5,
 	k_EMsgServerPingResponse = k_EMsgServerBegin+6,
 	k_EMsgServerPlayerHitSun = k_EMsgServerBegin+7,
+	k_EMsgServerUpdateWorldDelta = k_EMsgServerBegin+8,
 
 	// Client messages
 	k_EMsgClientBegin = 500,
 	k_EMsgClientBeginAuthentication = k_EMsgClientBegin+2,
 	k_EMsgClientSendLocalUpdate = k_EMsgClientBegin+3,
+	k_EMsgClientAckWorldSnapshot = k_EMsgClientBegin+4,
 
 	// P2P authentication messages
 	k_EMsgP2PBegin = 600, 
@@ -55,6 +57,22 @@ enum EDisconnectReason
 	k_EDRClientKicked = k_ESteamNetConnectionEnd_App_Min + 5
 };
 
+// Lanes both ends send on, so a burst of voice or a big reliable message can't hold up world
+// state queued behind it.  Lane 0 is the cheapest on the wire, and carries the most messages.
+enum ESpaceWarLane
+{
+	k_ESpaceWarLaneState = 0,		// World updates, client input and acks of world updates
+	k_ESpaceWarLaneControl = 1,		// Server info, authentication, P2P tickets, leaving
+	k_ESpaceWarLaneVoice = 2,		// Voice chat
+	k_ESpaceWarLaneCount
+};
+
+// Lower priority lanes only send when nothing higher is waiting, lanes of equal priority share
+// bandwidth by weight.  State goes first, then control and voice share what's left 3:1, so
+// neither can starve the other.
+static const int k_rgnSpaceWarLanePriorities[k_ESpaceWarLaneCount] = { 0, 1, 1 };
+static const uint16 k_rgunSpaceWarLaneWeights[k_ESpaceWarLaneCount] = { 1, 3, 1 };
+
 
 // Msg from the server to the client which is sent right after communications are established
 // and tells the client what SteamID the game server is using as well as whether the server is secure
@@ -102,7 +120,9 @@ private:
 	uint32 m_uPlayerPosition;
 };
 
-// Msg from the server to clients when updating the world state
+// A full world snapshot.  This isn't sent as is, it's packed down (see PackWorldSnapshot) and
+// delta encoded into a MsgServerUpdateWorldDelta_t.
+// Variable length, the per player data for each slot follows the struct, see ServerSpaceWarUpdateData_t
 struct MsgServerUpdateWorld_t
 {
 	MsgServerUpdateWorld_t() : m_dwMessageType( LittleDWord( k_EMsgServerUpdateWorld ) ) {}
@@ -110,11 +130,47 @@ struct MsgServerUpdateWorld_t
 
 	ServerSpaceWarUpdateData_t *AccessUpdateData() { return &m_ServerUpdateData; }
 
+	// Full size of the message for the given number of player slots
+	static uint32 GetMessageSize( uint32 unPlayerSlots ) { return sizeof( MsgServerUpdateWorld_t ) + unPlayerSlots * sizeof( ServerPlayerUpdateData_t ); }
+
 private:
 	const DWORD m_dwMessageType;
 	ServerSpaceWarUpdateData_t m_ServerUpdateData;
 };
 
+// Msg from the server to clients when updating the world state.  Carries a packed world snapshot
+// delta encoded against an earlier snapshot the client acked, or against
+// nothing if it hasn't acked one the server still has.  Variable length, the encoding follows
+// the struct, see EncodeWorldSnapshotDelta.
+struct MsgServerUpdateWorldDelta_t
+{
+	MsgServerUpdateWorldDelta_t() : m_dwMessageType( LittleDWord( k_EMsgServerUpdateWorldDelta ) ) {}
+	DWORD GetMessageType() { return LittleDWord( m_dwMessageType ); }
+
+	void SetSequence( uint32 unSequence ) { m_unSequence = LittleDWord( unSequence ); }
+	uint32 GetSequence() { return LittleDWord( m_unSequence ); }
+
+	void SetBaselineSequence( uint32 unSequence ) { m_unBaselineSequence = LittleDWord( unSequence ); }
+	uint32 GetBaselineSequence() { return LittleDWord( m_unBaselineSequence ); }
+
+	void SetSnapshotSize( uint32 cubSnapshot ) { m_cubSnapshot = LittleDWord( cubSnapshot ); }
+	uint32 GetSnapshotSize() { return LittleDWord( m_cubSnapshot ); }
+
+	const uint8 *GetEncodedData() { return (const uint8 *)( this + 1 ); }
+
+private:
+	const DWORD m_dwMessageType;
+
+	// Sequence number of this snapshot
+	uint32 m_unSequence;
+
+	// Snapshot the delta is against, WORLD_SNAPSHOT_NONE for a full snapshot
+	uint32 m_unBaselineSequence;
+
+	// Size of the decoded, still packed, snapshot
+	uint32 m_cubSnapshot;
+};
+
 // Msg from server to clients when it is exiting
 struct MsgServerExiting_t
 {
@@ -125,27 +181,38 @@ private:
 	const DWORD m_dwMessageType;
 };
 
-// Msg from client to server when initiating authentication
+// Msg from client to server when initiating authentication.  Only as much of the token as
+// there is gets sent, see GetMessageSize.
 struct MsgClientBeginAuthentication_t
 {
-	MsgClientBeginAuthentication_t() : m_dwMessageType( LittleDWord( k_EMsgClientBeginAuthentication ) ) {}
+	MsgClientBeginAuthentication_t() : m_dwMessageType( LittleDWord( k_EMsgClientBeginAuthentication ) ), m_uTokenLen( 0 ) {}
 	DWORD GetMessageType() { return LittleDWord( m_dwMessageType ); }
 
-	void SetToken( const char *pchToken, uint32 unLen ) { m_uTokenLen = LittleDWord( unLen ); memcpy( m_rgchToken, pchToken, MIN( unLen, sizeof( m_rgchToken ) ) ); }
+	void SetSteamID( uint64 ulSteamID ) { m_ulSteamID = LittleQWord( ulSteamID ); }
+	uint64 GetSteamID() { return LittleQWord( m_ulSteamID ); }
+
+#ifdef USE_GS_AUTH_API
+	void SetToken( const char *pchToken, uint32 unLen ) { unLen = MIN( unLen, (uint32)sizeof( m_rgchToken ) ); m_uTokenLen = LittleDWord( unLen ); memcpy( m_rgchToken, pchToken, unLen ); }
 	uint32 GetTokenLen() { return LittleDWord( m_uTokenLen ); }
 	const char *GetTokenPtr() { return m_rgchToken; }
 
-	void SetSteamID( uint64 ulSteamID ) { m_ulSteamID = LittleQWord( ulSteamID ); }
-	uint64 GetSteamID() { return LittleQWord( m_ulSteamID ); }
+	// Size of the message with a token of unTokenLen, and the most a token can be
+	static uint32 GetMessageSize( uint32 unTokenLen ) { return (uint32)offsetof( MsgClientBeginAuthentication_t, m_rgchToken ) + unTokenLen; }
+	static uint32 GetMaxTokenLen() { return sizeof( ( (MsgClientBeginAuthentication_t *)0 )->m_rgchToken ); }
+	uint32 GetMessageSize() { return GetMessageSize( GetTokenLen() ); }
+#else
+	uint32 GetTokenLen() { return LittleDWord( m_uTokenLen ); }
+	uint32 GetMessageSize() { return sizeof( *this ); }
+#endif
 
 private:
 	const DWORD m_dwMessageType;
 	
 	uint32 m_uTokenLen;
+	uint64 m_ulSteamID;
 #ifdef USE_GS_AUTH_API
 	char m_rgchToken[1024];
 #endif
-	uint64 m_ulSteamID;
 };
 
 // Msg from client to server when sending state update
@@ -164,6 +231,21 @@ private:
 	ClientSpaceWarUpdateData_t m_ClientUpdateData;
 };
 
+// Msg from client to server acknowledging the newest world snapshot it has, so the server can
+// delta encode against it
+struct MsgClientAckWorldSnapshot_t
+{
+	MsgClientAckWorldSnapshot_t() : m_dwMessageType( LittleDWord( k_EMsgClientAckWorldSnapshot ) ) {}
+	DWORD GetMessageType() { return LittleDWord( m_dwMessageType ); }
+
+	void SetSequence( uint32 unSequence ) { m_unSequence = LittleDWord( unSequence ); }
+	uint32 GetSequence() { return LittleDWord( m_unSequence ); }
+
+private:
+	const DWORD m_dwMessageType;
+	uint32 m_unSequence;
+};
+
 // Message sent from one peer to another, so peers authenticate directly with each other.
 // (In this example, the server is responsible for relaying the messages, but peers
 // are directly authenticating each other.)
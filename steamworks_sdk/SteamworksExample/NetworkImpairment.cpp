@@ -0,0 +1,603 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Seeded network impairment in front of a SpaceWar transport, for
+//			playing over a reproducibly bad connection
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "NetworkImpairment.h"
+#include <algorithm>
+#include <limits>
+#include <string>
+
+// The named profiles, roughly what each kind of connection does to traffic one way
+static const struct
+{
+	const char *m_pchName;
+	NetworkImpairmentProfile_t m_profile;
+} s_rgNetworkImpairmentPresets[] =
+{
+	{ "none",		{ 0, 0, 0.0f, 0.0f, 0.0f, 0 } },
+	{ "lan",		{ 1, 1, 0.0f, 0.0f, 0.0f, 0 } },
+	{ "broadband",	{ 20, 5, 0.1f, 0.0f, 0.0f, 0 } },
+	{ "wifi",		{ 30, 20, 1.0f, 0.5f, 0.0f, 0 } },
+	{ "mobile",		{ 80, 40, 2.0f, 1.0f, 0.5f, 32000 } },
+	{ "lossy",		{ 50, 10, 10.0f, 2.0f, 1.0f, 0 } },
+	{ "congested",	{ 40, 10, 1.0f, 0.0f, 0.0f, 6000 } },
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Does the profile do anything to messages?
+//-----------------------------------------------------------------------------
+bool NetworkImpairmentProfile_t::BImpaired() const
+{
+	return m_unLatencyMilliseconds || m_unJitterMilliseconds || m_flLossPercent > 0.0f || m_flReorderPercent > 0.0f
+		|| m_flDuplicatePercent > 0.0f || m_unBandwidthBytesPerSecond;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Look up a named profile
+//-----------------------------------------------------------------------------
+bool BGetNetworkImpairmentPreset( const char *pchName, NetworkImpairmentProfile_t *pProfile )
+{
+	for ( uint32 i = 0; i < ARRAYSIZE( s_rgNetworkImpairmentPresets ); ++i )
+	{
+		if ( !strcmp( pchName, s_rgNetworkImpairmentPresets[i].m_pchName ) )
+		{
+			*pProfile = s_rgNetworkImpairmentPresets[i].m_profile;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Describe a profile as the keys a script would set it with
+//-----------------------------------------------------------------------------
+void FormatNetworkImpairmentProfile( const NetworkImpairmentProfile_t &profile, char *pchBuffer, uint32 cchBuffer )
+{
+	char rgchProfile[256];
+	sprintf_safe( rgchProfile, "latency=%u jitter=%u loss=%g reorder=%g duplicate=%g bandwidth=%u",
+		profile.m_unLatencyMilliseconds, profile.m_unJitterMilliseconds, profile.m_flLossPercent,
+		profile.m_flReorderPercent, profile.m_flDuplicatePercent, profile.m_unBandwidthBytesPerSecond );
+	strncpy_safe( pchBuffer, rgchProfile, cchBuffer );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Apply one script word to a profile, a preset or a key=value.  False
+//			if it's neither.
+//-----------------------------------------------------------------------------
+static bool BApplyNetworkImpairmentSetting( const char *pchSetting, NetworkImpairmentProfile_t *pProfile )
+{
+	const char *pchEquals = strchr( pchSetting, '=' );
+	if ( !pchEquals )
+		return BGetNetworkImpairmentPreset( pchSetting, pProfile );
+
+	char *pchEnd;
+	double flValue = strtod( pchEquals + 1, &pchEnd );
+	if ( pchEnd == pchEquals + 1 || *pchEnd || flValue < 0.0 )
+		return false;
+
+	std::string strKey( pchSetting, pchEquals - pchSetting );
+	if ( strKey == "latency" )
+		pProfile->m_unLatencyMilliseconds = (uint32)flValue;
+	else if ( strKey == "jitter" )
+		pProfile->m_unJitterMilliseconds = (uint32)flValue;
+	else if ( strKey == "loss" && flValue <= 100.0 )
+		pProfile->m_flLossPercent = (float)flValue;
+	else if ( strKey == "reorder" && flValue <= 100.0 )
+		pProfile->m_flReorderPercent = (float)flValue;
+	else if ( strKey == "duplicate" && flValue <= 100.0 )
+		pProfile->m_flDuplicatePercent = (float)flValue;
+	else if ( strKey == "bandwidth" )
+		pProfile->m_unBandwidthBytesPerSecond = (uint32)flValue;
+	else
+		return false;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CImpairedTransport::CImpairedTransport( ISpaceWarTransport *pInner, IGameEngine *pClockEngine, uint32 unSeed )
+{
+	m_pInner = pInner;
+	m_pClockEngine = pClockEngine;
+	m_unSeed = unSeed;
+	memset( m_rgProfiles, 0, sizeof( m_rgProfiles ) );
+	m_iNextScriptStep = 0;
+	m_ulScriptStartTickCount = 0;
+	memset( m_rgClosedStats, 0, sizeof( m_rgClosedStats ) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor, what's still held back never gets there
+//-----------------------------------------------------------------------------
+CImpairedTransport::~CImpairedTransport()
+{
+	for ( std::map< HSteamNetConnection, Connection_t * >::iterator iter = m_mapConnections.begin(); iter != m_mapConnections.end(); ++iter )
+	{
+		for ( uint32 i = 0; i < iter->second->m_vecHeld.size(); ++i )
+			iter->second->m_vecHeld[i].m_pMsg->Release();
+		delete iter->second;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Change one direction's profile
+//-----------------------------------------------------------------------------
+void CImpairedTransport::SetProfile( ENetworkImpairmentDirection eDirection, const NetworkImpairmentProfile_t &profile )
+{
+	m_rgProfiles[eDirection] = profile;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Give one connection a profile of its own
+//-----------------------------------------------------------------------------
+bool CImpairedTransport::SetConnectionProfile( HSteamNetConnection hConn, const NetworkImpairmentProfile_t &profile )
+{
+	Connection_t *pConnection = FindOrCreateConnection( hConn );
+	if ( !pConnection )
+		return false;
+
+	pConnection->m_bOwnProfile = true;
+	pConnection->m_profile = profile;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Load a preset or a script file
+//-----------------------------------------------------------------------------
+bool CImpairedTransport::BLoadScript( const char *pchScript )
+{
+	char rgchBuffer[512];
+	std::vector< ScriptStep_t > vecScript;
+
+	ScriptStep_t step;
+	memset( &step, 0, sizeof( step ) );
+	if ( BGetNetworkImpairmentPreset( pchScript, &step.m_rgProfiles[k_ENetworkImpairmentUp] ) )
+	{
+		step.m_rgProfiles[k_ENetworkImpairmentDown] = step.m_rgProfiles[k_ENetworkImpairmentUp];
+		vecScript.push_back( step );
+	}
+	else
+	{
+		FILE *pFile = fopen( pchScript, "rt" );
+		if ( !pFile )
+		{
+			sprintf_safe( rgchBuffer, "Network profile %s isn't a preset or a file we can open\n", pchScript );
+			OutputDebugString( rgchBuffer );
+			return false;
+		}
+
+		// Each line starts from where the last one left the profiles
+		char szLine[512];
+		uint32 iLine = 0;
+		bool bOK = true;
+		while ( bOK && fgets( szLine, sizeof( szLine ), pFile ) )
+		{
+			++iLine;
+
+			char *rgpchWords[32];
+			uint32 cWords = 0;
+			char *pch = szLine;
+			while ( cWords < ARRAYSIZE( rgpchWords ) )
+			{
+				pch += strspn( pch, " \t\r\n" );
+				if ( !*pch )
+					break;
+				rgpchWords[cWords++] = pch;
+				pch += strcspn( pch, " \t\r\n" );
+				if ( *pch )
+					*pch++ = '\0';
+			}
+			if ( !cWords || rgpchWords[0][0] == '#' )
+				continue;
+
+			char *pchEnd;
+			double flSeconds = strtod( rgpchWords[0], &pchEnd );
+			uint64 ulMilliseconds = (uint64)( flSeconds * 1000.0 + 0.5 );
+			bool bUp = cWords > 1 && ( !strcmp( rgpchWords[1], "up" ) || !strcmp( rgpchWords[1], "both" ) );
+			bool bDown = cWords > 1 && ( !strcmp( rgpchWords[1], "down" ) || !strcmp( rgpchWords[1], "both" ) );
+			bOK = *pchEnd == '\0' && flSeconds >= 0.0 && cWords > 2 && ( bUp || bDown )
+				&& ( vecScript.empty() || ulMilliseconds >= vecScript.back().m_ulMilliseconds );
+
+			step.m_ulMilliseconds = ulMilliseconds;
+			for ( uint32 i = 2; i < cWords && bOK; ++i )
+			{
+				if ( bUp )
+					bOK = BApplyNetworkImpairmentSetting( rgpchWords[i], &step.m_rgProfiles[k_ENetworkImpairmentUp] );
+				if ( bDown && bOK )
+					bOK = BApplyNetworkImpairmentSetting( rgpchWords[i], &step.m_rgProfiles[k_ENetworkImpairmentDown] );
+			}
+			if ( bOK )
+				vecScript.push_back( step );
+		}
+		fclose( pFile );
+
+		if ( !bOK )
+		{
+			sprintf_safe( rgchBuffer, "Network profile %s line %u isn't <seconds> <up|down|both> [preset] [key=value ...]\n", pchScript, iLine );
+			OutputDebugString( rgchBuffer );
+			return false;
+		}
+	}
+
+	m_vecScript = vecScript;
+	m_iNextScriptStep = 0;
+	m_ulScriptStartTickCount = m_pClockEngine->GetGameTickCount();
+	RunScript();
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Switch to the profiles of any script steps that are due
+//-----------------------------------------------------------------------------
+void CImpairedTransport::RunScript()
+{
+	uint64 ulElapsed = m_pClockEngine->GetGameTickCount() - m_ulScriptStartTickCount;
+	while ( m_iNextScriptStep < m_vecScript.size() && m_vecScript[m_iNextScriptStep].m_ulMilliseconds <= ulElapsed )
+	{
+		for ( uint32 i = 0; i < k_ENetworkImpairmentDirectionCount; ++i )
+			m_rgProfiles[i] = m_vecScript[m_iNextScriptStep].m_rgProfiles[i];
+		++m_iNextScriptStep;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Add up what's been done to the messages going one way
+//-----------------------------------------------------------------------------
+void CImpairedTransport::GetStats( ENetworkImpairmentDirection eDirection, NetworkImpairmentStats_t *pStats )
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+
+	*pStats = m_rgClosedStats[eDirection];
+	for ( std::map< HSteamNetConnection, Connection_t * >::iterator iter = m_mapConnections.begin(); iter != m_mapConnections.end(); ++iter )
+	{
+		const Connection_t *pConnection = iter->second;
+		if ( pConnection->m_eDirection != eDirection )
+			continue;
+
+		pStats->m_cMessages += pConnection->m_stats.m_cMessages;
+		pStats->m_cDropped += pConnection->m_stats.m_cDropped;
+		pStats->m_cRetransmitted += pConnection->m_stats.m_cRetransmitted;
+		pStats->m_cReordered += pConnection->m_stats.m_cReordered;
+		pStats->m_cDuplicated += pConnection->m_stats.m_cDuplicated;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Find our state for a connection, making it if this is the first
+//			we've heard of the connection
+//-----------------------------------------------------------------------------
+CImpairedTransport::Connection_t *CImpairedTransport::FindOrCreateConnection( HSteamNetConnection hConn )
+{
+	std::lock_guard< std::mutex > lock( m_Mutex );
+
+	std::map< HSteamNetConnection, Connection_t * >::iterator iter = m_mapConnections.find( hConn );
+	if ( iter != m_mapConnections.end() )
+		return iter->second;
+
+	// The end that connected has no listen socket, its messages go up to the server
+	SteamNetConnectionInfo_t info;
+	if ( !m_pInner->GetConnectionInfo( hConn, &info ) )
+		return NULL;
+
+	Connection_t *pConnection = new Connection_t;
+	pConnection->m_hConn = hConn;
+	pConnection->m_eDirection = ( info.m_hListenSocket == k_HSteamListenSocket_Invalid ) ? k_ENetworkImpairmentUp : k_ENetworkImpairmentDown;
+	pConnection->m_bOwnProfile = false;
+	memset( &pConnection->m_profile, 0, sizeof( pConnection->m_profile ) );
+	pConnection->m_ulRandom = ( (uint64)m_unSeed << 32 ) | (uint32)hConn;
+	pConnection->m_usecLinkFree = 0;
+	pConnection->m_unNextSequence = 0;
+	pConnection->m_nNextMessageNumber = 0;
+	memset( &pConnection->m_stats, 0, sizeof( pConnection->m_stats ) );
+	m_mapConnections[hConn] = pConnection;
+	return pConnection;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Next number from a connection's random stream (splitmix64)
+//-----------------------------------------------------------------------------
+uint32 CImpairedTransport::Random( Connection_t *pConnection )
+{
+	uint64 z = ( pConnection->m_ulRandom += 0x9e3779b97f4a7c15ull );
+	z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+	z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebull;
+	return (uint32)( ( z ^ ( z >> 31 ) ) >> 32 );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: True flPercent of the time.  Draws nothing for 0, so turning one
+//			impairment on doesn't change what the others do.
+//-----------------------------------------------------------------------------
+bool CImpairedTransport::BRandomChance( Connection_t *pConnection, float flPercent )
+{
+	if ( flPercent <= 0.0f )
+		return false;
+	return Random( pConnection ) * ( 100.0 / 4294967296.0 ) < flPercent;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Put a message on a connection's heap until its time comes
+//-----------------------------------------------------------------------------
+void CImpairedTransport::PushHeldMessage( Connection_t *pConnection, SteamNetworkingMicroseconds usecDeliver, SteamNetworkingMessage_t *pMsg )
+{
+	HeldMessage_t held;
+	held.m_usecDeliver = usecDeliver;
+	held.m_unSequence = pConnection->m_unNextSequence++;
+	held.m_pMsg = pMsg;
+	pConnection->m_vecHeld.push_back( held );
+	std::push_heap( pConnection->m_vecHeld.begin(), pConnection->m_vecHeld.end() );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Work out what the connection's profile does to a message and hold
+//			it, and any copy of it, back for as long as it says
+//-----------------------------------------------------------------------------
+int64 CImpairedTransport::HoldMessage( Connection_t *pConnection, SteamNetworkingMessage_t *pMsg )
+{
+	const NetworkImpairmentProfile_t &profile = GetConnectionProfile( pConnection );
+	SteamNetworkingMicroseconds usecNow = GetMicroseconds();
+	bool bReliable = ( pMsg->m_nFlags & k_nSteamNetworkingSend_Reliable ) != 0;
+	SteamNetworkingMicroseconds usecJitter = (SteamNetworkingMicroseconds)profile.m_unJitterMilliseconds * 1000;
+
+	++pConnection->m_stats.m_cMessages;
+	int64 nMessageNumber = ++pConnection->m_nNextMessageNumber;
+
+	// A capped link sends one thing at a time, so the message leaves once what's ahead of it has
+	SteamNetworkingMicroseconds usecSent = usecNow;
+	if ( profile.m_unBandwidthBytesPerSecond )
+	{
+		SteamNetworkingMicroseconds usecStart = MAX( usecNow, pConnection->m_usecLinkFree );
+		if ( !bReliable && usecStart - usecNow > NETWORK_IMPAIRMENT_MAX_QUEUE_MILLISECONDS * 1000 )
+		{
+			++pConnection->m_stats.m_cDropped;
+			pMsg->Release();
+			return nMessageNumber;
+		}
+		pConnection->m_usecLinkFree = usecStart + (SteamNetworkingMicroseconds)pMsg->m_cbSize * 1000000 / profile.m_unBandwidthBytesPerSecond;
+		usecSent = pConnection->m_usecLinkFree;
+	}
+
+	SteamNetworkingMicroseconds usecDeliver = usecSent + (SteamNetworkingMicroseconds)profile.m_unLatencyMilliseconds * 1000;
+	if ( usecJitter )
+		usecDeliver += Random( pConnection ) % ( usecJitter + 1 );
+
+	if ( BRandomChance( pConnection, profile.m_flLossPercent ) )
+	{
+		if ( !bReliable )
+		{
+			++pConnection->m_stats.m_cDropped;
+			pMsg->Release();
+			return nMessageNumber;
+		}
+
+		// A lost reliable message still gets there, a retransmit timeout later each time it's lost
+		SteamNetworkingMicroseconds usecRetransmit = 1000 * (SteamNetworkingMicroseconds)MAX( 2 * profile.m_unLatencyMilliseconds + profile.m_unJitterMilliseconds,
+			(uint32)NETWORK_IMPAIRMENT_MIN_RETRANSMIT_MILLISECONDS );
+		uint32 cRetransmits = 0;
+		do
+		{
+			usecDeliver += usecRetransmit;
+			++pConnection->m_stats.m_cRetransmitted;
+		} while ( ++cRetransmits < NETWORK_IMPAIRMENT_MAX_RETRANSMITS && BRandomChance( pConnection, profile.m_flLossPercent ) );
+	}
+
+	// Everything else arrives in the order it was sent, among messages of the same kind on the
+	// same lane.  A reordered message is held back past whatever is sent after it without
+	// holding that up.
+	std::vector< SteamNetworkingMicroseconds > &vecLastInOrder = pConnection->m_rgvecLastInOrder[ bReliable ? 1 : 0 ];
+	if ( pMsg->m_idxLane >= vecLastInOrder.size() )
+		vecLastInOrder.resize( pMsg->m_idxLane + 1, 0 );
+	SteamNetworkingMicroseconds &usecLastInOrder = vecLastInOrder[ pMsg->m_idxLane ];
+	if ( !bReliable && BRandomChance( pConnection, profile.m_flReorderPercent ) )
+	{
+		usecDeliver = MAX( usecDeliver, usecLastInOrder ) + 1000
+			+ Random( pConnection ) % ( NETWORK_IMPAIRMENT_REORDER_MAX_MILLISECONDS * 1000 );
+		++pConnection->m_stats.m_cReordered;
+	}
+	else
+	{
+		usecDeliver = MAX( usecDeliver, usecLastInOrder );
+		usecLastInOrder = usecDeliver;
+	}
+
+	PushHeldMessage( pConnection, usecDeliver, pMsg );
+
+	// The copy takes its own way there, so it can arrive either side of the original
+	if ( !bReliable && BRandomChance( pConnection, profile.m_flDuplicatePercent ) )
+	{
+		SteamNetworkingMessage_t *pCopy = m_pInner->AllocateMessage( pMsg->m_cbSize );
+		memcpy( pCopy->m_pData, pMsg->m_pData, pMsg->m_cbSize );
+		pCopy->m_conn = pMsg->m_conn;
+		pCopy->m_nFlags = pMsg->m_nFlags;
+		pCopy->m_idxLane = pMsg->m_idxLane;
+		PushHeldMessage( pConnection, usecSent + (SteamNetworkingMicroseconds)profile.m_unLatencyMilliseconds * 1000
+			+ ( usecJitter ? Random( pConnection ) % ( usecJitter + 1 ) : 0 ), pCopy );
+		++pConnection->m_stats.m_cDuplicated;
+	}
+
+	return nMessageNumber;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Pass the messages that are due on to the inner transport, in the
+//			order they're due
+//-----------------------------------------------------------------------------
+void CImpairedTransport::ReleaseHeldMessages( Connection_t *pConnection, SteamNetworkingMicroseconds usecNow )
+{
+	SteamNetworkingMessage_t *rgpMessages[64];
+	int cMessages = 0;
+	std::vector< HeldMessage_t > &vecHeld = pConnection->m_vecHeld;
+	while ( !vecHeld.empty() && vecHeld.front().m_usecDeliver <= usecNow )
+	{
+		rgpMessages[cMessages++] = vecHeld.front().m_pMsg;
+		std::pop_heap( vecHeld.begin(), vecHeld.end() );
+		vecHeld.pop_back();
+
+		if ( cMessages == (int)ARRAYSIZE( rgpMessages ) )
+		{
+			m_pInner->SendMessages( cMessages, rgpMessages, NULL );
+			cMessages = 0;
+		}
+	}
+	if ( cMessages )
+		m_pInner->SendMessages( cMessages, rgpMessages, NULL );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Close a connection.  Whatever we're still holding back was already
+//			on its way, and gets there before the close does.
+//-----------------------------------------------------------------------------
+bool CImpairedTransport::CloseConnection( HSteamNetConnection hPeer, int nReason, const char *pszDebug, bool bEnableLinger )
+{
+	{
+		std::lock_guard< std::mutex > lock( m_Mutex );
+
+		std::map< HSteamNetConnection, Connection_t * >::iterator iter = m_mapConnections.find( hPeer );
+		if ( iter != m_mapConnections.end() )
+		{
+			Connection_t *pConnection = iter->second;
+			ReleaseHeldMessages( pConnection, std::numeric_limits< SteamNetworkingMicroseconds >::max() );
+
+			NetworkImpairmentStats_t &stats = m_rgClosedStats[pConnection->m_eDirection];
+			stats.m_cMessages += pConnection->m_stats.m_cMessages;
+			stats.m_cDropped += pConnection->m_stats.m_cDropped;
+			stats.m_cRetransmitted += pConnection->m_stats.m_cRetransmitted;
+			stats.m_cReordered += pConnection->m_stats.m_cReordered;
+			stats.m_cDuplicated += pConnection->m_stats.m_cDuplicated;
+
+			delete pConnection;
+			m_mapConnections.erase( iter );
+		}
+	}
+
+	return m_pInner->CloseConnection( hPeer, nReason, pszDebug, bEnableLinger );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: The inner transport's view of the connection, plus what we add
+//-----------------------------------------------------------------------------
+EResult CImpairedTransport::GetConnectionRealTimeStatus( HSteamNetConnection hConn, SteamNetConnectionRealTimeStatus_t *pStatus, int nLanes, SteamNetConnectionRealTimeLaneStatus_t *pLanes )
+{
+	EResult eResult = m_pInner->GetConnectionRealTimeStatus( hConn, pStatus, nLanes, pLanes );
+	if ( eResult != k_EResultOK )
+		return eResult;
+
+	Connection_t *pConnection = FindOrCreateConnection( hConn );
+	if ( !pConnection )
+		return eResult;
+
+	// Our latency one way, the profile the other way's the rest of the round trip
+	const NetworkImpairmentProfile_t &profile = GetConnectionProfile( pConnection );
+	const NetworkImpairmentProfile_t &profileReturn = m_rgProfiles[ pConnection->m_eDirection == k_ENetworkImpairmentUp ? k_ENetworkImpairmentDown : k_ENetworkImpairmentUp ];
+	SteamNetworkingMicroseconds usecBacklog = MAX( pConnection->m_usecLinkFree - GetMicroseconds(), (SteamNetworkingMicroseconds)0 );
+	if ( pStatus )
+	{
+		pStatus->m_nPing += (int)( profile.m_unLatencyMilliseconds + profileReturn.m_unLatencyMilliseconds );
+		pStatus->m_flConnectionQualityRemote *= 1.0f - profile.m_flLossPercent / 100.0f;
+		if ( profile.m_unBandwidthBytesPerSecond && ( !pStatus->m_nSendRateBytesPerSecond || (uint32)pStatus->m_nSendRateBytesPerSecond > profile.m_unBandwidthBytesPerSecond ) )
+			pStatus->m_nSendRateBytesPerSecond = (int)profile.m_unBandwidthBytesPerSecond;
+	}
+	for ( int i = 0; i < nLanes && pLanes; ++i )
+		pLanes[i].m_usecQueueTime += usecBacklog;
+	return eResult;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Send a copy of a message
+//-----------------------------------------------------------------------------
+EResult CImpairedTransport::SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber )
+{
+	Connection_t *pConnection = FindOrCreateConnection( hConn );
+	if ( !pConnection || ( !GetConnectionProfile( pConnection ).BImpaired() && pConnection->m_vecHeld.empty() ) )
+		return m_pInner->SendMessageToConnection( hConn, pData, cbData, nSendFlags, pOutMessageNumber );
+
+	if ( cbData > k_cbMaxSteamNetworkingSocketsMessageSizeSend )
+		return k_EResultInvalidParam;
+
+	SteamNetworkingMessage_t *pMsg = m_pInner->AllocateMessage( (int)cbData );
+	memcpy( pMsg->m_pData, pData, cbData );
+	pMsg->m_conn = hConn;
+	pMsg->m_nFlags = nSendFlags;
+	pMsg->m_idxLane = 0;
+
+	int64 nMessageNumber = HoldMessage( pConnection, pMsg );
+	if ( pOutMessageNumber )
+		*pOutMessageNumber = nMessageNumber;
+	return k_EResultOK;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Send messages, holding back the ones on impaired connections.  Ones
+//			on connections with nothing to do to them go straight on, as many
+//			at a time as the caller gave us.
+//-----------------------------------------------------------------------------
+void CImpairedTransport::SendMessages( int nMessages, SteamNetworkingMessage_t *const *pMessages, int64 *pOutMessageNumberOrResult )
+{
+	int iFirstUntouched = 0;
+	for ( int i = 0; i < nMessages; ++i )
+	{
+		// Ones the inner transport doesn't know go on too, for it to fail
+		Connection_t *pConnection = FindOrCreateConnection( pMessages[i]->m_conn );
+		if ( !pConnection || ( !GetConnectionProfile( pConnection ).BImpaired() && pConnection->m_vecHeld.empty() ) )
+			continue;
+
+		if ( i > iFirstUntouched )
+			m_pInner->SendMessages( i - iFirstUntouched, pMessages + iFirstUntouched, pOutMessageNumberOrResult ? pOutMessageNumberOrResult + iFirstUntouched : NULL );
+		iFirstUntouched = i + 1;
+
+		int64 nMessageNumber = HoldMessage( pConnection, pMessages[i] );
+		if ( pOutMessageNumberOrResult )
+			pOutMessageNumberOrResult[i] = nMessageNumber;
+	}
+
+	if ( nMessages > iFirstUntouched )
+		m_pInner->SendMessages( nMessages - iFirstUntouched, pMessages + iFirstUntouched, pOutMessageNumberOrResult ? pOutMessageNumberOrResult + iFirstUntouched : NULL );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Move the script on, send on whatever's due, then let the inner
+//			transport run its callbacks
+//-----------------------------------------------------------------------------
+void CImpairedTransport::RunCallbacks()
+{
+	RunScript();
+
+	SteamNetworkingMicroseconds usecNow = GetMicroseconds();
+	{
+		std::lock_guard< std::mutex > lock( m_Mutex );
+		for ( std::map< HSteamNetConnection, Connection_t * >::iterator iter = m_mapConnections.begin(); iter != m_mapConnections.end(); ++iter )
+		{
+			if ( !iter->second->m_vecHeld.empty() )
+				ReleaseHeldMessages( iter->second, usecNow );
+		}
+	}
+
+	m_pInner->RunCallbacks();
+}
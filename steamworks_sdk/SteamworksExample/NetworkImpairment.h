@@ -0,0 +1,244 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Seeded network impairment in front of a SpaceWar transport, for
+//			playing over a reproducibly bad connection
+//
+//=============================================================================
+
+#ifndef NETWORKIMPAIRMENT_H
+#define NETWORKIMPAIRMENT_H
+
+#include "SpaceWarTransport.h"
+#include "GameEngine.h"
+#include <map>
+#include <mutex>
+#include <vector>
+
+// How much later than the messages sent after it a reordered message can arrive, at most
+#define NETWORK_IMPAIRMENT_REORDER_MAX_MILLISECONDS 50
+
+// Unreliable messages that would wait longer than this for a bandwidth capped link are dropped,
+// like a full router queue drops them.  Reliable ones wait however long it takes.
+#define NETWORK_IMPAIRMENT_MAX_QUEUE_MILLISECONDS 1000
+
+// A lost reliable message arrives a round trip later, but never sooner than this after it was
+// lost, and it can be lost again at most this many times
+#define NETWORK_IMPAIRMENT_MIN_RETRANSMIT_MILLISECONDS 20
+#define NETWORK_IMPAIRMENT_MAX_RETRANSMITS 8
+
+//-----------------------------------------------------------------------------
+// Purpose: What to do to the messages going one way over a connection.  All
+//			zero sends them on untouched.
+//-----------------------------------------------------------------------------
+struct NetworkImpairmentProfile_t
+{
+	uint32 m_unLatencyMilliseconds;		// One way
+	uint32 m_unJitterMilliseconds;		// Up to this much more latency, picked per message
+	float m_flLossPercent;				// Unreliable messages dropped, reliable ones retransmitted
+	float m_flReorderPercent;			// Unreliable messages held back past later ones
+	float m_flDuplicatePercent;			// Unreliable messages that arrive twice
+	uint32 m_unBandwidthBytesPerSecond;	// Link rate, 0 for no cap
+
+	bool BImpaired() const;
+};
+
+// Which way a message is going.  Up is from the end that connected, the client, and down is from
+// the end that accepted, the server.
+enum ENetworkImpairmentDirection
+{
+	k_ENetworkImpairmentUp,
+	k_ENetworkImpairmentDown,
+	k_ENetworkImpairmentDirectionCount,
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: What an impairment stage has done to the messages going one way
+//-----------------------------------------------------------------------------
+struct NetworkImpairmentStats_t
+{
+	uint64 m_cMessages;
+	uint64 m_cDropped;
+	uint64 m_cRetransmitted;
+	uint64 m_cReordered;
+	uint64 m_cDuplicated;
+};
+
+// Fill in one of the named profiles (none, lan, broadband, wifi, mobile, lossy, congested),
+// false if there's no profile by that name
+bool BGetNetworkImpairmentPreset( const char *pchName, NetworkImpairmentProfile_t *pProfile );
+
+// Describe a profile in the form the scripts take it
+void FormatNetworkImpairmentProfile( const NetworkImpairmentProfile_t &profile, char *pchBuffer, uint32 cchBuffer );
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Transport that holds messages back on their way into another one,
+//			to play out latency, jitter, loss, reordering, duplication and
+//			bandwidth caps.  Each direction has its own profile, and any
+//			connection can be given one of its own.
+//
+//			Everything is decided as a message is sent, from a random stream
+//			per connection seeded from the stage's seed and the connection's
+//			handle, and from the clock of the game engine passed in, never the
+//			wall clock.  The same seed and the same traffic impair the same
+//			messages the same way, whichever threads the connections are
+//			served on.
+//
+//			Held back messages go on to the inner transport from RunCallbacks
+//			once their time has come, so they arrive a frame of the clock
+//			late at best.  RunCallbacks has to be called from one thread
+//			while nothing is sending, as the load test and the client do
+//			between frames.  Otherwise a connection's sends, and closing it,
+//			have to come from one thread at a time, which is how the server
+//			and client already use them.
+//-----------------------------------------------------------------------------
+class CImpairedTransport : public ISpaceWarTransport
+{
+public:
+	// Holds back what's sent on pInner, by pClockEngine's clock.  Doesn't take ownership of either.
+	CImpairedTransport( ISpaceWarTransport *pInner, IGameEngine *pClockEngine, uint32 unSeed );
+
+	// Destructor, frees anything still held back
+	~CImpairedTransport();
+
+	// Profile for every connection that hasn't got one of its own, going one way
+	void SetProfile( ENetworkImpairmentDirection eDirection, const NetworkImpairmentProfile_t &profile );
+	const NetworkImpairmentProfile_t &GetProfile( ENetworkImpairmentDirection eDirection ) const { return m_rgProfiles[eDirection]; }
+
+	// Profile for what we send on one connection, whichever way it goes
+	bool SetConnectionProfile( HSteamNetConnection hConn, const NetworkImpairmentProfile_t &profile );
+
+	// Load a script of profile changes, from a file or, if pchScript names a preset, a one line
+	// script setting both ways to it.  Each line of a file is
+	//		<seconds> <up|down|both> [preset] [key=value ...]
+	// with the keys latency, jitter, loss, reorder, duplicate and bandwidth, as in
+	// FormatNetworkImpairmentProfile.  The preset replaces the profile and the keys change it.
+	// Lines take effect from RunCallbacks that many seconds of the clock after the script is
+	// loaded, and blank lines and lines starting with # are skipped.
+	bool BLoadScript( const char *pchScript );
+
+	// What's been done to each way's messages so far
+	void GetStats( ENetworkImpairmentDirection eDirection, NetworkImpairmentStats_t *pStats );
+
+	// ISpaceWarTransport.  The real time status of a connection is the inner transport's, with the
+	// latency, link rate, backlog and loss we're adding on top.
+	HSteamListenSocket CreateListenSocketP2P( int nVirtualPort ) { return m_pInner->CreateListenSocketP2P( nVirtualPort ); }
+	bool CloseListenSocket( HSteamListenSocket hSocket ) { return m_pInner->CloseListenSocket( hSocket ); }
+	HSteamNetConnection ConnectP2P( const SteamNetworkingIdentity &identityRemote, int nRemoteVirtualPort ) { return m_pInner->ConnectP2P( identityRemote, nRemoteVirtualPort ); }
+	EResult AcceptConnection( HSteamNetConnection hConn ) { return m_pInner->AcceptConnection( hConn ); }
+	bool CloseConnection( HSteamNetConnection hPeer, int nReason, const char *pszDebug, bool bEnableLinger );
+	bool GetConnectionInfo( HSteamNetConnection hConn, SteamNetConnectionInfo_t *pInfo ) { return m_pInner->GetConnectionInfo( hConn, pInfo ); }
+	HSteamNetPollGroup CreatePollGroup() { return m_pInner->CreatePollGroup(); }
+	bool DestroyPollGroup( HSteamNetPollGroup hPollGroup ) { return m_pInner->DestroyPollGroup( hPollGroup ); }
+	bool SetConnectionPollGroup( HSteamNetConnection hConn, HSteamNetPollGroup hPollGroup ) { return m_pInner->SetConnectionPollGroup( hConn, hPollGroup ); }
+	bool SetConnectionUserData( HSteamNetConnection hPeer, int64 nUserData ) { return m_pInner->SetConnectionUserData( hPeer, nUserData ); }
+	EResult ConfigureConnectionLanes( HSteamNetConnection hConn, int nNumLanes, const int *pLanePriorities, const uint16 *pLaneWeights )
+		{ return m_pInner->ConfigureConnectionLanes( hConn, nNumLanes, pLanePriorities, pLaneWeights ); }
+	EResult GetConnectionRealTimeStatus( HSteamNetConnection hConn, SteamNetConnectionRealTimeStatus_t *pStatus, int nLanes, SteamNetConnectionRealTimeLaneStatus_t *pLanes );
+	EResult SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber );
+	int ReceiveMessagesOnConnection( HSteamNetConnection hConn, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages )
+		{ return m_pInner->ReceiveMessagesOnConnection( hConn, ppOutMessages, nMaxMessages ); }
+	int ReceiveMessagesOnPollGroup( HSteamNetPollGroup hPollGroup, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages )
+		{ return m_pInner->ReceiveMessagesOnPollGroup( hPollGroup, ppOutMessages, nMaxMessages ); }
+	SteamNetworkingMessage_t *AllocateMessage( int cbAllocateBuffer ) { return m_pInner->AllocateMessage( cbAllocateBuffer ); }
+	void SendMessages( int nMessages, SteamNetworkingMessage_t *const *pMessages, int64 *pOutMessageNumberOrResult );
+	void AddListener( ISpaceWarTransportListener *pListener ) { m_pInner->AddListener( pListener ); }
+	void RemoveListener( ISpaceWarTransportListener *pListener ) { m_pInner->RemoveListener( pListener ); }
+	void RunCallbacks();
+	bool BIsInProcess() { return m_pInner->BIsInProcess(); }
+
+private:
+	// A message waiting for its time, ordered so the heap gives the earliest, and the first sent
+	// of those that are due together
+	struct HeldMessage_t
+	{
+		SteamNetworkingMicroseconds m_usecDeliver;
+		uint64 m_unSequence;
+		SteamNetworkingMessage_t *m_pMsg;
+
+		bool operator<( const HeldMessage_t &rhs ) const
+		{
+			if ( m_usecDeliver != rhs.m_usecDeliver )
+				return m_usecDeliver > rhs.m_usecDeliver;
+			return m_unSequence > rhs.m_unSequence;
+		}
+	};
+
+	// What we're doing to one connection's sends.  Only the thread sending on the connection, or
+	// RunCallbacks, touch it.
+	struct Connection_t
+	{
+		HSteamNetConnection m_hConn;
+		ENetworkImpairmentDirection m_eDirection;
+
+		// Set with SetConnectionProfile, otherwise the connection follows its direction's profile
+		bool m_bOwnProfile;
+		NetworkImpairmentProfile_t m_profile;
+
+		uint64 m_ulRandom;
+
+		// When a capped link will have sent everything it's been given
+		SteamNetworkingMicroseconds m_usecLinkFree;
+
+		// Delivery time of the last message that wasn't reordered on each lane, for unreliable
+		// messages in [0] and reliable ones in [1].  Nothing else of the same kind on the lane can
+		// arrive before it, but a reliable message waiting on a retransmit doesn't hold up
+		// unreliable traffic or other lanes.
+		std::vector< SteamNetworkingMicroseconds > m_rgvecLastInOrder[2];
+
+		std::vector< HeldMessage_t > m_vecHeld;
+		uint64 m_unNextSequence;
+		int64 m_nNextMessageNumber;
+
+		NetworkImpairmentStats_t m_stats;
+	};
+
+	// A script line, the profiles both ways from then on
+	struct ScriptStep_t
+	{
+		uint64 m_ulMilliseconds;
+		NetworkImpairmentProfile_t m_rgProfiles[k_ENetworkImpairmentDirectionCount];
+	};
+
+	// Our state for a connection, made the first time it's sent on.  NULL if the inner transport
+	// doesn't know it.
+	Connection_t *FindOrCreateConnection( HSteamNetConnection hConn );
+
+	// Switch to the profiles of the script steps that are due
+	void RunScript();
+
+	const NetworkImpairmentProfile_t &GetConnectionProfile( const Connection_t *pConnection ) const
+		{ return pConnection->m_bOwnProfile ? pConnection->m_profile : m_rgProfiles[pConnection->m_eDirection]; }
+
+	// Decide when, and whether, a message gets there and hold it back till then.  Returns the
+	// message number, or minus the result if it couldn't be sent.
+	int64 HoldMessage( Connection_t *pConnection, SteamNetworkingMessage_t *pMsg );
+	void PushHeldMessage( Connection_t *pConnection, SteamNetworkingMicroseconds usecDeliver, SteamNetworkingMessage_t *pMsg );
+
+	// Send on the messages that are due by usecNow
+	void ReleaseHeldMessages( Connection_t *pConnection, SteamNetworkingMicroseconds usecNow );
+
+	// The connection's own random stream
+	uint32 Random( Connection_t *pConnection );
+	bool BRandomChance( Connection_t *pConnection, float flPercent );
+
+	SteamNetworkingMicroseconds GetMicroseconds() const { return (SteamNetworkingMicroseconds)m_pClockEngine->GetGameTickCount() * 1000; }
+
+	ISpaceWarTransport *m_pInner;
+	IGameEngine *m_pClockEngine;
+	uint32 m_unSeed;
+
+	NetworkImpairmentProfile_t m_rgProfiles[k_ENetworkImpairmentDirectionCount];
+
+	// Script steps still to come, and when the script started
+	std::vector< ScriptStep_t > m_vecScript;
+	uint32 m_iNextScriptStep;
+	uint64 m_ulScriptStartTickCount;
+
+	// Guards the map and the stats of closed connections, not what's in each connection
+	std::mutex m_Mutex;
+	std::map< HSteamNetConnection, Connection_t * > m_mapConnections;
+	NetworkImpairmentStats_t m_rgClosedStats[k_ENetworkImpairmentDirectionCount];
+};
+
+#endif // NETWORKIMPAIRMENT_H
@@ -9,20 +9,26 @@
 #include "PhotonBeam.h"
 #include "SpaceWar.h"
 
+// Every beam has the same geometry, drawn in the color of the ship that fired it
+static const VectorEntityVertex_t s_rgPhotonBeamVertexes[] =
+{
+	VECTORENTITY_LINE( -2.0f, -3.0f, -2.0f, 3.0f ),
+	VECTORENTITY_LINE( 2.0f, -3.0f, 2.0f, 3.0f ),
+};
+
 //-----------------------------------------------------------------------------
 // Purpose: Constructor
 //-----------------------------------------------------------------------------
-CPhotonBeam::CPhotonBeam( IGameEngine *pGameEngine, float xPos, float yPos, DWORD dwBeamColor, float flInitialRotation, float flInitialXVelocity, float flInitialYVelocity ) 
-	: CSpaceWarEntity( pGameEngine, 3, true )
+CPhotonBeam::CPhotonBeam( IGameEngine *pGameEngine, float xPos, float yPos, DWORD dwBeamColor, float flInitialRotation, float flInitialXVelocity, float flInitialYVelocity, CVectorEntityStatePool *pStatePool ) 
+	: CSpaceWarEntity( pGameEngine, 3, true, pStatePool )
 {
 	// Beams only have a lifetime of 1 second
-	m_ulTickCountToDieAt = m_pGameEngine->GetGameTickCount()+PHOTON_BEAM_LIFETIME_IN_TICKS;
+	GetStatePool()->m_vecExpireTickCount[GetStateSlot()] = m_pGameEngine->GetGameTickCount()+PHOTON_BEAM_LIFETIME_IN_TICKS;
 
 	// Set a really high max velocity for photon beams
 	SetMaximumVelocity( 500 );
 
-	AddLine( -2.0f, -3.0f, -2.0f, 3.0f, dwBeamColor );
-	AddLine( 2.0f, -3.0f, 2.0f, 3.0f, dwBeamColor );
+	SetSharedGeometry( s_rgPhotonBeamVertexes, V_ARRAYSIZE( s_rgPhotonBeamVertexes ), dwBeamColor );
 	SetPosition( xPos, yPos );
 	SetRotationDeltaNextFrame( flInitialRotation );
 	SetVelocity( flInitialXVelocity, flInitialYVelocity );
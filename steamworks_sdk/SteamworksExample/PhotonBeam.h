@@ -16,16 +16,13 @@ class CPhotonBeam : public CSpaceWarEntity
 {
 public:
 	// Constructor
-	CPhotonBeam( IGameEngine *pGameEngine, float xPos, float yPos, DWORD dwBeamColor, float flInitialRotation, float flInitialXVelocity, float flInitialYVelocity );
+	CPhotonBeam( IGameEngine *pGameEngine, float xPos, float yPos, DWORD dwBeamColor, float flInitialRotation, float flInitialXVelocity, float flInitialYVelocity, CVectorEntityStatePool *pStatePool = NULL );
 
 	// Check if the photon beam needs to die
-	bool BIsBeamExpired() { return m_pGameEngine->GetGameTickCount() > m_ulTickCountToDieAt; }
+	bool BIsBeamExpired() { return m_pGameEngine->GetGameTickCount() > GetStatePool()->m_vecExpireTickCount[GetStateSlot()]; }
 
 	// Update with new data from server
 	void OnReceiveServerUpdate( ServerPhotonBeamUpdateData_t *pUpdateData );
-
-private:
-	uint64 m_ulTickCountToDieAt;
 };
 
 #endif // PHOTONBEAM_H
\ No newline at end of file
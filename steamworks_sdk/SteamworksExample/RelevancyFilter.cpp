@@ -0,0 +1,142 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Picks which players each client is sent in a world update
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "RelevancyFilter.h"
+#include "WorldSnapshot.h"
+#include <algorithm>
+#include <math.h>
+
+
+//-----------------------------------------------------------------------------
+// Purpose: How many lanes fit in the byte budget, never more than there are
+//			player slots
+//-----------------------------------------------------------------------------
+uint32 CRelevancyFilter::GetLaneCount( uint32 unPlayerSlots )
+{
+	uint32 unLanes = MAX( WORLD_UPDATE_LANE_BYTE_BUDGET / WORLD_SNAPSHOT_LANE_BYTES, 1 );
+	return MIN( unLanes, unPlayerSlots );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Distance between two normalized positions in pixels, the short way
+//			around the wrapping world
+//-----------------------------------------------------------------------------
+static float WrappedDistance( float flXPos0, float flYPos0, float flXPos1, float flYPos1, float flViewportWidth, float flViewportHeight )
+{
+	float flDeltaX = (float)fabs( flXPos1 - flXPos0 );
+	float flDeltaY = (float)fabs( flYPos1 - flYPos0 );
+	flDeltaX = MIN( flDeltaX, 1.0f - flDeltaX ) * flViewportWidth;
+	flDeltaY = MIN( flDeltaY, 1.0f - flDeltaY ) * flViewportHeight;
+	return (float)sqrt( flDeltaX * flDeltaX + flDeltaY * flDeltaY );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Orders player slots by who should be sent first
+//-----------------------------------------------------------------------------
+struct RelevancyOrder_t
+{
+	const uint32 *m_rgunPriority;
+	uint32 m_iClientSlot;
+
+	bool operator()( uint32 iSlot0, uint32 iSlot1 ) const
+	{
+		if ( ( iSlot0 == m_iClientSlot ) != ( iSlot1 == m_iClientSlot ) )
+			return iSlot0 == m_iClientSlot;
+		if ( m_rgunPriority[iSlot0] != m_rgunPriority[iSlot1] )
+			return m_rgunPriority[iSlot0] > m_rgunPriority[iSlot1];
+		return iSlot0 < iSlot1;
+	}
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Pick the players to send a client this update
+//-----------------------------------------------------------------------------
+void CRelevancyFilter::SelectPlayers( ServerSpaceWarUpdateData_t *pUpdateData, uint32 iClientSlot, float flViewportWidth, float flViewportHeight, uint32 unMaxLanes )
+{
+	uint32 unPlayerSlots = pUpdateData->GetPlayerSlotCount();
+	uint32 unLanes = GetLaneCount( unPlayerSlots );
+	if ( unMaxLanes )
+		unLanes = MIN( unLanes, unMaxLanes );
+
+	// Changing the lane count only moves everyone to new lanes, what they're owed stays
+	if ( m_vecPriority.size() != unPlayerSlots )
+	{
+		m_vecPriority.assign( unPlayerSlots, 0 );
+		m_vecLaneSlots.clear();
+	}
+	if ( m_vecLaneSlots.size() != unLanes )
+		m_vecLaneSlots.assign( unLanes, WORLD_SNAPSHOT_EMPTY_LANE );
+
+	ServerShipUpdateData_t *pClientShip = pUpdateData->AccessShipUpdateData( iClientSlot );
+	float flClientXPos = pClientShip->GetXPosition();
+	float flClientYPos = pClientShip->GetYPosition();
+
+	// Everyone active gains priority by distance band
+	m_vecCandidates.clear();
+	for ( uint32 i = 0; i < unPlayerSlots; ++i )
+	{
+		if ( !pUpdateData->GetPlayerActive( i ) )
+		{
+			m_vecPriority[i] = 0;
+			continue;
+		}
+
+		m_vecCandidates.push_back( i );
+		if ( i == iClientSlot )
+			continue;
+
+		ServerShipUpdateData_t *pShip = pUpdateData->AccessShipUpdateData( i );
+		float flDistance = WrappedDistance( flClientXPos, flClientYPos, pShip->GetXPosition(), pShip->GetYPosition(), flViewportWidth, flViewportHeight );
+		if ( flDistance < RELEVANCY_NEAR_DISTANCE )
+			m_vecPriority[i] += RELEVANCY_NEAR_PRIORITY;
+		else if ( flDistance < RELEVANCY_MID_DISTANCE )
+			m_vecPriority[i] += RELEVANCY_MID_PRIORITY;
+		else
+			m_vecPriority[i] += RELEVANCY_FAR_PRIORITY;
+	}
+
+	// If there's more than fits, the client's own ship first then the highest priority, lowest
+	// slot breaking ties
+	if ( m_vecCandidates.size() > unLanes )
+	{
+		RelevancyOrder_t order = { &m_vecPriority[0], iClientSlot };
+		std::nth_element( m_vecCandidates.begin(), m_vecCandidates.begin() + unLanes, m_vecCandidates.end(), order );
+		m_vecCandidates.resize( unLanes );
+	}
+
+	m_vecSelected.assign( unPlayerSlots, false );
+	for ( uint32 i = 0; i < m_vecCandidates.size(); ++i )
+	{
+		m_vecSelected[ m_vecCandidates[i] ] = true;
+		m_vecPriority[ m_vecCandidates[i] ] = 0;
+	}
+
+	// Players picked again keep their lane, the rest go in the lanes that freed up
+	for ( uint32 iLane = 0; iLane < unLanes; ++iLane )
+	{
+		uint32 iSlot = m_vecLaneSlots[iLane];
+		if ( iSlot < unPlayerSlots && m_vecSelected[iSlot] )
+			m_vecSelected[iSlot] = false;
+		else
+			m_vecLaneSlots[iLane] = WORLD_SNAPSHOT_EMPTY_LANE;
+	}
+
+	uint32 iLane = 0;
+	for ( uint32 i = 0; i < m_vecCandidates.size(); ++i )
+	{
+		uint32 iSlot = m_vecCandidates[i];
+		if ( !m_vecSelected[iSlot] )
+			continue;
+
+		while ( m_vecLaneSlots[iLane] != WORLD_SNAPSHOT_EMPTY_LANE )
+			++iLane;
+		m_vecLaneSlots[iLane] = iSlot;
+	}
+}
@@ -0,0 +1,63 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Picks which players each client is sent in a world update
+//
+//=============================================================================
+
+#ifndef RELEVANCYFILTER_H
+#define RELEVANCYFILTER_H
+
+#include <vector>
+#include "SpaceWar.h"
+
+// Distance bands, in pixels from the client's own ship.  The world wraps, so distances are
+// measured the short way around.
+#define RELEVANCY_NEAR_DISTANCE 256.0f
+#define RELEVANCY_MID_DISTANCE 512.0f
+
+// Priority a ship gains each update it isn't sent, by band.  The client's own ship is always sent.
+#define RELEVANCY_NEAR_PRIORITY 8
+#define RELEVANCY_MID_PRIORITY 3
+#define RELEVANCY_FAR_PRIORITY 1
+
+// Bytes of packed player and ship data each client is sent per world update, before delta
+// encoding.  This sets how many lanes an update has, see GetLaneCount.
+#define WORLD_UPDATE_LANE_BYTE_BUDGET 2400
+
+//-----------------------------------------------------------------------------
+// Purpose: One client's view of who is relevant.  Every update each other
+//			ship gains priority by how close it is, and the highest priority
+//			ones that fit in the byte budget are sent and start again from
+//			zero.  Near ships go out every update, far ones less often, and
+//			what a client costs to update stays flat however big the match.
+//
+//			Players stay in the same lane from one update to the next while
+//			they keep being picked, so the lanes delta encode well.
+//-----------------------------------------------------------------------------
+class CRelevancyFilter
+{
+public:
+	// How many lanes an update for a server with this many player slots has
+	static uint32 GetLaneCount( uint32 unPlayerSlots );
+
+	// Pick the players to send the client in slot iClientSlot this update, in at most unMaxLanes
+	// lanes if that's fewer than the byte budget allows (0 for no limit)
+	void SelectPlayers( ServerSpaceWarUpdateData_t *pUpdateData, uint32 iClientSlot, float flViewportWidth, float flViewportHeight, uint32 unMaxLanes = 0 );
+
+	// The slot in each lane from the last SelectPlayers, WORLD_SNAPSHOT_EMPTY_LANE if none
+	const uint32 *GetLaneSlots() { return m_vecLaneSlots.empty() ? NULL : &m_vecLaneSlots[0]; }
+	uint32 GetLaneCount() { return (uint32)m_vecLaneSlots.size(); }
+
+private:
+	// Priority each player slot has built up since it was last sent
+	std::vector< uint32 > m_vecPriority;
+
+	// Player slot in each lane
+	std::vector< uint32 > m_vecLaneSlots;
+
+	// Scratch space for SelectPlayers
+	std::vector< uint32 > m_vecCandidates;
+	std::vector< bool > m_vecSelected;
+};
+
+#endif // RELEVANCYFILTER_H
@@ -0,0 +1,525 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Recording a match's client input and world snapshots to a compact
+//			log, and playing it back from a memory-mapped file
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "ReplayLog.h"
+#include "LoopbackTransport.h"
+#include "MatchGameEngine.h"
+#include "SpaceWarServer.h"
+#include "WorldSnapshot.h"
+#include <chrono>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Records are buffered this much before they go to the file
+#define REPLAY_LOG_WRITE_BUFFER_SIZE ( 256 * 1024 )
+
+// Viewport replays run in, the same as the dedicated server's
+#define REPLAY_VIEWPORT_WIDTH 1024
+#define REPLAY_VIEWPORT_HEIGHT 768
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CReplayRecorder::CReplayRecorder()
+{
+	m_pFile = NULL;
+	m_ulLastTickCount = 0;
+	m_cubWritten = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor
+//-----------------------------------------------------------------------------
+CReplayRecorder::~CReplayRecorder()
+{
+	if ( m_pFile )
+		fclose( m_pFile );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Create the log and write its header
+//-----------------------------------------------------------------------------
+bool CReplayRecorder::BOpen( const char *pchFileName, uint32 unMaxPlayers, uint64 ulStartTickCount )
+{
+	m_pFile = fopen( pchFileName, "wb" );
+	if ( !m_pFile )
+		return false;
+	setvbuf( m_pFile, NULL, _IOFBF, REPLAY_LOG_WRITE_BUFFER_SIZE );
+
+	ReplayLogHeader_t header;
+	header.m_unMagic = LittleDWord( REPLAY_LOG_MAGIC );
+	header.m_unVersion = LittleDWord( REPLAY_LOG_VERSION );
+	header.m_unMaxPlayers = LittleDWord( unMaxPlayers );
+	header.m_unSimulationStepMilliseconds = LittleDWord( SIMULATION_STEP_MILLISECONDS );
+	header.m_ulStartTickCount = LittleQWord( ulStartTickCount );
+	fwrite( &header, sizeof( header ), 1, m_pFile );
+	m_cubWritten = sizeof( header );
+	m_ulLastTickCount = ulStartTickCount;
+
+	m_vecLaneSlots.resize( unMaxPlayers );
+	for ( uint32 i = 0; i < unMaxPlayers; ++i )
+		m_vecLaneSlots[i] = i;
+	m_vecPackedSnapshot.resize( GetPackedWorldSnapshotSize( unMaxPlayers, unMaxPlayers ) );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Write an unsigned number 7 bits at a time, low bits first, with the
+//			top bit of each byte set if more follow
+//-----------------------------------------------------------------------------
+void CReplayRecorder::WriteVarint( uint64 ulValue )
+{
+	uint8 rgubVarint[10];
+	uint32 cubVarint = 0;
+	do
+	{
+		rgubVarint[cubVarint] = (uint8)( ulValue & 0x7f );
+		ulValue >>= 7;
+		if ( ulValue )
+			rgubVarint[cubVarint] |= 0x80;
+		++cubVarint;
+	} while ( ulValue );
+
+	fwrite( rgubVarint, 1, cubVarint, m_pFile );
+	m_cubWritten += cubVarint;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Write one record: its type, the ticks since the last record, the
+//			slot if it has one, then the payload and its size if it has one
+//-----------------------------------------------------------------------------
+void CReplayRecorder::WriteRecord( EReplayRecord eType, uint64 ulTickCount, uint32 uSlot, const void *pubData, uint32 cubData )
+{
+	if ( !m_pFile )
+		return;
+
+	uint8 ubType = (uint8)eType;
+	fwrite( &ubType, 1, 1, m_pFile );
+	++m_cubWritten;
+
+	WriteVarint( ulTickCount - m_ulLastTickCount );
+	m_ulLastTickCount = ulTickCount;
+
+	if ( eType == k_EReplayRecordClientMessage || eType == k_EReplayRecordPlayerJoined || eType == k_EReplayRecordPlayerLeft )
+		WriteVarint( uSlot );
+
+	if ( eType == k_EReplayRecordClientMessage || eType == k_EReplayRecordPlayerJoined || eType == k_EReplayRecordWorldSnapshot )
+	{
+		WriteVarint( cubData );
+		fwrite( pubData, 1, cubData, m_pFile );
+		m_cubWritten += cubData;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Record the different kinds of event
+//-----------------------------------------------------------------------------
+void CReplayRecorder::RecordClientMessage( uint64 ulTickCount, uint32 uSlot, const void *pubData, uint32 cubData )
+{
+	WriteRecord( k_EReplayRecordClientMessage, ulTickCount, uSlot, pubData, cubData );
+}
+
+void CReplayRecorder::RecordPlayerJoined( uint64 ulTickCount, uint32 uSlot, CSteamID steamID )
+{
+	uint64 ulSteamID = LittleQWord( steamID.ConvertToUint64() );
+	WriteRecord( k_EReplayRecordPlayerJoined, ulTickCount, uSlot, &ulSteamID, sizeof( ulSteamID ) );
+}
+
+void CReplayRecorder::RecordPlayerLeft( uint64 ulTickCount, uint32 uSlot )
+{
+	WriteRecord( k_EReplayRecordPlayerLeft, ulTickCount, uSlot, NULL, 0 );
+}
+
+void CReplayRecorder::RecordFrame( uint64 ulTickCount )
+{
+	WriteRecord( k_EReplayRecordFrame, ulTickCount, 0, NULL, 0 );
+}
+
+void CReplayRecorder::RecordWorldSnapshot( uint64 ulTickCount, ServerSpaceWarUpdateData_t *pUpdateData )
+{
+	uint32 cubSnapshot = PackWorldSnapshot( pUpdateData, &m_vecLaneSlots[0], (uint32)m_vecLaneSlots.size(), &m_vecPackedSnapshot[0], (uint32)m_vecPackedSnapshot.size() );
+	if ( cubSnapshot )
+		WriteRecord( k_EReplayRecordWorldSnapshot, ulTickCount, 0, &m_vecPackedSnapshot[0], cubSnapshot );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CReplayReader::CReplayReader()
+{
+	m_pubFile = NULL;
+	m_cubFile = 0;
+	m_iPosition = 0;
+	m_ulTickCount = 0;
+	memset( &m_Header, 0, sizeof( m_Header ) );
+#ifdef _WIN32
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor
+//-----------------------------------------------------------------------------
+CReplayReader::~CReplayReader()
+{
+	Close();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Unmap the log
+//-----------------------------------------------------------------------------
+void CReplayReader::Close()
+{
+#ifdef _WIN32
+	if ( m_pubFile )
+		UnmapViewOfFile( m_pubFile );
+	if ( m_hMapping )
+		CloseHandle( m_hMapping );
+	if ( m_hFile != INVALID_HANDLE_VALUE )
+		CloseHandle( m_hFile );
+	m_hMapping = NULL;
+	m_hFile = INVALID_HANDLE_VALUE;
+#else
+	if ( m_pubFile )
+		munmap( (void *)m_pubFile, (size_t)m_cubFile );
+#endif
+	m_pubFile = NULL;
+	m_cubFile = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Map the log and check its header
+//-----------------------------------------------------------------------------
+bool CReplayReader::BOpen( const char *pchFileName )
+{
+	Close();
+
+#ifdef _WIN32
+	m_hFile = CreateFileA( pchFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if ( m_hFile == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER liSize;
+	if ( !GetFileSizeEx( m_hFile, &liSize ) || liSize.QuadPart < (LONGLONG)sizeof( ReplayLogHeader_t ) )
+	{
+		Close();
+		return false;
+	}
+
+	m_hMapping = CreateFileMappingA( m_hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+	if ( !m_hMapping )
+	{
+		Close();
+		return false;
+	}
+
+	m_pubFile = (const uint8 *)MapViewOfFile( m_hMapping, FILE_MAP_READ, 0, 0, 0 );
+	if ( !m_pubFile )
+	{
+		Close();
+		return false;
+	}
+	m_cubFile = (uint64)liSize.QuadPart;
+#else
+	int fd = open( pchFileName, O_RDONLY );
+	if ( fd < 0 )
+		return false;
+
+	struct stat st;
+	if ( fstat( fd, &st ) != 0 || st.st_size < (off_t)sizeof( ReplayLogHeader_t ) )
+	{
+		close( fd );
+		return false;
+	}
+
+	// The mapping keeps the file open, we don't need the descriptor once it's made
+	void *pMapping = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( pMapping == MAP_FAILED )
+		return false;
+
+	// We read it front to back
+	madvise( pMapping, (size_t)st.st_size, MADV_SEQUENTIAL );
+
+	m_pubFile = (const uint8 *)pMapping;
+	m_cubFile = (uint64)st.st_size;
+#endif
+
+	memcpy( &m_Header, m_pubFile, sizeof( m_Header ) );
+	m_Header.m_unMagic = LittleDWord( m_Header.m_unMagic );
+	m_Header.m_unVersion = LittleDWord( m_Header.m_unVersion );
+	m_Header.m_unMaxPlayers = LittleDWord( m_Header.m_unMaxPlayers );
+	m_Header.m_unSimulationStepMilliseconds = LittleDWord( m_Header.m_unSimulationStepMilliseconds );
+	m_Header.m_ulStartTickCount = LittleQWord( m_Header.m_ulStartTickCount );
+
+	if ( m_Header.m_unMagic != REPLAY_LOG_MAGIC || m_Header.m_unVersion != REPLAY_LOG_VERSION ||
+		m_Header.m_unMaxPlayers == 0 || m_Header.m_unMaxPlayers > MAX_PLAYERS_PER_SERVER_LIMIT )
+	{
+		Close();
+		return false;
+	}
+
+	Rewind();
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Go back to the first record
+//-----------------------------------------------------------------------------
+void CReplayReader::Rewind()
+{
+	m_iPosition = sizeof( ReplayLogHeader_t );
+	m_ulTickCount = m_Header.m_ulStartTickCount;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Read a varint, false if the log ends in the middle of it
+//-----------------------------------------------------------------------------
+bool CReplayReader::BReadVarint( uint64 *pulValue )
+{
+	uint64 ulValue = 0;
+	for ( uint32 nShift = 0; nShift < 64; nShift += 7 )
+	{
+		if ( m_iPosition >= m_cubFile )
+			return false;
+
+		uint8 ubByte = m_pubFile[ m_iPosition++ ];
+		ulValue |= (uint64)( ubByte & 0x7f ) << nShift;
+		if ( !( ubByte & 0x80 ) )
+		{
+			*pulValue = ulValue;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Read the next record.  A server that didn't shut down cleanly
+//			leaves a partial record at the end, which reads as the end.
+//-----------------------------------------------------------------------------
+bool CReplayReader::BReadRecord( ReplayRecord_t *pRecord )
+{
+	if ( m_iPosition >= m_cubFile )
+		return false;
+
+	pRecord->m_eType = (EReplayRecord)m_pubFile[ m_iPosition++ ];
+	pRecord->m_uSlot = 0;
+	pRecord->m_pubData = NULL;
+	pRecord->m_cubData = 0;
+
+	uint64 ulTickDelta;
+	if ( !BReadVarint( &ulTickDelta ) )
+		return false;
+	m_ulTickCount += ulTickDelta;
+	pRecord->m_ulTickCount = m_ulTickCount;
+
+	switch ( pRecord->m_eType )
+	{
+	case k_EReplayRecordClientMessage:
+	case k_EReplayRecordPlayerJoined:
+	case k_EReplayRecordPlayerLeft:
+		{
+			uint64 ulSlot;
+			if ( !BReadVarint( &ulSlot ) || ulSlot >= m_Header.m_unMaxPlayers )
+				return false;
+			pRecord->m_uSlot = (uint32)ulSlot;
+		}
+		break;
+	case k_EReplayRecordFrame:
+	case k_EReplayRecordWorldSnapshot:
+		break;
+	default:
+		return false;
+	}
+
+	if ( pRecord->m_eType == k_EReplayRecordClientMessage || pRecord->m_eType == k_EReplayRecordPlayerJoined || pRecord->m_eType == k_EReplayRecordWorldSnapshot )
+	{
+		uint64 cubData;
+		if ( !BReadVarint( &cubData ) || cubData > m_cubFile - m_iPosition )
+			return false;
+		pRecord->m_pubData = m_pubFile + m_iPosition;
+		pRecord->m_cubData = (uint32)cubData;
+		m_iPosition += cubData;
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Play a log back, re-simulating it or just unpacking its snapshots
+//-----------------------------------------------------------------------------
+bool RunReplay( const char *pchFileName, bool bResimulate )
+{
+	char rgchBuffer[256];
+
+	CReplayReader reader;
+	if ( !reader.BOpen( pchFileName ) )
+	{
+		sprintf_safe( rgchBuffer, "Couldn't read replay log %s\n", pchFileName );
+		OutputDebugString( rgchBuffer );
+		return false;
+	}
+
+	const ReplayLogHeader_t &header = reader.GetHeader();
+	if ( bResimulate && header.m_unSimulationStepMilliseconds != SIMULATION_STEP_MILLISECONDS )
+	{
+		sprintf_safe( rgchBuffer, "Replay log was recorded with %u ms simulation steps, we use %u, it can't be re-simulated\n",
+			header.m_unSimulationStepMilliseconds, (uint32)SIMULATION_STEP_MILLISECONDS );
+		OutputDebugString( rgchBuffer );
+		return false;
+	}
+
+	// Nothing connects to the replayed server, it just needs somewhere to send to
+	CMatchGameEngine engine( REPLAY_VIEWPORT_WIDTH, REPLAY_VIEWPORT_HEIGHT );
+	engine.SetGameTickCount( header.m_ulStartTickCount );
+	CLoopbackTransport transport;
+	CSpaceWarServer *pServer = bResimulate ? new CSpaceWarServer( &engine, true, 0, header.m_unMaxPlayers, &transport ) : NULL;
+
+	std::vector< uint8 > vecUpdateWorld;
+	std::vector< uint32 > vecLaneSlots( header.m_unMaxPlayers );
+	for ( uint32 i = 0; i < header.m_unMaxPlayers; ++i )
+		vecLaneSlots[i] = i;
+	std::vector< uint8 > vecPacked( GetPackedWorldSnapshotSize( header.m_unMaxPlayers, header.m_unMaxPlayers ) );
+
+	uint32 cRecords = 0;
+	uint32 cFrames = 0;
+	uint32 cSnapshots = 0;
+	uint32 cMismatches = 0;
+	uint32 cBadSnapshots = 0;
+	uint64 ulFirstMismatchTickCount = 0;
+	uint64 ulLastTickCount = header.m_ulStartTickCount;
+
+	// A frame where nothing happened before it still has to move the clock, even by nothing, so
+	// the server sees the same frame delta it did when recording
+	bool bClockSetThisFrame = false;
+
+	std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+
+	ReplayRecord_t record;
+	while ( reader.BReadRecord( &record ) )
+	{
+		++cRecords;
+		ulLastTickCount = record.m_ulTickCount;
+
+		if ( pServer && record.m_eType != k_EReplayRecordWorldSnapshot )
+		{
+			if ( record.m_ulTickCount != engine.GetGameTickCount() || ( record.m_eType == k_EReplayRecordFrame && !bClockSetThisFrame ) )
+			{
+				engine.SetGameTickCount( record.m_ulTickCount );
+				bClockSetThisFrame = true;
+			}
+		}
+
+		switch ( record.m_eType )
+		{
+		case k_EReplayRecordClientMessage:
+			if ( pServer )
+				pServer->ReplayClientMessage( record.m_uSlot, record.m_pubData, record.m_cubData );
+			break;
+
+		case k_EReplayRecordPlayerJoined:
+			if ( pServer && record.m_cubData == sizeof( uint64 ) )
+			{
+				uint64 ulSteamID;
+				memcpy( &ulSteamID, record.m_pubData, sizeof( ulSteamID ) );
+				if ( !pServer->ReplayPlayerJoined( CSteamID( LittleQWord( ulSteamID ) ), record.m_uSlot ) )
+				{
+					sprintf_safe( rgchBuffer, "Replay log has a player joining in slot %u at %.3f s, but that isn't the slot they'd get, it can't be re-simulated\n",
+						record.m_uSlot, (double)( record.m_ulTickCount - header.m_ulStartTickCount ) / 1000.0 );
+					OutputDebugString( rgchBuffer );
+					delete pServer;
+					return false;
+				}
+			}
+			break;
+
+		case k_EReplayRecordPlayerLeft:
+			if ( pServer )
+				pServer->ReplayPlayerLeft( record.m_uSlot );
+			break;
+
+		case k_EReplayRecordFrame:
+			++cFrames;
+			if ( pServer )
+			{
+				pServer->RunFrame();
+				bClockSetThisFrame = false;
+			}
+			break;
+
+		case k_EReplayRecordWorldSnapshot:
+			++cSnapshots;
+			if ( pServer )
+			{
+				// The server built this one in the frame we just ran, pack it the same way and compare
+				uint32 cubPacked = PackWorldSnapshot( pServer->AccessLastWorldUpdate(), &vecLaneSlots[0], (uint32)vecLaneSlots.size(), &vecPacked[0], (uint32)vecPacked.size() );
+				if ( cubPacked != record.m_cubData || memcmp( &vecPacked[0], record.m_pubData, cubPacked ) != 0 )
+				{
+					if ( !cMismatches )
+						ulFirstMismatchTickCount = record.m_ulTickCount;
+					++cMismatches;
+				}
+			}
+			else if ( !BUnpackWorldSnapshot( record.m_pubData, record.m_cubData, vecUpdateWorld ) )
+			{
+				++cBadSnapshots;
+			}
+			break;
+		}
+	}
+
+	double flWallSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - tStart ).count();
+	double flMatchSeconds = (double)( ulLastTickCount - header.m_ulStartTickCount ) / 1000.0;
+
+	delete pServer;
+
+	sprintf_safe( rgchBuffer, "Replay %s: %u player slots, %.1f s of match, %u records, %u frames, %u snapshots, %llu bytes\n",
+		pchFileName, header.m_unMaxPlayers, flMatchSeconds, cRecords, cFrames, cSnapshots, (unsigned long long)reader.GetSize() );
+	OutputDebugString( rgchBuffer );
+	sprintf_safe( rgchBuffer, "%s in %.3f s, %.0fx real time\n", bResimulate ? "Re-simulated" : "Fast-forwarded",
+		flWallSeconds, flWallSeconds > 0.0 ? flMatchSeconds / flWallSeconds : 0.0 );
+	OutputDebugString( rgchBuffer );
+
+	if ( bResimulate )
+	{
+		if ( cMismatches )
+			sprintf_safe( rgchBuffer, "%u of %u snapshots didn't match, the first at %.3f s\n", cMismatches, cSnapshots, (double)( ulFirstMismatchTickCount - header.m_ulStartTickCount ) / 1000.0 );
+		else
+			sprintf_safe( rgchBuffer, "All %u snapshots matched\n", cSnapshots );
+		OutputDebugString( rgchBuffer );
+		return cMismatches == 0;
+	}
+
+	if ( cBadSnapshots )
+	{
+		sprintf_safe( rgchBuffer, "%u snapshots couldn't be unpacked\n", cBadSnapshots );
+		OutputDebugString( rgchBuffer );
+	}
+	return cBadSnapshots == 0;
+}
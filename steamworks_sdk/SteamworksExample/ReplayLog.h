@@ -0,0 +1,154 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Recording a match's client input and world snapshots to a compact
+//			log, and playing it back from a memory-mapped file
+//
+//=============================================================================
+
+#ifndef REPLAYLOG_H
+#define REPLAYLOG_H
+
+#include <vector>
+#include "SpaceWar.h"
+
+// First four bytes of every replay log, and the format version after them
+#define REPLAY_LOG_MAGIC 0x50525753 // 'SWRP'
+#define REPLAY_LOG_VERSION 1
+
+// What each record in a log is.  Every record has the host tick count it happened at; records
+// for a player also have their slot.
+enum EReplayRecord
+{
+	// A client message the server acted on (a local update or a snapshot ack), in the order they were received
+	k_EReplayRecordClientMessage = 1,
+
+	// A player was given a slot, the payload is their SteamID
+	k_EReplayRecordPlayerJoined = 2,
+
+	// A player left their slot, for any reason
+	k_EReplayRecordPlayerLeft = 3,
+
+	// The server started a frame, everything before it was received before the frame ran
+	k_EReplayRecordFrame = 4,
+
+	// The world update the server built for its clients, packed with every player in it
+	k_EReplayRecordWorldSnapshot = 5,
+};
+
+// Fixed header at the start of a log
+struct ReplayLogHeader_t
+{
+	uint32 m_unMagic;
+	uint32 m_unVersion;
+
+	// Player slots the server had
+	uint32 m_unMaxPlayers;
+
+	// The simulation step the log was made with, replaying with any other won't match
+	uint32 m_unSimulationStepMilliseconds;
+
+	// Host tick count when recording started, records store the ticks since the record before
+	uint64 m_ulStartTickCount;
+};
+
+// One record read back from a log.  The payload points into the mapped file.
+struct ReplayRecord_t
+{
+	EReplayRecord m_eType;
+	uint64 m_ulTickCount;
+	uint32 m_uSlot;
+	const uint8 *m_pubData;
+	uint32 m_cubData;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Appends records to a replay log.  Ticks, slots and sizes are
+//			written as varints, and snapshots the way they are packed for
+//			clients, so a log is only a little bigger than the traffic was.
+//-----------------------------------------------------------------------------
+class CReplayRecorder
+{
+public:
+	// Constructor
+	CReplayRecorder();
+
+	// Destructor, closes the log
+	~CReplayRecorder();
+
+	// Create the log and write its header, false if the file can't be created
+	bool BOpen( const char *pchFileName, uint32 unMaxPlayers, uint64 ulStartTickCount );
+
+	void RecordClientMessage( uint64 ulTickCount, uint32 uSlot, const void *pubData, uint32 cubData );
+	void RecordPlayerJoined( uint64 ulTickCount, uint32 uSlot, CSteamID steamID );
+	void RecordPlayerLeft( uint64 ulTickCount, uint32 uSlot );
+	void RecordFrame( uint64 ulTickCount );
+	void RecordWorldSnapshot( uint64 ulTickCount, ServerSpaceWarUpdateData_t *pUpdateData );
+
+	// Bytes written so far, header included
+	uint64 GetBytesWritten() { return m_cubWritten; }
+
+private:
+	void WriteRecord( EReplayRecord eType, uint64 ulTickCount, uint32 uSlot, const void *pubData, uint32 cubData );
+	void WriteVarint( uint64 ulValue );
+
+	FILE *m_pFile;
+	uint64 m_ulLastTickCount;
+	uint64 m_cubWritten;
+
+	// Every slot as a lane, so snapshots are packed with the whole world in them
+	std::vector< uint32 > m_vecLaneSlots;
+	std::vector< uint8 > m_vecPackedSnapshot;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Reads a replay log through a read-only mapping of the file, so
+//			reading a record is just decoding its header.  Payloads point
+//			straight into the mapping.
+//-----------------------------------------------------------------------------
+class CReplayReader
+{
+public:
+	// Constructor
+	CReplayReader();
+
+	// Destructor, unmaps the log
+	~CReplayReader();
+
+	// Map the log and check its header, false if it can't be mapped or isn't a log we understand
+	bool BOpen( const char *pchFileName );
+
+	const ReplayLogHeader_t &GetHeader() { return m_Header; }
+	uint64 GetSize() { return m_cubFile; }
+
+	// Read the next record, false at the end of the log or if the rest of it is truncated
+	bool BReadRecord( ReplayRecord_t *pRecord );
+
+	// Go back to the first record
+	void Rewind();
+
+private:
+	bool BReadVarint( uint64 *pulValue );
+	void Close();
+
+	const uint8 *m_pubFile;
+	uint64 m_cubFile;
+	uint64 m_iPosition;
+	uint64 m_ulTickCount;
+	ReplayLogHeader_t m_Header;
+
+#ifdef _WIN32
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+#endif
+};
+
+
+// Play a log back.  With bResimulate a server re-runs the match from the recorded input and
+// every snapshot it builds is checked against the recorded one, otherwise the recorded snapshots
+// are just unpacked (fast-forwarding through the match).  Reports how much faster than real time
+// it went.  Returns false if the log can't be read, or a re-simulated snapshot didn't match.
+bool RunReplay( const char *pchFileName, bool bResimulate );
+
+#endif // REPLAYLOG_H
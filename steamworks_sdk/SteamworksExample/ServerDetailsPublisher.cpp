@@ -0,0 +1,152 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Publishes a server's details to Steam, only calling the
+//			ISteamGameServer setters for what has changed
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "ServerDetailsPublisher.h"
+#include "SpaceWar.h"
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CServerDetailsPublisher::CServerDetailsPublisher()
+{
+	m_unFlushIntervalMilliseconds = SERVER_DETAILS_REFRESH_MILLISECONDS;
+	m_ulLastFlushTick = 0;
+	m_cFlushes = 0;
+	m_Stats.Reset();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Note the values to publish at the next flush
+//-----------------------------------------------------------------------------
+void CServerDetailsPublisher::SetMaxPlayerCount( int cPlayersMax )
+{
+	++m_Stats.m_cRequested;
+	m_MaxPlayerCount.Set( cPlayersMax );
+}
+
+void CServerDetailsPublisher::SetPasswordProtected( bool bPasswordProtected )
+{
+	++m_Stats.m_cRequested;
+	m_PasswordProtected.Set( bPasswordProtected );
+}
+
+void CServerDetailsPublisher::SetServerName( const char *pchServerName )
+{
+	++m_Stats.m_cRequested;
+	m_ServerName.Set( pchServerName );
+}
+
+void CServerDetailsPublisher::SetBotPlayerCount( int cBotPlayers )
+{
+	++m_Stats.m_cRequested;
+	m_BotPlayerCount.Set( cBotPlayers );
+}
+
+void CServerDetailsPublisher::SetMapName( const char *pchMapName )
+{
+	++m_Stats.m_cRequested;
+	m_MapName.Set( pchMapName );
+}
+
+void CServerDetailsPublisher::SetUserData( CSteamID steamIDUser, const char *pchPlayerName, uint32 uScore )
+{
+	++m_Stats.m_cRequested;
+	UserDetails_t &user = m_mapUsers[ steamIDUser.ConvertToUint64() ];
+	user.m_Name.Set( pchPlayerName );
+	user.m_Score.Set( uScore );
+	user.m_unLastSetFlush = m_cFlushes;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: One setter call per changed value, and one BUpdateUserData per
+//			player whose name or score changed.  Players who weren't given
+//			since the last flush are forgotten, so if they come back they're
+//			published again.
+//-----------------------------------------------------------------------------
+void CServerDetailsPublisher::Flush( ISteamGameServer *pGameServer, uint64 ulTickCount )
+{
+	if ( !pGameServer )
+		return;
+
+	if ( m_MaxPlayerCount.BNeedsPublishing() )
+	{
+		pGameServer->SetMaxPlayerCount( m_MaxPlayerCount.m_Value );
+		m_MaxPlayerCount.OnPublished();
+		++m_Stats.m_cPublished;
+	}
+	if ( m_PasswordProtected.BNeedsPublishing() )
+	{
+		pGameServer->SetPasswordProtected( m_PasswordProtected.m_Value );
+		m_PasswordProtected.OnPublished();
+		++m_Stats.m_cPublished;
+	}
+	if ( m_ServerName.BNeedsPublishing() )
+	{
+		pGameServer->SetServerName( m_ServerName.m_Value.c_str() );
+		m_ServerName.OnPublished();
+		++m_Stats.m_cPublished;
+	}
+	if ( m_BotPlayerCount.BNeedsPublishing() )
+	{
+		pGameServer->SetBotPlayerCount( m_BotPlayerCount.m_Value );
+		m_BotPlayerCount.OnPublished();
+		++m_Stats.m_cPublished;
+	}
+	if ( m_MapName.BNeedsPublishing() )
+	{
+		pGameServer->SetMapName( m_MapName.m_Value.c_str() );
+		m_MapName.OnPublished();
+		++m_Stats.m_cPublished;
+	}
+
+	std::map< uint64, UserDetails_t >::iterator iter = m_mapUsers.begin();
+	while ( iter != m_mapUsers.end() )
+	{
+		UserDetails_t &user = iter->second;
+		if ( user.m_unLastSetFlush != m_cFlushes )
+		{
+			m_mapUsers.erase( iter++ );
+			continue;
+		}
+
+		if ( user.m_Name.BNeedsPublishing() || user.m_Score.BNeedsPublishing() )
+		{
+			pGameServer->BUpdateUserData( CSteamID( iter->first ), user.m_Name.m_Value.c_str(), user.m_Score.m_Value );
+			user.m_Name.OnPublished();
+			user.m_Score.OnPublished();
+			++m_Stats.m_cPublished;
+		}
+		++iter;
+	}
+
+	m_ulLastFlushTick = ulTickCount;
+	++m_cFlushes;
+	++m_Stats.m_cFlushes;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Everything goes out again at the next flush
+//-----------------------------------------------------------------------------
+void CServerDetailsPublisher::RepublishAll()
+{
+	m_MaxPlayerCount.m_bPublished = false;
+	m_PasswordProtected.m_bPublished = false;
+	m_ServerName.m_bPublished = false;
+	m_BotPlayerCount.m_bPublished = false;
+	m_MapName.m_bPublished = false;
+
+	for ( std::map< uint64, UserDetails_t >::iterator iter = m_mapUsers.begin(); iter != m_mapUsers.end(); ++iter )
+	{
+		iter->second.m_Name.m_bPublished = false;
+		iter->second.m_Score.m_bPublished = false;
+	}
+}
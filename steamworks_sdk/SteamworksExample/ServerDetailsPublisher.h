@@ -0,0 +1,112 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Publishes a server's details to Steam, only calling the
+//			ISteamGameServer setters for what has changed
+//
+//=============================================================================
+
+#ifndef SERVERDETAILSPUBLISHER_H
+#define SERVERDETAILSPUBLISHER_H
+
+#include <map>
+#include <string>
+
+class ISteamGameServer;
+
+// What a publisher has done since it was last reset
+struct ServerDetailsPublisherStats_t
+{
+	uint64 m_cFlushes;				// Times we published whatever had changed
+	uint64 m_cRequested;			// Values we were given to publish
+	uint64 m_cPublished;			// Setter calls we made into Steam
+
+	// Values that never needed a call, because they hadn't changed or a newer one replaced them first
+	uint64 GetAvoidedCount() const { return m_cRequested > m_cPublished ? m_cRequested - m_cPublished : 0; }
+
+	void Reset() { m_cFlushes = 0; m_cRequested = 0; m_cPublished = 0; }
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Holds the details a server wants Steam to have, and what Steam was
+//			last told.  Setting a value only notes it, Flush() then makes a
+//			setter call for each value that differs from what was published,
+//			so any number of changes between flushes cost at most one call.
+//			Players' details are given for everyone on the server before each
+//			flush, anyone not given since the last one has left and is
+//			forgotten.  Not thread safe.
+//-----------------------------------------------------------------------------
+class CServerDetailsPublisher
+{
+public:
+	CServerDetailsPublisher();
+
+	// How long to leave between flushes, see BIsFlushDue()
+	void SetFlushInterval( uint32 unMilliseconds ) { m_unFlushIntervalMilliseconds = unMilliseconds; }
+	uint32 GetFlushInterval() const { return m_unFlushIntervalMilliseconds; }
+
+	// Whether it's been the flush interval since we last flushed.  Callers needn't gather
+	// their details any more often than this.
+	bool BIsFlushDue( uint64 ulTickCount ) const { return !m_cFlushes || ulTickCount - m_ulLastFlushTick >= m_unFlushIntervalMilliseconds; }
+
+	void SetMaxPlayerCount( int cPlayersMax );
+	void SetPasswordProtected( bool bPasswordProtected );
+	void SetServerName( const char *pchServerName );
+	void SetBotPlayerCount( int cBotPlayers );
+	void SetMapName( const char *pchMapName );
+	void SetUserData( CSteamID steamIDUser, const char *pchPlayerName, uint32 uScore );
+
+	// Make the setter calls for everything that's changed.  Nothing is published without a
+	// pGameServer, it all waits for the next flush.
+	void Flush( ISteamGameServer *pGameServer, uint64 ulTickCount );
+
+	// Forget what we've published, so the next flush sends everything.  For when Steam may
+	// not have it any more, like after logging on again.
+	void RepublishAll();
+
+	const ServerDetailsPublisherStats_t &GetStats() const { return m_Stats; }
+	void ResetStats() { m_Stats.Reset(); }
+
+private:
+	//-----------------------------------------------------------------------------
+	// Purpose: A value as it was last published and as it is now
+	//-----------------------------------------------------------------------------
+	template < class T >
+	struct PublishedValue_t
+	{
+		PublishedValue_t() : m_Value(), m_PublishedValue(), m_bSet( false ), m_bPublished( false ) {}
+
+		void Set( const T &value ) { m_Value = value; m_bSet = true; }
+		bool BNeedsPublishing() const { return m_bSet && ( !m_bPublished || !( m_Value == m_PublishedValue ) ); }
+		void OnPublished() { m_PublishedValue = m_Value; m_bPublished = true; }
+
+		T m_Value;
+		T m_PublishedValue;
+		bool m_bSet;
+		bool m_bPublished;
+	};
+
+	struct UserDetails_t
+	{
+		PublishedValue_t< std::string > m_Name;
+		PublishedValue_t< uint32 > m_Score;
+		uint32 m_unLastSetFlush;	// Flush count when they were last given, so we can tell who's left
+	};
+
+	uint32 m_unFlushIntervalMilliseconds;
+	uint64 m_ulLastFlushTick;
+	uint32 m_cFlushes;
+
+	PublishedValue_t< int > m_MaxPlayerCount;
+	PublishedValue_t< bool > m_PasswordProtected;
+	PublishedValue_t< std::string > m_ServerName;
+	PublishedValue_t< int > m_BotPlayerCount;
+	PublishedValue_t< std::string > m_MapName;
+
+	// Every player we were given since the last flush, or have published, by Steam ID
+	std::map< uint64, UserDetails_t > m_mapUsers;
+
+	ServerDetailsPublisherStats_t m_Stats;
+};
+
+#endif // SERVERDETAILSPUBLISHER_H
@@ -10,24 +10,92 @@
 #include "Ship.h"
 #include "stdlib.h"
 #include "SpaceWarServer.h"
+#include "CollisionGrid.h"
 #include "StatsAndAchievements.h"
 #include "Inventory.h"
 #include <math.h>
 #include <string.h>
 
+// Geometry shared by every ship, its thrusters and its debris.  None of it depends on the ship, other
+// than the color it's drawn in, so it's built once here rather than for every ship and every explosion.
+static const VectorEntityVertex_t s_rgForwardThrusterVertexes[] =
+{
+	VECTORENTITY_LINE( 0.0, 12.0f, 0.0f, 19.0f ),
+	VECTORENTITY_LINE( 1.0, 12.0f, 6.0f, 19.0f ),
+	VECTORENTITY_LINE( 4.0, 12.0f, 11.0f, 19.0f ),
+	VECTORENTITY_LINE( -1.0, 12.0f, -6.0f, 19.0f ),
+	VECTORENTITY_LINE( -4.0, 12.0f, -11.0f, 19.0f ),
+};
+
+static const VectorEntityVertex_t s_rgReverseThrusterVertexes[] =
+{
+	VECTORENTITY_LINE( -8.875, 10.5f, -14.85f, 10.5f ),
+	VECTORENTITY_LINE( -8.875, 10.5f, -13.765f, 5.61f ),
+	VECTORENTITY_LINE( -8.875, 10.5f, -7.85f, 3.5f ),
+
+	VECTORENTITY_LINE( 8.875, 10.5f, 14.85f, 10.5f ),
+	VECTORENTITY_LINE( 8.875, 10.5f, 13.765f, 5.61f ),
+	VECTORENTITY_LINE( 8.875, 10.5f, 7.85f, 3.5f ),
+};
+
+static const VectorEntityVertex_t s_rgShipDebrisVertexes[] =
+{
+	VECTORENTITY_LINE( 0.0f, 0.0f, 16.0f, 0.0f ),
+};
+
+// The hull every ship has
+#define SHIP_HULL_LINES \
+	VECTORENTITY_LINE( -9.0f, 12.0f, 0.0f, -12.0f ), \
+	VECTORENTITY_LINE( 0.0f, -12.0f, 9.0f, 12.0f ), \
+	VECTORENTITY_LINE( 9.0f, 12.0f, -9.0f, 12.0f )
+
+static const VectorEntityVertex_t s_rgShipVertexes[] =
+{
+	SHIP_HULL_LINES,
+};
+
+static const VectorEntityVertex_t s_rgShipDecoration1Vertexes[] =
+{
+	SHIP_HULL_LINES,
+	VECTORENTITY_LINE( 0.0f, -12.0f, -0.0f, 12.0f ),
+	VECTORENTITY_LINE( 4.5f, 0.0f, -4.5f, 0.0f ),
+};
+
+static const VectorEntityVertex_t s_rgShipDecoration2Vertexes[] =
+{
+	SHIP_HULL_LINES,
+	VECTORENTITY_LINE( 0.0f, -12.0f, -0.0f, 12.0f ),
+	VECTORENTITY_LINE( 4.5f, 0.0f, -4.5f, 0.0f ),
+	VECTORENTITY_LINE( 2.5f, -6.0f, -9.0f, 12.0f ),
+	VECTORENTITY_LINE( 9.0f, 12.0f, -2.5f, -6.0f ),
+};
+
+static const VectorEntityVertex_t s_rgShipDecoration3Vertexes[] =
+{
+	SHIP_HULL_LINES,
+	VECTORENTITY_LINE( 0.0f, -12.0f, 0.0f, 12.0f ),
+	VECTORENTITY_LINE( 2.0f, -8.0f, 2.0f, 12.0f ),
+	VECTORENTITY_LINE( -2.0f, -8.0f, -2.0f, 12.0f ),
+};
+
+static const VectorEntityVertex_t s_rgShipDecoration4Vertexes[] =
+{
+	SHIP_HULL_LINES,
+	VECTORENTITY_LINE( -12.0,  12.0f, -3.0f,-12.0f ),
+	VECTORENTITY_LINE( -17.0f,  4.0f,-11.0f,-10.0f ),
+	VECTORENTITY_LINE( -17.0f,  4.0f,-10.0f, 7.0f ),
+	VECTORENTITY_LINE( -11.0f,-10.0f, -3.0f,-7.0f ),
+};
+
 //-----------------------------------------------------------------------------
 // Purpose: Constructor for thrusters
 //-----------------------------------------------------------------------------
-CForwardThrusters::CForwardThrusters( IGameEngine *pGameEngine, CShip *pShip ) : CVectorEntity( pGameEngine, 0 )
+CForwardThrusters::CForwardThrusters( IGameEngine *pGameEngine, CShip *pShip, CVectorEntityStatePool *pStatePool ) : CVectorEntity( pGameEngine, 0, pStatePool )
 {
 	DWORD dwColor = D3DCOLOR_ARGB( 255, 255, 255, 102 );
 
 	// Initialize our geometry
-	AddLine( 0.0, 12.0f, 0.0f, 19.0f, dwColor );
-	AddLine( 1.0, 12.0f, 6.0f, 19.0f, dwColor );
-	AddLine( 4.0, 12.0f, 11.0f, 19.0f, dwColor );
-	AddLine( -1.0, 12.0f, -6.0f, 19.0f, dwColor );
-	AddLine( -4.0, 12.0f, -11.0f, 19.0f, dwColor );
+	SetSharedGeometry( s_rgForwardThrusterVertexes, V_ARRAYSIZE( s_rgForwardThrusterVertexes ), dwColor );
 
 	m_pShip = pShip;
 }
@@ -48,18 +116,12 @@ void CForwardThrusters::RunFrame()
 //-----------------------------------------------------------------------------
 // Purpose: Constructor for reverse thrusters
 //-----------------------------------------------------------------------------
-CReverseThrusters::CReverseThrusters( IGameEngine *pGameEngine, CShip *pShip ) : CVectorEntity( pGameEngine, 0 )
+CReverseThrusters::CReverseThrusters( IGameEngine *pGameEngine, CShip *pShip, CVectorEntityStatePool *pStatePool ) : CVectorEntity( pGameEngine, 0, pStatePool )
 {
 	DWORD dwColor = D3DCOLOR_ARGB( 255, 255, 255, 102 );
 
 	// Initialize our geometry
-	AddLine( -8.875, 10.5f, -14.85f, 10.5f, dwColor );
-	AddLine( -8.875, 10.5f, -13.765f, 5.61f, dwColor );
-	AddLine( -8.875, 10.5f, -7.85f, 3.5f, dwColor );
-
-	AddLine( 8.875, 10.5f, 14.85f, 10.5f, dwColor );
-	AddLine( 8.875, 10.5f, 13.765f, 5.61f, dwColor );
-	AddLine( 8.875, 10.5f, 7.85f, 3.5f, dwColor );
+	SetSharedGeometry( s_rgReverseThrusterVertexes, V_ARRAYSIZE( s_rgReverseThrusterVertexes ), dwColor );
 
 	m_pShip = pShip;
 }
@@ -80,9 +142,9 @@ void CReverseThrusters::RunFrame()
 //-----------------------------------------------------------------------------
 // Purpose: Constructor for ship debris after explosion
 //-----------------------------------------------------------------------------
-CShipDebris::CShipDebris( IGameEngine *pGameEngine, float xPos, float yPos, DWORD dwDebrisColor ) : CSpaceWarEntity( pGameEngine, 0, true )
+CShipDebris::CShipDebris( IGameEngine *pGameEngine, float xPos, float yPos, DWORD dwDebrisColor, CVectorEntityStatePool *pStatePool ) : CSpaceWarEntity( pGameEngine, 0, true, pStatePool )
 {
-	AddLine( 0.0f, 0.0f, 16.0f, 0.0f, dwDebrisColor );
+	SetSharedGeometry( s_rgShipDebrisVertexes, V_ARRAYSIZE( s_rgShipDebrisVertexes ), dwDebrisColor );
 
 	// Random rotation between 0 and 360 degrees (6.28 radians)
 	float flRotation = (float)(rand()%628)/100.0f;
@@ -128,12 +190,13 @@ void CShipDebris::RunFrame()
 //  warning C4355: 'this' : used in base member initializer list
 //  This is OK because the thruster classes won't use the ship object in their constructors (where it may still be only partly constructed)
 #pragma warning( disable : 4355 ) 
-CShip::CShip( IGameEngine *pGameEngine, bool bIsServerInstance, float xPos, float yPos, DWORD dwShipColor ) : 
-	CSpaceWarEntity( pGameEngine, 11, true ), m_ForwardThrusters( pGameEngine, this ), m_ReverseThrusters( pGameEngine, this )
+CShip::CShip( IGameEngine *pGameEngine, bool bIsServerInstance, float xPos, float yPos, DWORD dwShipColor, CVectorEntityStatePool *pStatePool ) : 
+	CSpaceWarEntity( pGameEngine, 11, true, pStatePool ), m_ForwardThrusters( pGameEngine, this, pStatePool ), m_ReverseThrusters( pGameEngine, this, pStatePool )
 {
 	m_bDisabled = false;
 	m_bExploding = false;
-	m_ulLastThrustStartedTickCount = 0;
+	m_unThrustSteps = 0;
+	m_unInputSteps = 0;
 	m_dwVKLeft = 0;
 	m_dwVKRight = 0;
 	m_nFade = 255;
@@ -162,6 +225,11 @@ CShip::CShip( IGameEngine *pGameEngine, bool bIsServerInstance, float xPos, floa
 		m_rgPhotonBeams[i] = NULL;
 	}
 
+	for( int i=0; i < SHIP_DEBRIS_PIECES; ++i )
+	{
+		m_rgpDebris[i] = NULL;
+	}
+
 	BuildGeometry();
 
 	SetPosition( xPos, yPos );
@@ -173,35 +241,22 @@ CShip::CShip( IGameEngine *pGameEngine, bool bIsServerInstance, float xPos, floa
 
 void CShip::BuildGeometry()
 {
-	ClearVertexes();
-
-	// Initialize our geometry
-	AddLine( -9.0f, 12.0f, 0.0f, -12.0f, m_dwShipColor );
-	AddLine( 0.0f, -12.0f, 9.0f, 12.0f, m_dwShipColor );
-	AddLine( 9.0f, 12.0f, -9.0f, 12.0f, m_dwShipColor );
-
 	switch ( m_nShipDecoration )
 	{
 	case 1:
-		AddLine( 0.0f, -12.0f, -0.0f, 12.0f, m_dwShipColor );
-		AddLine( 4.5f, 0.0f, -4.5f, 0.0f, m_dwShipColor );
+		SetSharedGeometry( s_rgShipDecoration1Vertexes, V_ARRAYSIZE( s_rgShipDecoration1Vertexes ), m_dwShipColor );
 		break;
 	case 2:
-		AddLine( 0.0f, -12.0f, -0.0f, 12.0f, m_dwShipColor );
-		AddLine( 4.5f, 0.0f, -4.5f, 0.0f, m_dwShipColor );
-		AddLine( 2.5f, -6.0f, -9.0f, 12.0f, m_dwShipColor );
-		AddLine( 9.0f, 12.0f, -2.5f, -6.0f, m_dwShipColor );
+		SetSharedGeometry( s_rgShipDecoration2Vertexes, V_ARRAYSIZE( s_rgShipDecoration2Vertexes ), m_dwShipColor );
 		break;
 	case 3:
-		AddLine( 0.0f, -12.0f, 0.0f, 12.0f, m_dwShipColor );
-		AddLine( 2.0f, -8.0f, 2.0f, 12.0f, m_dwShipColor );
-		AddLine( -2.0f, -8.0f, -2.0f, 12.0f, m_dwShipColor );
+		SetSharedGeometry( s_rgShipDecoration3Vertexes, V_ARRAYSIZE( s_rgShipDecoration3Vertexes ), m_dwShipColor );
 		break;
 	case 4:
-		AddLine( -12.0,  12.0f, -3.0f,-12.0f, m_dwShipColor );
-		AddLine( -17.0f,  4.0f,-11.0f,-10.0f, m_dwShipColor );
-		AddLine( -17.0f,  4.0f,-10.0f, 7.0f, m_dwShipColor );
-		AddLine( -11.0f,-10.0f, -3.0f,-7.0f, m_dwShipColor );
+		SetSharedGeometry( s_rgShipDecoration4Vertexes, V_ARRAYSIZE( s_rgShipDecoration4Vertexes ), m_dwShipColor );
+		break;
+	default:
+		SetSharedGeometry( s_rgShipVertexes, V_ARRAYSIZE( s_rgShipVertexes ), m_dwShipColor );
 		break;
 	}
 }
@@ -212,23 +267,13 @@ void CShip::BuildGeometry()
 CShip::~CShip() 
 {
 	// Cleanup beams
+	for( int i=0; i < MAX_PHOTON_BEAMS_PER_SHIP; ++i )
 	{
-		for( int i=0; i < MAX_PHOTON_BEAMS_PER_SHIP; ++i )
-		{
-			if ( m_rgPhotonBeams[i] )
-				delete m_rgPhotonBeams[i];
-		}
+		DestroyPhotonBeam( i );
 	}
 
 	// Cleanup debris
-	{
-		std::list<CShipDebris *>::iterator iter;
-		for ( iter = m_ListDebris.begin(); iter != m_ListDebris.end(); ++iter )
-		{
-			delete (*iter);
-		}
-		m_ListDebris.clear();
-	}
+	DestroyDebris();
 
 	// Restore Controller Color
 	m_pGameEngine->SetControllerColor( 0, 0, 0, k_ESteamControllerLEDFlag_RestoreUserDefault );
@@ -282,10 +327,10 @@ void CShip::OnReceiveServerUpdate( ServerShipUpdateData_t *pUpdateData )
 		{
 			if ( !m_rgPhotonBeams[i] )
 			{
-				m_rgPhotonBeams[i] = new CPhotonBeam( m_pGameEngine, 
+				m_rgPhotonBeams[i] = new ( m_PhotonBeamPool.Alloc() ) CPhotonBeam( m_pGameEngine, 
 					pPhotonUpdate->GetXPosition(), pPhotonUpdate->GetYPosition(), 
 					m_dwShipColor, pPhotonUpdate->GetRotation(), 
-					pPhotonUpdate->GetXVelocity(), pPhotonUpdate->GetYVelocity() );
+					pPhotonUpdate->GetXVelocity(), pPhotonUpdate->GetYVelocity(), GetStatePool() );
 			}
 			else
 			{
@@ -294,11 +339,7 @@ void CShip::OnReceiveServerUpdate( ServerShipUpdateData_t *pUpdateData )
 		}
 		else
 		{
-			if ( m_rgPhotonBeams[i] )
-			{
-				delete m_rgPhotonBeams[i];
-				m_rgPhotonBeams[i] = NULL;
-			}
+			DestroyPhotonBeam( i );
 		}
 	}
 }
@@ -321,6 +362,65 @@ void CShip::OnReceiveClientUpdate( ClientSpaceWarUpdateData_t *pUpdateData )
 	m_nShipShieldStrength = pUpdateData->GetShieldStrength();
 
 	memcpy( &m_SpaceWarClientUpdateData, pUpdateData, sizeof( ClientSpaceWarUpdateData_t ) );
+	m_unInputSteps = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Put a server side ship back to where an update from the server had
+//			it.  Everything else a step depends on is worked out fresh each step.
+//-----------------------------------------------------------------------------
+void CShip::RewindToServerUpdate( ServerShipUpdateData_t *pUpdateData )
+{
+	if ( !m_bIsServerInstance )
+	{
+		OutputDebugString( "Only server instances can be rewound, client ships just take server updates\n" );
+		return;
+	}
+
+	SetPosition( pUpdateData->GetXPosition()*m_pGameEngine->GetViewportWidth(), pUpdateData->GetYPosition()*m_pGameEngine->GetViewportHeight() );
+	SetVelocity( pUpdateData->GetXVelocity(), pUpdateData->GetYVelocity() );
+	SetAccumulatedRotation( pUpdateData->GetRotation() );
+	m_unThrustSteps = pUpdateData->GetThrustSteps();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Move the ship to where a ship predicting it has got to
+//-----------------------------------------------------------------------------
+void CShip::CopyPredictedState( CShip *pPredictedShip )
+{
+	SetPosition( pPredictedShip->GetXPos(), pPredictedShip->GetYPos() );
+	SetVelocity( pPredictedShip->GetXVelocity(), pPredictedShip->GetYVelocity() );
+	SetAccumulatedRotation( pPredictedShip->GetAccumulatedRotation() );
+	m_bForwardThrustersActive = pPredictedShip->m_bForwardThrustersActive;
+	m_bReverseThrustersActive = pPredictedShip->m_bReverseThrustersActive;
+
+	// Bring the thrusters along, they just follow the ship so this doesn't move them any further
+	UpdateThrusters();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Move the ship to a state between two server updates
+//-----------------------------------------------------------------------------
+void CShip::SetInterpolatedState( float flXPos, float flYPos, float flXVelocity, float flYVelocity, float flRotation )
+{
+	SetPosition( flXPos, flYPos );
+	SetVelocity( flXVelocity, flYVelocity );
+	SetAccumulatedRotation( flRotation );
+
+	UpdateThrusters();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Move the thrusters to the ship
+//-----------------------------------------------------------------------------
+void CShip::UpdateThrusters()
+{
+	m_ForwardThrusters.RunFrame();
+	m_ReverseThrusters.RunFrame();
 }
 
 
@@ -377,10 +477,7 @@ void CShip::RunFrame()
 		if ( m_rgPhotonBeams[i] )
 		{
 			if ( m_rgPhotonBeams[i]->BIsBeamExpired() )
-			{
-				delete m_rgPhotonBeams[i];
-				m_rgPhotonBeams[i] = NULL;
-			}
+				DestroyPhotonBeam( i );
 		}
 
 		if ( !m_rgPhotonBeams[i] && nNextAvailablePhotonBeamSlot == -1 )
@@ -395,10 +492,10 @@ void CShip::RunFrame()
 	}
 
 	// run all the space debris
+	for( int i=0; i < SHIP_DEBRIS_PIECES; ++i )
 	{
-		std::list<CShipDebris *>::iterator iter;
-		for( iter = m_ListDebris.begin(); iter != m_ListDebris.end(); ++iter )
-			(*iter)->RunFrame();
+		if ( m_rgpDebris[i] )
+			m_rgpDebris[i]->RunFrame();
 	}
 
 	if ( m_bIsLocalPlayer )
@@ -435,7 +532,10 @@ void CShip::RunFrame()
 	}
 	else if ( m_bIsServerInstance )
 	{
-		// Server side
+		// Server side, each frame is one simulation step run with the client's latest input
+		if ( m_unInputSteps < SHIP_INPUT_STEPS_MAX )
+			++m_unInputSteps;
+
 		const float fMaxTurnSpeed = (PI_VALUE / 2.0f) * (float)m_pGameEngine->GetGameTicksFrameDelta( ) / 400.0f;
 
 		float flRotationDelta = 0.0f;
@@ -510,6 +610,7 @@ void CShip::RunFrame()
 			m_pGameEngine->DeactivateSteamControllerActionSetLayer( eControllerActionSet_Layer_Thrust );
 		}
 
+#ifndef DEDICATED_SERVER
 		// Hardcoded keys to choose various outfits and weapon powerups which require inventory. Note that this is not
 		// a "secure" multiplayer model - clients can lie about what they own. A more robust solution, if your items
 		// matter enough to bother, would be to use SerializeResult / DeserializeResult to encode the fact that your
@@ -555,6 +656,7 @@ void CShip::RunFrame()
 		{
 			m_nShipPower = 2;
 		}
+#endif
 	}
 	else if ( m_bIsServerInstance )
 	{
@@ -582,21 +684,21 @@ void CShip::RunFrame()
 				flSign = fThrusterLevel;
 			}
 
-			if ( m_ulLastThrustStartedTickCount == 0 )
-			{
-				m_ulLastThrustStartedTickCount = ulCurrentTickCount;
+			if ( m_unThrustSteps == 0 )
 				m_pGameEngine->TriggerControllerHaptics( k_ESteamControllerPad_Left, 2900, 1200, 4 );
-			}
 
-			// You have to hold the key for a second to reach maximum thrust
-			float factor = MIN( ((float)(ulCurrentTickCount - m_ulLastThrustStartedTickCount) / 500.0f) + 0.2f, 1.0f );
+			// You have to hold the key for a bit to reach maximum thrust.  This counts steps rather
+			// than time so a client replaying our inputs ramps up exactly the same.
+			float factor = MIN( ((float)(m_unThrustSteps * SIMULATION_STEP_MILLISECONDS) / 500.0f) + 0.2f, 1.0f );
+			if ( m_unThrustSteps < SHIP_THRUST_RAMP_STEPS )
+				++m_unThrustSteps;
 
 			xThrust = flSign * (float)(MAXIMUM_SHIP_THRUST * factor * sin( GetAccumulatedRotation() ) );
 			yThrust = flSign * -1.0f * (float)(MAXIMUM_SHIP_THRUST * factor * cos( GetAccumulatedRotation() ) );
 		}
 		else
 		{
-			m_ulLastThrustStartedTickCount = 0;
+			m_unThrustSteps = 0;
 		}
 
 		SetAcceleration( xThrust, yThrust );
@@ -638,7 +740,7 @@ void CShip::RunFrame()
 				float xPos = GetXPos() - sinvalue1*-12.0f;
 				float yPos = GetYPos() + cosvalue1*-12.0f;
 
-				m_rgPhotonBeams[nNextAvailablePhotonBeamSlot] = new CPhotonBeam( m_pGameEngine, xPos, yPos, m_dwShipColor, GetAccumulatedRotation(), xVelocity, yVelocity );
+				m_rgPhotonBeams[nNextAvailablePhotonBeamSlot] = new ( m_PhotonBeamPool.Alloc() ) CPhotonBeam( m_pGameEngine, xPos, yPos, m_dwShipColor, GetAccumulatedRotation(), xVelocity, yVelocity, GetStatePool() );
 
 				nNextAvailablePhotonBeamSlot = -1;  // Track next available slot for use spawning new beams below
 				for( int i=0; i < MAX_PHOTON_BEAMS_PER_SHIP; ++i )
@@ -656,7 +758,7 @@ void CShip::RunFrame()
 					xPos = GetXPos() - sinvalue2*-12.0f;
 					yPos = GetYPos() + cosvalue2*-12.0f;
 
-					m_rgPhotonBeams[nNextAvailablePhotonBeamSlot] = new CPhotonBeam( m_pGameEngine, xPos, yPos, m_dwShipColor, GetAccumulatedRotation(), xVelocity, yVelocity );
+					m_rgPhotonBeams[nNextAvailablePhotonBeamSlot] = new ( m_PhotonBeamPool.Alloc() ) CPhotonBeam( m_pGameEngine, xPos, yPos, m_dwShipColor, GetAccumulatedRotation(), xVelocity, yVelocity, GetStatePool() );
 					m_pGameEngine->TriggerControllerHaptics( k_ESteamControllerPad_Right, 1000, 1500, 2 );
 				}
 			}
@@ -674,7 +776,7 @@ void CShip::RunFrame()
 				float xPos = GetXPos() - sinvalue*-12.0f;
 				float yPos = GetYPos() + cosvalue*-12.0f;
 
-				m_rgPhotonBeams[nNextAvailablePhotonBeamSlot] = new CPhotonBeam( m_pGameEngine, xPos, yPos, m_dwShipColor, GetAccumulatedRotation(), xVelocity, yVelocity );
+				m_rgPhotonBeams[nNextAvailablePhotonBeamSlot] = new ( m_PhotonBeamPool.Alloc() ) CPhotonBeam( m_pGameEngine, xPos, yPos, m_dwShipColor, GetAccumulatedRotation(), xVelocity, yVelocity, GetStatePool() );
 				m_pGameEngine->TriggerControllerHaptics( k_ESteamControllerPad_Right, 1200, 2500, 3 );
 			}
 		}
@@ -682,9 +784,10 @@ void CShip::RunFrame()
 
 	CSpaceWarEntity::RunFrame();
 
-	// Finally, update the thrusters ( we do this after the base class call as they rely on our data being fully up-to-date)
-	m_ForwardThrusters.RunFrame();
-	m_ReverseThrusters.RunFrame();
+	// Finally, update the thrusters ( we do this after the base class call as they rely on our data being fully up-to-date).
+	// If we haven't moved yet our owner does it after integrating the batch.
+	if ( !GetStatePool()->BIsBatchIntegrated() )
+		UpdateThrusters();
 }
 
 
@@ -712,9 +815,11 @@ void CShip::Render()
 	if ( m_bExploding )
 	{
 		// Don't draw actual ship, instead draw the pieces created in the explosion
-		std::list<CShipDebris *>::iterator iter;
-		for ( iter = m_ListDebris.begin(); iter != m_ListDebris.end(); ++iter )
-			( *iter )->Render();
+		for ( int i = 0; i < SHIP_DEBRIS_PIECES; ++i )
+		{
+			if ( m_rgpDebris[i] )
+				m_rgpDebris[i]->Render();
+		}
 		return;
 	}
 
@@ -818,6 +923,30 @@ void CShip::UpdateVibrationEffects()
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Set whether the ship is disabled
+//-----------------------------------------------------------------------------
+void CShip::SetDisabled( bool bDisabled )
+{
+	m_bDisabled = bDisabled;
+
+	// A disabled ship doesn't run frames, so nothing it owns should move either
+	SetIntegrationPaused( bDisabled );
+	m_ForwardThrusters.SetIntegrationPaused( bDisabled );
+	m_ReverseThrusters.SetIntegrationPaused( bDisabled );
+	for( int i=0; i < MAX_PHOTON_BEAMS_PER_SHIP; ++i )
+	{
+		if ( m_rgPhotonBeams[i] )
+			m_rgPhotonBeams[i]->SetIntegrationPaused( bDisabled );
+	}
+	for( int i=0; i < SHIP_DEBRIS_PIECES; ++i )
+	{
+		if ( m_rgpDebris[i] )
+			m_rgpDebris[i]->SetIntegrationPaused( bDisabled );
+	}
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Set whether the ship is exploding
 //-----------------------------------------------------------------------------
@@ -842,18 +971,14 @@ void CShip::SetExploding( bool bExploding )
 
 		for( int i = 0; i < SHIP_DEBRIS_PIECES; ++i )
 		{
-			CShipDebris * pDebris = new CShipDebris( m_pGameEngine, GetXPos(), GetYPos(), m_dwShipColor );
-			m_ListDebris.push_back( pDebris );
+			m_rgpDebris[i] = new ( m_DebrisPool.Alloc() ) CShipDebris( m_pGameEngine, GetXPos(), GetYPos(), m_dwShipColor, GetStatePool() );
 		}
 	}
 	else
 	{
 		m_ulExplosionTickCount = 0;
 
-		std::list<CShipDebris *>::iterator iter;
-		for( iter = m_ListDebris.begin(); iter != m_ListDebris.end(); ++iter )
-			delete *iter;
-		m_ListDebris.clear();
+		DestroyDebris();
 	}
 
 	UpdateVibrationEffects();
@@ -865,38 +990,98 @@ void CShip::SetExploding( bool bExploding )
 //-----------------------------------------------------------------------------
 void CShip::DestroyPhotonsColldingWith( CVectorEntity *pTarget )
 {
-	for( int i=0; i < MAX_PHOTON_BEAMS_PER_SHIP; ++i )
+	uint32 unHits = GetPhotonBeamsCollidingWith( pTarget );
+	for( int i=0; unHits; ++i, unHits >>= 1 )
 	{
-		if ( !m_rgPhotonBeams[i] )
-			continue;
-
-		if ( m_rgPhotonBeams[i]->BCollidesWith( pTarget ) )
+		if ( unHits & 1 )
 		{
 			// Photon beam hit the entity, destroy beam
-			delete m_rgPhotonBeams[i];
-			m_rgPhotonBeams[i] = NULL;
+			DestroyPhotonBeam( i );
 		}
 	}
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Destroy one of our photon beams, if it exists
+//-----------------------------------------------------------------------------
+void CShip::DestroyPhotonBeam( int iBeam )
+{
+	m_PhotonBeamPool.Free( m_rgPhotonBeams[iBeam] );
+	m_rgPhotonBeams[iBeam] = NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destroy the debris from our explosion
+//-----------------------------------------------------------------------------
+void CShip::DestroyDebris()
+{
+	for( int i = 0; i < SHIP_DEBRIS_PIECES; ++i )
+	{
+		m_DebrisPool.Free( m_rgpDebris[i] );
+		m_rgpDebris[i] = NULL;
+	}
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Check whether any of the photons this ship has fired are colliding with the target 
 //-----------------------------------------------------------------------------
 bool CShip::BCheckForPhotonsCollidingWith( CVectorEntity *pTarget )
 {
+	return GetPhotonBeamsCollidingWith( pTarget ) != 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Test all of our photon beams against the target in one batch
+//-----------------------------------------------------------------------------
+uint32 CShip::GetPhotonBeamsCollidingWith( CVectorEntity *pTarget )
+{
+	static_assert( MAX_PHOTON_BEAMS_PER_SHIP <= COLLISION_BATCH_MAX, "Photon beams don't fit in one collision batch" );
+
+	float rgflXPos[MAX_PHOTON_BEAMS_PER_SHIP];
+	float rgflYPos[MAX_PHOTON_BEAMS_PER_SHIP];
+	float rgflRadius[MAX_PHOTON_BEAMS_PER_SHIP];
+	bool bAnyBeams = false;
 	for( int i=0; i < MAX_PHOTON_BEAMS_PER_SHIP; ++i )
 	{
-		if ( !m_rgPhotonBeams[i] )
-			continue;
-
-		if ( m_rgPhotonBeams[i]->BCollidesWith( pTarget ) )
+		if ( m_rgPhotonBeams[i] )
+		{
+			m_rgPhotonBeams[i]->GetCollisionCircle( &rgflXPos[i], &rgflYPos[i], &rgflRadius[i] );
+			bAnyBeams = true;
+		}
+		else
 		{
-			return true;
+			// Empty slots never hit
+			rgflXPos[i] = 0.0f;
+			rgflYPos[i] = 0.0f;
+			rgflRadius[i] = COLLISION_RADIUS_DISABLED;
 		}
 	}
 
-	return false;
+	if ( !bAnyBeams )
+		return 0;
+
+	float xPos, yPos, flRadius;
+	pTarget->GetCollisionCircle( &xPos, &yPos, &flRadius );
+	return CollideCircleBatch( xPos, yPos, flRadius, rgflXPos, rgflYPos, rgflRadius, MAX_PHOTON_BEAMS_PER_SHIP );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Place the ship and its photon beams in a collision grid
+//-----------------------------------------------------------------------------
+void CShip::UpdateCollisionGrid( CCollisionGrid *pGrid, uint32 unOwner )
+{
+	pGrid->UpdateEntity( this, unOwner );
+
+	for( int i=0; i < MAX_PHOTON_BEAMS_PER_SHIP; ++i )
+	{
+		if ( m_rgPhotonBeams[i] )
+			pGrid->UpdateEntity( m_rgPhotonBeams[i], unOwner );
+	}
 }
 
 
@@ -922,6 +1107,9 @@ void CShip::BuildServerUpdate( ServerShipUpdateData_t *pUpdateData )
 	pUpdateData->SetWeapon( m_nShipWeapon );
 	pUpdateData->SetPower( m_nShipPower );
 	pUpdateData->SetShieldStrength( m_nShipShieldStrength );
+	pUpdateData->SetInputSequence( m_SpaceWarClientUpdateData.GetInputSequence() );
+	pUpdateData->SetInputSteps( m_unInputSteps );
+	pUpdateData->SetThrustSteps( m_unThrustSteps );
 
 	BuildServerPhotonBeamUpdate( pUpdateData );
 }
@@ -956,8 +1144,11 @@ void CShip::BuildServerPhotonBeamUpdate( ServerShipUpdateData_t *pUpdateData )
 //-----------------------------------------------------------------------------
 void CShip::AccumulateStats( CStatsAndAchievements *pStats )
 {
+	// The dedicated server has no local player, or stats to give them
+#ifndef DEDICATED_SERVER
 	if ( m_bIsLocalPlayer )
 	{
 		pStats->AddDistanceTraveled( GetDistanceTraveledLastFrame() );
 	}
+#endif
 }
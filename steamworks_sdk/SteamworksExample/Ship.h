@@ -8,26 +8,31 @@
 #ifndef SHIP_H
 #define SHIP_H
 
-#include <list>
 #include "GameEngine.h"
 #include "SpaceWarEntity.h"
 #include "PhotonBeam.h"
+#include "EntityPool.h"
 #include "SpaceWar.h"
 
 #define MAXIMUM_SHIP_THRUST 150
 
 #define SHIP_DEBRIS_PIECES 6
 
+// Most state pool slots one ship can hold at once: the ship, its two thrusters, a full set of
+// photon beams and its debris
+#define SHIP_STATE_POOL_SLOTS ( 3 + MAX_PHOTON_BEAMS_PER_SHIP + SHIP_DEBRIS_PIECES )
+
 // Forward declaration
 class CShip;
 class CSpaceWarServer;
+class CCollisionGrid;
 class CStatsAndAchievements;
 
 // Simple class for the ship thrusters
 class CForwardThrusters : public CVectorEntity
 {
 public:
-	CForwardThrusters( IGameEngine *pGameEngine, CShip *pShip );
+	CForwardThrusters( IGameEngine *pGameEngine, CShip *pShip, CVectorEntityStatePool *pStatePool );
 
 	// Run Frame
 	void RunFrame();
@@ -40,7 +45,7 @@ private:
 class CReverseThrusters : public CVectorEntity
 {
 public:
-	CReverseThrusters( IGameEngine *pGameEngine, CShip *pShip );
+	CReverseThrusters( IGameEngine *pGameEngine, CShip *pShip, CVectorEntityStatePool *pStatePool );
 
 	// Run Frame
 	void RunFrame();
@@ -53,7 +58,7 @@ private:
 class CShipDebris : public CSpaceWarEntity
 {
 public:
-	CShipDebris( IGameEngine *pGameEngine, float xPos, float yPos, DWORD dwDebrisColor );
+	CShipDebris( IGameEngine *pGameEngine, float xPos, float yPos, DWORD dwDebrisColor, CVectorEntityStatePool *pStatePool );
 
 	// Run Frame
 	void RunFrame();
@@ -66,8 +71,8 @@ private:
 class CShip : public CSpaceWarEntity
 {
 public:
-	// Constructor
-	CShip( IGameEngine *pGameEngine, bool bIsServerInstance, float xPos, float yPos, DWORD dwShipColor );
+	// Constructor, the ship, its thrusters, photon beams and debris all keep their state in pStatePool
+	CShip( IGameEngine *pGameEngine, bool bIsServerInstance, float xPos, float yPos, DWORD dwShipColor, CVectorEntityStatePool *pStatePool = NULL );
 
 	// Destructor
 	~CShip();
@@ -93,6 +98,23 @@ public:
 	// Build update data for photon beams to send to clients
 	void BuildServerPhotonBeamUpdate( ServerShipUpdateData_t *pUpdateData );
 
+	// Put a server side ship back to the state in an update from the server, so the inputs since
+	// can be replayed on top of it (see CShipPredictor)
+	void RewindToServerUpdate( ServerShipUpdateData_t *pUpdateData );
+
+	// Move a client side ship to where a ship predicting it has got to
+	void CopyPredictedState( CShip *pPredictedShip );
+
+	// Bring the thrusters to where the ship is, once it has been integrated.  RunFrame does this
+	// itself unless the ship's pool is batch integrated.
+	void UpdateThrusters();
+
+	// Move a client side ship to a state interpolated between server updates (see CSnapshotInterpolator)
+	void SetInterpolatedState( float flXPos, float flYPos, float flXVelocity, float flYVelocity, float flRotation );
+
+	// Sequence number of the newest client input the ship has
+	uint32 GetInputSequence() { return m_SpaceWarClientUpdateData.GetInputSequence(); }
+
 	// Reset vertex data for our object
 	void ResetVertexData();
 
@@ -103,7 +125,7 @@ public:
 	void BuildGeometry();
 
 	// Set whether the ship is disabled
-	void SetDisabled( bool bDisabled ) { m_bDisabled = bDisabled; }
+	void SetDisabled( bool bDisabled );
 
 	// Set the initial rotation for the ship
 	void SetInitialRotation( float flRotation ) { SetAccumulatedRotation( flRotation ); }
@@ -121,6 +143,9 @@ public:
 	// Check whether any of the photons this ship has fired are colliding with the target
 	bool BCheckForPhotonsCollidingWith( CVectorEntity *pTarget );
 
+	// Place the ship and its photon beams in a collision grid, tagged with the given owner
+	void UpdateCollisionGrid( CCollisionGrid *pGrid, uint32 unOwner );
+
 	// Check if the ship is currently exploding
 	bool BIsExploding() { return m_bExploding; }
 
@@ -146,11 +171,23 @@ public:
 
 private:
 
+	// Get a mask with bit i set if photon beam i is colliding with the target
+	uint32 GetPhotonBeamsCollidingWith( CVectorEntity *pTarget );
+
+	// Destroy photon beam i and give its slot back to the pool
+	void DestroyPhotonBeam( int iBeam );
+
+	// Destroy all the debris from an explosion
+	void DestroyDebris();
+
 	// Last time we sent an update on our local data to the server
 	uint64 m_ulLastClientUpdateTick;
 
-	// Last time we detected the thrust key go down
-	uint64 m_ulLastThrustStartedTickCount;
+	// Simulation steps the thrust key has been held for, up to SHIP_THRUST_RAMP_STEPS
+	uint32 m_unThrustSteps;
+
+	// Simulation steps run with the client input we have (server side), up to SHIP_INPUT_STEPS_MAX
+	uint32 m_unInputSteps;
 
 	// Last time we fired a photon
 	uint64 m_ulLastPhotonTickCount;
@@ -179,8 +216,12 @@ private:
 	// vector of beams we have fired (in order of firing time)
 	CPhotonBeam * m_rgPhotonBeams[MAX_PHOTON_BEAMS_PER_SHIP];
 
-	// vector of debris to draw after an explosion
-	std::list< CShipDebris *> m_ListDebris;
+	// debris to draw after an explosion, NULL when we aren't exploding
+	CShipDebris * m_rgpDebris[SHIP_DEBRIS_PIECES];
+
+	// Room for all the beams and debris we can have out at once, so firing and exploding don't allocate
+	CFixedEntityPool< CPhotonBeam, MAX_PHOTON_BEAMS_PER_SHIP > m_PhotonBeamPool;
+	CFixedEntityPool< CShipDebris, SHIP_DEBRIS_PIECES > m_DebrisPool;
 
 	// Color for this ship
 	DWORD m_dwShipColor;
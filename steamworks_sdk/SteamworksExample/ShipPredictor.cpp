@@ -0,0 +1,236 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Client side prediction of the local player's ship
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "ShipPredictor.h"
+#include "Ship.h"
+#include <math.h>
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Distance between two positions in pixels, the short way around the
+//			wrapping world
+//-----------------------------------------------------------------------------
+static float WrappedDistance( float flXPos0, float flYPos0, float flXPos1, float flYPos1, float flViewportWidth, float flViewportHeight )
+{
+	float flDeltaX = (float)fabs( flXPos1 - flXPos0 );
+	float flDeltaY = (float)fabs( flYPos1 - flYPos0 );
+	flDeltaX = MIN( flDeltaX, flViewportWidth - flDeltaX );
+	flDeltaY = MIN( flDeltaY, flViewportHeight - flDeltaY );
+	return (float)sqrt( flDeltaX * flDeltaX + flDeltaY * flDeltaY );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CShipPredictor::CShipPredictor( IGameEngine *pGameEngine )
+	: m_SimulationEngine( pGameEngine->GetViewportWidth(), pGameEngine->GetViewportHeight() )
+{
+	m_pGameEngine = pGameEngine;
+
+	// The predicted ship runs exactly the code the server's copy of our ship does
+	m_pShip = new CShip( &m_SimulationEngine, true, 0.0f, 0.0f, 0, &m_StatePool );
+
+	memset( m_rgInputs, 0, sizeof( m_rgInputs ) );
+	m_unInputSequence = 0;
+	m_unShipInputSequence = 0;
+	m_unFirstStep = 0;
+	m_unNextStep = 0;
+	m_bPredicting = false;
+
+	ResetMetrics();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor
+//-----------------------------------------------------------------------------
+CShipPredictor::~CShipPredictor()
+{
+	delete m_pShip;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Stop predicting until the server tells us where our ship is again
+//-----------------------------------------------------------------------------
+void CShipPredictor::Reset()
+{
+	m_bPredicting = false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Clear the metrics
+//-----------------------------------------------------------------------------
+void CShipPredictor::ResetMetrics()
+{
+	m_cUpdatesChecked = 0;
+	m_cCorrections = 0;
+	m_cResyncs = 0;
+	m_flTotalCorrectionDistance = 0.0f;
+	m_flMaxCorrectionDistance = 0.0f;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Number an input on its way to the server and remember it.  Firing
+//			isn't predicted, photon beams only appear when the server says so.
+//-----------------------------------------------------------------------------
+void CShipPredictor::OnSendInput( ClientSpaceWarUpdateData_t *pInput )
+{
+	// Zero is what a ship that hasn't had an input yet reports, never send it
+	if ( ++m_unInputSequence == 0 )
+		++m_unInputSequence;
+	pInput->SetInputSequence( m_unInputSequence );
+
+	ClientSpaceWarUpdateData_t *pStoredInput = &m_rgInputs[ m_unInputSequence % SHIP_PREDICTION_HISTORY_INPUTS ];
+	memcpy( pStoredInput, pInput, sizeof( ClientSpaceWarUpdateData_t ) );
+	pStoredInput->SetFirePressed( false );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Give the predicted ship one of the inputs we sent
+//-----------------------------------------------------------------------------
+void CShipPredictor::SetShipInput( uint32 unInputSequence )
+{
+	ClientSpaceWarUpdateData_t *pInput = &m_rgInputs[ unInputSequence % SHIP_PREDICTION_HISTORY_INPUTS ];
+	if ( pInput->GetInputSequence() != unInputSequence )
+	{
+		// Too old to have kept, the ship carries on with what it has
+		return;
+	}
+
+	m_pShip->OnReceiveClientUpdate( pInput );
+	m_unShipInputSequence = unInputSequence;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Run one simulation step and remember where it left the ship
+//-----------------------------------------------------------------------------
+void CShipPredictor::RunStep( uint32 unInputSequence )
+{
+	if ( unInputSequence != m_unShipInputSequence )
+		SetShipInput( unInputSequence );
+
+	m_pShip->RunFrame();
+
+	PredictedStep_t *pStep = &m_rgSteps[ m_unNextStep % SHIP_PREDICTION_HISTORY_STEPS ];
+	pStep->m_unInputSequence = unInputSequence;
+	pStep->m_flXPos = m_pShip->GetXPos();
+	pStep->m_flYPos = m_pShip->GetYPos();
+	pStep->m_flRotation = m_pShip->GetAccumulatedRotation();
+
+	++m_unNextStep;
+	if ( m_unNextStep - m_unFirstStep > SHIP_PREDICTION_HISTORY_STEPS )
+		++m_unFirstStep;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Run as many steps as the time since the last frame covers, then put
+//			our ship where the prediction has it
+//-----------------------------------------------------------------------------
+void CShipPredictor::RunFrame( CShip *pLocalShip )
+{
+	// Steps are run even before we have a server state to start from, so there's a record of
+	// which input each step had for the first update to line up with
+	uint32 cSteps = m_SimulationEngine.AccumulateTime( m_pGameEngine->GetGameTicksFrameDelta() );
+	for ( uint32 i = 0; i < cSteps; ++i )
+	{
+		m_SimulationEngine.Step();
+		RunStep( m_unInputSequence );
+	}
+
+	if ( m_bPredicting )
+		pLocalShip->CopyPredictedState( m_pShip );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Note a correction in the metrics
+//-----------------------------------------------------------------------------
+void CShipPredictor::RecordCorrection( float flDistance )
+{
+	++m_cCorrections;
+	m_flTotalCorrectionDistance += flDistance;
+	m_flMaxCorrectionDistance = MAX( m_flMaxCorrectionDistance, flDistance );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Line the server's state for our ship up with one of our predicted
+//			steps, and if we got it wrong rewind to the server's state and
+//			replay every step we've predicted since
+//-----------------------------------------------------------------------------
+void CShipPredictor::OnReceiveServerUpdate( ServerShipUpdateData_t *pUpdateData )
+{
+	// Nothing to predict while the ship is out of action
+	if ( pUpdateData->GetExploding() || pUpdateData->GetDisabled() )
+	{
+		Reset();
+		return;
+	}
+
+	float flViewportWidth = (float)m_pGameEngine->GetViewportWidth();
+	float flViewportHeight = (float)m_pGameEngine->GetViewportHeight();
+	float flServerXPos = pUpdateData->GetXPosition() * flViewportWidth;
+	float flServerYPos = pUpdateData->GetYPosition() * flViewportHeight;
+
+	// The server's state is after the step that ran our input for the InputSteps'th time, find the
+	// first step we ran that input in
+	uint32 unInputSequence = pUpdateData->GetInputSequence();
+	uint32 unStepAfter = m_unNextStep + 1;
+	for ( uint32 unStep = m_unFirstStep; unStep != m_unNextStep; ++unStep )
+	{
+		if ( m_rgSteps[ unStep % SHIP_PREDICTION_HISTORY_STEPS ].m_unInputSequence == unInputSequence )
+		{
+			unStepAfter = unStep + pUpdateData->GetInputSteps();
+			break;
+		}
+	}
+
+	bool bLinedUp = unStepAfter > m_unFirstStep && unStepAfter <= m_unNextStep;
+	if ( bLinedUp && m_bPredicting )
+	{
+		++m_cUpdatesChecked;
+
+		PredictedStep_t *pStep = &m_rgSteps[ ( unStepAfter - 1 ) % SHIP_PREDICTION_HISTORY_STEPS ];
+		float flDistance = WrappedDistance( pStep->m_flXPos, pStep->m_flYPos, flServerXPos, flServerYPos, flViewportWidth, flViewportHeight );
+
+		float flRotationDelta = (float)fmod( fabs( pStep->m_flRotation - pUpdateData->GetRotation() ), 2.0f*PI_VALUE );
+		flRotationDelta = MIN( flRotationDelta, 2.0f*PI_VALUE - flRotationDelta );
+
+		if ( flDistance <= SHIP_PREDICTION_CORRECTION_DISTANCE && flRotationDelta <= SHIP_PREDICTION_CORRECTION_ROTATION )
+			return;
+
+		RecordCorrection( flDistance );
+	}
+	else if ( !bLinedUp && m_bPredicting )
+	{
+		// We've no step to compare with, either the server is acking something we've long
+		// forgotten or it has run our input further than we have.  Start over from its state.
+		++m_cResyncs;
+	}
+
+	// Back to the server's state, with the input it had
+	m_pShip->RewindToServerUpdate( pUpdateData );
+	SetShipInput( unInputSequence );
+	m_bPredicting = true;
+
+	// Nothing to replay, predict on from here.  The steps we remember still line up later updates.
+	if ( !bLinedUp )
+		return;
+
+	// Replay the steps we predicted since, with the inputs we ran them with
+	uint32 unReplayEnd = m_unNextStep;
+	m_unNextStep = unStepAfter;
+	while ( m_unNextStep != unReplayEnd )
+		RunStep( m_rgSteps[ m_unNextStep % SHIP_PREDICTION_HISTORY_STEPS ].m_unInputSequence );
+}
@@ -0,0 +1,121 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Client side prediction of the local player's ship
+//
+//=============================================================================
+
+#ifndef SHIPPREDICTOR_H
+#define SHIPPREDICTOR_H
+
+#include "GameEngine.h"
+#include "SpaceWar.h"
+#include "MatchGameEngine.h"
+#include "VectorEntityStatePool.h"
+
+class CShip;
+
+// Simulation steps of prediction remembered, about a second.  An update from the server that
+// lines up with a step older than this snaps the ship to the server's state.
+#define SHIP_PREDICTION_HISTORY_STEPS 128
+
+// Inputs remembered for replaying, enough to cover the step history at CLIENT_UPDATE_SEND_RATE
+#define SHIP_PREDICTION_HISTORY_INPUTS 64
+
+// How far the prediction can be from the server, in pixels and radians, before it's corrected.
+// Anything under this is the quantization in the world update rather than a misprediction.
+#define SHIP_PREDICTION_CORRECTION_DISTANCE 1.0f
+#define SHIP_PREDICTION_CORRECTION_ROTATION 0.01f
+
+//-----------------------------------------------------------------------------
+// Purpose: Runs a hidden server side copy of our ship in fixed steps with the
+//			inputs we send, so our own ship moves as soon as we press a key
+//			rather than a round trip later.
+//
+//			Each input we send is numbered, and the server tells us the newest
+//			one it has and how many steps it has run it for.  That lines its
+//			state up with one of our steps.  If we predicted something
+//			different there, we go back to the server's state and replay our
+//			inputs since on top of it.
+//-----------------------------------------------------------------------------
+class CShipPredictor
+{
+public:
+	// Constructor
+	CShipPredictor( IGameEngine *pGameEngine );
+
+	// Destructor
+	~CShipPredictor();
+
+	// Stop predicting, the next update from the server starts us again from its state
+	void Reset();
+
+	// Number an input we are about to send to the server, and predict with it from now on
+	void OnSendInput( ClientSpaceWarUpdateData_t *pInput );
+
+	// Predict ahead by the time since the last frame, then move our ship to the prediction
+	void RunFrame( CShip *pLocalShip );
+
+	// Check the prediction against an update for our ship from the server
+	void OnReceiveServerUpdate( ServerShipUpdateData_t *pUpdateData );
+
+	// How many server updates we have checked the prediction against, how many it was off
+	// enough to correct and by how far, and how many we had nothing to check against and just
+	// started over from
+	uint32 GetUpdatesChecked() { return m_cUpdatesChecked; }
+	uint32 GetCorrectionCount() { return m_cCorrections; }
+	uint32 GetResyncCount() { return m_cResyncs; }
+	float GetAverageCorrectionDistance() { return m_cCorrections ? m_flTotalCorrectionDistance / m_cCorrections : 0.0f; }
+	float GetMaxCorrectionDistance() { return m_flMaxCorrectionDistance; }
+	void ResetMetrics();
+
+private:
+	// Run one step with the given input, remembering where it left the ship
+	void RunStep( uint32 unInputSequence );
+
+	// Give the predicted ship an input we sent
+	void SetShipInput( uint32 unInputSequence );
+
+	// Note a correction of the given distance in the metrics
+	void RecordCorrection( float flDistance );
+
+	struct PredictedStep_t
+	{
+		uint32 m_unInputSequence;
+		float m_flXPos;
+		float m_flYPos;
+		float m_flRotation;
+	};
+
+	// Game engine we get frame times and the viewport from
+	IGameEngine *m_pGameEngine;
+
+	// Clock and state the predicted ship runs under, apart from the ships being drawn
+	CSimulationEngine m_SimulationEngine;
+	CVectorEntityStatePool m_StatePool;
+	CShip *m_pShip;
+
+	// Have we got a server state to predict from?
+	bool m_bPredicting;
+
+	// Inputs we have sent, by sequence number
+	ClientSpaceWarUpdateData_t m_rgInputs[SHIP_PREDICTION_HISTORY_INPUTS];
+
+	// Sequence number of the newest input we sent, and of the one the predicted ship has
+	uint32 m_unInputSequence;
+	uint32 m_unShipInputSequence;
+
+	// Steps we have predicted, by step number.  Steps from m_unFirstStep up to (not including)
+	// m_unNextStep are still in the ring.
+	PredictedStep_t m_rgSteps[SHIP_PREDICTION_HISTORY_STEPS];
+	uint32 m_unFirstStep;
+	uint32 m_unNextStep;
+
+	// Metrics
+	uint32 m_cUpdatesChecked;
+	uint32 m_cCorrections;
+	uint32 m_cResyncs;
+	float m_flTotalCorrectionDistance;
+	float m_flMaxCorrectionDistance;
+};
+
+#endif // SHIPPREDICTOR_H
@@ -0,0 +1,270 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Offline benchmark of world snapshot packing
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "SnapshotBenchmark.h"
+#include "MatchGameEngine.h"
+#include "Ship.h"
+#include "VectorEntityStatePool.h"
+#include "WorldSnapshot.h"
+#include "RelevancyFilter.h"
+#include <chrono>
+#include <math.h>
+
+// How long to simulate each match size for
+#define SNAPSHOT_BENCHMARK_FRAMES 240
+#define SNAPSHOT_BENCHMARK_TICKS_PER_FRAME 16
+
+// Each snapshot is packed and unpacked this many times so the timer has something to measure
+#define SNAPSHOT_BENCHMARK_REPEATS 8
+
+// How many snapshots old the baseline for the delta size is, about what a client's ack lags by
+#define SNAPSHOT_BENCHMARK_ACK_LAG 3
+
+// Viewport the benchmark matches run in
+#define SNAPSHOT_BENCHMARK_VIEWPORT_WIDTH 1024
+#define SNAPSHOT_BENCHMARK_VIEWPORT_HEIGHT 768
+
+// Compare one field of the update struct pData with the same field of pUnpacked
+#define CHECK_FLOAT_FIELD( Name, flMin, flMax, cBits ) bMatches = bMatches && BWithinQuantizationError( pData->Get##Name(), pUnpacked->Get##Name(), flMin, flMax, cBits );
+#define CHECK_INT_FIELD( Name, nMin, nMax ) bMatches = bMatches && MAX( (int64)( nMin ), MIN( (int64)pData->Get##Name(), (int64)( nMax ) ) ) == (int64)pUnpacked->Get##Name();
+#define CHECK_UINT64_FIELD( Name ) bMatches = bMatches && pData->Get##Name() == pUnpacked->Get##Name();
+#define CHECK_BOOL_FIELD( Name ) bMatches = bMatches && pData->Get##Name() == pUnpacked->Get##Name();
+#define CHECK_FIELDS( FIELDS ) FIELDS( CHECK_FLOAT_FIELD, CHECK_INT_FIELD, CHECK_UINT64_FIELD, CHECK_BOOL_FIELD )
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Small deterministic random number generator
+//-----------------------------------------------------------------------------
+static uint32 SnapshotBenchmarkRandom( uint32 *punSeed )
+{
+	*punSeed = *punSeed * 1664525 + 1013904223;
+	return *punSeed >> 8;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Did a float come back within the error its quantization allows?
+//			Out of range values come back clamped.
+//-----------------------------------------------------------------------------
+static bool BWithinQuantizationError( float flValue, float flUnpacked, float flMin, float flMax, uint32 cBits )
+{
+	float flClamped = MAX( flMin, MIN( flValue, flMax ) );
+
+	// A little slack for float rounding in the quantize and dequantize themselves
+	float flError = GetQuantizationError( flMin, flMax, cBits ) * 1.001f + ( flMax - flMin ) * 1.0e-6f;
+	return fabs( flUnpacked - flClamped ) <= flError;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Compare a photon beam with what came out of packing and unpacking it
+//-----------------------------------------------------------------------------
+static bool BPhotonBeamMatches( ServerPhotonBeamUpdateData_t *pData, ServerPhotonBeamUpdateData_t *pUnpacked )
+{
+	bool bMatches = pData->GetActive() == pUnpacked->GetActive();
+	if ( bMatches && pData->GetActive() )
+	{
+		CHECK_FIELDS( WORLD_SNAPSHOT_PHOTON_BEAM_FIELDS );
+	}
+	return bMatches;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Compare a ship with what came out of packing and unpacking it
+//-----------------------------------------------------------------------------
+static bool BShipMatches( ServerShipUpdateData_t *pData, ServerShipUpdateData_t *pUnpacked )
+{
+	bool bMatches = true;
+	CHECK_FIELDS( WORLD_SNAPSHOT_SHIP_FIELDS );
+
+	for ( int i = 0; i < MAX_PHOTON_BEAMS_PER_SHIP && bMatches; ++i )
+		bMatches = BPhotonBeamMatches( pData->AccessPhotonBeamData( i ), pUnpacked->AccessPhotonBeamData( i ) );
+
+	return bMatches;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Compare a player slot with what came out of packing and unpacking it
+//-----------------------------------------------------------------------------
+static bool BPlayerMatches( ServerPlayerUpdateData_t *pData, ServerPlayerUpdateData_t *pUnpacked )
+{
+	bool bMatches = pData->GetActive() == pUnpacked->GetActive() && pUnpacked->GetIncluded();
+	CHECK_FIELDS( WORLD_SNAPSHOT_PLAYER_FIELDS );
+
+	if ( bMatches && pData->GetActive() )
+		bMatches = BShipMatches( pData->AccessShipUpdateData(), pUnpacked->AccessShipUpdateData() );
+
+	return bMatches;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Compare a whole update with what came out of packing and unpacking it
+//-----------------------------------------------------------------------------
+static bool BUpdateMatches( ServerSpaceWarUpdateData_t *pData, ServerSpaceWarUpdateData_t *pUnpacked )
+{
+	bool bMatches = true;
+	CHECK_FIELDS( WORLD_SNAPSHOT_HEADER_FIELDS );
+
+	for ( uint32 i = 0; i < pData->GetPlayerSlotCount() && bMatches; ++i )
+		bMatches = BPlayerMatches( pData->AccessPlayerUpdateData( i ), pUnpacked->AccessPlayerUpdateData( i ) );
+
+	return bMatches;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Remember a snapshot, and return how big its delta is against the
+//			one a client would have acked a few updates ago
+//-----------------------------------------------------------------------------
+static uint32 AddSnapshotAndMeasureDelta( CWorldSnapshotHistory &snapshots, uint32 unSequence, const uint8 *pubPacked, uint32 cubPacked, std::vector< uint8 > &vecEncoded )
+{
+	snapshots.AddSnapshot( unSequence, pubPacked, cubPacked );
+
+	const std::vector< uint8 > *pvecBaseline = NULL;
+	if ( unSequence > SNAPSHOT_BENCHMARK_ACK_LAG )
+		pvecBaseline = snapshots.FindSnapshot( unSequence - SNAPSHOT_BENCHMARK_ACK_LAG );
+
+	vecEncoded.clear();
+	EncodeWorldSnapshotDelta( pubPacked, pvecBaseline ? &(*pvecBaseline)[0] : NULL, cubPacked, vecEncoded );
+	return (uint32)vecEncoded.size();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Run the benchmark for each match size
+//-----------------------------------------------------------------------------
+bool RunSnapshotBenchmark()
+{
+	bool bAllMatched = true;
+	char rgchBuffer[256];
+
+	OutputDebugString( "Ships   Raw (bytes)   Packed (bytes)   Delta (bytes)   Pack (ns)   Unpack (ns)   Per client delta (bytes)\n" );
+
+	for ( uint32 unShips = 4; unShips <= MAX_PLAYERS_PER_SERVER_LIMIT; unShips *= 2 )
+	{
+		CMatchGameEngine gameEngine( SNAPSHOT_BENCHMARK_VIEWPORT_WIDTH, SNAPSHOT_BENCHMARK_VIEWPORT_HEIGHT );
+		CVectorEntityStatePool entityStatePool;
+		std::vector< CShip * > vecpShips;
+		std::vector< ClientSpaceWarUpdateData_t > vecShipInput( unShips );
+
+		// Same mix of inputs as the collision benchmark, with every eighth slot left empty
+		uint32 unSeed = unShips;
+		for ( uint32 i = 0; i < unShips; ++i )
+		{
+			float xPos = (float)( SnapshotBenchmarkRandom( &unSeed ) % SNAPSHOT_BENCHMARK_VIEWPORT_WIDTH );
+			float yPos = (float)( SnapshotBenchmarkRandom( &unSeed ) % SNAPSHOT_BENCHMARK_VIEWPORT_HEIGHT );
+			float flRotation = (float)( SnapshotBenchmarkRandom( &unSeed ) % 628 ) / 100.0f;
+
+			CShip *pShip = NULL;
+			if ( i % 8 != 7 )
+			{
+				pShip = new CShip( &gameEngine, true, xPos, yPos, GetPlayerColor( i ), &entityStatePool );
+				pShip->SetInitialRotation( flRotation );
+			}
+			vecpShips.push_back( pShip );
+
+			ClientSpaceWarUpdateData_t &input = vecShipInput[i];
+			memset( &input, 0, sizeof( input ) );
+			input.SetFirePressed( true );
+			input.SetTurnLeftPressed( i % 3 == 1 );
+			input.SetTurnRightPressed( i % 3 == 2 );
+			input.SetForwardThrustersPressed( i % 2 == 0 );
+			input.SetShieldStrength( i % 4 == 0 ? 255 : 0 );
+		}
+
+		// The whole world is packed with a lane for every slot, and for comparison the update one
+		// client would get with only the players relevant to it
+		std::vector< uint32 > vecAllSlots;
+		for ( uint32 i = 0; i < unShips; ++i )
+			vecAllSlots.push_back( i );
+		CRelevancyFilter relevancyFilter;
+
+		std::vector< uint8 > vecUpdateWorld( MsgServerUpdateWorld_t::GetMessageSize( unShips ) );
+		std::vector< uint8 > vecPacked( GetPackedWorldSnapshotSize( unShips, unShips ) );
+		std::vector< uint8 > vecClientPacked( GetPackedWorldSnapshotSize( unShips, CRelevancyFilter::GetLaneCount( unShips ) ) );
+		std::vector< uint8 > vecUnpacked;
+		std::vector< uint8 > vecEncoded;
+		CWorldSnapshotHistory snapshots;
+		CWorldSnapshotHistory clientSnapshots;
+
+		double flPackNanoseconds = 0.0;
+		double flUnpackNanoseconds = 0.0;
+		uint64 cubDeltaTotal = 0;
+		uint64 cubClientDeltaTotal = 0;
+		bool bMatched = true;
+
+		uint64 ulTickCount = 1000;
+		for ( uint32 iFrame = 0; iFrame < SNAPSHOT_BENCHMARK_FRAMES && bMatched; ++iFrame )
+		{
+			ulTickCount += SNAPSHOT_BENCHMARK_TICKS_PER_FRAME;
+			gameEngine.SetGameTickCount( ulTickCount );
+
+			// Build the update the way the server does
+			memset( &vecUpdateWorld[0], 0, vecUpdateWorld.size() );
+			MsgServerUpdateWorld_t *pMsg = new( &vecUpdateWorld[0] ) MsgServerUpdateWorld_t;
+			ServerSpaceWarUpdateData_t *pUpdateData = pMsg->AccessUpdateData();
+			pUpdateData->SetServerGameState( k_EServerActive );
+			pUpdateData->SetPlayerSlotCount( unShips );
+			for ( uint32 i = 0; i < unShips; ++i )
+			{
+				if ( !vecpShips[i] )
+					continue;
+
+				vecpShips[i]->OnReceiveClientUpdate( &vecShipInput[i] );
+				vecpShips[i]->RunFrame();
+
+				pUpdateData->SetPlayerActive( i, true );
+				pUpdateData->SetPlayerScore( i, iFrame + i );
+				pUpdateData->SetPlayerSteamID( i, CSteamID( 1000 + i, k_EUniversePublic, k_EAccountTypeIndividual ).ConvertToUint64() );
+				vecpShips[i]->BuildServerUpdate( pUpdateData->AccessShipUpdateData( i ) );
+			}
+
+			uint32 cubPacked = 0;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for ( uint32 iRepeat = 0; iRepeat < SNAPSHOT_BENCHMARK_REPEATS; ++iRepeat )
+				cubPacked = PackWorldSnapshot( pUpdateData, &vecAllSlots[0], unShips, &vecPacked[0], (uint32)vecPacked.size() );
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+			flPackNanoseconds += std::chrono::duration< double, std::nano >( end - start ).count() / SNAPSHOT_BENCHMARK_REPEATS;
+
+			start = std::chrono::steady_clock::now();
+			for ( uint32 iRepeat = 0; iRepeat < SNAPSHOT_BENCHMARK_REPEATS && bMatched; ++iRepeat )
+				bMatched = BUnpackWorldSnapshot( &vecPacked[0], cubPacked, vecUnpacked );
+			end = std::chrono::steady_clock::now();
+			flUnpackNanoseconds += std::chrono::duration< double, std::nano >( end - start ).count() / SNAPSHOT_BENCHMARK_REPEATS;
+
+			bMatched = bMatched && BUpdateMatches( pUpdateData, ( (MsgServerUpdateWorld_t *)&vecUnpacked[0] )->AccessUpdateData() );
+
+			cubDeltaTotal += AddSnapshotAndMeasureDelta( snapshots, iFrame + 1, &vecPacked[0], cubPacked, vecEncoded );
+
+			relevancyFilter.SelectPlayers( pUpdateData, 0, (float)SNAPSHOT_BENCHMARK_VIEWPORT_WIDTH, (float)SNAPSHOT_BENCHMARK_VIEWPORT_HEIGHT );
+			uint32 cubClientPacked = PackWorldSnapshot( pUpdateData, relevancyFilter.GetLaneSlots(), relevancyFilter.GetLaneCount(), &vecClientPacked[0], (uint32)vecClientPacked.size() );
+			cubClientDeltaTotal += AddSnapshotAndMeasureDelta( clientSnapshots, iFrame + 1, &vecClientPacked[0], cubClientPacked, vecEncoded );
+		}
+
+		for ( uint32 i = 0; i < unShips; ++i )
+			delete vecpShips[i];
+
+		if ( !bMatched )
+		{
+			sprintf_safe( rgchBuffer, "%5u   unpacked snapshot doesn't match what was packed\n", unShips );
+			OutputDebugString( rgchBuffer );
+			bAllMatched = false;
+			continue;
+		}
+
+		sprintf_safe( rgchBuffer, "%5u   %11u   %14u   %13u   %9.0f   %11.0f   %24u\n", unShips,
+			(uint32)vecUpdateWorld.size(), (uint32)vecPacked.size(), (uint32)( cubDeltaTotal / SNAPSHOT_BENCHMARK_FRAMES ),
+			flPackNanoseconds / SNAPSHOT_BENCHMARK_FRAMES, flUnpackNanoseconds / SNAPSHOT_BENCHMARK_FRAMES,
+			(uint32)( cubClientDeltaTotal / SNAPSHOT_BENCHMARK_FRAMES ) );
+		OutputDebugString( rgchBuffer );
+	}
+
+	return bAllMatched;
+}
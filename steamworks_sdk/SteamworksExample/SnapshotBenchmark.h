@@ -0,0 +1,16 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Offline benchmark of world snapshot packing
+//
+//=============================================================================
+
+#ifndef SNAPSHOTBENCHMARK_H
+#define SNAPSHOTBENCHMARK_H
+
+// Simulate matches of 4 up to MAX_PLAYERS_PER_SERVER_LIMIT ships, pack and unpack the world update
+// every frame, and report the time each took and how big the update is raw, packed and delta
+// encoded, along with the delta one client gets with only the players relevant to it.  Returns
+// false if anything doesn't come back within its quantization error.
+bool RunSnapshotBenchmark();
+
+#endif // SNAPSHOTBENCHMARK_H
@@ -0,0 +1,285 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Smooths other players' ships between world updates from the server
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "SnapshotInterpolator.h"
+#include "Ship.h"
+#include <math.h>
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Wrap a normalized position back into [0, 1)
+//-----------------------------------------------------------------------------
+static float WrapPosition( float flPos )
+{
+	if ( flPos >= 1.0f )
+		flPos -= 1.0f;
+	else if ( flPos < 0.0f )
+		flPos += 1.0f;
+	return flPos;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Move a normalized position some way towards another, the short way
+//			around the wrapping world
+//-----------------------------------------------------------------------------
+static float LerpWrappedPosition( float flPos0, float flPos1, float flFraction )
+{
+	float flDelta = flPos1 - flPos0;
+	if ( flDelta > 0.5f )
+		flDelta -= 1.0f;
+	else if ( flDelta < -0.5f )
+		flDelta += 1.0f;
+	return WrapPosition( flPos0 + flDelta * flFraction );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Move a rotation some way towards another, the short way round
+//-----------------------------------------------------------------------------
+static float LerpRotation( float flRotation0, float flRotation1, float flFraction )
+{
+	float flDelta = (float)fmod( flRotation1 - flRotation0, 2.0f*PI_VALUE );
+	if ( flDelta > PI_VALUE )
+		flDelta -= 2.0f*PI_VALUE;
+	else if ( flDelta < -PI_VALUE )
+		flDelta += 2.0f*PI_VALUE;
+	return flRotation0 + flDelta * flFraction;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CSnapshotInterpolator::CSnapshotInterpolator( IGameEngine *pGameEngine )
+{
+	m_pGameEngine = pGameEngine;
+
+	Reset();
+	ResetMetrics();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Forget every ship's history and the server's clock
+//-----------------------------------------------------------------------------
+void CSnapshotInterpolator::Reset()
+{
+	for ( uint32 i = 0; i < m_vecHistory.size(); ++i )
+		m_vecHistory[i].m_cStates = 0;
+
+	m_bClockSynced = false;
+	m_flClockOffset = 0.0;
+	m_flLastClockOffset = 0.0;
+	m_unLastServerTime = 0;
+	m_flUpdateInterval = SNAPSHOT_INTERPOLATION_INTERVAL_MILLISECONDS;
+	m_flJitter = 0.0f;
+	m_flDelay = SNAPSHOT_INTERPOLATION_INTERVAL_MILLISECONDS;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Clear the metrics
+//-----------------------------------------------------------------------------
+void CSnapshotInterpolator::ResetMetrics()
+{
+	m_cInterpolatedFrames = 0;
+	m_cExtrapolatedFrames = 0;
+	m_cHeldFrames = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Track how far our clock is ahead of the server's and how much that
+//			varies from one update to the next, and pick the delay from that
+//-----------------------------------------------------------------------------
+void CSnapshotInterpolator::UpdateClock( uint32 unServerTime )
+{
+	double flClockOffset = (double)m_pGameEngine->GetGameTickCount() - (double)unServerTime;
+
+	if ( !m_bClockSynced || fabs( flClockOffset - m_flClockOffset ) > SNAPSHOT_INTERPOLATION_CLOCK_RESYNC_MILLISECONDS )
+	{
+		// The histories are on the old clock, so they have to go too
+		Reset();
+		m_bClockSynced = true;
+		m_flClockOffset = flClockOffset;
+	}
+	else
+	{
+		// Jitter as RTP measures it (RFC 3550), a running average of how much the time between two
+		// updates arriving differs from the time between the server sending them
+		float flDeviation = (float)fabs( flClockOffset - m_flLastClockOffset );
+		m_flJitter += ( flDeviation - m_flJitter ) / 16.0f;
+		m_flClockOffset += ( flClockOffset - m_flClockOffset ) / 16.0;
+
+		// The server sends us fewer updates when our connection is struggling, follow it down
+		// quickly and back up slowly, the same as the delay
+		int32 nInterval = (int32)( unServerTime - m_unLastServerTime );
+		if ( nInterval > 0 )
+			m_flUpdateInterval += ( MIN( (float)nInterval, SNAPSHOT_INTERPOLATION_MAX_DELAY_MILLISECONDS ) - m_flUpdateInterval ) / ( nInterval > m_flUpdateInterval ? 4.0f : 16.0f );
+	}
+	m_flLastClockOffset = flClockOffset;
+	m_unLastServerTime = unServerTime;
+
+	// Grow the delay quickly when the connection gets worse so we don't run out of updates, and
+	// shrink it slowly so ships don't visibly speed up
+	float flTargetDelay = m_flUpdateInterval + SNAPSHOT_INTERPOLATION_JITTER_MULTIPLE * m_flJitter;
+	flTargetDelay = MIN( flTargetDelay, SNAPSHOT_INTERPOLATION_MAX_DELAY_MILLISECONDS );
+	if ( flTargetDelay > m_flDelay )
+		m_flDelay += ( flTargetDelay - m_flDelay ) / 4.0f;
+	else
+		m_flDelay += ( flTargetDelay - m_flDelay ) / 64.0f;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Add a ship's state to the front of its history
+//-----------------------------------------------------------------------------
+void CSnapshotInterpolator::AddState( ShipHistory_t *pHistory, uint32 unServerTime, ServerShipUpdateData_t *pShipData )
+{
+	// Nothing to draw between if the clock hasn't moved on
+	if ( pHistory->m_cStates && (int32)( unServerTime - pHistory->m_rgStates[ pHistory->m_iNewest ].m_unServerTime ) <= 0 )
+		return;
+
+	pHistory->m_iNewest = ( pHistory->m_iNewest + 1 ) % SNAPSHOT_INTERPOLATION_STATES;
+	if ( pHistory->m_cStates < SNAPSHOT_INTERPOLATION_STATES )
+		++pHistory->m_cStates;
+
+	ShipState_t *pState = &pHistory->m_rgStates[ pHistory->m_iNewest ];
+	pState->m_unServerTime = unServerTime;
+	pState->m_flXPos = pShipData->GetXPosition();
+	pState->m_flYPos = pShipData->GetYPosition();
+	pState->m_flXVelocity = pShipData->GetXVelocity();
+	pState->m_flYVelocity = pShipData->GetYVelocity();
+	pState->m_flRotation = pShipData->GetRotation();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Time an update from the server and remember the state of every
+//			ship it has but our own
+//-----------------------------------------------------------------------------
+void CSnapshotInterpolator::OnReceiveServerUpdate( ServerSpaceWarUpdateData_t *pUpdateData, uint32 iLocalSlot )
+{
+	uint32 unPlayerSlots = pUpdateData->GetPlayerSlotCount();
+	if ( m_vecHistory.size() != unPlayerSlots )
+	{
+		m_vecHistory.resize( unPlayerSlots );
+		for ( uint32 i = 0; i < unPlayerSlots; ++i )
+			m_vecHistory[i].m_cStates = 0;
+	}
+
+	uint32 unServerTime = pUpdateData->GetServerTime();
+	UpdateClock( unServerTime );
+
+	for ( uint32 i = 0; i < unPlayerSlots; ++i )
+	{
+		ShipHistory_t *pHistory = &m_vecHistory[i];
+		if ( i == iLocalSlot || !pUpdateData->GetPlayerActive( i ) )
+		{
+			pHistory->m_cStates = 0;
+			continue;
+		}
+
+		// Players left out of this update keep what they had
+		if ( !pUpdateData->GetPlayerIncluded( i ) )
+			continue;
+
+		// A ship that's blown up or waiting to respawn is drawn where the server says, and
+		// shouldn't slide across to wherever it respawns
+		ServerShipUpdateData_t *pShipData = pUpdateData->AccessShipUpdateData( i );
+		if ( pShipData->GetExploding() || pShipData->GetDisabled() )
+		{
+			pHistory->m_cStates = 0;
+			continue;
+		}
+
+		AddState( pHistory, unServerTime, pShipData );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Work out where a ship was at a time on the server's clock, in
+//			normalized position
+//-----------------------------------------------------------------------------
+void CSnapshotInterpolator::SampleHistory( ShipHistory_t *pHistory, double flServerTime, ShipState_t *pState )
+{
+	// Look back from the newest update for the one just before the time we want
+	uint32 iState = pHistory->m_iNewest;
+	uint32 iNewer = iState;
+	for ( uint32 cChecked = 1; cChecked < pHistory->m_cStates && (double)pHistory->m_rgStates[iState].m_unServerTime > flServerTime; ++cChecked )
+	{
+		iNewer = iState;
+		iState = ( iState + SNAPSHOT_INTERPOLATION_STATES - 1 ) % SNAPSHOT_INTERPOLATION_STATES;
+	}
+
+	ShipState_t *pState0 = &pHistory->m_rgStates[iState];
+	*pState = *pState0;
+
+	if ( flServerTime <= (double)pState0->m_unServerTime )
+	{
+		// Older than anything we have, just show the oldest
+		++m_cHeldFrames;
+		return;
+	}
+
+	if ( iState == pHistory->m_iNewest )
+	{
+		// Past the newest update, carry on along its velocity for a while
+		float flMilliseconds = (float)( flServerTime - (double)pState0->m_unServerTime );
+		if ( flMilliseconds > SNAPSHOT_INTERPOLATION_MAX_EXTRAPOLATION_MILLISECONDS )
+		{
+			flMilliseconds = SNAPSHOT_INTERPOLATION_MAX_EXTRAPOLATION_MILLISECONDS;
+			++m_cHeldFrames;
+		}
+		else
+		{
+			++m_cExtrapolatedFrames;
+		}
+
+		float flSeconds = flMilliseconds / 1000.0f;
+		pState->m_flXPos = WrapPosition( pState0->m_flXPos + pState0->m_flXVelocity * flSeconds / m_pGameEngine->GetViewportWidth() );
+		pState->m_flYPos = WrapPosition( pState0->m_flYPos + pState0->m_flYVelocity * flSeconds / m_pGameEngine->GetViewportHeight() );
+		return;
+	}
+
+	ShipState_t *pState1 = &pHistory->m_rgStates[iNewer];
+	float flFraction = (float)( ( flServerTime - (double)pState0->m_unServerTime ) / (double)( pState1->m_unServerTime - pState0->m_unServerTime ) );
+	++m_cInterpolatedFrames;
+
+	pState->m_flXPos = LerpWrappedPosition( pState0->m_flXPos, pState1->m_flXPos, flFraction );
+	pState->m_flYPos = LerpWrappedPosition( pState0->m_flYPos, pState1->m_flYPos, flFraction );
+	pState->m_flXVelocity = pState0->m_flXVelocity + ( pState1->m_flXVelocity - pState0->m_flXVelocity ) * flFraction;
+	pState->m_flYVelocity = pState0->m_flYVelocity + ( pState1->m_flYVelocity - pState0->m_flYVelocity ) * flFraction;
+	pState->m_flRotation = LerpRotation( pState0->m_flRotation, pState1->m_flRotation, flFraction );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Move every remote ship to where its history has it the delay ago
+//-----------------------------------------------------------------------------
+void CSnapshotInterpolator::RunFrame( CShip **rgpShips, uint32 unPlayerSlots, uint32 iLocalSlot )
+{
+	if ( !m_bClockSynced )
+		return;
+
+	double flRenderTime = (double)m_pGameEngine->GetGameTickCount() - m_flClockOffset - m_flDelay;
+	float flViewportWidth = (float)m_pGameEngine->GetViewportWidth();
+	float flViewportHeight = (float)m_pGameEngine->GetViewportHeight();
+
+	for ( uint32 i = 0; i < unPlayerSlots && i < m_vecHistory.size(); ++i )
+	{
+		if ( i == iLocalSlot || !rgpShips[i] || !m_vecHistory[i].m_cStates )
+			continue;
+
+		ShipState_t state;
+		SampleHistory( &m_vecHistory[i], flRenderTime, &state );
+		rgpShips[i]->SetInterpolatedState( state.m_flXPos * flViewportWidth, state.m_flYPos * flViewportHeight,
+			state.m_flXVelocity, state.m_flYVelocity, state.m_flRotation );
+	}
+}
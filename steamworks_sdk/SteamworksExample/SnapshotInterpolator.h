@@ -0,0 +1,123 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Smooths other players' ships between world updates from the server
+//
+//=============================================================================
+
+#ifndef SNAPSHOTINTERPOLATOR_H
+#define SNAPSHOTINTERPOLATOR_H
+
+#include "GameEngine.h"
+#include "SpaceWar.h"
+#include <vector>
+
+class CShip;
+
+// Server updates remembered per ship, about half a second at SERVER_UPDATE_SEND_RATE
+#define SNAPSHOT_INTERPOLATION_STATES 32
+
+// Time between server updates at full rate.  Ships are drawn at least the time between updates
+// in the past so there's normally an update either side of the time we draw.  A client on a
+// congested connection gets updates less often, so the time between them is measured.
+#define SNAPSHOT_INTERPOLATION_INTERVAL_MILLISECONDS ( 1000.0f / SERVER_UPDATE_SEND_RATE )
+
+// On top of the interval, the delay allows this many times the measured jitter, up to a limit
+#define SNAPSHOT_INTERPOLATION_JITTER_MULTIPLE 3.0f
+#define SNAPSHOT_INTERPOLATION_MAX_DELAY_MILLISECONDS 250.0f
+
+// How long a ship carries on along its last velocity when updates stop coming, before it stops
+// where that left it
+#define SNAPSHOT_INTERPOLATION_MAX_EXTRAPOLATION_MILLISECONDS 100.0f
+
+// If the server's clock jumps by more than this against ours it has restarted, or we've been
+// stalled, so start timing it over again
+#define SNAPSHOT_INTERPOLATION_CLOCK_RESYNC_MILLISECONDS 1000.0
+
+//-----------------------------------------------------------------------------
+// Purpose: Keeps the last few server updates for each remote ship, stamped
+//			with the server's clock, and draws the ship where they put it a
+//			short delay in the past.  That's normally between two updates, so
+//			it moves smoothly however unevenly they arrived.  If it runs past
+//			the newest update the ship carries on along its velocity for a bit.
+//
+//			The delay follows the jitter in how long updates take to get here,
+//			so it stays short on a good connection and grows on a bad one.
+//-----------------------------------------------------------------------------
+class CSnapshotInterpolator
+{
+public:
+	// Constructor
+	CSnapshotInterpolator( IGameEngine *pGameEngine );
+
+	// Forget everything, the next update starts timing the server's clock again
+	void Reset();
+
+	// Time an update from the server and remember the state of every ship in it but our own
+	void OnReceiveServerUpdate( ServerSpaceWarUpdateData_t *pUpdateData, uint32 iLocalSlot );
+
+	// Move every ship but our own to where the updates have it, the delay in the past
+	void RunFrame( CShip **rgpShips, uint32 unPlayerSlots, uint32 iLocalSlot );
+
+	// Current delay and jitter in milliseconds, and how many ship frames were drawn between two
+	// updates, carried on past the newest, or stopped after carrying on as long as we allow
+	float GetDelay() { return m_flDelay; }
+	float GetJitter() { return m_flJitter; }
+	float GetUpdateInterval() { return m_flUpdateInterval; }
+	uint32 GetInterpolatedFrames() { return m_cInterpolatedFrames; }
+	uint32 GetExtrapolatedFrames() { return m_cExtrapolatedFrames; }
+	uint32 GetHeldFrames() { return m_cHeldFrames; }
+	void ResetMetrics();
+
+private:
+	struct ShipState_t
+	{
+		uint32 m_unServerTime;
+		float m_flXPos;
+		float m_flYPos;
+		float m_flXVelocity;
+		float m_flYVelocity;
+		float m_flRotation;
+	};
+
+	struct ShipHistory_t
+	{
+		ShipState_t m_rgStates[SNAPSHOT_INTERPOLATION_STATES];
+		uint32 m_iNewest;
+		uint32 m_cStates;
+	};
+
+	// Note the time of an update on the server's clock and on ours
+	void UpdateClock( uint32 unServerTime );
+
+	// Add a ship's state to its history
+	void AddState( ShipHistory_t *pHistory, uint32 unServerTime, ServerShipUpdateData_t *pShipData );
+
+	// Work out where a ship was at a time on the server's clock
+	void SampleHistory( ShipHistory_t *pHistory, double flServerTime, ShipState_t *pState );
+
+	// Game engine we get the clock and viewport from
+	IGameEngine *m_pGameEngine;
+
+	// History for each player slot, by slot
+	std::vector< ShipHistory_t > m_vecHistory;
+
+	// Our clock minus the server's as updates arrive, averaged, and the last one
+	bool m_bClockSynced;
+	double m_flClockOffset;
+	double m_flLastClockOffset;
+
+	// Server time of the last update, and the average time between updates
+	uint32 m_unLastServerTime;
+	float m_flUpdateInterval;
+
+	// Jitter in the clock offset between updates, and how far behind the server we draw
+	float m_flJitter;
+	float m_flDelay;
+
+	// Metrics
+	uint32 m_cInterpolatedFrames;
+	uint32 m_cExtrapolatedFrames;
+	uint32 m_cHeldFrames;
+};
+
+#endif // SNAPSHOTINTERPOLATOR_H
@@ -0,0 +1,160 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Picks how often, and in how much detail, each client is sent world
+//			updates from how well its connection is keeping up
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "SnapshotRateController.h"
+#include "SpaceWar.h"
+
+// What each level sends.  Rate goes first, it costs the client less than losing ships from its
+// updates, which the interpolator can't make up for.
+static const struct
+{
+	uint32 m_unInterval;
+	uint32 m_unLanePercent;
+} s_rgSnapshotRateLevels[SNAPSHOT_RATE_LEVELS] =
+{
+	{ 1, 100 },
+	{ 2, 100 },
+	{ 3, 100 },
+	{ 4, 100 },
+	{ 4, 75 },
+	{ 4, 50 },
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Start a new client at full rate
+//-----------------------------------------------------------------------------
+void CSnapshotRateController::Reset( uint64 ulTickCount )
+{
+	m_unLevel = 0;
+	m_cUpdatesSinceSent = 0;
+	m_flAvgFullUpdateBytes = 0.0f;
+	m_ulLastCongestedTick = ulTickCount;
+	m_ulLastChangeTick = ulTickCount;
+	m_nPing = 0;
+	m_usecQueueTime = 0;
+	m_nSendRateBytesPerSecond = 0;
+	m_cBackoffs = 0;
+	m_cRecoveries = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Count off world updates until the client is due one
+//-----------------------------------------------------------------------------
+bool CSnapshotRateController::BUpdateDue()
+{
+	if ( ++m_cUpdatesSinceSent < s_rgSnapshotRateLevels[m_unLevel].m_unInterval )
+		return false;
+
+	m_cUpdatesSinceSent = 0;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Bytes per second updates would take at a level
+//-----------------------------------------------------------------------------
+float CSnapshotRateController::GetUpdateBytesPerSecond( uint32 unLevel ) const
+{
+	return m_flAvgFullUpdateBytes * s_rgSnapshotRateLevels[unLevel].m_unLanePercent / 100.0f
+		* SERVER_UPDATE_SEND_RATE / s_rgSnapshotRateLevels[unLevel].m_unInterval;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Back off if the connection is falling behind, or step back up if
+//			it's been fine for long enough and has room
+//-----------------------------------------------------------------------------
+void CSnapshotRateController::OnConnectionStatus( const SteamNetConnectionRealTimeStatus_t &status, const SteamNetConnectionRealTimeLaneStatus_t &stateLane, uint64 ulTickCount )
+{
+	m_nPing = status.m_nPing;
+	m_usecQueueTime = stateLane.m_usecQueueTime;
+	m_nSendRateBytesPerSecond = status.m_nSendRateBytesPerSecond;
+
+	// A send rate of 0 means the transport doesn't know, and we can only go by the queue
+	float flBudget = m_nSendRateBytesPerSecond * SNAPSHOT_RATE_BANDWIDTH_SHARE;
+	bool bQueued = m_usecQueueTime > SNAPSHOT_RATE_CONGESTED_QUEUE_MILLISECONDS * 1000;
+	bool bOverBudget = flBudget > 0.0f && GetUpdateBytesPerSecond( m_unLevel ) > flBudget;
+	if ( bQueued || bOverBudget )
+	{
+		m_ulLastCongestedTick = ulTickCount;
+		if ( m_unLevel + 1 < SNAPSHOT_RATE_LEVELS && ulTickCount - m_ulLastChangeTick >= SNAPSHOT_RATE_BACKOFF_HOLD_MILLISECONDS )
+		{
+			m_unLevel = MIN( m_unLevel + 2, (uint32)SNAPSHOT_RATE_LEVELS - 1 );
+			m_ulLastChangeTick = ulTickCount;
+			++m_cBackoffs;
+		}
+		return;
+	}
+
+	if ( !m_unLevel )
+		return;
+
+	uint64 ulRecoverMilliseconds = MAX( (uint64)SNAPSHOT_RATE_RECOVER_MILLISECONDS, (uint64)MAX( m_nPing, 0 ) * SNAPSHOT_RATE_RECOVER_ROUND_TRIPS );
+	if ( ulTickCount - m_ulLastCongestedTick < ulRecoverMilliseconds || ulTickCount - m_ulLastChangeTick < ulRecoverMilliseconds )
+		return;
+
+	if ( flBudget > 0.0f && GetUpdateBytesPerSecond( m_unLevel - 1 ) > flBudget )
+		return;
+
+	--m_unLevel;
+	m_ulLastChangeTick = ulTickCount;
+	++m_cRecoveries;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Keep a running average of what a full detail update costs
+//-----------------------------------------------------------------------------
+void CSnapshotRateController::OnUpdateSent( uint32 cubUpdate )
+{
+	float flFullUpdateBytes = cubUpdate * 100.0f / s_rgSnapshotRateLevels[m_unLevel].m_unLanePercent;
+	if ( m_flAvgFullUpdateBytes == 0.0f )
+		m_flAvgFullUpdateBytes = flFullUpdateBytes;
+	else
+		m_flAvgFullUpdateBytes += ( flFullUpdateBytes - m_flAvgFullUpdateBytes ) / 8.0f;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Lanes an update should have at our level, always at least one so
+//			the client gets its own ship
+//-----------------------------------------------------------------------------
+uint32 CSnapshotRateController::GetLaneCount( uint32 unMaxLanes ) const
+{
+	return MAX( unMaxLanes * s_rgSnapshotRateLevels[m_unLevel].m_unLanePercent / 100, 1u );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: What a level sends
+//-----------------------------------------------------------------------------
+void CSnapshotRateController::GetLevel( uint32 unLevel, uint32 *punInterval, uint32 *punLanePercent )
+{
+	unLevel = MIN( unLevel, (uint32)SNAPSHOT_RATE_LEVELS - 1 );
+	*punInterval = s_rgSnapshotRateLevels[unLevel].m_unInterval;
+	*punLanePercent = s_rgSnapshotRateLevels[unLevel].m_unLanePercent;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: The rate we've picked and what it was picked from
+//-----------------------------------------------------------------------------
+void CSnapshotRateController::GetRate( ClientSnapshotRate_t *pRate ) const
+{
+	pRate->m_unLevel = m_unLevel;
+	pRate->m_unInterval = s_rgSnapshotRateLevels[m_unLevel].m_unInterval;
+	pRate->m_unLanePercent = s_rgSnapshotRateLevels[m_unLevel].m_unLanePercent;
+	pRate->m_nPing = m_nPing;
+	pRate->m_usecQueueTime = m_usecQueueTime;
+	pRate->m_nSendRateBytesPerSecond = m_nSendRateBytesPerSecond;
+	pRate->m_flUpdateBytesPerSecond = GetUpdateBytesPerSecond( m_unLevel );
+	pRate->m_cBackoffs = m_cBackoffs;
+	pRate->m_cRecoveries = m_cRecoveries;
+}
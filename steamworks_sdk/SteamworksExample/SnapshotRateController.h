@@ -0,0 +1,107 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Picks how often, and in how much detail, each client is sent world
+//			updates from how well its connection is keeping up
+//
+//=============================================================================
+
+#ifndef SNAPSHOTRATECONTROLLER_H
+#define SNAPSHOTRATECONTROLLER_H
+
+#include "steam/steamnetworkingtypes.h"
+
+// Rate levels, from every world update at full detail down to one in four with half the lanes.
+// See s_rgSnapshotRateLevels.
+#define SNAPSHOT_RATE_LEVELS 6
+
+// A client whose world updates have waited this long to go out is congested
+#define SNAPSHOT_RATE_CONGESTED_QUEUE_MILLISECONDS 50
+
+// Fraction of a connection's estimated send rate world updates can use.  More than that and we
+// slow down before a queue builds, and we won't speed up into less than that.
+#define SNAPSHOT_RATE_BANDWIDTH_SHARE 0.75f
+
+// After backing off, how long before we'll back off again, so the queue gets a chance to drain
+#define SNAPSHOT_RATE_BACKOFF_HOLD_MILLISECONDS 250
+
+// How long a client has to go without congestion before we step its rate back up, or this many
+// round trips if that's longer, so the last change has had time to show
+#define SNAPSHOT_RATE_RECOVER_MILLISECONDS 1000
+#define SNAPSHOT_RATE_RECOVER_ROUND_TRIPS 4
+
+//-----------------------------------------------------------------------------
+// Purpose: The rate a client is being sent world updates at, and what the
+//			connection looked like when it was last decided
+//-----------------------------------------------------------------------------
+struct ClientSnapshotRate_t
+{
+	uint32 m_unLevel;					// 0 for every update at full detail, up to SNAPSHOT_RATE_LEVELS - 1
+	uint32 m_unInterval;				// World updates per one sent to the client
+	uint32 m_unLanePercent;				// Percent of the lanes the byte budget allows each update has
+	int m_nPing;						// Round trip in milliseconds
+	SteamNetworkingMicroseconds m_usecQueueTime;	// How long world updates wait to go out
+	int m_nSendRateBytesPerSecond;		// Estimated bandwidth to the client, 0 if unknown
+	float m_flUpdateBytesPerSecond;		// What world updates to the client take at this rate
+	uint32 m_cBackoffs;					// Times the rate has gone down
+	uint32 m_cRecoveries;				// Times it has come back up
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: One client's world update rate.  Every world update asks whether
+//			this client is due one, and before each one it's sent the rate is
+//			checked against the connection.  A connection with updates queued
+//			up, or that the updates would outrun, drops two levels at once.
+//			One that's had no trouble for a while and has room for more comes
+//			back up a level at a time.
+//-----------------------------------------------------------------------------
+class CSnapshotRateController
+{
+public:
+	CSnapshotRateController() { Reset( 0 ); }
+
+	// Start a new client at full rate
+	void Reset( uint64 ulTickCount );
+
+	// Called every world update, true if the client is due this one
+	bool BUpdateDue();
+
+	// Look at the connection before sending the client an update, and change its rate if need be.
+	// stateLane is the lane world updates go on.
+	void OnConnectionStatus( const SteamNetConnectionRealTimeStatus_t &status, const SteamNetConnectionRealTimeLaneStatus_t &stateLane, uint64 ulTickCount );
+
+	// Note the size of an update we sent, for working out what the updates cost
+	void OnUpdateSent( uint32 cubUpdate );
+
+	// Lanes an update to the client should have, out of the most the byte budget allows
+	uint32 GetLaneCount( uint32 unMaxLanes ) const;
+
+	void GetRate( ClientSnapshotRate_t *pRate ) const;
+
+	// The world update interval and percent of lanes a level sends
+	static void GetLevel( uint32 unLevel, uint32 *punInterval, uint32 *punLanePercent );
+
+private:
+	// Bytes per second updates would take at a level
+	float GetUpdateBytesPerSecond( uint32 unLevel ) const;
+
+	uint32 m_unLevel;
+	uint32 m_cUpdatesSinceSent;
+
+	// Average size of the updates we've sent, scaled to full detail
+	float m_flAvgFullUpdateBytes;
+
+	// When we last saw congestion, and when we last changed level
+	uint64 m_ulLastCongestedTick;
+	uint64 m_ulLastChangeTick;
+
+	// The connection when we last looked
+	int m_nPing;
+	SteamNetworkingMicroseconds m_usecQueueTime;
+	int m_nSendRateBytesPerSecond;
+
+	uint32 m_cBackoffs;
+	uint32 m_cRecoveries;
+};
+
+#endif // SNAPSHOTRATECONTROLLER_H
@@ -44,12 +44,18 @@
 // How long to wait for a client to send an update before we drop its connection server side
 #define SERVER_TIMEOUT_MILLISECONDS 5000
 
+// How often a server that publishes its own details refreshes them with Steam
+#define SERVER_DETAILS_REFRESH_MILLISECONDS 1000
+
 // Maximum packet size in bytes
 #define MAX_SPACEWAR_PACKET_SIZE 1024*512
 
-// Maximum number of players who can join a server and play simultaneously
+// Default number of players who can join a server and play simultaneously
 #define MAX_PLAYERS_PER_SERVER 4
 
+// Largest player cap a server can be started with (see CSpaceWarServer's unMaxPlayers)
+#define MAX_PLAYERS_PER_SERVER_LIMIT 512
+
 // Time to pause wait after a round ends before starting a new one
 #define MILLISECONDS_BETWEEN_ROUNDS 4000
 
@@ -74,6 +80,20 @@
 // How fast does the server internally run at?
 #define MAX_CLIENT_AND_SERVER_FPS 86
 
+// Length of one server simulation step.  The simulation always advances by exactly this much at a
+// time, however fast frames are running, so the same inputs always play out the same way.
+#define SIMULATION_STEP_MILLISECONDS 8
+
+// Most time a server frame will catch the simulation up on, anything past this is dropped so a
+// stall doesn't turn into a long burst of steps
+#define MAX_SIMULATION_CATCHUP_MILLISECONDS 100
+
+// Simulation steps a ship's thrusters have to be held to reach full thrust
+#define SHIP_THRUST_RAMP_STEPS ( 400 / SIMULATION_STEP_MILLISECONDS )
+
+// Most simulation steps a ship counts running with one client input, past this it stops counting
+#define SHIP_INPUT_STEPS_MAX 255
+
 
 template <typename T>
 inline T WordSwap( T w )
@@ -151,6 +171,9 @@ DWORD const g_rgPlayerColors[ MAX_PLAYERS_PER_SERVER ] =
 	D3DCOLOR_ARGB( 255, 153, 255, 153 ), // green
 };
 
+// Color for a player slot, slots past the default player count reuse the palette
+inline DWORD GetPlayerColor( uint32 iPlayer ) { return g_rgPlayerColors[ iPlayer % V_ARRAYSIZE( g_rgPlayerColors ) ]; }
+
 
 // Enum for possible game states on the client
 enum EClientGameState
@@ -301,6 +324,15 @@ struct ServerShipUpdateData_t
 	void SetTurnSpeed( float fSpeed ) { m_fTurnSpeed = fSpeed; }
 	float GetTurnSpeed( ) { return m_fTurnSpeed; }
 
+	void SetInputSequence( uint32 unSequence ) { m_unInputSequence = LittleDWord( unSequence ); }
+	uint32 GetInputSequence() { return LittleDWord( m_unInputSequence ); }
+
+	void SetInputSteps( uint32 unSteps ) { m_unInputSteps = LittleDWord( unSteps ); }
+	uint32 GetInputSteps() { return LittleDWord( m_unInputSteps ); }
+
+	void SetThrustSteps( uint32 unSteps ) { m_unThrustSteps = LittleDWord( unSteps ); }
+	uint32 GetThrustSteps() { return LittleDWord( m_unThrustSteps ); }
+
 	ServerPhotonBeamUpdateData_t *AccessPhotonBeamData( int iIndex ) { return &m_PhotonBeamData[iIndex]; }
 
 private:
@@ -348,10 +380,57 @@ private:
 	// Thrust and rotation speed can be anlog when using a Steam Controller
 	float m_fThrusterLevel;
 	float m_fTurnSpeed;
+
+	// Newest client input the ship has, and how many simulation steps it has been run with.  The
+	// owning client lines this up with its own prediction (see CShipPredictor).
+	uint32 m_unInputSequence;
+	uint32 m_unInputSteps;
+
+	// Simulation steps the thrusters have been held for, up to SHIP_THRUST_RAMP_STEPS
+	uint32 m_unThrustSteps;
+};
+
+
+// This is the data that gets sent per player slot in each update, see below for the full update data
+struct ServerPlayerUpdateData_t
+{
+	void SetActive( bool bIsActive ) { m_bActive = bIsActive; }
+	bool GetActive() { return m_bActive; }
+
+	void SetScore( uint32 unScore ) { m_unScore = LittleDWord( unScore ); }
+	uint32 GetScore() { return LittleDWord( m_unScore ); }
+
+	void SetSteamID( uint64 ulSteamID ) { m_ulSteamID = LittleQWord( ulSteamID ); }
+	uint64 GetSteamID() { return LittleQWord( m_ulSteamID ); }
+
+	void SetIncluded( bool bIncluded ) { m_bIncluded = bIncluded; }
+	bool GetIncluded() { return m_bIncluded; }
+
+	ServerShipUpdateData_t *AccessShipUpdateData() { return &m_ShipData; }
+
+private:
+	// is this player slot in use?
+	bool m_bActive;
+
+	// are the score, steamid and ship data below in this update?  Each client is only sent the
+	// players most relevant to it each update, the rest keep what they had last time.
+	bool m_bIncluded;
+
+	// score for the player
+	uint32 m_unScore;
+
+	// steamid of the player, serialized to uint64
+	uint64 m_ulSteamID;
+
+	// ship data
+	ServerShipUpdateData_t m_ShipData;
 };
 
 
-// This is the data that gets sent from the server to each client for each update
+// This is the data that gets sent from the server to each client for each update.  The number
+// of player slots is set by the server at runtime, so the fixed header is followed directly by
+// GetPlayerSlotCount() ServerPlayerUpdateData_t records.  This must be the last thing in any
+// message that contains it.
 struct ServerSpaceWarUpdateData_t
 {
 	void SetServerGameState( EServerGameState eState ) { m_eCurrentGameState = LittleDWord( (uint32)eState ); }
@@ -360,16 +439,27 @@ struct ServerSpaceWarUpdateData_t
 	void SetPlayerWhoWon( uint32 iIndex ) { m_uPlayerWhoWonGame = LittleDWord( iIndex ); }
 	uint32 GetPlayerWhoWon() { return LittleDWord( m_uPlayerWhoWonGame ); }
 
-	void SetPlayerActive( uint32 iIndex, bool bIsActive ) { m_rgPlayersActive[iIndex] = bIsActive; }
-	bool GetPlayerActive( uint32 iIndex ) { return m_rgPlayersActive[iIndex]; }
+	void SetPlayerSlotCount( uint32 unSlots ) { m_unPlayerSlots = LittleDWord( unSlots ); }
+	uint32 GetPlayerSlotCount() { return LittleDWord( m_unPlayerSlots ); }
 
-	void SetPlayerScore( uint32 iIndex, uint32 unScore ) { m_rgPlayerScores[iIndex] = LittleDWord(unScore); }
-	uint32 GetPlayerScore( uint32 iIndex ) { return LittleDWord(m_rgPlayerScores[iIndex]); }
+	void SetServerTime( uint32 unServerTime ) { m_unServerTime = LittleDWord( unServerTime ); }
+	uint32 GetServerTime() { return LittleDWord( m_unServerTime ); }
 
-	void SetPlayerSteamID( uint32 iIndex, uint64 ulSteamID ) { m_rgPlayerSteamIDs[iIndex] = LittleQWord(ulSteamID); }
-	uint64 GetPlayerSteamID( uint32 iIndex ) { return LittleQWord(m_rgPlayerSteamIDs[iIndex]); }
+	ServerPlayerUpdateData_t *AccessPlayerUpdateData( uint32 iIndex ) { return (ServerPlayerUpdateData_t *)( this + 1 ) + iIndex; }
 
-	ServerShipUpdateData_t *AccessShipUpdateData( uint32 iIndex ) { return &m_rgShipData[iIndex];}
+	void SetPlayerActive( uint32 iIndex, bool bIsActive ) { AccessPlayerUpdateData( iIndex )->SetActive( bIsActive ); }
+	bool GetPlayerActive( uint32 iIndex ) { return AccessPlayerUpdateData( iIndex )->GetActive(); }
+
+	void SetPlayerScore( uint32 iIndex, uint32 unScore ) { AccessPlayerUpdateData( iIndex )->SetScore( unScore ); }
+	uint32 GetPlayerScore( uint32 iIndex ) { return AccessPlayerUpdateData( iIndex )->GetScore(); }
+
+	void SetPlayerSteamID( uint32 iIndex, uint64 ulSteamID ) { AccessPlayerUpdateData( iIndex )->SetSteamID( ulSteamID ); }
+	uint64 GetPlayerSteamID( uint32 iIndex ) { return AccessPlayerUpdateData( iIndex )->GetSteamID(); }
+
+	void SetPlayerIncluded( uint32 iIndex, bool bIncluded ) { AccessPlayerUpdateData( iIndex )->SetIncluded( bIncluded ); }
+	bool GetPlayerIncluded( uint32 iIndex ) { return AccessPlayerUpdateData( iIndex )->GetIncluded(); }
+
+	ServerShipUpdateData_t *AccessShipUpdateData( uint32 iIndex ) { return AccessPlayerUpdateData( iIndex )->AccessShipUpdateData(); }
 
 private:
 	// What state the game is in
@@ -378,17 +468,11 @@ private:
 	// Who just won the game? -- only valid when m_eCurrentGameState == k_EGameWinner
 	uint32 m_uPlayerWhoWonGame;
 
-	// which player slots are in use
-	bool m_rgPlayersActive[MAX_PLAYERS_PER_SERVER];
+	// How many ServerPlayerUpdateData_t records follow
+	uint32 m_unPlayerSlots;
 
-	// what are the scores for each player?
-	uint32 m_rgPlayerScores[MAX_PLAYERS_PER_SERVER];
-
-	// array of ship data
-	ServerShipUpdateData_t m_rgShipData[MAX_PLAYERS_PER_SERVER];
-
-	// array of players steamids for each slot, serialized to uint64
-	uint64 m_rgPlayerSteamIDs[MAX_PLAYERS_PER_SERVER];
+	// Simulation clock on the server when this update was built, in milliseconds
+	uint32 m_unServerTime;
 };
 
 
@@ -431,6 +515,9 @@ struct ClientSpaceWarUpdateData_t
 	void SetTurnSpeed( float fSpeed ) { m_fTurnSpeed = fSpeed; }
 	float GetTurnSpeed( ) { return m_fTurnSpeed; }
 
+	void SetInputSequence( uint32 unSequence ) { m_unInputSequence = unSequence; }
+	uint32 GetInputSequence() { return m_unInputSequence; }
+
 private:
 	// Key's which are done
 	bool m_bFirePressed;
@@ -457,6 +544,10 @@ private:
 	// Thrust and rotation speed can be anlog when using a Steam Controller
 	float m_fThrusterLevel;
 	float m_fTurnSpeed;
+
+	// Goes up by one with each update the client sends, so the server can tell it which input
+	// it has applied and drop updates that arrive out of order
+	uint32 m_unInputSequence;
 };
 
 #pragma pack( pop )
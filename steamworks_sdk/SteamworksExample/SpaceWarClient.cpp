@@ -28,6 +28,8 @@
 #include "ItemStore.h"
 #include "OverlayExamples.h"
 #include "timeline.h"
+#include "ShipPredictor.h"
+#include "SnapshotInterpolator.h"
 #ifdef WIN32
 #include <direct.h>
 #else
@@ -71,16 +73,16 @@ uint32 Plat_GetTicks()
 //-----------------------------------------------------------------------------
 // Purpose: Constructor
 //-----------------------------------------------------------------------------
-CSpaceWarClient::CSpaceWarClient( IGameEngine *pGameEngine )
+CSpaceWarClient::CSpaceWarClient( IGameEngine *pGameEngine, ISpaceWarTransport *pTransport )
 {
-	Init( pGameEngine );
+	Init( pGameEngine, pTransport );
 }
 
 
 //-----------------------------------------------------------------------------
 // Purpose: initialize our client for use
 //-----------------------------------------------------------------------------
-void CSpaceWarClient::Init( IGameEngine *pGameEngine )
+void CSpaceWarClient::Init( IGameEngine *pGameEngine, ISpaceWarTransport *pTransport )
 {
 	// On PC/OSX we always know the user has a SteamID and is logged in already,
 	// as Steam enforces this before game launch.  On PS3 however the game must
@@ -106,6 +108,11 @@ void CSpaceWarClient::Init( IGameEngine *pGameEngine )
 	m_ulLastNetworkDataReceivedTime = 0;
 	m_pServer = NULL;
 	m_uPlayerShipIndex = 0;
+	m_unPlayerSlots = MAX_PLAYERS_PER_SERVER;
+	m_unLatestWorldSnapshot = WORLD_SNAPSHOT_NONE;
+	m_unAckedWorldSnapshot = WORLD_SNAPSHOT_NONE;
+	m_ulLastWorldSnapshotAckTime = 0;
+	memset( m_rgusecLaneQueueTimeMax, 0, sizeof( m_rgusecLaneQueueTimeMax ) );
 	m_eConnectedStatus = k_EClientNotConnected;
 	m_bTransitionedGameState = true;
 	m_rgchErrorText[0] = 0;
@@ -119,10 +126,14 @@ void CSpaceWarClient::Init( IGameEngine *pGameEngine )
 	m_hConnServer = k_HSteamNetConnection_Invalid;
 	m_unTicksAtLaunch = Plat_GetTicks();
 
+	m_bOwnsTransport = ( pTransport == NULL );
+	m_pTransport = pTransport ? pTransport : new CSteamNetworkingTransport( SteamNetworkingSockets(), SteamNetworkingUtils() );
+	m_pTransport->AddListener( this );
+
 	// Initialize the peer to peer connection process
 	SteamNetworkingUtils()->InitRelayNetworkAccess();
 
-	for( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	for( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER_LIMIT; ++i )
 	{
 		m_rguPlayerScores[i] = 0;
 		m_rgpShips[i] = NULL;
@@ -158,6 +169,12 @@ void CSpaceWarClient::Init( IGameEngine *pGameEngine )
 	// Initialize sun
 	m_pSun = new CSun( pGameEngine );
 
+	// Initialize prediction of our ship
+	m_pShipPredictor = new CShipPredictor( pGameEngine );
+
+	// Initialize smoothing of the other ships
+	m_pSnapshotInterpolator = new CSnapshotInterpolator( pGameEngine );
+
 	m_nNumWorkshopItems = 0;
 	for (uint32 i = 0; i < MAX_WORKSHOP_ITEMS; ++i)
 	{
@@ -165,7 +182,7 @@ void CSpaceWarClient::Init( IGameEngine *pGameEngine )
 	}
 
 	// initialize P2P auth engine
-	m_pP2PAuthedGame = new CP2PAuthedGame( m_pGameEngine );
+	m_pP2PAuthedGame = new CP2PAuthedGame( m_pGameEngine, m_pTransport );
 
 	// Create matchmaking menus
 	m_pServerBrowser = new CServerBrowser( m_pGameEngine );
@@ -188,7 +205,7 @@ void CSpaceWarClient::Init( IGameEngine *pGameEngine )
 	m_pRemoteStorage = new CRemoteStorage( pGameEngine );
 
 	// P2P voice chat 
-	m_pVoiceChat = new CVoiceChat( pGameEngine );
+	m_pVoiceChat = new CVoiceChat( pGameEngine, m_pTransport );
 
 	// HTML Surface page
 	m_pHTMLSurface = new CHTMLSurface(pGameEngine);
@@ -238,6 +255,12 @@ CSpaceWarClient::~CSpaceWarClient()
 	if ( m_pSun )
 		delete m_pSun;
 
+	if ( m_pShipPredictor )
+		delete m_pShipPredictor;
+
+	if ( m_pSnapshotInterpolator )
+		delete m_pSnapshotInterpolator;
+
 	if ( m_pStatsAndAchievements )
 		delete m_pStatsAndAchievements;
 
@@ -253,7 +276,7 @@ CSpaceWarClient::~CSpaceWarClient()
 	if ( m_pHTMLSurface )
 		delete m_pHTMLSurface;
 
-	for( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	for( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER_LIMIT; ++i )
 	{
 		if ( m_rgpShips[i] )
 		{
@@ -270,6 +293,10 @@ CSpaceWarClient::~CSpaceWarClient()
 			m_rgpWorkshopItems[i] = NULL;
 		}
 	}
+
+	m_pTransport->RemoveListener( this );
+	if ( m_bOwnsTransport )
+		delete m_pTransport;
 }
 
 
@@ -292,6 +319,31 @@ void CSpaceWarClient::DisconnectFromServer()
 		SteamUser()->BSetDurationControlOnlineState( k_EDurationControlOnlineState_Offline );
 
 		m_eConnectedStatus = k_EClientNotConnected;
+		ResetWorldSnapshots();
+
+		// Report how well we predicted our ship over the game, then start fresh for the next
+		char rgchPrediction[256];
+		sprintf_safe( rgchPrediction, "Ship prediction: %u updates checked, %u corrections (average %.2f, max %.2f pixels), %u resyncs\n",
+			m_pShipPredictor->GetUpdatesChecked(), m_pShipPredictor->GetCorrectionCount(), m_pShipPredictor->GetAverageCorrectionDistance(),
+			m_pShipPredictor->GetMaxCorrectionDistance(), m_pShipPredictor->GetResyncCount() );
+		OutputDebugString( rgchPrediction );
+		m_pShipPredictor->Reset();
+		m_pShipPredictor->ResetMetrics();
+
+		char rgchInterpolation[256];
+		sprintf_safe( rgchInterpolation, "Snapshot interpolation: update interval %.1f ms, delay %.1f ms, jitter %.1f ms, %u ship frames interpolated, %u extrapolated, %u held\n",
+			m_pSnapshotInterpolator->GetUpdateInterval(), m_pSnapshotInterpolator->GetDelay(), m_pSnapshotInterpolator->GetJitter(), m_pSnapshotInterpolator->GetInterpolatedFrames(),
+			m_pSnapshotInterpolator->GetExtrapolatedFrames(), m_pSnapshotInterpolator->GetHeldFrames() );
+		OutputDebugString( rgchInterpolation );
+		m_pSnapshotInterpolator->Reset();
+		m_pSnapshotInterpolator->ResetMetrics();
+
+		char rgchLanes[256];
+		sprintf_safe( rgchLanes, "Lane queue time: state %.1f ms, control %.1f ms, voice %.1f ms at most\n",
+			m_rgusecLaneQueueTimeMax[k_ESpaceWarLaneState] / 1000.0, m_rgusecLaneQueueTimeMax[k_ESpaceWarLaneControl] / 1000.0,
+			m_rgusecLaneQueueTimeMax[k_ESpaceWarLaneVoice] / 1000.0 );
+		OutputDebugString( rgchLanes );
+		memset( m_rgusecLaneQueueTimeMax, 0, sizeof( m_rgusecLaneQueueTimeMax ) );
 
 		UpdateScoreInGamePhase( true );
 		SteamTimeline()->EndGamePhase();
@@ -310,7 +362,7 @@ void CSpaceWarClient::DisconnectFromServer()
 	}
 
 	if ( m_hConnServer != k_HSteamNetConnection_Invalid )
-		SteamNetworkingSockets()->CloseConnection( m_hConnServer, k_EDRClientDisconnect, nullptr, false );
+		m_pTransport->CloseConnection( m_hConnServer, k_EDRClientDisconnect, nullptr, false );
 	m_steamIDGameServer = CSteamID();
 	m_steamIDGameServerFromBrowser = CSteamID();
 	m_hConnServer = k_HSteamNetConnection_Invalid;
@@ -327,7 +379,7 @@ void CSpaceWarClient::OnReceiveServerInfo( CSteamID steamIDGameServer, bool bVAC
 	m_steamIDGameServer = steamIDGameServer;
 
 	SteamNetConnectionInfo_t info;
-	SteamNetworkingSockets()->GetConnectionInfo( m_hConnServer, &info );
+	m_pTransport->GetConnectionInfo( m_hConnServer, &info );
 	m_unServerIP = info.m_addrRemote.GetIPv4();
 	m_usServerPort = info.m_addrRemote.m_port;
 
@@ -362,7 +414,7 @@ void CSpaceWarClient::OnReceiveServerInfo( CSteamID steamIDGameServer, bool bVAC
 	if ( msg.GetTokenLen() < 1 )
 		OutputDebugString( "Warning: Looks like GetAuthSessionTicket didn't give us a good ticket\n" );
 
-	BSendServerData( &msg, sizeof(msg), k_nSteamNetworkingSend_Reliable );
+	BSendServerData( &msg, msg.GetMessageSize(), k_nSteamNetworkingSend_Reliable, k_ESpaceWarLaneControl );
 }
 
 
@@ -402,11 +454,87 @@ void CSpaceWarClient::OnReceiveServerFullResponse()
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Decodes a state update from the game server against the snapshot
+//			it was encoded against, unpacks it, then applies it
+//-----------------------------------------------------------------------------
+void CSpaceWarClient::OnReceiveServerUpdateDelta( MsgServerUpdateWorldDelta_t *pMsg, uint32 cubMsgSize )
+{
+	// Updates are unreliable and can arrive out of order, anything older than what we have is no use
+	uint32 unSequence = pMsg->GetSequence();
+	if ( unSequence <= m_unLatestWorldSnapshot )
+		return;
+
+	uint32 cubSnapshot = pMsg->GetSnapshotSize();
+	if ( cubSnapshot < GetPackedWorldSnapshotSize( 0, 0 ) || cubSnapshot > GetPackedWorldSnapshotSize( MAX_PLAYERS_PER_SERVER_LIMIT, MAX_PLAYERS_PER_SERVER_LIMIT ) )
+	{
+		OutputDebugString( "Bad server world update msg\n" );
+		return;
+	}
+
+	// If we no longer have the baseline we can't decode this one, the server will fall back to a full
+	// snapshot once the baseline it is using gets too old
+	const uint8 *pubBaseline = NULL;
+	if ( pMsg->GetBaselineSequence() != WORLD_SNAPSHOT_NONE )
+	{
+		const std::vector< uint8 > *pvecBaseline = m_WorldSnapshots.FindSnapshot( pMsg->GetBaselineSequence() );
+		if ( !pvecBaseline || pvecBaseline->size() != cubSnapshot )
+			return;
+		pubBaseline = &(*pvecBaseline)[0];
+	}
+
+	m_vecWorldSnapshotBuffer.resize( cubSnapshot );
+	if ( !BDecodeWorldSnapshotDelta( pMsg->GetEncodedData(), cubMsgSize - sizeof( MsgServerUpdateWorldDelta_t ), pubBaseline, cubSnapshot, &m_vecWorldSnapshotBuffer[0] ) )
+	{
+		OutputDebugString( "Bad server world update msg\n" );
+		return;
+	}
+
+	// This checks the size matches the slot count it claims
+	if ( !BUnpackWorldSnapshot( &m_vecWorldSnapshotBuffer[0], cubSnapshot, m_vecUpdateWorldBuffer ) )
+	{
+		OutputDebugString( "Bad server world update msg\n" );
+		return;
+	}
+	MsgServerUpdateWorld_t *pUpdateMsg = (MsgServerUpdateWorld_t *)&m_vecUpdateWorldBuffer[0];
+
+	m_WorldSnapshots.AddSnapshot( unSequence, &m_vecWorldSnapshotBuffer[0], cubSnapshot );
+	m_unLatestWorldSnapshot = unSequence;
+
+	OnReceiveServerUpdate( pUpdateMsg->AccessUpdateData() );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Forget the world snapshots from the last server we were connected to
+//-----------------------------------------------------------------------------
+void CSpaceWarClient::ResetWorldSnapshots()
+{
+	m_WorldSnapshots.Clear();
+	m_unLatestWorldSnapshot = WORLD_SNAPSHOT_NONE;
+	m_unAckedWorldSnapshot = WORLD_SNAPSHOT_NONE;
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Handles receiving a state update from the game server
 //-----------------------------------------------------------------------------
 void CSpaceWarClient::OnReceiveServerUpdate( ServerSpaceWarUpdateData_t *pUpdateData )
 {
+	// Drop anything in slots the server no longer has
+	uint32 unPlayerSlots = pUpdateData->GetPlayerSlotCount();
+	for( uint32 i = unPlayerSlots; i < m_unPlayerSlots; ++i )
+	{
+		if ( m_rgpShips[i] )
+		{
+			delete m_rgpShips[i];
+			m_rgpShips[i] = NULL;
+		}
+		m_rguPlayerScores[i] = 0;
+		m_rgSteamIDPlayers[i] = CSteamID();
+	}
+	m_unPlayerSlots = unPlayerSlots;
+
 	// Update our client state based on what the server tells us
 	
 	switch( pUpdateData->GetServerGameState() )
@@ -459,10 +587,13 @@ void CSpaceWarClient::OnReceiveServerUpdate( ServerSpaceWarUpdateData_t *pUpdate
 		break;
 	}
 
-	// Update scores
+	// Update scores, players the server left out of this update keep what they had
 	bool bScoresChanged = false;
-	for( int i=0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	for( uint32 i=0; i < m_unPlayerSlots; ++i )
 	{
+		if ( !pUpdateData->GetPlayerIncluded( i ) )
+			continue;
+
 		m_rguPlayerScores[i] = pUpdateData->GetPlayerScore(i);
 		bScoresChanged = bScoresChanged || m_rguPlayerScores[ i ] != pUpdateData->GetPlayerScore( i );
 	}
@@ -481,8 +612,11 @@ void CSpaceWarClient::OnReceiveServerUpdate( ServerSpaceWarUpdateData_t *pUpdate
 		{
 			// if i am the server owner i need to auth everyone who wants to play
 			// assume i am in slot 0, so start at slot 1
-			for( uint32 i=1; i < MAX_PLAYERS_PER_SERVER; ++i )
+			for( uint32 i=1; i < m_unPlayerSlots; ++i )
 			{
+				if ( !pUpdateData->GetPlayerIncluded( i ) )
+					continue;
+
 				CSteamID steamIDNew( pUpdateData->GetPlayerSteamID(i) );
 				if ( steamIDNew == SteamUser()->GetSteamID() )
 				{
@@ -501,7 +635,7 @@ void CSpaceWarClient::OnReceiveServerUpdate( ServerSpaceWarUpdateData_t *pUpdate
 				}
 			}
 		}
-		else
+		else if ( m_unPlayerSlots > 0 && pUpdateData->GetPlayerIncluded( 0 ) )
 		{
 			// i am just a client, i need to auth the game owner ( slot 0 )
 			CSteamID steamIDNew( pUpdateData->GetPlayerSteamID( 0 ) );
@@ -524,23 +658,36 @@ void CSpaceWarClient::OnReceiveServerUpdate( ServerSpaceWarUpdateData_t *pUpdate
 		}
 	}
 
+	// Remember where everyone else's ship is in this update, to draw them between updates
+	m_pSnapshotInterpolator->OnReceiveServerUpdate( pUpdateData, m_uPlayerShipIndex );
+
 	// update all players that are active
 	if ( m_pVoiceChat )
 		m_pVoiceChat->MarkAllPlayersInactive();
 
 	// Update the players
-	for( uint32 i=0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	for( uint32 i=0; i < m_unPlayerSlots; ++i )
 	{
+		// Players the server left out of this update keep what they had
+		bool bIncluded = pUpdateData->GetPlayerIncluded( i );
+
 		// Update steamid array with data from server
-		m_rgSteamIDPlayers[i].SetFromUint64( pUpdateData->GetPlayerSteamID( i ) );
+		if ( bIncluded )
+			m_rgSteamIDPlayers[i].SetFromUint64( pUpdateData->GetPlayerSteamID( i ) );
 
-		if ( pUpdateData->GetPlayerActive( i ) )
+		if ( pUpdateData->GetPlayerActive( i ) && !bIncluded )
+		{
+			// Their ship, if we have it yet, carries on from its last update
+			if ( m_pVoiceChat && m_rgSteamIDPlayers[i].IsValid() )
+				m_pVoiceChat->MarkPlayerAsActive( m_rgSteamIDPlayers[i] );
+		}
+		else if ( pUpdateData->GetPlayerActive( i ) )
 		{
 			// Check if we have a ship created locally for this player slot, if not create it
 			if ( !m_rgpShips[i] )
 			{
 				ServerShipUpdateData_t *pShipData = pUpdateData->AccessShipUpdateData( i );
-				m_rgpShips[i] = new CShip( m_pGameEngine, false, pShipData->GetXPosition(), pShipData->GetYPosition(), g_rgPlayerColors[i] );
+				m_rgpShips[i] = new CShip( m_pGameEngine, false, pShipData->GetXPosition(), pShipData->GetYPosition(), GetPlayerColor( i ) );
 				if ( i == m_uPlayerShipIndex )
 				{
 					// If this is our local ship, then setup key bindings appropriately
@@ -559,6 +706,15 @@ void CSpaceWarClient::OnReceiveServerUpdate( ServerSpaceWarUpdateData_t *pUpdate
 
 			m_rgpShips[i]->OnReceiveServerUpdate( pUpdateData->AccessShipUpdateData( i ) );			
 
+			// Check where we predicted our own ship against where the server has it
+			if ( i == m_uPlayerShipIndex )
+			{
+				if ( m_eGameState == k_EClientGameActive )
+					m_pShipPredictor->OnReceiveServerUpdate( pUpdateData->AccessShipUpdateData( i ) );
+				else
+					m_pShipPredictor->Reset();
+			}
+
 			if ( m_pVoiceChat )
 				m_pVoiceChat->MarkPlayerAsActive( m_rgSteamIDPlayers[i] );
 		}
@@ -608,9 +764,9 @@ void CSpaceWarClient::SetConnectionFailureText( const char *pchErrorText )
 //-----------------------------------------------------------------------------
 // Purpose: Send data to the current server
 //-----------------------------------------------------------------------------
-bool CSpaceWarClient::BSendServerData( const void *pData, uint32 nSizeOfData, int nSendFlags )
+bool CSpaceWarClient::BSendServerData( const void *pData, uint32 nSizeOfData, int nSendFlags, ESpaceWarLane eLane )
 {
-	EResult res = SteamNetworkingSockets()->SendMessageToConnection( m_hConnServer, pData, nSizeOfData, nSendFlags, nullptr );
+	EResult res = SendMessageToConnectionOnLane( m_pTransport, m_hConnServer, pData, nSizeOfData, nSendFlags, eLane, nullptr );
 	switch (res)
 	{
 		case k_EResultOK:
@@ -652,6 +808,7 @@ void CSpaceWarClient::InitiateServerConnection( uint32 unServerAddress, const in
 	}
 
 	SetGameState( k_EClientGameConnecting );
+	ResetWorldSnapshots();
 
 	// Update when we last retried the connection, as well as the last packet received time so we won't timeout too soon,
 	// and so we will retry at appropriate intervals if packets drop
@@ -675,13 +832,17 @@ void CSpaceWarClient::InitiateServerConnection( CSteamID steamIDGameServer )
 	}
 
 	SetGameState( k_EClientGameConnecting );
+	ResetWorldSnapshots();
 
 	m_steamIDGameServerFromBrowser = m_steamIDGameServer = steamIDGameServer;
 
 	SteamNetworkingIdentity identity;
 	identity.SetSteamID(steamIDGameServer);
 
-	m_hConnServer = SteamNetworkingSockets()->ConnectP2P( identity, 0, 0, nullptr );
+	m_hConnServer = m_pTransport->ConnectP2P( identity, 0 );
+
+	// Keep our input and acks from queuing up behind voice or a big auth ticket
+	m_pTransport->ConfigureConnectionLanes( m_hConnServer, k_ESpaceWarLaneCount, k_rgnSpaceWarLanePriorities, k_rgunSpaceWarLaneWeights );
 	if ( m_pVoiceChat )
 		m_pVoiceChat->m_hConnServer = m_hConnServer;
 	if ( m_pP2PAuthedGame )
@@ -720,7 +881,7 @@ void CSpaceWarClient::OnNetConnectionStatusChanged(SteamNetConnectionStatusChang
 		m_info.m_eState == k_ESteamNetworkingConnectionState_ClosedByPeer)
 	{
 		// close the connection with the server
-		SteamNetworkingSockets()->CloseConnection(m_hConn, m_info.m_eEndReason, nullptr, false);
+		m_pTransport->CloseConnection(m_hConn, m_info.m_eEndReason, nullptr, false);
 		switch (m_info.m_eEndReason)
 		{
 		case k_EDRServerReject:
@@ -739,7 +900,7 @@ void CSpaceWarClient::OnNetConnectionStatusChanged(SteamNetConnectionStatusChang
 	{
 		// failed, error out
 		OutputDebugString("Failed to make P2P connection, quiting server\n");
-		SteamNetworkingSockets()->CloseConnection(m_hConn, m_info.m_eEndReason, nullptr, false);
+		m_pTransport->CloseConnection(m_hConn, m_info.m_eEndReason, nullptr, false);
 		OnReceiveServerExiting();
 	}
 }
@@ -750,13 +911,14 @@ void CSpaceWarClient::OnNetConnectionStatusChanged(SteamNetConnectionStatusChang
 //-----------------------------------------------------------------------------
 void CSpaceWarClient::ReceiveNetworkData()
 {
-	if ( !SteamNetworkingSockets() )
-		return;
+	// Let a transport that holds messages back pass on the ones that are due
+	m_pTransport->RunCallbacks();
+
 	if ( m_hConnServer == k_HSteamNetConnection_Invalid )
 		return;
 
 	SteamNetworkingMessage_t* msgs[32];
-	int res = SteamNetworkingSockets()->ReceiveMessagesOnConnection(m_hConnServer, msgs, 32);
+	int res = m_pTransport->ReceiveMessagesOnConnection(m_hConnServer, msgs, 32);
 	for (int i = 0; i < res; i++)
 	{
 		SteamNetworkingMessage_t* message = msgs[i];
@@ -813,16 +975,15 @@ void CSpaceWarClient::ReceiveNetworkData()
 			OnReceiveServerAuthenticationResponse(false, 0);
 		}
 		break;
-		case k_EMsgServerUpdateWorld:
+		case k_EMsgServerUpdateWorldDelta:
 		{
-			if (cubMsgSize != sizeof(MsgServerUpdateWorld_t))
+			if (cubMsgSize < sizeof(MsgServerUpdateWorldDelta_t))
 			{
 				OutputDebugString("Bad server world update msg\n");
 				break;
 			}
 
-			MsgServerUpdateWorld_t* pMsg = (MsgServerUpdateWorld_t*)message->GetData();
-			OnReceiveServerUpdate(pMsg->AccessUpdateData());
+			OnReceiveServerUpdateDelta((MsgServerUpdateWorldDelta_t*)message->GetData(), cubMsgSize);
 		}
 		break;
 		case k_EMsgServerExiting:
@@ -1137,7 +1298,7 @@ const char *CSpaceWarClient::SetInGameRichPresence() const
 	uint32 cWinners = 0;
 	uint32 uHighScore = m_rguPlayerScores[0];
 	uint32 uMyScore = 0;
-	for ( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	for ( uint32 i = 0; i < m_unPlayerSlots; ++i )
 	{
 		if ( m_rguPlayerScores[i] > uHighScore )
 		{
@@ -1641,7 +1802,7 @@ void CSpaceWarClient::RunFrame()
 
 		// Update all the entities (this is client side interpolation)...
 		m_pSun->RunFrame();
-		for( uint32 i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
+		for( uint32 i=0; i<m_unPlayerSlots; ++i )
 		{
 			if ( m_rgpShips[i] )
 				m_rgpShips[i]->RunFrame();
@@ -1755,7 +1916,7 @@ void CSpaceWarClient::RunFrame()
 
 		// Update all the entities (this is client side interpolation)...
 		m_pSun->RunFrame();
-		for( uint32 i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
+		for( uint32 i=0; i<m_unPlayerSlots; ++i )
 		{
 			if ( m_rgpShips[i] )
 				m_rgpShips[i]->RunFrame();
@@ -1783,12 +1944,20 @@ void CSpaceWarClient::RunFrame()
 
 		// Update all the entities...
 		m_pSun->RunFrame();
-		for( uint32 i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
+		for( uint32 i=0; i<m_unPlayerSlots; ++i )
 		{
 			if ( m_rgpShips[i] )
 				m_rgpShips[i]->RunFrame();
 		}
 
+		// Everyone else's ships are drawn a little in the past, between the updates either side
+		m_pSnapshotInterpolator->RunFrame( m_rgpShips, m_unPlayerSlots, m_uPlayerShipIndex );
+
+		// Our own ship goes where the server will have it once it gets our input, rather than
+		// waiting a round trip to see it move
+		if ( m_uPlayerShipIndex < m_unPlayerSlots && m_rgpShips[ m_uPlayerShipIndex ] )
+			m_pShipPredictor->RunFrame( m_rgpShips[ m_uPlayerShipIndex ] );
+
 		for (uint32 i = 0; i < MAX_WORKSHOP_ITEMS; ++i)
 		{
 			if (m_rgpWorkshopItems[i])
@@ -1874,7 +2043,32 @@ void CSpaceWarClient::RunFrame()
 		// That's OK, because we would rather just send a new, update message, instead of
 		// retransmitting the old one.
 		if ( m_rgpShips[ m_uPlayerShipIndex ]->BGetClientUpdateData( msg.AccessUpdateData() ) )
-			BSendServerData( &msg, sizeof( msg ), k_nSteamNetworkingSend_Unreliable );
+		{
+			m_pShipPredictor->OnSendInput( msg.AccessUpdateData() );
+			BSendServerData( &msg, sizeof( msg ), k_nSteamNetworkingSend_Unreliable, k_ESpaceWarLaneState );
+		}
+
+		SteamNetConnectionRealTimeLaneStatus_t rgLaneStatus[k_ESpaceWarLaneCount];
+		if ( m_pTransport->GetConnectionRealTimeStatus( m_hConnServer, NULL, k_ESpaceWarLaneCount, rgLaneStatus ) == k_EResultOK )
+		{
+			for ( uint32 iLane = 0; iLane < k_ESpaceWarLaneCount; ++iLane )
+				m_rgusecLaneQueueTimeMax[iLane] = MAX( m_rgusecLaneQueueTimeMax[iLane], rgLaneStatus[iLane].m_usecQueueTime );
+		}
+	}
+
+	// Let the server know the newest world update we have, so it can send just what changed since
+	if ( m_eConnectedStatus == k_EClientConnectedAndAuthenticated && m_unLatestWorldSnapshot != m_unAckedWorldSnapshot &&
+		m_pGameEngine->GetGameTickCount() - m_ulLastWorldSnapshotAckTime >= 1000.0f/CLIENT_UPDATE_SEND_RATE )
+	{
+		MsgClientAckWorldSnapshot_t msg;
+		msg.SetSequence( m_unLatestWorldSnapshot );
+
+		// Unreliable too, if it gets lost the server just keeps using an older baseline
+		if ( BSendServerData( &msg, sizeof( msg ), k_nSteamNetworkingSend_Unreliable, k_ESpaceWarLaneState ) )
+		{
+			m_unAckedWorldSnapshot = m_unLatestWorldSnapshot;
+			m_ulLastWorldSnapshotAckTime = m_pGameEngine->GetGameTickCount();
+		}
 	}
 
 	if ( m_pP2PAuthedGame )
@@ -1884,7 +2078,7 @@ void CSpaceWarClient::RunFrame()
 			// Now if we are the owner of the game, lets make sure all of our players are legit.
 			// if they are not, we tell the server to kick them off
 			// Start at 1 to skip myself
-			for ( int i = 1; i < MAX_PLAYERS_PER_SERVER; i++ )
+			for ( uint32 i = 1; i < m_unPlayerSlots; i++ )
 			{
 				if ( m_pP2PAuthedGame->m_rgpP2PAuthPlayer[i] && !m_pP2PAuthedGame->m_rgpP2PAuthPlayer[i]->BIsAuthOk() )
 				{
@@ -1914,7 +2108,7 @@ void CSpaceWarClient::RunFrame()
 	}
 
 	// Accumulate stats
-	for( uint32 i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
+	for( uint32 i=0; i<m_unPlayerSlots; ++i )
 	{
 		if ( m_rgpShips[i] )
 			m_rgpShips[i]->AccumulateStats( m_pStatsAndAchievements );
@@ -1928,7 +2122,7 @@ void CSpaceWarClient::RunFrame()
 	case k_EClientGameActive:
 		// Now render all the objects
 		m_pSun->Render();
-		for( uint32 i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
+		for( uint32 i=0; i<m_unPlayerSlots; ++i )
 		{
 			if ( m_rgpShips[i] )
 				m_rgpShips[i]->Render();
@@ -2004,8 +2198,9 @@ void CSpaceWarClient::DrawHUDText()
 
 	LONG scorewidth = LONG((m_pGameEngine->GetViewportWidth() - nHudPaddingHorizontal*2.0f)/4.0f);
 
+	// Only the default number of players have a corner of the HUD to draw in
 	char rgchBuffer[256];
-	for( uint32 i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
+	for( uint32 i=0; i<MIN( m_unPlayerSlots, (uint32)MAX_PLAYERS_PER_SERVER ); ++i )
 	{
 		// Draw nothing in the spot for an inactive player
 		if ( !m_rgpShips[i] )
@@ -2297,7 +2492,7 @@ void CSpaceWarClient::DrawWinnerDrawOrWaitingText()
 	} 
 	else if ( m_eGameState == k_EClientGameWinner )
 	{
-		if ( m_uPlayerWhoWonGame >= MAX_PLAYERS_PER_SERVER )
+		if ( m_uPlayerWhoWonGame >= m_unPlayerSlots )
 		{
 			OutputDebugString( "Invalid winner value\n" );
 			return;
@@ -2341,7 +2536,7 @@ bool CSpaceWarClient::BLocalPlayerWonLastGame()
 {
 	if ( m_eGameState == k_EClientGameWinner )
 	{
-		if ( m_uPlayerWhoWonGame >= MAX_PLAYERS_PER_SERVER )
+		if ( m_uPlayerWhoWonGame >= m_unPlayerSlots )
 		{
 			// ur
 			return false;
@@ -2816,7 +3011,7 @@ void CSpaceWarClient::UpdateScoreInGamePhase( bool bFinal )
 {
 	std::string strScores;
 	uint32 unHighScore = 0;
-	for ( int i = 0; i < MAX_PLAYERS_PER_SERVER; i++ )
+	for ( uint32 i = 0; i < m_unPlayerSlots; i++ )
 	{
 		if ( !strScores.empty() )
 			strScores += " / ";
@@ -2825,7 +3020,7 @@ void CSpaceWarClient::UpdateScoreInGamePhase( bool bFinal )
 	}
 
 	uint32 unCountAtHighScore = 0;
-	for ( int i = 0; i < MAX_PLAYERS_PER_SERVER; i++ )
+	for ( uint32 i = 0; i < m_unPlayerSlots; i++ )
 	{
 		if ( m_rguPlayerScores[ i ] == unHighScore )
 			unCountAtHighScore++;
@@ -12,6 +12,7 @@
 #include "GameEngine.h"
 #include "SpaceWar.h"
 #include "Messages.h"
+#include "WorldSnapshot.h"
 #include "StarField.h"
 #include "Sun.h"
 #include "Ship.h"
@@ -20,6 +21,7 @@
 #include "musicplayer.h"
 #include "steam/isteamnetworkingsockets.h"
 #include "steam/isteamnetworkingutils.h"
+#include "SpaceWarTransport.h"
 
 // Forward class declaration
 class CConnectingMenu;
@@ -40,6 +42,8 @@ class CRemotePlayList;
 class CItemStore;
 class COverlayExamples;
 class CTimeline;
+class CShipPredictor;
+class CSnapshotInterpolator;
 
 // Height of the HUD font
 #define HUD_FONT_HEIGHT 18
@@ -158,14 +162,15 @@ struct OverlayExample_t
 };
 
 
-class CSpaceWarClient 
+class CSpaceWarClient : public ISpaceWarTransportListener
 {
 public:
-	//Constructor
-	CSpaceWarClient( IGameEngine *pEngine );
+	// Constructor.  We connect to servers over pTransport, or over SteamNetworkingSockets() if
+	// it's NULL.
+	CSpaceWarClient( IGameEngine *pEngine, ISpaceWarTransport *pTransport = NULL );
 
 	// Shared init for all constructors
-	void Init( IGameEngine *pGameEngine );
+	void Init( IGameEngine *pGameEngine, ISpaceWarTransport *pTransport );
 
 	// Destructor
 	~CSpaceWarClient();
@@ -185,8 +190,8 @@ public:
 	void InitiateServerConnection( CSteamID steamIDGameServer );
 	void InitiateServerConnection( uint32 unServerAddress, const int32 nPort );
 
-	// Send data to a client at the given ship index
-	bool BSendServerData( const void *pData, uint32 nSizeOfData, int nSendFlags );
+	// Send data to the server on one of the lanes in ESpaceWarLane
+	bool BSendServerData( const void *pData, uint32 nSizeOfData, int nSendFlags, ESpaceWarLane eLane );
 
 	// Menu callback handler (handles a bunch of menus that just change state with no extra data)
 	void OnMenuSelection( EClientGameState eState ) { SetGameState( eState ); }
@@ -274,6 +279,12 @@ private:
 	// Receive a state update from the server
 	void OnReceiveServerUpdate( ServerSpaceWarUpdateData_t *pUpdateData );
 
+	// Decode a delta encoded state update from the server and apply it
+	void OnReceiveServerUpdateDelta( MsgServerUpdateWorldDelta_t *pMsg, uint32 cubMsgSize );
+
+	// Forget the world snapshots from the last server we were connected to
+	void ResetWorldSnapshots();
+
 	// Handle the server exiting
 	void OnReceiveServerExiting();
 
@@ -334,14 +345,18 @@ private:
 	// Our ship position in the array below
 	uint32 m_uPlayerShipIndex;
 
+	// Number of player slots the server we are connected to has (from its last world update),
+	// only the first m_unPlayerSlots entries of the arrays below are used
+	uint32 m_unPlayerSlots;
+
 	// List of steamIDs for each player
-	CSteamID m_rgSteamIDPlayers[MAX_PLAYERS_PER_SERVER];
+	CSteamID m_rgSteamIDPlayers[MAX_PLAYERS_PER_SERVER_LIMIT];
 
 	// Ships for players, doubles as a way to check for open slots (pointer is NULL meaning open)
-	CShip *m_rgpShips[MAX_PLAYERS_PER_SERVER];
+	CShip *m_rgpShips[MAX_PLAYERS_PER_SERVER_LIMIT];
 
 	// Player scores
-	uint32 m_rguPlayerScores[MAX_PLAYERS_PER_SERVER];
+	uint32 m_rguPlayerScores[MAX_PLAYERS_PER_SERVER_LIMIT];
 
 	// Who just won the game? Should be set if we go into the k_EGameWinner state
 	uint32 m_uPlayerWhoWonGame;
@@ -370,6 +385,23 @@ private:
 	// Time we last got data from the server
 	uint64 m_ulLastNetworkDataReceivedTime;
 
+	// World snapshots we have got from the server, to decode later deltas against
+	CWorldSnapshotHistory m_WorldSnapshots;
+
+	// Newest world snapshot we have got, and the newest we have told the server about
+	uint32 m_unLatestWorldSnapshot;
+	uint32 m_unAckedWorldSnapshot;
+
+	// Time we last acked a world snapshot
+	uint64 m_ulLastWorldSnapshotAckTime;
+
+	// Longest our messages have waited to go out on each lane this game, reported when we leave
+	SteamNetworkingMicroseconds m_rgusecLaneQueueTimeMax[k_ESpaceWarLaneCount];
+
+	// Buffer world snapshots are decoded into, and the buffer they're unpacked into
+	std::vector< uint8 > m_vecWorldSnapshotBuffer;
+	std::vector< uint8 > m_vecUpdateWorldBuffer;
+
 	// Time when we sent our ping
 	uint64 m_ulPingSentTime;
 
@@ -384,6 +416,10 @@ private:
 	HAuthTicket m_hAuthTicket;
 	HSteamNetConnection m_hConnServer;
 
+	// What we connect to servers over, and whether we made it (and so have to delete it)
+	ISpaceWarTransport *m_pTransport;
+	bool m_bOwnsTransport;
+
 	// keep track of if we opened the overlay for a gamewebcallback
 	bool m_bSentWebOpen;
 
@@ -446,6 +482,12 @@ private:
 	// Sun instance
 	CSun *m_pSun;
 
+	// Predicts where our own ship is ahead of the server's updates
+	CShipPredictor *m_pShipPredictor;
+
+	// Smooths everyone else's ships between the server's updates
+	CSnapshotInterpolator *m_pSnapshotInterpolator;
+
 	// Steam Workshop items
 	CWorkshopItem *m_rgpWorkshopItems[ MAX_WORKSHOP_ITEMS ];
 	int m_nNumWorkshopItems; // items in m_rgpWorkshopItem
@@ -547,6 +589,9 @@ private:
 	// Called when we get new connections, or the state of a connection changes
 	STEAM_CALLBACK(CSpaceWarClient, OnNetConnectionStatusChanged, SteamNetConnectionStatusChangedCallback_t);
 
+	// Connection changes on a transport that delivers its own, rather than through Steam
+	void OnConnectionStatusChanged( SteamNetConnectionStatusChangedCallback_t *pCallback ) { OnNetConnectionStatusChanged( pCallback ); }
+
 	// ipc failure handler
 	STEAM_CALLBACK( CSpaceWarClient, OnIPCFailure, IPCFailure_t );
 
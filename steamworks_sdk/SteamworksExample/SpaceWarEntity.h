@@ -1,7 +1,7 @@
 //========= Copyright  1996-2008, Valve LLC, All rights reserved. ============
 //
-// Purpose: A SpaceWarEntity is just like a VectorEntity, except it knows how
-//			to apply gravity from the SpaceWar Sun
+// Purpose: A SpaceWarEntity is just like a VectorEntity, except it can be
+//			affected by gravity from the SpaceWar Sun
 //
 // $NoKeywords: $
 //=============================================================================
@@ -16,16 +16,10 @@ class CSpaceWarEntity : public CVectorEntity
 {
 public:
 	// Constructor
-	CSpaceWarEntity( IGameEngine *pGameEngine, uint32 uCollisionRadius, bool bAffectedByGravity );
+	CSpaceWarEntity( IGameEngine *pGameEngine, uint32 uCollisionRadius, bool bAffectedByGravity, CVectorEntityStatePool *pStatePool = NULL );
 
 	// Destructor
 	virtual ~CSpaceWarEntity() { return; }
-
-	// Run Frame
-	void RunFrame();
-
-private:
-	bool m_bAffectedByGravity;
 };
 
 #endif // SPACEWARENTITY_H
\ No newline at end of file
@@ -8,17 +8,24 @@
 #include "stdafx.h"
 #include "SpaceWarServer.h"
 #include "SpaceWarClient.h"
+#include "ReplayLog.h"
+#include "AllocationCounter.h"
 #include "stdlib.h"
 #include "time.h"
 #include <math.h>
+#include <algorithm>
+#include <functional>
 
 
 //-----------------------------------------------------------------------------
 // Purpose: Constructor -- note the syntax for setting up Steam API callback handlers
 //-----------------------------------------------------------------------------
-CSpaceWarServer::CSpaceWarServer( IGameEngine *pGameEngine ) 
+CSpaceWarServer::CSpaceWarServer( IGameEngine *pGameEngine, bool bHostedMatch, int nVirtualPort, uint32 unMaxPlayers, ISpaceWarTransport *pTransport ) 
+	: m_SimulationEngine( pGameEngine->GetViewportWidth(), pGameEngine->GetViewportHeight() )
 {
 	m_bConnectedToSteam = false;
+	m_bHostedMatch = bHostedMatch;
+	m_pReplayRecorder = NULL;
 
 
 	const char *pchGameDir = "spacewar";
@@ -37,15 +44,25 @@ CSpaceWarServer::CSpaceWarServer( IGameEngine *pGameEngine )
 
 	// !FIXME! We need a way to pass the dedicated server flag here!
 
+	// A hosted match shares the SteamGameServer the match host already initialized
 	SteamErrMsg errMsg = { 0 };
-	if ( SteamGameServer_InitEx( unIP, SPACEWAR_SERVER_PORT, usMasterServerUpdaterPort, eMode, SPACEWAR_SERVER_VERSION, &errMsg ) != k_ESteamAPIInitResult_OK )
+	if ( m_bHostedMatch )
+	{
+		m_bConnectedToSteam = SteamGameServer() && SteamGameServer()->BLoggedOn();
+		m_sServerName = "Spacewar!";
+	}
+	else if ( SteamGameServer_InitEx( unIP, SPACEWAR_SERVER_PORT, usMasterServerUpdaterPort, eMode, SPACEWAR_SERVER_VERSION, &errMsg ) != k_ESteamAPIInitResult_OK )
 	{
 		OutputDebugString( "SteamGameServer_Init call failed: " );
 		OutputDebugString( errMsg );
 		OutputDebugString( "\n" );
 	}
 
-	if ( SteamGameServer() )
+	if ( m_bHostedMatch )
+	{
+		// Nothing to set up, the match host did it for the whole process
+	}
+	else if ( SteamGameServer() )
 	{
 
 		// Set the "game dir".
@@ -88,35 +105,81 @@ CSpaceWarServer::CSpaceWarServer( IGameEngine *pGameEngine )
 	m_pGameEngine = pGameEngine;
 	m_eGameState = k_EServerWaitingForPlayers;
 
-	for( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i )
-	{
-		m_rguPlayerScores[i] = 0;
-		m_rgpShips[i] = NULL;
-	}
+	// Size all the per player data for our player cap
+	m_unMaxPlayers = MAX( 1u, MIN( unMaxPlayers, (uint32)MAX_PLAYERS_PER_SERVER_LIMIT ) );
+	m_vecPlayerScores.assign( m_unMaxPlayers, 0 );
+	m_vecpShips.assign( m_unMaxPlayers, NULL );
+	m_EntityStatePool.SetBatchIntegrated( true );
+	m_ShipPool.Init( m_unMaxPlayers );
+	m_EntityStatePool.Reserve( 1 + m_unMaxPlayers * SHIP_STATE_POOL_SLOTS );
+	m_CollisionGrid.Reserve( 1 + m_unMaxPlayers * SHIP_STATE_POOL_SLOTS, m_unMaxPlayers );
+	m_CollisionGrid.Init( (float)m_pGameEngine->GetViewportWidth(), (float)m_pGameEngine->GetViewportHeight(), COLLISION_GRID_CELL_SIZE );
+	m_cSimulationAllocations = 0;
+	m_vecExplodingShips.assign( m_unMaxPlayers, false );
+	m_vecShipCollisionXPos.resize( m_unMaxPlayers );
+	m_vecShipCollisionYPos.resize( m_unMaxPlayers );
+	m_vecShipCollisionRadius.resize( m_unMaxPlayers );
+	m_vecUpdateWorldBuffer.resize( MsgServerUpdateWorld_t::GetMessageSize( m_unMaxPlayers ) );
+	m_vecPackedWorldBuffer.resize( GetPackedWorldSnapshotSize( m_unMaxPlayers, CRelevancyFilter::GetLaneCount( m_unMaxPlayers ) ) );
+	m_vecpWorldUpdateMessages.reserve( m_unMaxPlayers );
+	m_vecBroadcastConnections.reserve( m_unMaxPlayers );
+	m_vecpBroadcastMessages.reserve( m_unMaxPlayers );
+	memset( m_rgusecLaneQueueTimeMax, 0, sizeof( m_rgusecLaneQueueTimeMax ) );
 
 	// No one has won
 	m_uPlayerWhoWonGame = 0;
-	m_ulStateTransitionTime = m_pGameEngine->GetGameTickCount();
 	m_ulLastServerUpdateTick = 0;
+	m_unWorldSnapshotSequence = WORLD_SNAPSHOT_NONE;
 
 	// zero the client connection data
-	memset( &m_rgClientData, 0, sizeof( m_rgClientData ) );
-	memset( &m_rgPendingClientData, 0, sizeof( m_rgPendingClientData ) );
+	m_vecClientData.assign( m_unMaxPlayers, ClientConnectionData_t() );
+	m_mapSteamIDToSlot.Init( m_unMaxPlayers );
+
+	// Every slot is free, in order, which is already a heap
+	m_vecFreeSlots.reserve( m_unMaxPlayers );
+	for ( uint32 i = 0; i < m_unMaxPlayers; ++i )
+		m_vecFreeSlots.push_back( i );
+
+	// A timeout for every player and logon, and one for publishing our details
+	m_Timers.Init( m_pGameEngine->GetGameTickCount(), 2 * m_unMaxPlayers + 1 );
+	m_SimulationTimers.Init( m_SimulationEngine.GetGameTickCount(), 1 );
+
+	// Wait a few seconds before starting, the same as between rounds
+	m_bRoundStateTimerExpired = false;
+	m_hRoundStateTimer = m_SimulationTimers.Arm( m_SimulationEngine.GetGameTickCount() + MILLISECONDS_BETWEEN_ROUNDS, this, (uint64)k_EServerTimerRoundState << 32 );
+
+	// Publish our details on the first frame, then every so often
+	if ( !m_bHostedMatch )
+		m_Timers.Arm( m_pGameEngine->GetGameTickCount(), this, (uint64)k_EServerTimerServerDetails << 32 );
 
 	// Seed random num generator
 	srand( (uint32)time( NULL ) );
 
 	// Initialize sun
-	m_pSun = new CSun( pGameEngine );
+	m_pSun = new CSun( &m_SimulationEngine, &m_EntityStatePool );
 
 	// Initialize ships
 	ResetPlayerShips();
 
-	// create the listen socket for listening for players connecting
-	m_hListenSocket = SteamGameServerNetworkingSockets()->CreateListenSocketP2P(0, 0, nullptr);
+	// Players connect over Steam unless we were given something else to use
+	m_bOwnsTransport = ( pTransport == NULL );
+	m_pTransport = pTransport ? pTransport : new CSteamNetworkingTransport( SteamGameServerNetworkingSockets(), SteamNetworkingUtils() );
+	m_pTransport->AddListener( this );
+
+	// Tickets are checked with Steam, unless there's no Steam auth or nobody outside the process
+	// can reach us
+#ifdef USE_GS_AUTH_API
+	m_pDefaultAuthValidator = m_pTransport->BIsInProcess() ? (IAuthValidator *)&m_TrustingAuthValidator : &m_SteamAuthValidator;
+#else
+	m_pDefaultAuthValidator = &m_TrustingAuthValidator;
+#endif
+	m_AuthPipeline.Init( m_unMaxPlayers, m_pDefaultAuthValidator, this, &m_Timers );
+
+	// create the listen socket for listening for players connecting, hosted matches each get their own virtual port
+	m_hListenSocket = m_pTransport->CreateListenSocketP2P(nVirtualPort);
 
 	// create the poll group
-	m_hNetPollGroup = SteamGameServerNetworkingSockets()->CreatePollGroup();
+	m_hNetPollGroup = m_pTransport->CreatePollGroup();
 }
 
 
@@ -125,23 +188,32 @@ CSpaceWarServer::CSpaceWarServer( IGameEngine *pGameEngine )
 //-----------------------------------------------------------------------------
 CSpaceWarServer::~CSpaceWarServer()
 {
+	StopRecording();
+
 	delete m_pSun;
 
-	for( uint32 i=0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	for( uint32 i=0; i < m_unMaxPlayers; ++i )
 	{
-		if ( m_rgpShips[i] )
+		if ( m_vecpShips[i] )
 		{
 			// Tell this client we are exiting
 			MsgServerExiting_t msg;
 			BSendDataToClient( i, (char*)&msg, sizeof(msg) );
 
-			delete m_rgpShips[i];
-			m_rgpShips[i] = NULL;
+			m_ShipPool.Free( m_vecpShips[i] );
+			m_vecpShips[i] = NULL;
 		}
 	}
 
-	SteamGameServerNetworkingSockets()->CloseListenSocket(m_hListenSocket);
-	SteamGameServerNetworkingSockets()->DestroyPollGroup(m_hNetPollGroup);
+	m_pTransport->CloseListenSocket(m_hListenSocket);
+	m_pTransport->DestroyPollGroup(m_hNetPollGroup);
+	m_pTransport->RemoveListener( this );
+	if ( m_bOwnsTransport )
+		delete m_pTransport;
+
+	// The match host owns the Steam connection
+	if ( m_bHostedMatch )
+		return;
 
 	// Disconnect from the steam servers
 	SteamGameServer()->LogOff();
@@ -166,69 +238,90 @@ void CSpaceWarServer::OnNetConnectionStatusChanged(SteamNetConnectionStatusChang
 
 	// Parse information to know what was changed
 
-	// Check if a client has connected
-	if (info.m_hListenSocket && 
+	// Check if a client has connected.  Hosted matches all get this callback, only take
+	// connections made to our own listen socket
+	if (info.m_hListenSocket && info.m_hListenSocket == m_hListenSocket &&
 		eOldState == k_ESteamNetworkingConnectionState_None && 
 		info.m_eState == k_ESteamNetworkingConnectionState_Connecting)
 	{
 		// Connection from a new client
-		// Search for an available slot
-		for (uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i)
+		uint64 ulTickCount = m_pGameEngine->GetGameTickCount();
+
+		// Turn away an address opening connections faster than anyone playing would
+		if ( !m_AuthPipeline.BAllowConnectionFrom( info.m_addrRemote, ulTickCount ) )
 		{
-			if (!m_rgClientData[i].m_bActive && !m_rgPendingClientData[i].m_hConn)
-			{
+			OutputDebugString( "Rejecting connection; too many from one address\n" );
+			m_pTransport->CloseConnection( hConn, k_EDRServerReject, "Too many connections", false );
+			return;
+		}
 
-				// Found one.  "Accept" the connection.
-				EResult res = SteamGameServerNetworkingSockets()->AcceptConnection( hConn );
-				if ( res != k_EResultOK )
-				{
-					char msg[ 256 ];
-					sprintf( msg, "AcceptConnection returned %d", res );
-					OutputDebugString( msg );
-					SteamGameServerNetworkingSockets()->CloseConnection( hConn, k_ESteamNetConnectionEnd_AppException_Generic, "Failed to accept connection", false );
-					return;
-				}
+		// Everyone logging on could get in, so between them and the players there has to be a
+		// slot to spare
+		if ( m_uPlayerCount + m_AuthPipeline.GetPendingCount() >= m_unMaxPlayers )
+		{
+			OutputDebugString("Rejecting connection; server full");
+			m_pTransport->CloseConnection( hConn, k_ESteamNetConnectionEnd_AppException_Generic, "Server full!", false );
+			return;
+		}
 
-				m_rgPendingClientData[i].m_hConn = hConn;
+		// "Accept" the connection.
+		EResult res = m_pTransport->AcceptConnection( hConn );
+		if ( res != k_EResultOK )
+		{
+			char msg[ 256 ];
+			sprintf( msg, "AcceptConnection returned %d", res );
+			OutputDebugString( msg );
+			m_pTransport->CloseConnection( hConn, k_ESteamNetConnectionEnd_AppException_Generic, "Failed to accept connection", false );
+			return;
+		}
 
-				// add the user to the poll group
-				SteamGameServerNetworkingSockets()->SetConnectionPollGroup(hConn, m_hNetPollGroup);
+		// Start the clock on them logging on, and tag the connection so their ticket finds it
+		uint32 unPending = m_AuthPipeline.AddConnection( hConn, ulTickCount );
+		if ( unPending == CAuthPipeline::k_unInvalidIndex )
+		{
+			OutputDebugString( "Rejecting connection; no room to log on\n" );
+			m_pTransport->CloseConnection( hConn, k_EDRServerFull, "Server full", false );
+			return;
+		}
+		m_pTransport->SetConnectionUserData( hConn, CAuthPipeline::GetConnectionUserData( unPending ) );
 
-				// Send them the server info as a reliable message
-				MsgServerSendInfo_t msg;
-				msg.SetSteamIDServer(SteamGameServer()->GetSteamID().ConvertToUint64());
-				#ifdef USE_GS_AUTH_API
-					// You can only make use of VAC when using the Steam authentication system
-					msg.SetSecure(SteamGameServer()->BSecure());
-				#endif
-				msg.SetServerName(m_sServerName.c_str());
-				SteamGameServerNetworkingSockets()->SendMessageToConnection( hConn, &msg, sizeof(MsgServerSendInfo_t), k_nSteamNetworkingSend_Reliable, nullptr );
+		// add the user to the poll group
+		m_pTransport->SetConnectionPollGroup(hConn, m_hNetPollGroup);
 
-				return;
-			}
-		}
+		// World state, control messages and voice each get their own lane
+		m_pTransport->ConfigureConnectionLanes( hConn, k_ESpaceWarLaneCount, k_rgnSpaceWarLanePriorities, k_rgunSpaceWarLaneWeights );
 
-		// No empty slots.  Server full!
-		OutputDebugString("Rejecting connection; server full");
-		SteamGameServerNetworkingSockets()->CloseConnection( hConn, k_ESteamNetConnectionEnd_AppException_Generic, "Server full!", false );
+		// Send them the server info as a reliable message
+		MsgServerSendInfo_t msg;
+		msg.SetSteamIDServer(GetSteamID().ConvertToUint64());
+		#ifdef USE_GS_AUTH_API
+			// You can only make use of VAC when using the Steam authentication system
+			msg.SetSecure(SteamGameServer() && SteamGameServer()->BSecure());
+		#endif
+		msg.SetServerName(m_sServerName.c_str());
+		m_TickProfiler.CountMessageSent( &msg, sizeof(msg) );
+		SendMessageToConnectionOnLane( m_pTransport, hConn, &msg, sizeof(MsgServerSendInfo_t), k_nSteamNetworkingSend_Reliable, k_ESpaceWarLaneControl, nullptr );
 	}
 	// Check if a client has disconnected
 	else if ((eOldState == k_ESteamNetworkingConnectionState_Connecting || eOldState == k_ESteamNetworkingConnectionState_Connected) &&
 			 info.m_eState == k_ESteamNetworkingConnectionState_ClosedByPeer)
 	{
-		// Handle disconnecting a client
-		for (uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i)
+		// A client that gave up before it finished logging on
+		uint32 unPending = m_AuthPipeline.FindConnection( hConn, info.m_nUserData );
+		if ( unPending != CAuthPipeline::k_unInvalidIndex )
 		{
-			// If there is no ship, skip
-			if (!m_rgClientData[i].m_bActive)
-				continue;
+			OutputDebugString( "Dropped user who was logging on\n" );
+			m_AuthPipeline.RemoveConnection( unPending );
+			m_pTransport->CloseConnection( hConn, k_EDRClientDisconnect, nullptr, false );
+			return;
+		}
 
-			if (m_rgClientData[i].m_SteamIDUser == info.m_identityRemote.GetSteamID())//pCallback->m_steamIDRemote)
-			{
-				OutputDebugString("Disconnected dropped user\n");
-				RemovePlayerFromServer(i, k_EDRClientDisconnect);
-				break;
-			}
+		// Handle disconnecting a client
+		uint32 uSlot = m_mapSteamIDToSlot.Find( info.m_identityRemote.GetSteamID() );
+		if ( uSlot < m_unMaxPlayers && m_vecClientData[uSlot].m_bActive )
+		{
+			OutputDebugString("Disconnected dropped user\n");
+			RemovePlayerFromServer(uSlot, k_EDRClientDisconnect);
 		}
 	}
 }
@@ -239,11 +332,18 @@ void CSpaceWarServer::OnNetConnectionStatusChanged(SteamNetConnectionStatusChang
 bool CSpaceWarServer::BSendDataToClient( uint32 uShipIndex, char *pData, uint32 nSizeOfData )
 {
 	// Validate index
-	if ( uShipIndex >= MAX_PLAYERS_PER_SERVER )
+	if ( uShipIndex >= m_unMaxPlayers )
 		return false;
 
+	// A player being replayed has no connection, there's nobody to send to
+	if ( m_vecClientData[uShipIndex].m_hConn == k_HSteamNetConnection_Invalid )
+		return false;
+
+	m_TickProfiler.CountMessageSent( pData, nSizeOfData );
+
+	// These are one-off control messages, nothing sends them again if they're lost
 	int64 messageOut;
-	if (!SteamGameServerNetworkingSockets()->SendMessageToConnection(m_rgClientData[uShipIndex].m_hConn, pData, nSizeOfData, k_nSteamNetworkingSend_Unreliable, &messageOut))
+	if ( SendMessageToConnectionOnLane( m_pTransport, m_vecClientData[uShipIndex].m_hConn, pData, nSizeOfData, k_nSteamNetworkingSend_Reliable, k_ESpaceWarLaneControl, &messageOut ) != k_EResultOK )
 	{
 		OutputDebugString("Failed sending data to a client\n");
 			return false;
@@ -253,154 +353,103 @@ bool CSpaceWarServer::BSendDataToClient( uint32 uShipIndex, char *pData, uint32
 
 
 //-----------------------------------------------------------------------------
-// Purpose: Handle sending data to a pending client at a given index
+// Purpose: Handle a client sending its ticket.  Only connections still logging
+//			on have a pending logon, anyone already in is ignored.
 //-----------------------------------------------------------------------------
-bool CSpaceWarServer::BSendDataToPendingClient( uint32 uShipIndex, char *pData, uint32 nSizeOfData )
+void CSpaceWarServer::OnClientBeginAuthentication( CSteamID steamIDClient, HSteamNetConnection connectionID, int64 nUserData, const void *pToken, uint32 uTokenLen )
 {
-	// Validate index
-	if ( uShipIndex >= MAX_PLAYERS_PER_SERVER )
-		return false;
+	uint32 unPending = m_AuthPipeline.FindConnection( connectionID, nUserData );
+	if ( unPending == CAuthPipeline::k_unInvalidIndex )
+		return;
 
-	int64 messageOut;
-	if (!SteamGameServerNetworkingSockets()->SendMessageToConnection(m_rgPendingClientData[uShipIndex].m_hConn, pData, nSizeOfData, k_nSteamNetworkingSend_Unreliable, &messageOut))
+	// Two connections can't log on as the same player at once
+	if ( !m_AuthPipeline.BOnTicketReceived( unPending, steamIDClient, pToken, uTokenLen, m_pGameEngine->GetGameTickCount() ) )
 	{
-		OutputDebugString("Failed sending data to a client\n");
-		return false;
+		OutputDebugString( "Rejecting duplicate logon\n" );
+		m_AuthPipeline.RemoveConnection( unPending );
+		m_pTransport->CloseConnection( connectionID, k_EDRServerReject, "Already logging on", false );
 	}
-	return true;
 }
 
+
 //-----------------------------------------------------------------------------
-// Purpose: Handle a new client connecting
+// Purpose: A new client that connected has had their authentication processed
 //-----------------------------------------------------------------------------
-void CSpaceWarServer::OnClientBeginAuthentication(CSteamID steamIDClient, HSteamNetConnection connectionID, void* pToken, uint32 uTokenLen)
+void CSpaceWarServer::OnAuthFinished( HSteamNetConnection hConn, CSteamID steamID, EAuthResult eResult )
 {
-	// First, check this isn't a duplicate and we already have a user logged on from the same steamid
-	for (uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i)
+	if ( eResult == k_EAuthResultAccepted )
 	{
-		if (m_rgClientData[i].m_hConn == connectionID)
-		{
-			// We already logged them on... (should maybe tell them again incase they don't know?)
-			return;
-		}
+		AddAuthenticatedPlayer( steamID, hConn );
+		return;
 	}
 
-	// Second, do we have room?
-	uint32 nPendingOrActivePlayerCount = 0;
-	for (uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i)
+	if ( eResult == k_EAuthResultTimedOut )
 	{
-		if (m_rgPendingClientData[i].m_bActive)
-			++nPendingOrActivePlayerCount;
-
-		if (m_rgClientData[i].m_bActive)
-			++nPendingOrActivePlayerCount;
+		OutputDebugString( "Timing out client that didn't finish logging on\n" );
+		m_pTransport->CloseConnection( hConn, k_EDRClientKicked, "Logon timed out", false );
+		return;
 	}
 
-	// We are full (or will be if the pending players auth), deny new login
-	if ( nPendingOrActivePlayerCount >= MAX_PLAYERS_PER_SERVER )
-	{
-		SteamGameServerNetworkingSockets()->CloseConnection(connectionID, k_EDRServerFull, "Server full", false);
-	}
+	// Send a deny for the client, lingering so it gets there before the connection closes
+	OutputDebugString( "Auth failed for a client\n" );
+	MsgServerFailAuthentication_t msg;
+	int64 outMessage;
+	m_TickProfiler.CountMessageSent( &msg, sizeof(msg) );
+	SendMessageToConnectionOnLane( m_pTransport, hConn, &msg, sizeof(msg), k_nSteamNetworkingSend_Reliable, k_ESpaceWarLaneControl, &outMessage );
+	m_pTransport->CloseConnection( hConn, k_EDRServerReject, "Authentication failed", true );
+}
 
-	// If we get here there is room, add the player as pending
-	for (uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i)
-	{
-		if (!m_rgPendingClientData[i].m_bActive)
-		{
-			m_rgPendingClientData[i].m_ulTickCountLastData = m_pGameEngine->GetGameTickCount();
-#ifdef USE_GS_AUTH_API
-			// authenticate the user with the Steam back-end servers
-			EBeginAuthSessionResult res = SteamGameServer()->BeginAuthSession(pToken, uTokenLen, steamIDClient);
-			if (res != k_EBeginAuthSessionResultOK)
-			{
-				SteamGameServerNetworkingSockets()->CloseConnection(connectionID, k_EDRServerReject, "BeginAuthSession failed", false);
-				break;
-			}
 
-			m_rgPendingClientData[i].m_SteamIDUser = steamIDClient;
-			m_rgPendingClientData[i].m_bActive = true;
-			m_rgPendingClientData[i].m_hConn = connectionID;
-			break;
-#else
-			m_rgPendingClientData[i].m_bActive = true;
-			// we need to tell the server our Steam id in the non-auth case, so we stashed it in the login message, pull it back out
-			m_rgPendingClientData[i].m_SteamIDUser = *(CSteamID*)pToken;
-			m_rgPendingClientData[i].m_connection = connectionID;
-			// You would typically do your own authentication method here and later call OnAuthCompleted
-			// In this sample we just automatically auth anyone who connects
-			OnAuthCompleted(true, i);
-			break;
-#endif
-		}
-	}
-}
 //-----------------------------------------------------------------------------
-// Purpose: A new client that connected has had their authentication processed
+// Purpose: Let a player in.  They get the lowest free slot, which a replay
+//			relies on to put everyone back where they were.
 //-----------------------------------------------------------------------------
-void CSpaceWarServer::OnAuthCompleted( bool bAuthSuccessful, uint32 iPendingAuthIndex )
+void CSpaceWarServer::AddAuthenticatedPlayer( CSteamID steamID, HSteamNetConnection hConn )
 {
-	if ( !m_rgPendingClientData[iPendingAuthIndex].m_bActive )
+	if ( m_vecFreeSlots.empty() )
 	{
-		OutputDebugString( "Got auth completed callback for client who is not pending\n" );
+		// Shouldn't happen, connections aren't accepted unless there's room for them
+		OutputDebugString( "No slot for a client who passed authentication\n" );
+		m_AuthPipeline.GetValidator()->EndValidation( steamID );
+		m_pTransport->CloseConnection( hConn, k_EDRServerFull, "Server full", false );
 		return;
 	}
 
-	if ( !bAuthSuccessful )
+	std::pop_heap( m_vecFreeSlots.begin(), m_vecFreeSlots.end(), std::greater< uint32 >() );
+	uint32 i = m_vecFreeSlots.back();
+	m_vecFreeSlots.pop_back();
+	++m_uPlayerCount;
+
+	ClientConnectionData_t &client = m_vecClientData[i];
+	client.m_bActive = true;
+	client.m_SteamIDUser = steamID;
+	client.m_hConn = hConn;
+	client.m_ulTickCountLastData = m_pGameEngine->GetGameTickCount();
+	client.m_SnapshotRate.Reset( m_pGameEngine->GetGameTickCount() );
+	client.m_hTimeoutTimer = m_Timers.Arm( client.m_ulTickCountLastData + SERVER_TIMEOUT_MILLISECONDS + 1, this, ( (uint64)k_EServerTimerClientTimeout << 32 ) | i );
+
+	// Tag the connection with the slot, so messages on it don't have to search for the player
+	m_pTransport->SetConnectionUserData( hConn, i );
+	m_mapSteamIDToSlot.Insert( steamID, i );
+
+	if ( m_pReplayRecorder )
+		m_pReplayRecorder->RecordPlayerJoined( m_pGameEngine->GetGameTickCount(), i, steamID );
+
+	// Add a new ship, make it dead immediately
+	AddPlayerShip( i );
+	m_vecpShips[i]->SetDisabled( true );
+
+	MsgServerPassAuthentication_t msg;
+	msg.SetPlayerPosition( i );
+	BSendDataToClient( i, (char*)&msg, sizeof( msg ) );
+
+	// If we just got the second player, immediately reset round as a draw.  This will prevent
+	// the existing player getting a win, and it will cause a new round to start right off
+	// so that the one player can't just float around not letting the new one get into the game.
+	if ( m_uPlayerCount == 2 )
 	{
-#ifdef USE_GS_AUTH_API
-		// Tell the GS the user is leaving the server
-		SteamGameServer()->EndAuthSession( m_rgPendingClientData[iPendingAuthIndex].m_SteamIDUser );
-#endif
-		// Send a deny for the client, and zero out the pending data
-		MsgServerFailAuthentication_t msg;
-		int64 outMessage;
-		SteamGameServerNetworkingSockets()->SendMessageToConnection(m_rgPendingClientData[iPendingAuthIndex].m_hConn, &msg, sizeof(msg), k_nSteamNetworkingSend_Reliable, &outMessage);
-		m_rgPendingClientData[iPendingAuthIndex] = ClientConnectionData_t();
-		return;
-	}
-
-	bool bAddedOk = false;
-	for( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i ) 
-	{
-		if ( !m_rgClientData[i].m_bActive )
-		{
-			// copy over the data from the pending array
-			memcpy( &m_rgClientData[i], &m_rgPendingClientData[iPendingAuthIndex], sizeof( ClientConnectionData_t ) );
-			m_rgPendingClientData[iPendingAuthIndex] = ClientConnectionData_t();
-			m_rgClientData[i].m_ulTickCountLastData = m_pGameEngine->GetGameTickCount();
-
-			// Add a new ship, make it dead immediately
-			AddPlayerShip( i );
-			m_rgpShips[i]->SetDisabled( true );
-
-			MsgServerPassAuthentication_t msg;
-			msg.SetPlayerPosition( i );
-			BSendDataToClient( i, (char*)&msg, sizeof( msg ) );
-
-			bAddedOk = true;
-
-			break;
-		}
-	}
-
-	// If we just successfully added the player, check if they are #2 so we can restart the round
-	if ( bAddedOk )
-	{
-		uint32 uPlayers = 0;
-		for( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i ) 
-		{
-			if ( m_rgClientData[i].m_bActive )
-				++uPlayers;
-		}
-
-		// If we just got the second player, immediately reset round as a draw.  This will prevent
-		// the existing player getting a win, and it will cause a new round to start right off
-		// so that the one player can't just float around not letting the new one get into the game.
-		if ( uPlayers == 2 )
-		{
-			if ( m_eGameState != k_EServerWaitingForPlayers )
-				SetGameState( k_EServerDraw );
-		}
+		if ( m_eGameState != k_EServerWaitingForPlayers )
+			SetGameState( k_EServerDraw );
 	}
 }
 
@@ -410,9 +459,9 @@ void CSpaceWarServer::OnAuthCompleted( bool bAuthSuccessful, uint32 iPendingAuth
 //-----------------------------------------------------------------------------
 void CSpaceWarServer::ResetScores()
 {
-	for( uint32 i=0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	for( uint32 i=0; i < m_unMaxPlayers; ++i )
 	{
-		m_rguPlayerScores[i] = 0;
+		m_vecPlayerScores[i] = 0;
 	}
 }
 
@@ -421,13 +470,13 @@ void CSpaceWarServer::ResetScores()
 //-----------------------------------------------------------------------------
 void CSpaceWarServer::AddPlayerShip( uint32 uShipPosition )
 {
-	if ( uShipPosition >= MAX_PLAYERS_PER_SERVER )
+	if ( uShipPosition >= m_unMaxPlayers )
 	{
 		OutputDebugString( "Trying to add ship at invalid positon\n" );
 		return;
 	}
 
-	if ( m_rgpShips[uShipPosition] )
+	if ( m_vecpShips[uShipPosition] )
 	{
 		OutputDebugString( "Trying to add a ship where one already exists\n" );
 		return;
@@ -442,33 +491,43 @@ void CSpaceWarServer::AddPlayerShip( uint32 uShipPosition )
 	switch( uShipPosition )
 	{
 	case 0:
-		m_rgpShips[uShipPosition] = new CShip( m_pGameEngine, true, flXOffset, flYOffset, g_rgPlayerColors[uShipPosition] );
-		m_rgpShips[uShipPosition]->SetInitialRotation( flAngle );
+		m_vecpShips[uShipPosition] = new ( m_ShipPool.Alloc() ) CShip( &m_SimulationEngine, true, flXOffset, flYOffset, GetPlayerColor( uShipPosition ), &m_EntityStatePool );
+		m_vecpShips[uShipPosition]->SetInitialRotation( flAngle );
 		break;
 	case 1:
-		m_rgpShips[uShipPosition] = new CShip( m_pGameEngine, true, flWidth-flXOffset, flYOffset, g_rgPlayerColors[uShipPosition] );
-		m_rgpShips[uShipPosition]->SetInitialRotation( -1.0f*flAngle );
+		m_vecpShips[uShipPosition] = new ( m_ShipPool.Alloc() ) CShip( &m_SimulationEngine, true, flWidth-flXOffset, flYOffset, GetPlayerColor( uShipPosition ), &m_EntityStatePool );
+		m_vecpShips[uShipPosition]->SetInitialRotation( -1.0f*flAngle );
 		break;
 	case 2:
-		m_rgpShips[uShipPosition] = new CShip( m_pGameEngine, true, flXOffset, flHeight-flYOffset, g_rgPlayerColors[uShipPosition] );
-		m_rgpShips[uShipPosition]->SetInitialRotation( PI_VALUE-flAngle );
+		m_vecpShips[uShipPosition] = new ( m_ShipPool.Alloc() ) CShip( &m_SimulationEngine, true, flXOffset, flHeight-flYOffset, GetPlayerColor( uShipPosition ), &m_EntityStatePool );
+		m_vecpShips[uShipPosition]->SetInitialRotation( PI_VALUE-flAngle );
 		break;
 	case 3:
-		m_rgpShips[uShipPosition] = new CShip( m_pGameEngine, true, flWidth-flXOffset, flHeight-flYOffset, g_rgPlayerColors[uShipPosition] );
-		m_rgpShips[uShipPosition]->SetInitialRotation( -1.0f*(PI_VALUE-flAngle) );
+		m_vecpShips[uShipPosition] = new ( m_ShipPool.Alloc() ) CShip( &m_SimulationEngine, true, flWidth-flXOffset, flHeight-flYOffset, GetPlayerColor( uShipPosition ), &m_EntityStatePool );
+		m_vecpShips[uShipPosition]->SetInitialRotation( -1.0f*(PI_VALUE-flAngle) );
 		break;
 	default:
-		OutputDebugString( "AddPlayerShip() code needs updating for more than 4 players\n" );
+		{
+			// Past the four corners, spread the extra slots evenly around a ring about the sun,
+			// each one facing the sun like the corner ships do
+			float flRingAngle = 2.0f*PI_VALUE*(float)( uShipPosition - 4 )/(float)( m_unMaxPlayers - 4 );
+			float flRadius = MIN( flWidth, flHeight )*0.38f;
+			float xPos = flWidth/2.0f + flRadius*(float)cos( flRingAngle );
+			float yPos = flHeight/2.0f + flRadius*(float)sin( flRingAngle );
+			m_vecpShips[uShipPosition] = new ( m_ShipPool.Alloc() ) CShip( &m_SimulationEngine, true, xPos, yPos, GetPlayerColor( uShipPosition ), &m_EntityStatePool );
+			m_vecpShips[uShipPosition]->SetInitialRotation( flRingAngle - PI_VALUE/2.0f );
+		}
+		break;
 	}
 
-	if ( m_rgpShips[uShipPosition] )
+	if ( m_vecpShips[uShipPosition] )
 	{
 		// Setup key bindings... don't even really need these on server?
-		m_rgpShips[uShipPosition]->SetVKBindingLeft( 0x41 ); // A key
-		m_rgpShips[uShipPosition]->SetVKBindingRight( 0x44 ); // D key
-		m_rgpShips[uShipPosition]->SetVKBindingForwardThrusters( 0x57 ); // W key
-		m_rgpShips[uShipPosition]->SetVKBindingReverseThrusters( 0x53 ); // S key
-		m_rgpShips[uShipPosition]->SetVKBindingFire( VK_SPACE ); 
+		m_vecpShips[uShipPosition]->SetVKBindingLeft( 0x41 ); // A key
+		m_vecpShips[uShipPosition]->SetVKBindingRight( 0x44 ); // D key
+		m_vecpShips[uShipPosition]->SetVKBindingForwardThrusters( 0x57 ); // W key
+		m_vecpShips[uShipPosition]->SetVKBindingReverseThrusters( 0x53 ); // S key
+		m_vecpShips[uShipPosition]->SetVKBindingFire( VK_SPACE ); 
 	}
 }
 
@@ -478,31 +537,38 @@ void CSpaceWarServer::AddPlayerShip( uint32 uShipPosition )
 //-----------------------------------------------------------------------------
 void CSpaceWarServer::RemovePlayerFromServer( uint32 uShipPosition, EDisconnectReason reason)
 {
-	if ( uShipPosition >= MAX_PLAYERS_PER_SERVER )
+	if ( uShipPosition >= m_unMaxPlayers )
 	{
 		OutputDebugString( "Trying to remove ship at invalid position\n" );
 		return;
 	}
 
-	if ( !m_rgpShips[uShipPosition] )
+	if ( !m_vecpShips[uShipPosition] )
 	{
 		OutputDebugString( "Trying to remove a ship that does not exist\n" );
 		return;
 	}
 
 	OutputDebugString( "Removing a ship\n" );
-	delete m_rgpShips[uShipPosition];
-	m_rgpShips[uShipPosition] = NULL;
-	m_rguPlayerScores[uShipPosition] = 0;
+	if ( m_pReplayRecorder )
+		m_pReplayRecorder->RecordPlayerLeft( m_pGameEngine->GetGameTickCount(), uShipPosition );
+
+	m_ShipPool.Free( m_vecpShips[uShipPosition] );
+	m_vecpShips[uShipPosition] = NULL;
+	m_vecPlayerScores[uShipPosition] = 0;
 
 	// close the hNet connection
-	SteamGameServerNetworkingSockets()->CloseConnection( m_rgClientData[uShipPosition].m_hConn, reason, nullptr, false);
+	m_pTransport->CloseConnection( m_vecClientData[uShipPosition].m_hConn, reason, nullptr, false);
 
-#ifdef USE_GS_AUTH_API
-	// Tell the GS the user is leaving the server
-	SteamGameServer()->EndAuthSession( m_rgClientData[uShipPosition].m_SteamIDUser );
-#endif
-	m_rgClientData[uShipPosition] = ClientConnectionData_t();
+	// Tell whatever checked their ticket the user is leaving the server
+	m_AuthPipeline.GetValidator()->EndValidation( m_vecClientData[uShipPosition].m_SteamIDUser );
+
+	m_mapSteamIDToSlot.Remove( m_vecClientData[uShipPosition].m_SteamIDUser, uShipPosition );
+	m_Timers.Cancel( m_vecClientData[uShipPosition].m_hTimeoutTimer );
+	m_vecClientData[uShipPosition] = ClientConnectionData_t();
+	m_vecFreeSlots.push_back( uShipPosition );
+	std::push_heap( m_vecFreeSlots.begin(), m_vecFreeSlots.end(), std::greater< uint32 >() );
+	--m_uPlayerCount;
 }
 
 
@@ -513,12 +579,12 @@ void CSpaceWarServer::ResetPlayerShips()
 {
 	// Delete any currently active ships, but immediately recreate 
 	// (which causes all ship state/position to reset)
-	for( uint32 i=0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	for( uint32 i=0; i < m_unMaxPlayers; ++i )
 	{
-		if ( m_rgpShips[i] )
+		if ( m_vecpShips[i] )
 		{		
-			delete m_rgpShips[i];
-			m_rgpShips[i] = NULL;
+			m_ShipPool.Free( m_vecpShips[i] );
+			m_vecpShips[i] = NULL;
 			AddPlayerShip( i );
 		}
 	}
@@ -540,8 +606,14 @@ void CSpaceWarServer::SetGameState( EServerGameState eState )
 		ResetPlayerShips();
 	}
 
-	m_ulStateTransitionTime = m_pGameEngine->GetGameTickCount();
 	m_eGameState = eState;
+
+	// Waiting for players and the pause after a round both last MILLISECONDS_BETWEEN_ROUNDS
+	m_SimulationTimers.Cancel( m_hRoundStateTimer );
+	m_hRoundStateTimer = k_hTimerInvalid;
+	m_bRoundStateTimerExpired = false;
+	if ( eState == k_EServerWaitingForPlayers || eState == k_EServerDraw || eState == k_EServerWinner )
+		m_hRoundStateTimer = m_SimulationTimers.Arm( m_SimulationEngine.GetGameTickCount() + MILLISECONDS_BETWEEN_ROUNDS, this, (uint64)k_EServerTimerRoundState << 32 );
 }
 
 
@@ -550,116 +622,169 @@ void CSpaceWarServer::SetGameState( EServerGameState eState )
 //-----------------------------------------------------------------------------
 void CSpaceWarServer::ReceiveNetworkData()
 {
+	CTickProfileScope profile( m_TickProfiler, CTickProfiler::k_EPhaseReceiveNetworkData );
+
 	SteamNetworkingMessage_t* msgs[128];
-	int numMessages = SteamGameServerNetworkingSockets()->ReceiveMessagesOnPollGroup(m_hNetPollGroup, msgs, 128);
-	for (int idxMsg = 0; idxMsg < numMessages; idxMsg++)
-	{
-		SteamNetworkingMessage_t* message = msgs[idxMsg];
-		CSteamID steamIDRemote = message->m_identityPeer.GetSteamID();
-		HSteamNetConnection connection = message->m_conn;
+	int numMessages = 0;
 
-		if (message->GetSize() < sizeof(DWORD))
+	// Keep going until we've taken everything queued, with a lot of players one batch a frame falls behind
+	do
+	{
+		numMessages = m_pTransport->ReceiveMessagesOnPollGroup(m_hNetPollGroup, msgs, 128);
+		for (int idxMsg = 0; idxMsg < numMessages; idxMsg++)
 		{
-			OutputDebugString("Got garbage on server socket, too short\n");
-			message->Release();
-			message = nullptr;
-			continue;
-		}
+			SteamNetworkingMessage_t* message = msgs[idxMsg];
+			CSteamID steamIDRemote = message->m_identityPeer.GetSteamID();
+			HSteamNetConnection connection = message->m_conn;
+			m_TickProfiler.CountMessageReceived( message->GetData(), message->GetSize() );
 
-		EMessage eMsg = (EMessage)LittleDWord(*(DWORD*)message->GetData());
-
-		switch (eMsg)
-		{
-		case k_EMsgClientBeginAuthentication:
-		{
-			if (message->GetSize() != sizeof(MsgClientBeginAuthentication_t))
+			if (message->GetSize() < sizeof(DWORD))
 			{
-				OutputDebugString("Bad connection attempt msg\n");
+				OutputDebugString("Got garbage on server socket, too short\n");
 				message->Release();
 				message = nullptr;
 				continue;
 			}
-			MsgClientBeginAuthentication_t* pMsg = (MsgClientBeginAuthentication_t*)message->GetData();
+
+			EMessage eMsg = (EMessage)LittleDWord(*(DWORD*)message->GetData());
+
+			switch (eMsg)
+			{
+			case k_EMsgClientBeginAuthentication:
+			{
+				MsgClientBeginAuthentication_t* pMsg = (MsgClientBeginAuthentication_t*)message->GetData();
 #ifdef USE_GS_AUTH_API
-			OnClientBeginAuthentication(steamIDRemote, connection, (void*)pMsg->GetTokenPtr(), pMsg->GetTokenLen());
+				// Only as much of the token as there is gets sent
+				if (message->GetSize() < MsgClientBeginAuthentication_t::GetMessageSize(0) || pMsg->GetTokenLen() > MsgClientBeginAuthentication_t::GetMaxTokenLen() ||
+					message->GetSize() != pMsg->GetMessageSize())
 #else
-			OnClientBeginAuthentication(connection, 0);
+				if (message->GetSize() != sizeof(MsgClientBeginAuthentication_t))
+#endif
+				{
+					OutputDebugString("Bad connection attempt msg\n");
+					message->Release();
+					message = nullptr;
+					continue;
+				}
+#ifdef USE_GS_AUTH_API
+				OnClientBeginAuthentication(steamIDRemote, connection, message->m_nConnUserData, pMsg->GetTokenPtr(), pMsg->GetTokenLen());
+#else
+				// Without Steam auth there's no ticket, the client just tells us who it is
+				OnClientBeginAuthentication(CSteamID(pMsg->GetSteamID()), connection, message->m_nConnUserData, NULL, 0);
 #endif
-		}
-		break;
-		case k_EMsgClientSendLocalUpdate:
-		{
-			if (message->GetSize() != sizeof(MsgClientSendLocalUpdate_t))
-			{
-				OutputDebugString("Bad client update msg\n");
-				message->Release();
-				message = nullptr;
-				continue;
 			}
-
-			// Find the connection that should exist for this users address
-			bool bFound = false;
-			for (uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i)
+			break;
+			case k_EMsgClientSendLocalUpdate:
 			{
-				if (m_rgClientData[i].m_hConn == connection)
+				if (message->GetSize() != sizeof(MsgClientSendLocalUpdate_t))
+				{
+					OutputDebugString("Bad client update msg\n");
+					message->Release();
+					message = nullptr;
+					continue;
+				}
+
+				// The connection carries the slot of the player it belongs to
+				uint32 uSlot = GetClientSlotForMessage( message );
+				if ( uSlot < m_unMaxPlayers )
 				{
-					bFound = true;
 					MsgClientSendLocalUpdate_t* pMsg = (MsgClientSendLocalUpdate_t*)message->GetData();
-					OnReceiveClientUpdateData(i, pMsg->AccessUpdateData());
-					break;
+					if (m_pReplayRecorder)
+						m_pReplayRecorder->RecordClientMessage(m_pGameEngine->GetGameTickCount(), uSlot, message->GetData(), message->GetSize());
+					OnReceiveClientUpdateData(uSlot, pMsg->AccessUpdateData());
+				}
+				else
+				{
+					OutputDebugString("Got a client data update, but couldn't find a matching client\n");
 				}
 			}
-			if (!bFound)
-				OutputDebugString("Got a client data update, but couldn't find a matching client\n");
-		}
-		break;
-
-		case k_EMsgVoiceChatData:
-		{
-			// Received voice chat messages, broadcast to all other players
-			MsgVoiceChatData_t *pMsg = (MsgVoiceChatData_t *)message->GetData();
-			pMsg->SetSteamID( message->m_identityPeer.GetSteamID() ); // Make sure sender steam ID is set.
-			SendMessageToAll( connection, pMsg, message->GetSize() );
 			break;
-		}
-		case k_EMsgP2PSendingTicket:
-		{
-			// Received a P2P auth ticket, forward it to the intended recipient
-			MsgP2PSendingTicket_t msgP2PSendingTicket;
-			memcpy(&msgP2PSendingTicket, message->GetData(), sizeof(MsgP2PSendingTicket_t));
-			CSteamID toSteamID = msgP2PSendingTicket.GetSteamID();
 
-			HSteamNetConnection toHConn = 0;
-			for (int j = 0; j < MAX_PLAYERS_PER_SERVER; j++)
+			case k_EMsgClientAckWorldSnapshot:
 			{
-				if ( toSteamID == m_rgClientData[j].m_SteamIDUser )
+				if (message->GetSize() != sizeof(MsgClientAckWorldSnapshot_t))
 				{
+					OutputDebugString("Bad client snapshot ack msg\n");
+					message->Release();
+					message = nullptr;
+					continue;
+				}
 
+				MsgClientAckWorldSnapshot_t* pMsg = (MsgClientAckWorldSnapshot_t*)message->GetData();
+				uint32 uSlot = GetClientSlotForMessage( message );
+				if ( uSlot < m_unMaxPlayers )
+				{
+					if (m_pReplayRecorder)
+						m_pReplayRecorder->RecordClientMessage(m_pGameEngine->GetGameTickCount(), uSlot, message->GetData(), message->GetSize());
+					OnReceiveClientAckWorldSnapshot(uSlot, pMsg->GetSequence());
+				}
+			}
+			break;
+
+			case k_EMsgVoiceChatData:
+			{
+				// Received voice chat messages, broadcast to all other players
+				MsgVoiceChatData_t *pMsg = (MsgVoiceChatData_t *)message->GetData();
+				pMsg->SetSteamID( message->m_identityPeer.GetSteamID() ); // Make sure sender steam ID is set.
+				SendMessageToAll( connection, pMsg, message->GetSize() );
+				break;
+			}
+			case k_EMsgP2PSendingTicket:
+			{
+				// Received a P2P auth ticket, forward it to the intended recipient
+				MsgP2PSendingTicket_t msgP2PSendingTicket;
+				memcpy(&msgP2PSendingTicket, message->GetData(), sizeof(MsgP2PSendingTicket_t));
+				CSteamID toSteamID = msgP2PSendingTicket.GetSteamID();
+
+				HSteamNetConnection toHConn = 0;
+				uint32 uToSlot = m_mapSteamIDToSlot.Find( toSteamID );
+				if ( uToSlot < m_unMaxPlayers && m_vecClientData[uToSlot].m_bActive )
+				{
 					// Mutate the message, replacing the destination SteamID with the sender's SteamID
 					msgP2PSendingTicket.SetSteamID( message->m_identityPeer.GetSteamID64() );
 
-					SteamNetworkingSockets()->SendMessageToConnection( m_rgClientData[j].m_hConn, &msgP2PSendingTicket, sizeof(msgP2PSendingTicket), k_nSteamNetworkingSend_Reliable, nullptr );
-					break;
+					toHConn = m_vecClientData[uToSlot].m_hConn;
+					m_TickProfiler.CountMessageSent( &msgP2PSendingTicket, sizeof(msgP2PSendingTicket) );
+					SendMessageToConnectionOnLane( m_pTransport, toHConn, &msgP2PSendingTicket, sizeof(msgP2PSendingTicket), k_nSteamNetworkingSend_Reliable, k_ESpaceWarLaneControl, nullptr );
+				}
+
+				if (toHConn == 0)
+				{
+					OutputDebugString("msgP2PSendingTicket received with no valid target to send to.");
 				}
 			}
+			break;
 
-			if (toHConn == 0)
-			{
-				OutputDebugString("msgP2PSendingTicket received with no valid target to send to.");
+			default:
+				char rgch[128];
+				sprintf_safe(rgch, "Invalid message %x\n", eMsg);
+				rgch[sizeof(rgch) - 1] = 0;
+				OutputDebugString(rgch);
 			}
-		}
-		break;
 
-		default:
-			char rgch[128];
-			sprintf_safe(rgch, "Invalid message %x\n", eMsg);
-			rgch[sizeof(rgch) - 1] = 0;
-			OutputDebugString(rgch);
+			message->Release();
+			message = nullptr;
 		}
+	} while ( numMessages == 128 );
+}
 
-		message->Release();
-		message = nullptr;
-	}
+//-----------------------------------------------------------------------------
+// Purpose: Slot of the connected player a message came from.  Their connection
+//			was tagged with it when they joined, anything else (a pending
+//			player, or a message queued before its player left and someone
+//			else took the slot) gets m_unMaxPlayers.
+//-----------------------------------------------------------------------------
+uint32 CSpaceWarServer::GetClientSlotForMessage( SteamNetworkingMessage_t *pMessage )
+{
+	int64 nSlot = pMessage->m_nConnUserData;
+	if ( nSlot < 0 || nSlot >= (int64)m_unMaxPlayers )
+		return m_unMaxPlayers;
+
+	const ClientConnectionData_t &client = m_vecClientData[ (uint32)nSlot ];
+	if ( !client.m_bActive || client.m_hConn != pMessage->m_conn )
+		return m_unMaxPlayers;
+
+	return (uint32)nSlot;
 }
 
 //-----------------------------------------------------------------------------
@@ -667,64 +792,125 @@ void CSpaceWarServer::ReceiveNetworkData()
 //-----------------------------------------------------------------------------
 void CSpaceWarServer::RunFrame()
 {
-	// Run any Steam Game Server API callbacks
-	SteamGameServer_RunCallbacks();
+	CTickProfileScope profileFrame( m_TickProfiler, CTickProfiler::k_EPhaseFrame );
 
-	// Update our server details
-	SendUpdatedServerDetailsToSteam();
-
-	// Timeout stale player connections, also update player count data
-	uint32 uPlayerCount = 0;
-	for( uint32 i=0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	// The match host runs callbacks and publishes server details for the whole process
+	if ( !m_bHostedMatch )
 	{
-		// If there is no ship, skip
-		if ( !m_rgClientData[i].m_bActive )
-			continue;
+		// Run any Steam Game Server API callbacks
+		CTickProfileScope profile( m_TickProfiler, CTickProfiler::k_EPhaseRunCallbacks );
+		SteamGameServer_RunCallbacks();
+	}
+
+	// Everything received before now gets replayed before this frame
+	if ( m_pReplayRecorder )
+		m_pReplayRecorder->RecordFrame( m_pGameEngine->GetGameTickCount() );
+
+	// Let in or turn away whoever's tickets have been checked, and time out anyone taking too long
+	m_AuthPipeline.RunFrame( m_pGameEngine->GetGameTickCount() );
 
-		if ( m_pGameEngine->GetGameTickCount() - m_rgClientData[i].m_ulTickCountLastData > SERVER_TIMEOUT_MILLISECONDS )
+	// Time out players who've gone quiet and logons taking too long, and refresh our server
+	// details if they're due.  Only what's due is visited, however many players there are.
+	m_Timers.Advance( m_pGameEngine->GetGameTickCount() );
+
+	// Step the simulation for the time since the last frame, however many steps that is
+	RunSimulationSteps( m_SimulationEngine.AccumulateTime( m_pGameEngine->GetGameTicksFrameDelta() ) );
+
+	// Send client updates (will internal limit itself to the tick rate desired)
+	SendUpdateDataToAllClients();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: One of our timers came due.  A player's timeout isn't moved every
+//			time they send something, when it fires we check when they last
+//			did and arm it again for then if they're still within it.
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::OnTimerExpired( uint64 ulContext, uint64 ulTickCount )
+{
+	switch ( (EServerTimer)( ulContext >> 32 ) )
+	{
+	case k_EServerTimerClientTimeout:
 		{
-			OutputDebugString( "Timing out player connection\n" );
-			RemovePlayerFromServer( i, k_EDRClientKicked );
+			uint32 i = (uint32)ulContext;
+			ClientConnectionData_t &client = m_vecClientData[i];
+			client.m_hTimeoutTimer = k_hTimerInvalid;
+			if ( ulTickCount > client.m_ulTickCountLastData + SERVER_TIMEOUT_MILLISECONDS )
+			{
+				OutputDebugString( "Timing out player connection\n" );
+				RemovePlayerFromServer( i, k_EDRClientKicked );
+			}
+			else
+			{
+				client.m_hTimeoutTimer = m_Timers.Arm( client.m_ulTickCountLastData + SERVER_TIMEOUT_MILLISECONDS + 1, this, ulContext );
+			}
 		}
-		else
+		break;
+
+	case k_EServerTimerRoundState:
+		m_hRoundStateTimer = k_hTimerInvalid;
+		m_bRoundStateTimerExpired = true;
+		break;
+
+	case k_EServerTimerServerDetails:
 		{
-			++uPlayerCount;
+			CTickProfileScope profile( m_TickProfiler, CTickProfiler::k_EPhaseServerDetails );
+			SendUpdatedServerDetailsToSteam();
 		}
+
+		// From now rather than when it was due, a long frame shouldn't make us publish twice
+		m_Timers.Arm( m_pGameEngine->GetGameTickCount() + m_DetailsPublisher.GetFlushInterval(), this, ulContext );
+		break;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Run simulation steps back to back.  Nothing here waits on or reads
+//			the game engine, so a load test or replay can run the simulation
+//			as fast as it likes.
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::RunSimulationSteps( uint32 cSteps )
+{
+	uint64 cAllocationsBefore = GetThreadAllocationCount();
+	for ( uint32 i = 0; i < cSteps; ++i )
+	{
+		m_SimulationEngine.Step();
+		RunSimulationStep();
 	}
-	m_uPlayerCount = uPlayerCount;
+	m_cSimulationAllocations += GetThreadAllocationCount() - cAllocationsBefore;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Advance the game by one fixed step
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::RunSimulationStep()
+{
+	// Round state timers come due on the step that reaches them
+	m_SimulationTimers.Advance( m_SimulationEngine.GetGameTickCount() );
 
 	switch ( m_eGameState )
 	{
 	case k_EServerWaitingForPlayers:
-		// Wait a few seconds (so everyone can join if a lobby just started this server)
-		if ( m_pGameEngine->GetGameTickCount() - m_ulStateTransitionTime >= MILLISECONDS_BETWEEN_ROUNDS )
+		// Wait a few seconds (so everyone can join if a lobby just started this server), then
+		// just keep waiting until at least one ship is active
+		if ( m_bRoundStateTimerExpired && m_uPlayerCount )
 		{
-			// Just keep waiting until at least one ship is active
-			for( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i )
-			{
-				if ( m_rgClientData[i].m_bActive )
-				{
-					// Transition to active
-					OutputDebugString( "Server going active after waiting for players\n" );
-					SetGameState( k_EServerActive );
-				}
-			}
+			// Transition to active
+			OutputDebugString( "Server going active after waiting for players\n" );
+			SetGameState( k_EServerActive );
 		}
 		break;
 	case k_EServerDraw:
 	case k_EServerWinner:
 		// Update all the entities...
-		m_pSun->RunFrame();
-		for( uint32 i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
-		{
-			if ( m_rgpShips[i] )
-				m_rgpShips[i]->RunFrame();
-		}
+		RunEntityFrames();
 
 		// NOTE: no collision detection, because the round is really over, objects are now invulnerable
 
 		// After 5 seconds start the next round
-		if ( m_pGameEngine->GetGameTickCount() - m_ulStateTransitionTime >= MILLISECONDS_BETWEEN_ROUNDS )
+		if ( m_bRoundStateTimerExpired )
 		{
 			ResetPlayerShips();
 			SetGameState( k_EServerActive );
@@ -734,12 +920,7 @@ void CSpaceWarServer::RunFrame()
 
 	case k_EServerActive:
 		// Update all the entities...
-		m_pSun->RunFrame();
-		for( uint32 i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
-		{
-			if ( m_rgpShips[i] )
-				m_rgpShips[i]->RunFrame();
-		}
+		RunEntityFrames();
 
 		// Check for collisions which could lead to a winner this round
 		CheckForCollisions();
@@ -748,11 +929,38 @@ void CSpaceWarServer::RunFrame()
 	case k_EServerExiting:
 		break;
 	default:
-		OutputDebugString( "Unhandled game state in CSpaceWarServer::RunFrame\n" );
+		OutputDebugString( "Unhandled game state in CSpaceWarServer::RunSimulationStep\n" );
 	}
+}
 
-	// Send client updates (will internal limit itself to the tick rate desired)
-	SendUpdateDataToAllClients();
+
+//-----------------------------------------------------------------------------
+// Purpose: Run every entity's logic for the step, then integrate them all in
+//			one pass over the state pool
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::RunEntityFrames()
+{
+	CTickProfileScope profile( m_TickProfiler, CTickProfiler::k_EPhaseEntityUpdate );
+
+	m_EntityStatePool.BeginBatch();
+
+	m_pSun->RunFrame();
+	for( uint32 i=0; i<m_unMaxPlayers; ++i )
+	{
+		if ( m_vecpShips[i] )
+			m_vecpShips[i]->RunFrame();
+	}
+
+	IntegrationParams_t params;
+	CVectorEntity::GetIntegrationParams( &m_SimulationEngine, &params );
+	m_EntityStatePool.IntegrateBatch( params );
+
+	// Thrusters follow their ship, now that it has moved
+	for( uint32 i=0; i<m_unMaxPlayers; ++i )
+	{
+		if ( m_vecpShips[i] )
+			m_vecpShips[i]->UpdateThrusters();
+	}
 }
 
 
@@ -765,141 +973,368 @@ void CSpaceWarServer::SendUpdateDataToAllClients()
 	if ( m_pGameEngine->GetGameTickCount() - m_ulLastServerUpdateTick < 1000.0f/SERVER_UPDATE_SEND_RATE )
 		return;
 
+	// Only time the frames that send, the rest do nothing
+	CTickProfileScope profile( m_TickProfiler, CTickProfiler::k_EPhaseSendUpdates );
+
 	m_ulLastServerUpdateTick = m_pGameEngine->GetGameTickCount();
 
-	MsgServerUpdateWorld_t msg;
+	// The message is a fixed header followed by one record per player slot
+	memset( &m_vecUpdateWorldBuffer[0], 0, m_vecUpdateWorldBuffer.size() );
+	MsgServerUpdateWorld_t *pMsg = new( &m_vecUpdateWorldBuffer[0] ) MsgServerUpdateWorld_t;
 
-	msg.AccessUpdateData()->SetServerGameState( m_eGameState );
-	for( int i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
+	pMsg->AccessUpdateData()->SetServerGameState( m_eGameState );
+	pMsg->AccessUpdateData()->SetPlayerSlotCount( m_unMaxPlayers );
+	pMsg->AccessUpdateData()->SetServerTime( (uint32)m_SimulationEngine.GetGameTickCount() );
+	for( uint32 i=0; i<m_unMaxPlayers; ++i )
 	{
-		msg.AccessUpdateData()->SetPlayerActive( i, m_rgClientData[i].m_bActive );
-		msg.AccessUpdateData()->SetPlayerScore( i, m_rguPlayerScores[i]  );
-		msg.AccessUpdateData()->SetPlayerSteamID( i, m_rgClientData[i].m_SteamIDUser.ConvertToUint64() );
+		pMsg->AccessUpdateData()->SetPlayerActive( i, m_vecClientData[i].m_bActive );
+		pMsg->AccessUpdateData()->SetPlayerScore( i, m_vecPlayerScores[i]  );
+		pMsg->AccessUpdateData()->SetPlayerSteamID( i, m_vecClientData[i].m_SteamIDUser.ConvertToUint64() );
 
-		if ( m_rgpShips[i] )
+		if ( m_vecpShips[i] )
 		{
-			m_rgpShips[i]->BuildServerUpdate( msg.AccessUpdateData()->AccessShipUpdateData( i ) );
+			m_vecpShips[i]->BuildServerUpdate( pMsg->AccessUpdateData()->AccessShipUpdateData( i ) );
 		}
 	}
 
-	msg.AccessUpdateData()->SetPlayerWhoWon( m_uPlayerWhoWonGame );
+	pMsg->AccessUpdateData()->SetPlayerWhoWon( m_uPlayerWhoWonGame );
+
+	if ( m_pReplayRecorder )
+		m_pReplayRecorder->RecordWorldSnapshot( m_pGameEngine->GetGameTickCount(), pMsg->AccessUpdateData() );
+
+	++m_unWorldSnapshotSequence;
 	
-	for( int i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
+	for( uint32 i=0; i<m_unMaxPlayers; ++i )
 	{
-		if ( !m_rgClientData[i].m_bActive ) 
+		// Players being replayed have no connection to send to
+		if ( !m_vecClientData[i].m_bActive || m_vecClientData[i].m_hConn == k_HSteamNetConnection_Invalid ) 
+			continue;
+
+		// A client that's falling behind only gets some of the updates
+		CSnapshotRateController &snapshotRate = m_vecClientData[i].m_SnapshotRate;
+		if ( !snapshotRate.BUpdateDue() )
+			continue;
+
+		// See how the connection is keeping up, and slow the client down or speed it back up
+		SteamNetConnectionRealTimeStatus_t status;
+		SteamNetConnectionRealTimeLaneStatus_t rgLaneStatus[k_ESpaceWarLaneCount];
+		if ( m_pTransport->GetConnectionRealTimeStatus( m_vecClientData[i].m_hConn, &status, k_ESpaceWarLaneCount, rgLaneStatus ) == k_EResultOK )
+		{
+			snapshotRate.OnConnectionStatus( status, rgLaneStatus[k_ESpaceWarLaneState], m_pGameEngine->GetGameTickCount() );
+
+			// How far behind each lane to this client is running
+			for ( uint32 iLane = 0; iLane < k_ESpaceWarLaneCount; ++iLane )
+				m_rgusecLaneQueueTimeMax[iLane] = MAX( m_rgusecLaneQueueTimeMax[iLane], rgLaneStatus[iLane].m_usecQueueTime );
+		}
+
+		// Pack down just the players most relevant to this client, as many as its rate allows, and
+		// remember what we sent so later updates can be sent as a delta against it
+		CRelevancyFilter &relevancyFilter = m_vecClientData[i].m_RelevancyFilter;
+		relevancyFilter.SelectPlayers( pMsg->AccessUpdateData(), i, (float)m_pGameEngine->GetViewportWidth(), (float)m_pGameEngine->GetViewportHeight(),
+			snapshotRate.GetLaneCount( CRelevancyFilter::GetLaneCount( m_unMaxPlayers ) ) );
+		uint32 cubSnapshot = PackWorldSnapshot( pMsg->AccessUpdateData(), relevancyFilter.GetLaneSlots(), relevancyFilter.GetLaneCount(),
+			&m_vecPackedWorldBuffer[0], (uint32)m_vecPackedWorldBuffer.size() );
+		if ( !cubSnapshot )
 			continue;
+		m_vecClientData[i].m_WorldSnapshots.AddSnapshot( m_unWorldSnapshotSequence, &m_vecPackedWorldBuffer[0], cubSnapshot );
+
+		// Send only what changed since the newest update the client has acked, or everything if
+		// that update is too old for us to still have
+		uint32 unBaselineSequence = m_vecClientData[i].m_unAckedWorldSnapshot;
+		const std::vector< uint8 > *pvecBaseline = m_vecClientData[i].m_WorldSnapshots.FindSnapshot( unBaselineSequence );
+		if ( !pvecBaseline || pvecBaseline->size() != cubSnapshot )
+		{
+			unBaselineSequence = WORLD_SNAPSHOT_NONE;
+			pvecBaseline = NULL;
+		}
+
+		// Encode into the message itself, big enough for the worst case and trimmed to what we wrote
+		SteamNetworkingMessage_t *pOutMsg = m_pTransport->AllocateMessage( sizeof( MsgServerUpdateWorldDelta_t ) + GetWorldSnapshotDeltaMaxSize( cubSnapshot ) );
+		MsgServerUpdateWorldDelta_t *pDeltaMsg = new( pOutMsg->m_pData ) MsgServerUpdateWorldDelta_t;
+		pDeltaMsg->SetSequence( m_unWorldSnapshotSequence );
+		pDeltaMsg->SetBaselineSequence( unBaselineSequence );
+		pDeltaMsg->SetSnapshotSize( cubSnapshot );
+		pOutMsg->m_cbSize = sizeof( MsgServerUpdateWorldDelta_t ) + EncodeWorldSnapshotDelta( &m_vecPackedWorldBuffer[0],
+			pvecBaseline ? &(*pvecBaseline)[0] : NULL, cubSnapshot, (uint8 *)( pDeltaMsg + 1 ) );
+		pOutMsg->m_conn = m_vecClientData[i].m_hConn;
+		pOutMsg->m_nFlags = k_nSteamNetworkingSend_Unreliable;
+		pOutMsg->m_idxLane = k_ESpaceWarLaneState;
+		m_TickProfiler.CountMessageSent( pOutMsg->m_pData, pOutMsg->m_cbSize );
+		snapshotRate.OnUpdateSent( pOutMsg->m_cbSize );
+		m_vecpWorldUpdateMessages.push_back( pOutMsg );
+	}
 
-		BSendDataToClient( i, (char*)&msg, sizeof( msg ) );
+	// One call sends every client's update
+	if ( !m_vecpWorldUpdateMessages.empty() )
+	{
+		m_pTransport->SendMessages( (int)m_vecpWorldUpdateMessages.size(), &m_vecpWorldUpdateMessages[0], NULL );
+		m_vecpWorldUpdateMessages.clear();
 	}
 }
 
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Sends the same message to every client but one, sharing one copy
+//			of it between all of them
+//-----------------------------------------------------------------------------
 void CSpaceWarServer::SendMessageToAll( HSteamNetConnection hConnIgnore, const void* pubData, uint32 cubData)
 {
-	for (int i = 0; i < MAX_PLAYERS_PER_SERVER; i++)
+	m_vecBroadcastConnections.clear();
+	for (uint32 i = 0; i < m_unMaxPlayers; i++)
 	{
-		if ( m_rgClientData[i].m_hConn != k_HSteamNetConnection_Invalid && m_rgClientData[i].m_hConn != hConnIgnore )
-		{
-			SteamNetworkingSockets()->SendMessageToConnection(m_rgClientData[i].m_hConn, pubData, cubData, k_nSteamNetworkingSend_UnreliableNoDelay, nullptr );
-		}
+		if ( m_vecClientData[i].m_hConn != k_HSteamNetConnection_Invalid && m_vecClientData[i].m_hConn != hConnIgnore )
+			m_vecBroadcastConnections.push_back( m_vecClientData[i].m_hConn );
 	}
+
+	if ( m_vecBroadcastConnections.empty() )
+		return;
+
+	m_TickProfiler.CountMessageSent( pubData, cubData, (uint32)m_vecBroadcastConnections.size() );
+	if ( !SendMessageToConnections( m_pTransport, &m_vecBroadcastConnections[0], (uint32)m_vecBroadcastConnections.size(), pubData, cubData, k_nSteamNetworkingSend_UnreliableNoDelay, k_ESpaceWarLaneVoice, m_vecpBroadcastMessages ) )
+		OutputDebugString( "Failed sending data to all clients\n" );
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Longest queue time on each lane since the last call
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::GetLaneQueueTimes( SteamNetworkingMicroseconds rgusecMax[k_ESpaceWarLaneCount] )
+{
+	memcpy( rgusecMax, m_rgusecLaneQueueTimeMax, sizeof( m_rgusecLaneQueueTimeMax ) );
+	memset( m_rgusecLaneQueueTimeMax, 0, sizeof( m_rgusecLaneQueueTimeMax ) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: The rate the player in a slot is being sent world updates at
+//-----------------------------------------------------------------------------
+bool CSpaceWarServer::GetClientSnapshotRate( uint32 uSlot, ClientSnapshotRate_t *pRate )
+{
+	if ( uSlot >= m_unMaxPlayers || !m_vecClientData[uSlot].m_bActive )
+		return false;
+
+	m_vecClientData[uSlot].m_SnapshotRate.GetRate( pRate );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Report on the rates our players are being sent world updates at
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::AppendSnapshotRateReport( std::string &str, bool bPerClient )
+{
+	uint32 rgcClients[SNAPSHOT_RATE_LEVELS] = {};
+	uint32 cBackoffs = 0;
+	uint32 cRecoveries = 0;
+	std::string strClients;
+	char rgchBuffer[256];
+	for ( uint32 i = 0; i < m_unMaxPlayers; ++i )
+	{
+		ClientSnapshotRate_t rate;
+		if ( !GetClientSnapshotRate( i, &rate ) )
+			continue;
+
+		++rgcClients[rate.m_unLevel];
+		cBackoffs += rate.m_cBackoffs;
+		cRecoveries += rate.m_cRecoveries;
+		if ( !bPerClient )
+			continue;
+
+		sprintf_safe( rgchBuffer, "  Slot %u: %u Hz, %u%% lanes, ping %d ms, queue %.1f ms, send rate %d B/s, updates %.0f B/s, %u backoffs, %u recoveries\n",
+			i, SERVER_UPDATE_SEND_RATE / rate.m_unInterval, rate.m_unLanePercent, rate.m_nPing, rate.m_usecQueueTime / 1000.0,
+			rate.m_nSendRateBytesPerSecond, rate.m_flUpdateBytesPerSecond, rate.m_cBackoffs, rate.m_cRecoveries );
+		strClients += rgchBuffer;
+	}
+
+	str += "Snapshot rate players:";
+	for ( uint32 iLevel = 0; iLevel < SNAPSHOT_RATE_LEVELS; ++iLevel )
+	{
+		uint32 unInterval, unLanePercent;
+		CSnapshotRateController::GetLevel( iLevel, &unInterval, &unLanePercent );
+		sprintf_safe( rgchBuffer, "   %u Hz/%u%% %u", SERVER_UPDATE_SEND_RATE / unInterval, unLanePercent, rgcClients[iLevel] );
+		str += rgchBuffer;
+	}
+	sprintf_safe( rgchBuffer, "   (%u backoffs, %u recoveries)\n", cBackoffs, cRecoveries );
+	str += rgchBuffer;
+	str += strClients;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Receives a client's ack of the newest world update it has
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::OnReceiveClientAckWorldSnapshot( uint32 uShipIndex, uint32 unSequence )
+{
+	// Acks can arrive out of order, only move forward, and never past what we've sent
+	if ( unSequence > m_vecClientData[uShipIndex].m_unAckedWorldSnapshot && unSequence <= m_unWorldSnapshotSequence )
+		m_vecClientData[uShipIndex].m_unAckedWorldSnapshot = unSequence;
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Receives update data from clients
 //-----------------------------------------------------------------------------
 void CSpaceWarServer::OnReceiveClientUpdateData( uint32 uShipIndex, ClientSpaceWarUpdateData_t *pUpdateData )
 {
-	if ( m_rgClientData[uShipIndex].m_bActive && m_rgpShips[uShipIndex] )
+	if ( m_vecClientData[uShipIndex].m_bActive && m_vecpShips[uShipIndex] )
 	{
-		m_rgClientData[uShipIndex].m_ulTickCountLastData = m_pGameEngine->GetGameTickCount();
-		m_rgpShips[uShipIndex]->OnReceiveClientUpdate( pUpdateData );
+		m_vecClientData[uShipIndex].m_ulTickCountLastData = m_pGameEngine->GetGameTickCount();
+
+		// Updates are unreliable and can arrive out of order, don't go back to an older input
+		uint32 unShipInputSequence = m_vecpShips[uShipIndex]->GetInputSequence();
+		if ( unShipInputSequence != 0 && (int32)( pUpdateData->GetInputSequence() - unShipInputSequence ) <= 0 )
+			return;
+
+		m_vecpShips[uShipIndex]->OnReceiveClientUpdate( pUpdateData );
 	}
 }
 
 
 //-----------------------------------------------------------------------------
-// Purpose: Checks various game objects for collisions and updates state 
-//			appropriately if they have occurred
+// Purpose: Check ships against each other and each other's photon beams
 //-----------------------------------------------------------------------------
-void CSpaceWarServer::CheckForCollisions()
+void CSpaceWarServer::CheckForShipCollisions( CShip **rgpShips, uint32 unShips, CCollisionGrid *pGrid, std::vector< bool > &vecExplodingShips )
 {
-	// Make the ships check their photons for ones that have hit the sun and remove
-	// them before we go and check for them hitting the opponent
-	for ( uint32 i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
+	if ( pGrid )
 	{
-		if ( m_rgpShips[i] )
-			m_rgpShips[i]->DestroyPhotonsColldingWith( m_pSun );
+		pGrid->BeginUpdate();
+		for ( uint32 i=0; i<unShips; ++i )
+		{
+			if ( rgpShips[i] )
+				rgpShips[i]->UpdateCollisionGrid( pGrid, i );
+		}
+		pGrid->EndUpdate();
 	}
 
-	// Array to track who exploded, can't set the ship exploding within the loop below,
-	// or it will prevent that ship from colliding with later ships in the sequence
-	bool rgbExplodingShips[MAX_PLAYERS_PER_SERVER];
-	memset( rgbExplodingShips, 0, sizeof( rgbExplodingShips ) );
+	std::vector< uint32 > vecAllShips;
+	if ( !pGrid )
+	{
+		for ( uint32 j=0; j<unShips; ++j )
+			vecAllShips.push_back( j );
+	}
 
-	// Check each ship for colliding with the sun or another ships photons
-	for ( uint32 i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
+	for ( uint32 i=0; i<unShips; ++i )
 	{
 		// If the pointer is invalid skip the ship
-		if ( !m_rgpShips[i] )
+		if ( !rgpShips[i] )
 			continue;
 
-		if ( m_rgpShips[i]->BCollidesWith( m_pSun ) )
-		{
-			{
-				MsgServerPlayerHitSun_t msg;
-				msg.SetSteamID( m_rgClientData[ i ].m_SteamIDUser );
-				BSendDataToClient( i, ( char * )&msg, sizeof( msg ) );
-			}
-
-			rgbExplodingShips[i] |= 1;
-		}
+		// Ships that own anything near us, in the same order as the full scan so that shields
+		// soak up the same hit either way.  Anything the grid doesn't return can't be touching us.
+		const std::vector< uint32 > &vecCandidates = pGrid ? pGrid->GetCandidateOwners( rgpShips[i] ) : vecAllShips;
 
-		for( uint32 j=0; j<MAX_PLAYERS_PER_SERVER; ++j )
+		for( uint32 c=0; c<vecCandidates.size(); ++c )
 		{
+			uint32 j = vecCandidates[c];
+
 			// Don't check against your own photons, or NULL pointers!
-			if ( j == i || !m_rgpShips[j] )
+			if ( j == i || !rgpShips[j] )
 				continue;
 			
-			rgbExplodingShips[i] |= m_rgpShips[i]->BCollidesWith( m_rgpShips[j] );
-			if ( m_rgpShips[j]->BCheckForPhotonsCollidingWith( m_rgpShips[i] ) )
+			if ( rgpShips[i]->BCollidesWith( rgpShips[j] ) )
+				vecExplodingShips[i] = true;
+			if ( rgpShips[j]->BCheckForPhotonsCollidingWith( rgpShips[i] ) )
 			{
-				if ( m_rgpShips[i]->GetShieldStrength() > 200 )
+				if ( rgpShips[i]->GetShieldStrength() > 200 )
 				{
 					// Shield protects from the hit
-					m_rgpShips[i]->SetShieldStrength( 0 );
-					m_rgpShips[j]->DestroyPhotonsColldingWith( m_rgpShips[i] );
+					rgpShips[i]->SetShieldStrength( 0 );
+					rgpShips[j]->DestroyPhotonsColldingWith( rgpShips[i] );
 				}
 				else
 				{
-					rgbExplodingShips[i] |= 1;
+					vecExplodingShips[i] = true;
 				}
 			}
 		}
 	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Checks various game objects for collisions and updates state 
+//			appropriately if they have occurred
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::CheckForCollisions()
+{
+	CTickProfileScope profile( m_TickProfiler, CTickProfiler::k_EPhaseCollisions );
 
-	for ( uint32 i=0; i<MAX_PLAYERS_PER_SERVER; ++i )
+	// Make the ships check their photons for ones that have hit the sun and remove
+	// them before we go and check for them hitting the opponent
+	for ( uint32 i=0; i<m_unMaxPlayers; ++i )
 	{
-		if ( rgbExplodingShips[i] && m_rgpShips[i] )
-			m_rgpShips[i]->SetExploding( true );
+		if ( m_vecpShips[i] )
+			m_vecpShips[i]->DestroyPhotonsColldingWith( m_pSun );
+	}
+
+	// Array to track who exploded, can't set the ship exploding within the loop below,
+	// or it will prevent that ship from colliding with later ships in the sequence
+	m_vecExplodingShips.assign( m_unMaxPlayers, false );
+
+	// Check each ship for colliding with the sun, packing the ships up so they can be tested
+	// in batches
+	for ( uint32 i=0; i<m_unMaxPlayers; ++i )
+	{
+		if ( m_vecpShips[i] )
+		{
+			m_vecpShips[i]->GetCollisionCircle( &m_vecShipCollisionXPos[i], &m_vecShipCollisionYPos[i], &m_vecShipCollisionRadius[i] );
+		}
+		else
+		{
+			// If the pointer is invalid skip the ship
+			m_vecShipCollisionXPos[i] = 0.0f;
+			m_vecShipCollisionYPos[i] = 0.0f;
+			m_vecShipCollisionRadius[i] = COLLISION_RADIUS_DISABLED;
+		}
+	}
+
+	float xSunPos, ySunPos, flSunRadius;
+	m_pSun->GetCollisionCircle( &xSunPos, &ySunPos, &flSunRadius );
+	for ( uint32 iFirst=0; iFirst<m_unMaxPlayers; iFirst += COLLISION_BATCH_MAX )
+	{
+		uint32 unHits = CollideCircleBatch( xSunPos, ySunPos, flSunRadius, &m_vecShipCollisionXPos[iFirst], &m_vecShipCollisionYPos[iFirst],
+			&m_vecShipCollisionRadius[iFirst], MIN( (uint32)COLLISION_BATCH_MAX, m_unMaxPlayers - iFirst ) );
+
+		for ( uint32 i=iFirst; unHits; ++i, unHits >>= 1 )
+		{
+			if ( !( unHits & 1 ) )
+				continue;
+
+			{
+				MsgServerPlayerHitSun_t msg;
+				msg.SetSteamID( m_vecClientData[ i ].m_SteamIDUser );
+				BSendDataToClient( i, ( char * )&msg, sizeof( msg ) );
+			}
+
+			m_vecExplodingShips[i] = true;
+		}
+	}
+
+	// Then for colliding with another ship or another ships photons
+	m_CollisionGrid.Init( (float)m_pGameEngine->GetViewportWidth(), (float)m_pGameEngine->GetViewportHeight(), COLLISION_GRID_CELL_SIZE );
+	CheckForShipCollisions( &m_vecpShips[0], m_unMaxPlayers, &m_CollisionGrid, m_vecExplodingShips );
+
+	for ( uint32 i=0; i<m_unMaxPlayers; ++i )
+	{
+		if ( m_vecExplodingShips[i] && m_vecpShips[i] )
+			m_vecpShips[i]->SetExploding( true );
 	}
 
 	// Count how many ships are active, and how many are exploding
 	uint32 uActiveShips = 0;
 	uint32 uShipsExploding = 0;
 	uint32 uLastShipFoundAlive = 0;
-	for ( uint32 i = 0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	for ( uint32 i = 0; i < m_unMaxPlayers; ++i )
 	{
-		if ( m_rgpShips[i] )
+		if ( m_vecpShips[i] )
 		{
 			// Disabled ships don't count at all
-			if ( m_rgpShips[i]->BIsDisabled() )
+			if ( m_vecpShips[i]->BIsDisabled() )
 				continue;
 
 			++uActiveShips;
 		
-			if ( m_rgpShips[i]->BIsExploding() )
+			if ( m_vecpShips[i]->BIsExploding() )
 				++uShipsExploding;
 			else
 				uLastShipFoundAlive = i;
@@ -915,7 +1350,7 @@ void CSpaceWarServer::CheckForCollisions()
 	{
 		// If only one ship is alive they win
 		m_uPlayerWhoWonGame = uLastShipFoundAlive;
-		m_rguPlayerScores[uLastShipFoundAlive]++;
+		m_vecPlayerScores[uLastShipFoundAlive]++;
 		SetGameState( k_EServerWinner );
 	}
 }
@@ -931,8 +1366,12 @@ void CSpaceWarServer::OnSteamServersConnected( SteamServersConnected_t *pLogonSu
 
 	// log on is not finished until OnPolicyResponse() is called
 
-	// Tell Steam about our server details
-	SendUpdatedServerDetailsToSteam();
+	// Tell Steam about our server details, all of them in case it's logged us on again
+	if ( !m_bHostedMatch )
+	{
+		m_DetailsPublisher.RepublishAll();
+		SendUpdatedServerDetailsToSteam();
+	}
 }
 
 
@@ -987,13 +1426,14 @@ void CSpaceWarServer::SendUpdatedServerDetailsToSteam()
 
 	// Tell the Steam authentication servers about our game
 	char rgchServerName[128];
+#ifndef DEDICATED_SERVER
 	if ( SpaceWarClient() )
 	{
-		// If a client is running (should always be since we don't support a dedicated server)
-		// then we'll form the name based off of it
+		// If a client is running then we'll form the name based off of it
 		sprintf_safe( rgchServerName, "%s's game", SpaceWarClient()->GetLocalPlayerName() );
 	}
 	else
+#endif
 	{
 		sprintf_safe( rgchServerName, "%s", "Spacewar!" );
 	}
@@ -1005,24 +1445,16 @@ void CSpaceWarServer::SendUpdatedServerDetailsToSteam()
 
 	// These server state variables may be changed at any time.  Note that there is no lnoger a mechanism
 	// to send the player count.  The player count is maintained by steam and you should use the player
-	// creation/authentication functions to maintain your player count.
-	SteamGameServer()->SetMaxPlayerCount( 4 );
-	SteamGameServer()->SetPasswordProtected( false );
-	SteamGameServer()->SetServerName( m_sServerName.c_str() );
-	SteamGameServer()->SetBotPlayerCount( 0 ); // optional, defaults to zero
-	SteamGameServer()->SetMapName( "MilkyWay" );
-
-#ifdef USE_GS_AUTH_API
+	// creation/authentication functions to maintain your player count.  They go through the
+	// publisher, which only calls into Steam for the ones that have changed.
+	m_DetailsPublisher.SetMaxPlayerCount( m_unMaxPlayers );
+	m_DetailsPublisher.SetPasswordProtected( false );
+	m_DetailsPublisher.SetServerName( m_sServerName.c_str() );
+	m_DetailsPublisher.SetBotPlayerCount( 0 ); // optional, defaults to zero
+	m_DetailsPublisher.SetMapName( "MilkyWay" );
 
 	// Update all the players names/scores
-	for( uint32 i=0; i < MAX_PLAYERS_PER_SERVER; ++i )
-	{
-		if ( m_rgClientData[i].m_bActive && m_rgpShips[i] )
-		{
-			SteamGameServer()->BUpdateUserData( m_rgClientData[i].m_SteamIDUser, m_rgpShips[i]->GetPlayerName(), m_rguPlayerScores[i] );
-		}
-	}
-#endif
+	SendUpdatedPlayerDetailsToSteam( &m_DetailsPublisher );
 
 	// game type is a special string you can use for your game to differentiate different game play types occurring on the same maps
 	// When users search for this parameter they do a sub-string search of this string 
@@ -1032,44 +1464,38 @@ void CSpaceWarServer::SendUpdatedServerDetailsToSteam()
 	// update any rule values we publish
 	//SteamMasterServerUpdater()->SetKeyValue( "rule1_setting", "value" );
 	//SteamMasterServerUpdater()->SetKeyValue( "rule2_setting", "value2" );
+
+	m_DetailsPublisher.Flush( SteamGameServer(), m_pGameEngine->GetGameTickCount() );
 }
 
 
 //-----------------------------------------------------------------------------
-// Purpose: Tells us Steam3 (VAC and newer license checking) has accepted the user connection
+// Purpose: Tell Steam the names and scores of our players, through pPublisher
 //-----------------------------------------------------------------------------
-void CSpaceWarServer::OnValidateAuthTicketResponse( ValidateAuthTicketResponse_t *pResponse )
+void CSpaceWarServer::SendUpdatedPlayerDetailsToSteam( CServerDetailsPublisher *pPublisher )
 {
-	if ( pResponse->m_eAuthSessionResponse == k_EAuthSessionResponseOK )
-	{
-		// This is the final approval, and means we should let the client play (find the pending auth by steamid)
-		for ( uint32 i = 0; i<MAX_PLAYERS_PER_SERVER; ++i )
-		{
-			if ( !m_rgPendingClientData[i].m_bActive )
-				continue;
-			else if ( m_rgPendingClientData[i].m_SteamIDUser == pResponse->m_SteamID )
-			{
-				OutputDebugString( "Auth completed for a client\n" );
-				OnAuthCompleted( true, i );
-				return;
-			}
-		}
-	}
-	else
+#ifdef USE_GS_AUTH_API
+	for( uint32 i=0; i < m_unMaxPlayers; ++i )
 	{
-		// Looks like we shouldn't let this user play, kick them
-		for ( uint32 i = 0; i<MAX_PLAYERS_PER_SERVER; ++i )
+		if ( m_vecClientData[i].m_bActive && m_vecpShips[i] )
 		{
-			if ( !m_rgPendingClientData[i].m_bActive )
-				continue;
-			else if ( m_rgPendingClientData[i].m_SteamIDUser == pResponse->m_SteamID )
-			{
-				OutputDebugString( "Auth failed for a client\n" );
-				OnAuthCompleted( false, i );
-				return;
-			}
+			pPublisher->SetUserData( m_vecClientData[i].m_SteamIDUser, m_vecpShips[i]->GetPlayerName(), m_vecPlayerScores[i] );
 		}
 	}
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Tells us Steam3 (VAC and newer license checking) has accepted the user connection
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::OnValidateAuthTicketResponse( ValidateAuthTicketResponse_t *pResponse )
+{
+	// OK is the final approval, and means we should let the client play, anything else means we
+	// shouldn't.  Hosted matches all get this callback, the pipeline ignores players it isn't
+	// checking, or that something other than Steam is checking.
+	if ( m_AuthPipeline.GetValidator() == &m_SteamAuthValidator )
+		m_AuthPipeline.OnValidationResult( pResponse->m_SteamID, pResponse->m_eAuthSessionResponse == k_EAuthSessionResponseOK, m_pGameEngine->GetGameTickCount() );
 }
 
 
@@ -1080,7 +1506,10 @@ void CSpaceWarServer::OnValidateAuthTicketResponse( ValidateAuthTicketResponse_t
 CSteamID CSpaceWarServer::GetSteamID()
 {
 #ifdef USE_GS_AUTH_API
-	return SteamGameServer()->GetSteamID();
+	// No SteamGameServer when we only run in-process
+	if ( SteamGameServer() )
+		return SteamGameServer()->GetSteamID();
+	return k_steamIDNonSteamGS;
 #else
 	// this is a placeholder steam id to use when not making use of Steam auth or matchmaking
 	return k_steamIDNonSteamGS;
@@ -1093,26 +1522,118 @@ CSteamID CSpaceWarServer::GetSteamID()
 //-----------------------------------------------------------------------------
 void CSpaceWarServer::KickPlayerOffServer( CSteamID steamID )
 {
-	uint32 uPlayerCount = 0;
-	for( uint32 i=0; i < MAX_PLAYERS_PER_SERVER; ++i )
+	for( uint32 i=0; i < m_unMaxPlayers; ++i )
 	{
 		// If there is no ship, skip
-		if ( !m_rgClientData[i].m_bActive )
+		if ( !m_vecClientData[i].m_bActive )
 			continue;
 
-		if ( m_rgClientData[i].m_SteamIDUser == steamID )
+		if ( m_vecClientData[i].m_SteamIDUser == steamID )
 		{
 			OutputDebugString( "Kicking player\n" );
 			RemovePlayerFromServer( i, k_EDRClientKicked);
 			// send him a kick message
 			MsgServerFailAuthentication_t msg;
 			int64 outMessage;
-			SteamGameServerNetworkingSockets()->SendMessageToConnection(m_rgClientData[i].m_hConn, &msg, sizeof(msg), k_nSteamNetworkingSend_Reliable, &outMessage);
-		}
-		else
-		{
-			++uPlayerCount;
+			m_TickProfiler.CountMessageSent( &msg, sizeof(msg) );
+			SendMessageToConnectionOnLane( m_pTransport, m_vecClientData[i].m_hConn, &msg, sizeof(msg), k_nSteamNetworkingSend_Reliable, k_ESpaceWarLaneControl, &outMessage );
 		}
 	}
-	m_uPlayerCount = uPlayerCount;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Check tickets with something else, or go back to our own
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::SetAuthValidator( IAuthValidator *pValidator )
+{
+	m_AuthPipeline.SetValidator( pValidator ? pValidator : m_pDefaultAuthValidator );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Start recording a replay log
+//-----------------------------------------------------------------------------
+bool CSpaceWarServer::BStartRecording( const char *pchFileName )
+{
+	if ( m_pReplayRecorder || m_SimulationEngine.GetStepCount() )
+		return false;
+
+	if ( m_uPlayerCount || m_AuthPipeline.GetPendingCount() )
+		return false;
+
+	m_pReplayRecorder = new CReplayRecorder();
+	if ( !m_pReplayRecorder->BOpen( pchFileName, m_unMaxPlayers, m_pGameEngine->GetGameTickCount() ) )
+	{
+		delete m_pReplayRecorder;
+		m_pReplayRecorder = NULL;
+		return false;
+	}
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Stop recording, closing the log
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::StopRecording()
+{
+	delete m_pReplayRecorder;
+	m_pReplayRecorder = NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Replay a player joining.  They're let in like a real player who
+//			passed authentication, but with no connection, so nothing is
+//			sent to them.  That has to give them the slot they had when
+//			recording, if it wouldn't the replay has already diverged and
+//			this fails.
+//-----------------------------------------------------------------------------
+bool CSpaceWarServer::ReplayPlayerJoined( CSteamID steamID, uint32 uShipPosition )
+{
+	// The lowest free slot is the one they'd get
+	if ( m_vecFreeSlots.empty() || m_vecFreeSlots.front() != uShipPosition )
+		return false;
+
+	AddAuthenticatedPlayer( steamID, k_HSteamNetConnection_Invalid );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Replay a player leaving.  If they timed out the replay will already
+//			have timed them out too, and this does nothing.
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::ReplayPlayerLeft( uint32 uShipPosition )
+{
+	if ( uShipPosition < m_unMaxPlayers && m_vecpShips[uShipPosition] )
+		RemovePlayerFromServer( uShipPosition, k_EDRClientDisconnect );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Replay a message from the player in a slot
+//-----------------------------------------------------------------------------
+void CSpaceWarServer::ReplayClientMessage( uint32 uShipIndex, const void *pubData, uint32 cubData )
+{
+	if ( uShipIndex >= m_unMaxPlayers || cubData < sizeof( DWORD ) )
+		return;
+
+	// The recorded message is only aligned as well as the log is, copy everything out of it
+	DWORD dwMsg;
+	memcpy( &dwMsg, pubData, sizeof( dwMsg ) );
+	EMessage eMsg = (EMessage)LittleDWord( dwMsg );
+	if ( eMsg == k_EMsgClientSendLocalUpdate && cubData == sizeof( MsgClientSendLocalUpdate_t ) )
+	{
+		MsgClientSendLocalUpdate_t msg;
+		memcpy( (void *)&msg, pubData, sizeof( msg ) );
+		OnReceiveClientUpdateData( uShipIndex, msg.AccessUpdateData() );
+	}
+	else if ( eMsg == k_EMsgClientAckWorldSnapshot && cubData == sizeof( MsgClientAckWorldSnapshot_t ) )
+	{
+		MsgClientAckWorldSnapshot_t msg;
+		memcpy( (void *)&msg, pubData, sizeof( msg ) );
+		OnReceiveClientAckWorldSnapshot( uShipIndex, msg.GetSequence() );
+	}
 }
@@ -9,17 +9,36 @@
 #define SPACEWARSERVER_H
 
 #include <string>
+#include <vector>
 
 #include "GameEngine.h"
 #include "SpaceWar.h"
 #include "Ship.h"
 #include "Sun.h"
+#include "VectorEntityStatePool.h"
+#include "EntityPool.h"
+#include "CollisionGrid.h"
+#include "WorldSnapshot.h"
+#include "RelevancyFilter.h"
+#include "SnapshotRateController.h"
+#include "MatchGameEngine.h"
+#include "SpaceWarTransport.h"
+#include "SteamIDSlotMap.h"
+#include "AuthPipeline.h"
+#include "TickProfiler.h"
+#include "TimerWheel.h"
+#include "ServerDetailsPublisher.h"
 #include "steam/isteamnetworkingsockets.h" 
 #include "steam/steamclientpublic.h"
 #include "Messages.h"
 
 // Forward declaration
 class CSpaceWarClient;
+class CReplayRecorder;
+
+// Minimum size of a collision grid cell, must be at least the sum of the collision radii of a
+// ship and anything that can hit it (a ship is 11, a photon beam 3)
+#define COLLISION_GRID_CELL_SIZE 32.0f
 
 struct ClientConnectionData_t
 {
@@ -27,26 +46,40 @@ struct ClientConnectionData_t
 	CSteamID m_SteamIDUser;			// What is the steamid of the player?
 	uint64 m_ulTickCountLastData;	// What was the last time we got data from the player?
 	HSteamNetConnection m_hConn;	// The handle for the connection to the player
+	uint32 m_unAckedWorldSnapshot;	// Newest world snapshot the player has told us they got
+	CWorldSnapshotHistory m_WorldSnapshots;	// World snapshots we sent the player recently
+	CRelevancyFilter m_RelevancyFilter;	// Picks which players the player is sent each update
+	CSnapshotRateController m_SnapshotRate;	// How often and in how much detail the player is sent updates
+	TimerHandle_t m_hTimeoutTimer;	// Fires once they could have gone SERVER_TIMEOUT_MILLISECONDS without sending anything
 
 	ClientConnectionData_t() {
 		m_bActive = false;
 		m_ulTickCountLastData = 0;
 		m_hConn = 0;
+		m_unAckedWorldSnapshot = WORLD_SNAPSHOT_NONE;
+		m_hTimeoutTimer = k_hTimerInvalid;
 	}
 };
 
-class CSpaceWarServer
+class CSpaceWarServer : public ISpaceWarTransportListener, public IAuthPipelineListener, public ITimerListener
 {
 public:
-	//Constructor
-	CSpaceWarServer( IGameEngine *pEngine );
+	// Constructor.  A hosted match is one of many matches run by a CSpaceWarMatchHost, which owns
+	// the process-wide SteamGameServer connection and runs callbacks on our behalf.  Each hosted
+	// listens on its own P2P virtual port.  unMaxPlayers is clamped to MAX_PLAYERS_PER_SERVER_LIMIT.
+	// Players connect over pTransport, or over SteamGameServerNetworkingSockets() if it's NULL.
+	CSpaceWarServer( IGameEngine *pEngine, bool bHostedMatch = false, int nVirtualPort = 0, uint32 unMaxPlayers = MAX_PLAYERS_PER_SERVER, ISpaceWarTransport *pTransport = NULL );
 
 	// Destructor
 	~CSpaceWarServer();
 
-	// Run a game frame
+	// Run a game frame, stepping the simulation for however much time has passed since the last one
 	void RunFrame();
 
+	// Run simulation steps back to back without waiting for the time to pass, for running the
+	// simulation faster than real time
+	void RunSimulationSteps( uint32 cSteps );
+
 	// Set game state
 	void SetGameState( EServerGameState eState );
 
@@ -62,12 +95,66 @@ public:
 	// Checks various game objects for collisions and updates state appropriately if they have occurred
 	void CheckForCollisions();
 
+	// Check ships against each other and each other's photon beams, marking any that were hit in
+	// vecExplodingShips.  With a grid only the ships it finds nearby are checked, otherwise every
+	// pair is (which gives the same result, just slower).
+	static void CheckForShipCollisions( CShip **rgpShips, uint32 unShips, CCollisionGrid *pGrid, std::vector< bool > &vecExplodingShips );
+
 	// Kicks a given player off the server
 	void KickPlayerOffServer( CSteamID steamID );
 
+	// Give pPublisher the names and scores of our players, for it to tell Steam
+	void SendUpdatedPlayerDetailsToSteam( CServerDetailsPublisher *pPublisher );
+
+	// Record the client input we act on and the snapshots we build to a replay log, see
+	// ReplayLog.h.  A log can't describe a match already under way, so this fails once anyone
+	// has joined or the simulation has started.
+	bool BStartRecording( const char *pchFileName );
+	void StopRecording();
+
+	// Play back what a replay log recorded, in place of the network, see RunReplay.  A join
+	// fails if the player wouldn't get the slot the log has them in.
+	bool ReplayPlayerJoined( CSteamID steamID, uint32 uShipPosition );
+	void ReplayPlayerLeft( uint32 uShipPosition );
+	void ReplayClientMessage( uint32 uShipIndex, const void *pubData, uint32 cubData );
+
+	// How many heap allocations RunSimulationSteps has made since the count was last reset.  Once
+	// everyone is in a game a step shouldn't allocate at all.
+	uint64 GetSimulationAllocationCount() const { return m_cSimulationAllocations; }
+	void ResetSimulationAllocationCount() { m_cSimulationAllocations = 0; }
+
+	// Longest any client's connection had messages waiting to go out on each lane (see
+	// ESpaceWarLane) since the last call, sampled each world update
+	void GetLaneQueueTimes( SteamNetworkingMicroseconds rgusecMax[k_ESpaceWarLaneCount] );
+
+	// How long each phase of our frames has taken and what we've sent and received, since it
+	// was last reset.  Only touch it between frames.
+	CTickProfiler &AccessTickProfiler() { return m_TickProfiler; }
+
+	// The rate the player in a slot is being sent world updates at, false if the slot is empty
+	bool GetClientSnapshotRate( uint32 uSlot, ClientSnapshotRate_t *pRate );
+
+	// Append how many players are at each snapshot rate level, and with bPerClient a line for
+	// each player with their rate and connection
+	void AppendSnapshotRateReport( std::string &str, bool bPerClient );
+
+	// Check logon tickets with pValidator, which we don't own, rather than Steam (or nothing, on
+	// an in-process transport).  NULL goes back to our own.  Only before anyone connects.
+	void SetAuthValidator( IAuthValidator *pValidator );
+
+	// What logging players on has taken since it was last reset
+	const AuthPipelineStats_t &GetAuthStats() const { return m_AuthPipeline.GetStats(); }
+	void ResetAuthStats() { m_AuthPipeline.ResetStats(); }
+
+	// The world update we last built for clients
+	ServerSpaceWarUpdateData_t *AccessLastWorldUpdate() { return ( (MsgServerUpdateWorld_t *)&m_vecUpdateWorldBuffer[0] )->AccessUpdateData(); }
+
 	// data accessors
 	bool IsConnectedToSteam()		{ return m_bConnectedToSteam; }
 	CSteamID GetSteamID();
+	uint32 GetPlayerCount()			{ return m_uPlayerCount; }
+	uint32 GetMaxPlayers()			{ return m_unMaxPlayers; }
+	bool BIsHostedMatch()			{ return m_bHostedMatch; }
 
 private:
 	//
@@ -100,21 +187,44 @@ private:
 	// All connection changes are handled through this callback
 	STEAM_GAMESERVER_CALLBACK(CSpaceWarServer, OnNetConnectionStatusChanged, SteamNetConnectionStatusChangedCallback_t);
 
+	// Connection changes on a transport that delivers its own, rather than through Steam
+	void OnConnectionStatusChanged( SteamNetConnectionStatusChangedCallback_t *pCallback ) { OnNetConnectionStatusChanged( pCallback ); }
+
 	// Function to tell Steam about our servers details
 	void SendUpdatedServerDetailsToSteam();
 
+	// Slot of the connected player a message came from, or m_unMaxPlayers if it isn't from one
+	uint32 GetClientSlotForMessage( SteamNetworkingMessage_t *pMessage );
+
 	// Receive updates from client
 	void OnReceiveClientUpdateData( uint32 uShipIndex, ClientSpaceWarUpdateData_t *pUpdateData );
 
+	// Receive a client's ack of a world update
+	void OnReceiveClientAckWorldSnapshot( uint32 uShipIndex, uint32 unSequence );
+
 	// Send data to a client at the given ship index
 	bool BSendDataToClient( uint32 uShipIndex, char *pData, uint32 nSizeOfData );
 
-	// Send data to a client at the given pending index
-	bool BSendDataToPendingClient( uint32 uShipIndex, char *pData, uint32 nSizeOfData );
+	// Handles a client sending its ticket, on a connection tagged with nUserData
+	void OnClientBeginAuthentication( CSteamID steamIDClient, HSteamNetConnection connectionID, int64 nUserData, const void *pToken, uint32 uTokenLen );
 
-	void OnClientBeginAuthentication(CSteamID steamIDClient, HSteamNetConnection connectionID, void* pToken, uint32 uTokenLen);
 	// Handles authentication completing for a client
-	void OnAuthCompleted( bool bAuthSuccess, uint32 iPendingAuthIndex );
+	void OnAuthFinished( HSteamNetConnection hConn, CSteamID steamID, EAuthResult eResult );
+
+	// Give a player who's passed authentication the lowest free slot and a ship
+	void AddAuthenticatedPlayer( CSteamID steamID, HSteamNetConnection hConn );
+
+	// What our timers are for, in the top half of their context.  The bottom half is the
+	// player slot, for the ones that have one.
+	enum EServerTimer
+	{
+		k_EServerTimerClientTimeout,
+		k_EServerTimerRoundState,
+		k_EServerTimerServerDetails,
+	};
+
+	// Handles one of our timers coming due
+	void OnTimerExpired( uint64 ulContext, uint64 ulTickCount );
 
 	// Adds/initializes a new player ship at the given position
 	void AddPlayerShip( uint32 uShipPosition );
@@ -122,35 +232,91 @@ private:
 	// Removes a player from the server
 	void RemovePlayerFromServer( uint32 uShipPosition, EDisconnectReason reason);
 
+	// Advance the game by one SIMULATION_STEP_MILLISECONDS step
+	void RunSimulationStep();
+
+	// Run a step's worth of frames for the sun and ships
+	void RunEntityFrames();
+
 	// Send world update to all clients
 	void SendUpdateDataToAllClients();
 
-	// Send the same message to all clients, except the ignored connection if any
+	// Send the same message to all clients, except the ignored connection if any.  It goes
+	// unreliably on the voice lane, voice chat is all that's relayed like this.
 	void SendMessageToAll( HSteamNetConnection hConnIgnore, const void* pubData, uint32 cubData );
 
 	// Track whether our server is connected to Steam ok (meaning we can restrict who plays based on 
 	// ownership and VAC bans, etc...)
 	bool m_bConnectedToSteam;
 
+	// Are we one of many matches in a CSpaceWarMatchHost process?
+	bool m_bHostedMatch;
+
+	// How many player slots this server has, all the per player vectors below are this size
+	uint32 m_unMaxPlayers;
+
+	// Simulation state for every entity in this match (sun, ships, photon beams, debris)
+	CVectorEntityStatePool m_EntityStatePool;
+
 	// Ships for players, doubles as a way to check for open slots (pointer is NULL meaning open)
-	CShip *m_rgpShips[MAX_PLAYERS_PER_SERVER];
+	std::vector< CShip * > m_vecpShips;
+
+	// Room for a ship in every slot, set aside once for the match so a new round doesn't hit the heap
+	CEntityPool< CShip > m_ShipPool;
+
+	// Heap allocations made while running simulation steps, see GetSimulationAllocationCount
+	uint64 m_cSimulationAllocations;
 
 	// Player scores
-	uint32 m_rguPlayerScores[MAX_PLAYERS_PER_SERVER];
+	std::vector< uint32 > m_vecPlayerScores;
+
+	// Scratch space for CheckForCollisions, kept around so we don't allocate every frame
+	std::vector< bool > m_vecExplodingShips;
+
+	// Broadphase for ship collisions, updated each frame in CheckForCollisions
+	CCollisionGrid m_CollisionGrid;
+
+	// Ship collision circles packed for testing against the sun in batches
+	std::vector< float > m_vecShipCollisionXPos;
+	std::vector< float > m_vecShipCollisionYPos;
+	std::vector< float > m_vecShipCollisionRadius;
+
+	// Buffer we build world updates in, sized for m_unMaxPlayers slots
+	std::vector< uint8 > m_vecUpdateWorldBuffer;
+
+	// Buffer we pack each client's world update into
+	std::vector< uint8 > m_vecPackedWorldBuffer;
+
+	// Sequence number of the last world update we sent
+	uint32 m_unWorldSnapshotSequence;
+
+	// Each client's delta encoded world update, encoded straight into the message that sends it,
+	// and all sent in one go
+	std::vector< SteamNetworkingMessage_t * > m_vecpWorldUpdateMessages;
+
+	// Connections a message to all clients goes to, and the messages that send it
+	std::vector< HSteamNetConnection > m_vecBroadcastConnections;
+	std::vector< SteamNetworkingMessage_t * > m_vecpBroadcastMessages;
+
+	// Longest queue time seen on each lane since GetLaneQueueTimes was last called
+	SteamNetworkingMicroseconds m_rgusecLaneQueueTimeMax[k_ESpaceWarLaneCount];
+
+	// Phase timings and message counts
+	CTickProfiler m_TickProfiler;
 
 	// server name
 	std::string m_sServerName;
 
+	// What we've told Steam about ourselves, if we're not a hosted match
+	CServerDetailsPublisher m_DetailsPublisher;
+
 	// Who just won the game? Should be set if we go into the k_EGameWinner state
 	uint32 m_uPlayerWhoWonGame;
 
-	// Last time state changed
-	uint64 m_ulStateTransitionTime;
-
 	// Last time we sent clients an update
 	uint64 m_ulLastServerUpdateTick;
 
-	// Number of players currently connected, updated each frame
+	// Number of players currently connected
 	uint32 m_uPlayerCount;
 
 	// Current game state
@@ -162,17 +328,48 @@ private:
 	// pointer to game engine instance we are running under
 	IGameEngine *m_pGameEngine;
 
+	// Clock the sun and ships run under, moved on in fixed steps by RunFrame
+	CSimulationEngine m_SimulationEngine;
+
+	// Timers on the game engine's clock: players and logons timing out, and refreshing our
+	// server details
+	CTimerWheel m_Timers;
+
+	// Timers on the simulation clock, so a replay changes rounds on the same step: the wait
+	// for players and the pause between rounds.  Once it fires, the state it was armed for has
+	// lasted long enough.
+	CTimerWheel m_SimulationTimers;
+	TimerHandle_t m_hRoundStateTimer;
+	bool m_bRoundStateTimerExpired;
+
 	// Vector to keep track of client connections
-	ClientConnectionData_t m_rgClientData[MAX_PLAYERS_PER_SERVER];
+	std::vector< ClientConnectionData_t > m_vecClientData;
+
+	// Slots in m_vecClientData that aren't in use, as a min-heap so joins take the lowest
+	std::vector< uint32 > m_vecFreeSlots;
+
+	// Connections that haven't finished logging on, and what checks their tickets
+	CAuthPipeline m_AuthPipeline;
+	IAuthValidator *m_pDefaultAuthValidator;
+	CSteamAuthValidator m_SteamAuthValidator;
+	CTrustingAuthValidator m_TrustingAuthValidator;
 
-	// Vector to keep track of client connections which are pending auth
-	ClientConnectionData_t m_rgPendingClientData[MAX_PLAYERS_PER_SERVER];
+	// Slot in m_vecClientData each connected player's Steam ID is in.  Their connections
+	// carry the same slot as their user data.
+	CSteamIDSlotMap m_mapSteamIDToSlot;
 
 	// Socket to listen for new connections on 
 	HSteamListenSocket m_hListenSocket;
 
 	// Poll group used to receive messages from all clients at once
 	HSteamNetPollGroup m_hNetPollGroup;
+
+	// What players connect to us over, and whether we made it (and so have to delete it)
+	ISpaceWarTransport *m_pTransport;
+	bool m_bOwnsTransport;
+
+	// Replay log we're recording to, if any
+	CReplayRecorder *m_pReplayRecorder;
 };
 
 
@@ -0,0 +1,98 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: The networking calls the SpaceWar server makes, behind an interface
+//			so it can run on Steam or on an in-process transport
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "SpaceWarTransport.h"
+#include <atomic>
+#include <new>
+
+// Payload shared by the messages from one SendMessageToConnections, the data follows it.  Steam
+// can free sent messages on its own thread, so the count is atomic.
+struct SharedMessagePayload_t
+{
+	std::atomic< uint32 > m_cRefs;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: m_pfnFreeData for messages pointing at a shared payload, frees it
+//			with the last of them
+//-----------------------------------------------------------------------------
+static void ReleaseSharedMessagePayload( SteamNetworkingMessage_t *pMsg )
+{
+	SharedMessagePayload_t *pPayload = (SharedMessagePayload_t *)pMsg->m_pData - 1;
+	if ( pPayload->m_cRefs.fetch_sub( 1, std::memory_order_acq_rel ) != 1 )
+		return;
+
+	pPayload->~SharedMessagePayload_t();
+	free( pPayload );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Send one payload to many connections.  Each message is only a
+//			header, so sending to N players costs one copy of the payload
+//			rather than N.
+//-----------------------------------------------------------------------------
+bool SendMessageToConnections( ISpaceWarTransport *pTransport, const HSteamNetConnection *rgConns, uint32 cConns,
+	const void *pData, uint32 cbData, int nSendFlags, int nLane, std::vector< SteamNetworkingMessage_t * > &vecpMessages )
+{
+	if ( !cConns )
+		return true;
+
+	void *pMem = malloc( sizeof( SharedMessagePayload_t ) + cbData );
+	if ( !pMem )
+		return false;
+
+	SharedMessagePayload_t *pPayload = new( pMem ) SharedMessagePayload_t;
+	pPayload->m_cRefs.store( cConns, std::memory_order_relaxed );
+	memcpy( (uint8 *)( pPayload + 1 ), pData, cbData );
+
+	// A header per connection, all sent in one call
+	vecpMessages.resize( cConns );
+	for ( uint32 i = 0; i < cConns; ++i )
+	{
+		SteamNetworkingMessage_t *pMsg = pTransport->AllocateMessage( 0 );
+		pMsg->m_pData = pPayload + 1;
+		pMsg->m_cbSize = (int)cbData;
+		pMsg->m_pfnFreeData = ReleaseSharedMessagePayload;
+		pMsg->m_conn = rgConns[i];
+		pMsg->m_nFlags = nSendFlags;
+		pMsg->m_idxLane = (uint16)nLane;
+		vecpMessages[i] = pMsg;
+	}
+	pTransport->SendMessages( (int)cConns, &vecpMessages[0], NULL );
+	vecpMessages.clear();
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Send a copy of a message on a lane.  SendMessageToConnection has no
+//			lane to pass, everything it sends goes on lane 0.
+//-----------------------------------------------------------------------------
+EResult SendMessageToConnectionOnLane( ISpaceWarTransport *pTransport, HSteamNetConnection hConn, const void *pData, uint32 cbData,
+	int nSendFlags, int nLane, int64 *pOutMessageNumber )
+{
+	if ( cbData > k_cbMaxSteamNetworkingSocketsMessageSizeSend )
+		return k_EResultInvalidParam;
+
+	SteamNetworkingMessage_t *pMsg = pTransport->AllocateMessage( (int)cbData );
+	memcpy( pMsg->m_pData, pData, cbData );
+	pMsg->m_conn = hConn;
+	pMsg->m_nFlags = nSendFlags;
+	pMsg->m_idxLane = (uint16)nLane;
+
+	int64 nResult;
+	pTransport->SendMessages( 1, &pMsg, &nResult );
+	if ( nResult < 0 )
+		return (EResult)-nResult;
+
+	if ( pOutMessageNumber )
+		*pOutMessageNumber = nResult;
+	return k_EResultOK;
+}
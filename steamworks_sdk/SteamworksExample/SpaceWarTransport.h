@@ -0,0 +1,144 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: The networking calls the SpaceWar client and server make, behind an
+//			interface so they can run on Steam or on an in-process transport
+//
+//=============================================================================
+
+#ifndef SPACEWARTRANSPORT_H
+#define SPACEWARTRANSPORT_H
+
+#include <vector>
+#include "steam/isteamnetworkingsockets.h"
+#include "steam/isteamnetworkingutils.h"
+
+//-----------------------------------------------------------------------------
+// Purpose: Told about connections changing state by a transport that delivers
+//			its own status changes
+//-----------------------------------------------------------------------------
+class ISpaceWarTransportListener
+{
+public:
+	virtual ~ISpaceWarTransportListener() {}
+	virtual void OnConnectionStatusChanged( SteamNetConnectionStatusChangedCallback_t *pCallback ) = 0;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: The subset of ISteamNetworkingSockets SpaceWar uses.  The calls mean
+//			the same as they do there.
+//-----------------------------------------------------------------------------
+class ISpaceWarTransport
+{
+public:
+	virtual ~ISpaceWarTransport() {}
+
+	virtual HSteamListenSocket CreateListenSocketP2P( int nVirtualPort ) = 0;
+	virtual bool CloseListenSocket( HSteamListenSocket hSocket ) = 0;
+
+	virtual HSteamNetConnection ConnectP2P( const SteamNetworkingIdentity &identityRemote, int nRemoteVirtualPort ) = 0;
+	virtual EResult AcceptConnection( HSteamNetConnection hConn ) = 0;
+	virtual bool CloseConnection( HSteamNetConnection hPeer, int nReason, const char *pszDebug, bool bEnableLinger ) = 0;
+	virtual bool GetConnectionInfo( HSteamNetConnection hConn, SteamNetConnectionInfo_t *pInfo ) = 0;
+
+	virtual HSteamNetPollGroup CreatePollGroup() = 0;
+	virtual bool DestroyPollGroup( HSteamNetPollGroup hPollGroup ) = 0;
+	virtual bool SetConnectionPollGroup( HSteamNetConnection hConn, HSteamNetPollGroup hPollGroup ) = 0;
+
+	// Messages received on the connection carry the user data in m_nConnUserData, including
+	// ones already queued when it's set
+	virtual bool SetConnectionUserData( HSteamNetConnection hPeer, int64 nUserData ) = 0;
+
+	// Lanes are set up per direction, and messages pick theirs with m_idxLane when sent with
+	// SendMessages.  GetConnectionRealTimeStatus reports how long each lane's queue is.
+	virtual EResult ConfigureConnectionLanes( HSteamNetConnection hConn, int nNumLanes, const int *pLanePriorities, const uint16 *pLaneWeights ) = 0;
+	virtual EResult GetConnectionRealTimeStatus( HSteamNetConnection hConn, SteamNetConnectionRealTimeStatus_t *pStatus, int nLanes, SteamNetConnectionRealTimeLaneStatus_t *pLanes ) = 0;
+
+	virtual EResult SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber ) = 0;
+	virtual int ReceiveMessagesOnConnection( HSteamNetConnection hConn, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages ) = 0;
+	virtual int ReceiveMessagesOnPollGroup( HSteamNetPollGroup hPollGroup, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages ) = 0;
+
+	// Messages for SendMessages, which sends them without copying their payloads.  The transport
+	// takes the messages and releases them itself, even the ones that fail to send.  From
+	// ISteamNetworkingUtils, which is where AllocateMessage lives over Steam.
+	virtual SteamNetworkingMessage_t *AllocateMessage( int cbAllocateBuffer ) = 0;
+	virtual void SendMessages( int nMessages, SteamNetworkingMessage_t *const *pMessages, int64 *pOutMessageNumberOrResult ) = 0;
+
+	// Connection status changes are handed to every listener from RunCallbacks.  Over Steam they
+	// arrive through Steam callbacks instead, and the listeners get nothing from us.
+	virtual void AddListener( ISpaceWarTransportListener *pListener ) = 0;
+	virtual void RemoveListener( ISpaceWarTransportListener *pListener ) = 0;
+	virtual void RunCallbacks() = 0;
+
+	// Can connections only come from inside this process?  Then there's no Steam to
+	// authenticate them with, and no need to.
+	virtual bool BIsInProcess() = 0;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Transport over an ISteamNetworkingSockets, the game server's or the
+//			client's
+//-----------------------------------------------------------------------------
+class CSteamNetworkingTransport : public ISpaceWarTransport
+{
+public:
+	CSteamNetworkingTransport( ISteamNetworkingSockets *pSockets, ISteamNetworkingUtils *pUtils ) : m_pSockets( pSockets ), m_pUtils( pUtils ) {}
+
+	HSteamListenSocket CreateListenSocketP2P( int nVirtualPort ) { return m_pSockets->CreateListenSocketP2P( nVirtualPort, 0, nullptr ); }
+	bool CloseListenSocket( HSteamListenSocket hSocket ) { return m_pSockets->CloseListenSocket( hSocket ); }
+
+	HSteamNetConnection ConnectP2P( const SteamNetworkingIdentity &identityRemote, int nRemoteVirtualPort )
+		{ return m_pSockets->ConnectP2P( identityRemote, nRemoteVirtualPort, 0, nullptr ); }
+	EResult AcceptConnection( HSteamNetConnection hConn ) { return m_pSockets->AcceptConnection( hConn ); }
+	bool CloseConnection( HSteamNetConnection hPeer, int nReason, const char *pszDebug, bool bEnableLinger ) { return m_pSockets->CloseConnection( hPeer, nReason, pszDebug, bEnableLinger ); }
+	bool GetConnectionInfo( HSteamNetConnection hConn, SteamNetConnectionInfo_t *pInfo ) { return m_pSockets->GetConnectionInfo( hConn, pInfo ); }
+
+	HSteamNetPollGroup CreatePollGroup() { return m_pSockets->CreatePollGroup(); }
+	bool DestroyPollGroup( HSteamNetPollGroup hPollGroup ) { return m_pSockets->DestroyPollGroup( hPollGroup ); }
+	bool SetConnectionPollGroup( HSteamNetConnection hConn, HSteamNetPollGroup hPollGroup ) { return m_pSockets->SetConnectionPollGroup( hConn, hPollGroup ); }
+
+	bool SetConnectionUserData( HSteamNetConnection hPeer, int64 nUserData ) { return m_pSockets->SetConnectionUserData( hPeer, nUserData ); }
+
+	EResult ConfigureConnectionLanes( HSteamNetConnection hConn, int nNumLanes, const int *pLanePriorities, const uint16 *pLaneWeights )
+		{ return m_pSockets->ConfigureConnectionLanes( hConn, nNumLanes, pLanePriorities, pLaneWeights ); }
+	EResult GetConnectionRealTimeStatus( HSteamNetConnection hConn, SteamNetConnectionRealTimeStatus_t *pStatus, int nLanes, SteamNetConnectionRealTimeLaneStatus_t *pLanes )
+		{ return m_pSockets->GetConnectionRealTimeStatus( hConn, pStatus, nLanes, pLanes ); }
+
+	EResult SendMessageToConnection( HSteamNetConnection hConn, const void *pData, uint32 cbData, int nSendFlags, int64 *pOutMessageNumber )
+		{ return m_pSockets->SendMessageToConnection( hConn, pData, cbData, nSendFlags, pOutMessageNumber ); }
+	int ReceiveMessagesOnConnection( HSteamNetConnection hConn, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages )
+		{ return m_pSockets->ReceiveMessagesOnConnection( hConn, ppOutMessages, nMaxMessages ); }
+	int ReceiveMessagesOnPollGroup( HSteamNetPollGroup hPollGroup, SteamNetworkingMessage_t **ppOutMessages, int nMaxMessages )
+		{ return m_pSockets->ReceiveMessagesOnPollGroup( hPollGroup, ppOutMessages, nMaxMessages ); }
+
+	SteamNetworkingMessage_t *AllocateMessage( int cbAllocateBuffer ) { return m_pUtils->AllocateMessage( cbAllocateBuffer ); }
+	void SendMessages( int nMessages, SteamNetworkingMessage_t *const *pMessages, int64 *pOutMessageNumberOrResult )
+		{ m_pSockets->SendMessages( nMessages, pMessages, pOutMessageNumberOrResult ); }
+
+	// Steam runs its own callbacks
+	void AddListener( ISpaceWarTransportListener *pListener ) {}
+	void RemoveListener( ISpaceWarTransportListener *pListener ) {}
+	void RunCallbacks() {}
+
+	bool BIsInProcess() { return false; }
+
+private:
+	ISteamNetworkingSockets *m_pSockets;
+	ISteamNetworkingUtils *m_pUtils;
+};
+
+
+// Send the same payload to every connection in rgConns with one SendMessages call.  The payload
+// is copied once, into a reference counted buffer all the messages point at, which is freed when
+// the transport releases the last of them.  The messages are gathered in vecpMessages, which the
+// caller keeps so a send doesn't have to allocate, and it's left empty.  Returns false, having
+// sent nothing, if there's no memory for the payload.
+bool SendMessageToConnections( ISpaceWarTransport *pTransport, const HSteamNetConnection *rgConns, uint32 cConns,
+	const void *pData, uint32 cbData, int nSendFlags, int nLane, std::vector< SteamNetworkingMessage_t * > &vecpMessages );
+
+// SendMessageToConnection, on a lane other than 0
+EResult SendMessageToConnectionOnLane( ISpaceWarTransport *pTransport, HSteamNetConnection hConn, const void *pData, uint32 cbData,
+	int nSendFlags, int nLane, int64 *pOutMessageNumber );
+
+#endif // SPACEWARTRANSPORT_H
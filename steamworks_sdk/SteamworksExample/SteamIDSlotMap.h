@@ -0,0 +1,119 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Maps the Steam IDs of the players on a server to their slots
+//
+//=============================================================================
+
+#ifndef STEAMIDSLOTMAP_H
+#define STEAMIDSLOTMAP_H
+
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Purpose: Open addressed hash from Steam ID to player slot, kept in one flat
+//			array at most half full so a lookup is a probe or two however many
+//			players there are.  Sized once for the most players the server can
+//			hold, and never allocates after that.
+//-----------------------------------------------------------------------------
+class CSteamIDSlotMap
+{
+public:
+	// Value Find() returns for a Steam ID that isn't in the map
+	static const uint32 k_unInvalidSlot = 0xFFFFFFFF;
+
+	// Make room for unMaxEntries players
+	void Init( uint32 unMaxEntries )
+	{
+		uint32 unBuckets = 16;
+		while ( unBuckets < unMaxEntries * 2 )
+			unBuckets *= 2;
+
+		m_vecEntries.assign( unBuckets, Entry_t() );
+		m_unMask = unBuckets - 1;
+	}
+
+	// Map a Steam ID to a slot, replacing whatever slot it had
+	void Insert( CSteamID steamID, uint32 unSlot )
+	{
+		uint64 ulSteamID = steamID.ConvertToUint64();
+		if ( !ulSteamID || m_vecEntries.empty() )
+			return;
+
+		uint32 i = Bucket( ulSteamID );
+		while ( m_vecEntries[i].m_ulSteamID && m_vecEntries[i].m_ulSteamID != ulSteamID )
+			i = ( i + 1 ) & m_unMask;
+
+		m_vecEntries[i].m_ulSteamID = ulSteamID;
+		m_vecEntries[i].m_unSlot = unSlot;
+	}
+
+	// Slot a Steam ID is in, or k_unInvalidSlot
+	uint32 Find( CSteamID steamID ) const
+	{
+		uint64 ulSteamID = steamID.ConvertToUint64();
+		if ( !ulSteamID || m_vecEntries.empty() )
+			return k_unInvalidSlot;
+
+		for ( uint32 i = Bucket( ulSteamID ); m_vecEntries[i].m_ulSteamID; i = ( i + 1 ) & m_unMask )
+		{
+			if ( m_vecEntries[i].m_ulSteamID == ulSteamID )
+				return m_vecEntries[i].m_unSlot;
+		}
+		return k_unInvalidSlot;
+	}
+
+	// Forget a Steam ID, but only if it's still mapped to unSlot.  Two connections claiming
+	// the same Steam ID leave the map pointing at the newest, and the older one leaving
+	// shouldn't take that away.
+	void Remove( CSteamID steamID, uint32 unSlot )
+	{
+		uint64 ulSteamID = steamID.ConvertToUint64();
+		if ( !ulSteamID || m_vecEntries.empty() )
+			return;
+
+		uint32 i = Bucket( ulSteamID );
+		while ( m_vecEntries[i].m_ulSteamID != ulSteamID )
+		{
+			if ( !m_vecEntries[i].m_ulSteamID )
+				return;
+			i = ( i + 1 ) & m_unMask;
+		}
+		if ( m_vecEntries[i].m_unSlot != unSlot )
+			return;
+
+		// Shift back any later entries in the run that would no longer be reachable past the hole
+		uint32 iHole = i;
+		for ( uint32 j = ( i + 1 ) & m_unMask; m_vecEntries[j].m_ulSteamID; j = ( j + 1 ) & m_unMask )
+		{
+			uint32 iHome = Bucket( m_vecEntries[j].m_ulSteamID );
+			if ( ( ( j - iHome ) & m_unMask ) >= ( ( j - iHole ) & m_unMask ) )
+			{
+				m_vecEntries[iHole] = m_vecEntries[j];
+				iHole = j;
+			}
+		}
+		m_vecEntries[iHole] = Entry_t();
+	}
+
+private:
+	struct Entry_t
+	{
+		Entry_t() : m_ulSteamID( 0 ), m_unSlot( k_unInvalidSlot ) {}
+
+		// 0 for an empty bucket, no player has that Steam ID
+		uint64 m_ulSteamID;
+		uint32 m_unSlot;
+	};
+
+	// Steam IDs differ mostly in their low bits, mix them all into the bucket
+	uint32 Bucket( uint64 ulSteamID ) const
+	{
+		ulSteamID *= 0x9E3779B97F4A7C15ull;
+		return (uint32)( ulSteamID >> 32 ) & m_unMask;
+	}
+
+	std::vector< Entry_t > m_vecEntries;
+	uint32 m_unMask;
+};
+
+#endif // STEAMIDSLOTMAP_H
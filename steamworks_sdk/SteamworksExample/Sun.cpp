@@ -9,23 +9,30 @@
 #include "Sun.h"
 #include <math.h>
 
+// sqrt( 2 ), for the diagonal rays
+#define SUN_SQRT_2 1.41421356f
+
+static const VectorEntityVertex_t s_rgSunVertexes[] =
+{
+	VECTORENTITY_LINE( 2.0f*SUN_VECTOR_SCALE_FACTOR, 0.0f, -2.0f*SUN_VECTOR_SCALE_FACTOR, 0.0f ),
+	VECTORENTITY_LINE( 0.0f, 2.0f*SUN_VECTOR_SCALE_FACTOR, 0.0f, -2.0f*SUN_VECTOR_SCALE_FACTOR ),
+	VECTORENTITY_LINE( -1.0f*SUN_SQRT_2*SUN_VECTOR_SCALE_FACTOR, SUN_SQRT_2*SUN_VECTOR_SCALE_FACTOR, SUN_SQRT_2*SUN_VECTOR_SCALE_FACTOR, -1.0f*SUN_SQRT_2*SUN_VECTOR_SCALE_FACTOR ),
+	VECTORENTITY_LINE( SUN_SQRT_2*SUN_VECTOR_SCALE_FACTOR, SUN_SQRT_2*SUN_VECTOR_SCALE_FACTOR, -1.0f*SUN_SQRT_2*SUN_VECTOR_SCALE_FACTOR, -1.0f*SUN_SQRT_2*SUN_VECTOR_SCALE_FACTOR ),
+};
+
 
 //-----------------------------------------------------------------------------
 // Purpose: Constructor
 //-----------------------------------------------------------------------------
-CSun::CSun( IGameEngine *pGameEngine ) : CSpaceWarEntity( pGameEngine, 2*SUN_VECTOR_SCALE_FACTOR, false )
+CSun::CSun( IGameEngine *pGameEngine, CVectorEntityStatePool *pStatePool ) : CSpaceWarEntity( pGameEngine, 2*SUN_VECTOR_SCALE_FACTOR, false, pStatePool )
 {
 	float xcenter = (float)pGameEngine->GetViewportWidth()/2;
 	float ycenter = (float)pGameEngine->GetViewportHeight()/2;
-	float sqrtof2 = (float)sqrt( 2.0 );
 
 	DWORD dwColor = D3DCOLOR_ARGB( 255, 255, 255, 102 );
 
 	// Initialize our geometry
-	AddLine( (2.0f*SUN_VECTOR_SCALE_FACTOR), 0.0f, (-2.0f*SUN_VECTOR_SCALE_FACTOR), 0.0f, dwColor );
-	AddLine( 0.0f, (2.0f*SUN_VECTOR_SCALE_FACTOR), 0.0f, (-2.0f*SUN_VECTOR_SCALE_FACTOR), dwColor );
-	AddLine( -1.0f*sqrtof2*SUN_VECTOR_SCALE_FACTOR, sqrtof2*SUN_VECTOR_SCALE_FACTOR, sqrtof2*SUN_VECTOR_SCALE_FACTOR, -1.0f*sqrtof2*SUN_VECTOR_SCALE_FACTOR, dwColor );
-	AddLine( sqrtof2*SUN_VECTOR_SCALE_FACTOR, sqrtof2*SUN_VECTOR_SCALE_FACTOR, -1.0f*sqrtof2*SUN_VECTOR_SCALE_FACTOR, -1.0f*sqrtof2*SUN_VECTOR_SCALE_FACTOR, dwColor );
+	SetSharedGeometry( s_rgSunVertexes, V_ARRAYSIZE( s_rgSunVertexes ), dwColor );
 
 	// Has to be after unlock since the base class will lock in this call
 	SetPosition( xcenter, ycenter );
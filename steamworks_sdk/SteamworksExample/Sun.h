@@ -17,7 +17,7 @@ class CSun : public CSpaceWarEntity
 {
 public:
 	// Constructor
-	CSun( IGameEngine *pGameEngine );
+	CSun( IGameEngine *pGameEngine, CVectorEntityStatePool *pStatePool = NULL );
 
 	// Run a frame
 	void RunFrame();
@@ -0,0 +1,304 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Times the phases of a game server frame and counts the messages it
+//			sends and receives
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "TickProfiler.h"
+#include "SpaceWar.h"
+#include "Messages.h"
+#include <chrono>
+#include <thread>
+
+// The messages we count by name, in the order their counters are in.  The counter after the
+// last of them is for anything else.
+static const struct
+{
+	EMessage m_eMsg;
+	const char *m_pchName;
+} s_rgMessageTypes[] =
+{
+	{ k_EMsgServerSendInfo, "ServerSendInfo" },
+	{ k_EMsgServerFailAuthentication, "ServerFailAuthentication" },
+	{ k_EMsgServerPassAuthentication, "ServerPassAuthentication" },
+	{ k_EMsgServerUpdateWorld, "ServerUpdateWorld" },
+	{ k_EMsgServerExiting, "ServerExiting" },
+	{ k_EMsgServerPingResponse, "ServerPingResponse" },
+	{ k_EMsgServerPlayerHitSun, "ServerPlayerHitSun" },
+	{ k_EMsgServerUpdateWorldDelta, "ServerUpdateWorldDelta" },
+	{ k_EMsgClientBeginAuthentication, "ClientBeginAuthentication" },
+	{ k_EMsgClientSendLocalUpdate, "ClientSendLocalUpdate" },
+	{ k_EMsgClientAckWorldSnapshot, "ClientAckWorldSnapshot" },
+	{ k_EMsgP2PSendingTicket, "P2PSendingTicket" },
+	{ k_EMsgVoiceChatData, "VoiceChatData" },
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Index of the highest set bit, ulValue can't be 0
+//-----------------------------------------------------------------------------
+static uint32 GetHighestBit( uint64 ulValue )
+{
+#if defined( _MSC_VER ) && defined( _M_X64 )
+	unsigned long iBit;
+	_BitScanReverse64( &iBit, ulValue );
+	return (uint32)iBit;
+#elif defined( __GNUC__ )
+	return 63 - (uint32)__builtin_clzll( ulValue );
+#else
+	uint32 iBit = 0;
+	while ( ulValue >>= 1 )
+		++iBit;
+	return iBit;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Clear all the counts
+//-----------------------------------------------------------------------------
+void CCycleHistogram::Reset()
+{
+	memset( m_rgunCounts, 0, sizeof( m_rgunCounts ) );
+	m_cSamples = 0;
+	m_ulMax = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Bucket a cycle count falls in.  Counts under k_cSubBuckets get a
+//			bucket each, above that each power of two is split into
+//			k_cSubBuckets by the bits under its highest.
+//-----------------------------------------------------------------------------
+uint32 CCycleHistogram::GetBucket( uint64 ulCycles )
+{
+	if ( ulCycles < k_cSubBuckets )
+		return (uint32)ulCycles;
+
+	uint32 nShift = GetHighestBit( ulCycles ) - k_nSubBucketBits;
+	return nShift * k_cSubBuckets + (uint32)( ulCycles >> nShift );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Highest cycle count in a bucket
+//-----------------------------------------------------------------------------
+uint64 CCycleHistogram::GetBucketMax( uint32 iBucket )
+{
+	if ( iBucket < k_cSubBuckets )
+		return iBucket;
+
+	uint32 nShift = iBucket / k_cSubBuckets - 1;
+	uint64 ulTop = iBucket - nShift * k_cSubBuckets;
+	return ( ( ulTop + 1 ) << nShift ) - 1;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Count a sample
+//-----------------------------------------------------------------------------
+void CCycleHistogram::AddSample( uint64 ulCycles )
+{
+	++m_rgunCounts[GetBucket( ulCycles )];
+	++m_cSamples;
+	m_ulMax = MAX( m_ulMax, ulCycles );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Add another histogram's samples to ours
+//-----------------------------------------------------------------------------
+void CCycleHistogram::Merge( const CCycleHistogram &other )
+{
+	for ( uint32 i = 0; i < k_cBuckets; ++i )
+		m_rgunCounts[i] += other.m_rgunCounts[i];
+	m_cSamples += other.m_cSamples;
+	m_ulMax = MAX( m_ulMax, other.m_ulMax );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Walk the buckets up to the one the percentile lands in
+//-----------------------------------------------------------------------------
+uint64 CCycleHistogram::GetPercentile( double flPercent ) const
+{
+	if ( !m_cSamples )
+		return 0;
+
+	uint64 cTarget = (uint64)( flPercent / 100.0 * (double)m_cSamples + 0.5 );
+	cTarget = MAX( cTarget, (uint64)1 );
+
+	uint64 cSeen = 0;
+	for ( uint32 i = 0; i < k_cBuckets; ++i )
+	{
+		cSeen += m_rgunCounts[i];
+		if ( cSeen >= cTarget )
+			return MIN( GetBucketMax( i ), m_ulMax );
+	}
+	return m_ulMax;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CTickProfiler::CTickProfiler()
+{
+	// Start measuring the cycle counter now, so there's long enough to measure it over by the
+	// time anyone asks for a report
+	GetCyclesPerMicrosecond();
+
+	Reset();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Clear everything, starting a new period to report on
+//-----------------------------------------------------------------------------
+void CTickProfiler::Reset()
+{
+	for ( uint32 i = 0; i < k_EPhaseCount; ++i )
+		m_rgHistograms[i].Reset();
+	memset( m_rgReceived, 0, sizeof( m_rgReceived ) );
+	memset( m_rgSent, 0, sizeof( m_rgSent ) );
+	m_ulCycleStart = GetProfilerCycleCount();
+	m_cCyclesMerged = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Add everything another profiler has recorded to ours
+//-----------------------------------------------------------------------------
+void CTickProfiler::Merge( const CTickProfiler &other )
+{
+	for ( uint32 i = 0; i < k_EPhaseCount; ++i )
+		m_rgHistograms[i].Merge( other.m_rgHistograms[i] );
+
+	for ( uint32 i = 0; i < k_cMessageCounters; ++i )
+	{
+		m_rgReceived[i].m_cMessages += other.m_rgReceived[i].m_cMessages;
+		m_rgReceived[i].m_cubMessages += other.m_rgReceived[i].m_cubMessages;
+		m_rgSent[i].m_cMessages += other.m_rgSent[i].m_cMessages;
+		m_rgSent[i].m_cubMessages += other.m_rgSent[i].m_cubMessages;
+	}
+
+	// The servers' periods overlap, the report covers the longest of them
+	uint64 cCyclesOther = MAX( GetProfilerCycleCount() - other.m_ulCycleStart, other.m_cCyclesMerged );
+	m_cCyclesMerged = MAX( m_cCyclesMerged, cCyclesOther );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Count a message in the counter for its type
+//-----------------------------------------------------------------------------
+void CTickProfiler::CountMessage( MessageCounter_t *pCounters, const void *pData, uint32 cbData, uint32 cMessages )
+{
+	static_assert( V_ARRAYSIZE( s_rgMessageTypes ) + 1 == k_cMessageCounters, "A counter for each message type and one for the rest" );
+
+	uint32 iCounter = k_cMessageCounters - 1;
+	if ( cbData >= sizeof( DWORD ) )
+	{
+		DWORD dwMsg;
+		memcpy( &dwMsg, pData, sizeof( dwMsg ) );
+		EMessage eMsg = (EMessage)LittleDWord( dwMsg );
+		for ( uint32 i = 0; i < V_ARRAYSIZE( s_rgMessageTypes ); ++i )
+		{
+			if ( s_rgMessageTypes[i].m_eMsg == eMsg )
+			{
+				iCounter = i;
+				break;
+			}
+		}
+	}
+
+	pCounters[iCounter].m_cMessages += cMessages;
+	pCounters[iCounter].m_cubMessages += (uint64)cbData * cMessages;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Name a phase is reported under
+//-----------------------------------------------------------------------------
+const char *CTickProfiler::GetPhaseName( EPhase ePhase )
+{
+	switch ( ePhase )
+	{
+	case k_EPhaseFrame: return "Frame";
+	case k_EPhaseRunCallbacks: return "RunCallbacks";
+	case k_EPhaseServerDetails: return "ServerDetails";
+	case k_EPhaseReceiveNetworkData: return "ReceiveNetworkData";
+	case k_EPhaseEntityUpdate: return "EntityUpdate";
+	case k_EPhaseCollisions: return "Collisions";
+	case k_EPhaseSendUpdates: return "SendUpdates";
+	default: return "Unknown";
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: How fast the cycle counter counts.  Measured over all the time since
+//			the first call, so it gets more accurate the longer we've run.
+//-----------------------------------------------------------------------------
+double CTickProfiler::GetCyclesPerMicrosecond()
+{
+#ifdef TICK_PROFILER_RDTSC
+	struct CalibrationStart_t
+	{
+		CalibrationStart_t() : m_ulCycles( GetProfilerCycleCount() ), m_Time( std::chrono::steady_clock::now() ) {}
+		uint64 m_ulCycles;
+		std::chrono::steady_clock::time_point m_Time;
+	};
+	static const CalibrationStart_t s_Start;
+
+	// Anything under a few milliseconds is mostly the error in reading the two clocks
+	std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - s_Start.m_Time;
+	if ( elapsed < std::chrono::milliseconds( 10 ) )
+	{
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) - elapsed );
+		elapsed = std::chrono::steady_clock::now() - s_Start.m_Time;
+	}
+
+	double flMicroseconds = std::chrono::duration< double, std::micro >( elapsed ).count();
+	return (double)( GetProfilerCycleCount() - s_Start.m_ulCycles ) / flMicroseconds;
+#else
+	// Already counting in nanoseconds
+	return 1000.0;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Append a report of everything since the last Reset
+//-----------------------------------------------------------------------------
+void CTickProfiler::AppendReport( std::string &str ) const
+{
+	double flCyclesPerMicrosecond = GetCyclesPerMicrosecond();
+	uint64 cCycles = MAX( GetProfilerCycleCount() - m_ulCycleStart, m_cCyclesMerged );
+	double flSeconds = MAX( (double)cCycles / flCyclesPerMicrosecond / 1000000.0, 0.001 );
+
+	char rgchBuffer[256];
+	sprintf_safe( rgchBuffer, "Tick profile over %.1f s (us)          calls       p50       p99      p999       max\n", flSeconds );
+	str += rgchBuffer;
+
+	for ( uint32 i = 0; i < k_EPhaseCount; ++i )
+	{
+		const CCycleHistogram &histogram = m_rgHistograms[i];
+		sprintf_safe( rgchBuffer, "  %-30s %10llu %9.1f %9.1f %9.1f %9.1f\n", GetPhaseName( (EPhase)i ), histogram.GetSampleCount(),
+			histogram.GetPercentile( 50 ) / flCyclesPerMicrosecond, histogram.GetPercentile( 99 ) / flCyclesPerMicrosecond,
+			histogram.GetPercentile( 99.9 ) / flCyclesPerMicrosecond, histogram.GetMax() / flCyclesPerMicrosecond );
+		str += rgchBuffer;
+	}
+
+	str += "Messages                              recv   recv bytes       sent   sent bytes\n";
+	for ( uint32 i = 0; i < k_cMessageCounters; ++i )
+	{
+		if ( !m_rgReceived[i].m_cMessages && !m_rgSent[i].m_cMessages )
+			continue;
+
+		sprintf_safe( rgchBuffer, "  %-30s %10llu %12llu %10llu %12llu\n", i < V_ARRAYSIZE( s_rgMessageTypes ) ? s_rgMessageTypes[i].m_pchName : "Other",
+			m_rgReceived[i].m_cMessages, m_rgReceived[i].m_cubMessages, m_rgSent[i].m_cMessages, m_rgSent[i].m_cubMessages );
+		str += rgchBuffer;
+	}
+}
@@ -0,0 +1,157 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Times the phases of a game server frame and counts the messages it
+//			sends and receives
+//
+//=============================================================================
+
+#ifndef TICKPROFILER_H
+#define TICKPROFILER_H
+
+#include <string>
+
+#if defined( _MSC_VER ) && ( defined( _M_X64 ) || defined( _M_IX86 ) )
+#include <intrin.h>
+#define TICK_PROFILER_RDTSC
+#elif defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#include <x86intrin.h>
+#define TICK_PROFILER_RDTSC
+#else
+#include <chrono>
+#endif
+
+//-----------------------------------------------------------------------------
+// Purpose: Cheapest clock there is to time a phase with.  The time stamp
+//			counter on x86, nanoseconds from the steady clock elsewhere.  Use
+//			CTickProfiler::GetCyclesPerMicrosecond to turn cycles into time.
+//-----------------------------------------------------------------------------
+inline uint64 GetProfilerCycleCount()
+{
+#ifdef TICK_PROFILER_RDTSC
+	return __rdtsc();
+#else
+	return (uint64)std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Histogram of cycle counts with every bucket 1/16th the width of its
+//			power of two, so any percentile is within about 6% of the truth
+//			however wide the range of samples, in a fixed 4K of counts.
+//-----------------------------------------------------------------------------
+class CCycleHistogram
+{
+public:
+	CCycleHistogram() { Reset(); }
+
+	void Reset();
+	void AddSample( uint64 ulCycles );
+	void Merge( const CCycleHistogram &other );
+
+	uint64 GetSampleCount() const { return m_cSamples; }
+	uint64 GetMax() const { return m_ulMax; }
+
+	// Highest cycle count the given percent of samples are at or under, to the bucket
+	uint64 GetPercentile( double flPercent ) const;
+
+private:
+	static const uint32 k_nSubBucketBits = 4;
+	static const uint32 k_cSubBuckets = 1 << k_nSubBucketBits;
+	static const uint32 k_cBuckets = ( 64 - k_nSubBucketBits + 1 ) * k_cSubBuckets;
+
+	static uint32 GetBucket( uint64 ulCycles );
+	static uint64 GetBucketMax( uint32 iBucket );
+
+	uint32 m_rgunCounts[k_cBuckets];
+	uint64 m_cSamples;
+	uint64 m_ulMax;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Per phase timings and per message type traffic for one server, or
+//			several merged together.  Not thread safe, a server only touches
+//			its own from whichever thread is running it, and anyone reading it
+//			has to do so between frames.
+//-----------------------------------------------------------------------------
+class CTickProfiler
+{
+public:
+	enum EPhase
+	{
+		k_EPhaseFrame,					// All of CSpaceWarServer::RunFrame
+		k_EPhaseRunCallbacks,			// SteamGameServer_RunCallbacks
+		k_EPhaseServerDetails,			// SendUpdatedServerDetailsToSteam
+		k_EPhaseReceiveNetworkData,		// ReceiveNetworkData, taking and dispatching client messages
+		k_EPhaseEntityUpdate,			// Running and integrating the entities, once per simulation step
+		k_EPhaseCollisions,				// CheckForCollisions, once per simulation step
+		k_EPhaseSendUpdates,			// SendUpdateDataToAllClients
+		k_EPhaseCount
+	};
+
+	CTickProfiler();
+
+	// Clear everything, starting a new period to report on
+	void Reset();
+
+	// Add everything another profiler has recorded, for one report across many servers
+	void Merge( const CTickProfiler &other );
+
+	void AddSample( EPhase ePhase, uint64 ulCycles ) { m_rgHistograms[ePhase].AddSample( ulCycles ); }
+
+	// Count a message by the EMessage at its start, anything too short or unknown is counted
+	// as "other".  cMessages copies of it are counted, for one payload sent to many players.
+	void CountMessageReceived( const void *pData, uint32 cbData ) { CountMessage( m_rgReceived, pData, cbData, 1 ); }
+	void CountMessageSent( const void *pData, uint32 cbData, uint32 cMessages = 1 ) { CountMessage( m_rgSent, pData, cbData, cMessages ); }
+
+	const CCycleHistogram &GetPhaseHistogram( EPhase ePhase ) const { return m_rgHistograms[ePhase]; }
+
+	// Append a report of everything since the last Reset to str, a line per phase then a line
+	// per message type that was seen.  Times are in microseconds, messages and bytes are totals.
+	void AppendReport( std::string &str ) const;
+
+	// Name a phase is reported under
+	static const char *GetPhaseName( EPhase ePhase );
+
+	// How fast GetProfilerCycleCount counts, measured against the steady clock
+	static double GetCyclesPerMicrosecond();
+
+private:
+	struct MessageCounter_t
+	{
+		uint64 m_cMessages;
+		uint64 m_cubMessages;
+	};
+
+	// Every EMessage we know the name of, and a last counter for everything else
+	static const uint32 k_cMessageCounters = 14;
+
+	static void CountMessage( MessageCounter_t *pCounters, const void *pData, uint32 cbData, uint32 cMessages );
+
+	CCycleHistogram m_rgHistograms[k_EPhaseCount];
+	MessageCounter_t m_rgReceived[k_cMessageCounters];
+	MessageCounter_t m_rgSent[k_cMessageCounters];
+
+	// Cycle count at the last Reset, and the most time any profiler merged into us has covered
+	uint64 m_ulCycleStart;
+	uint64 m_cCyclesMerged;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Time from construction to destruction as a sample of a phase
+//-----------------------------------------------------------------------------
+class CTickProfileScope
+{
+public:
+	CTickProfileScope( CTickProfiler &profiler, CTickProfiler::EPhase ePhase ) : m_Profiler( profiler ), m_ePhase( ePhase ), m_ulCycleStart( GetProfilerCycleCount() ) {}
+	~CTickProfileScope() { m_Profiler.AddSample( m_ePhase, GetProfilerCycleCount() - m_ulCycleStart ); }
+
+private:
+	CTickProfiler &m_Profiler;
+	CTickProfiler::EPhase m_ePhase;
+	uint64 m_ulCycleStart;
+};
+
+#endif // TICKPROFILER_H
@@ -0,0 +1,230 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Hierarchical timer wheel, for deadlines that are mostly cancelled
+//			or pushed back before they come due
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "TimerWheel.h"
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CTimerWheel::CTimerWheel()
+{
+	m_unFirstFree = k_unInvalidIndex;
+	m_cArmed = 0;
+	m_ulTickCount = 0;
+	for ( uint32 i = 0; i < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS; ++i )
+	{
+		m_rgunSlotHead[i] = k_unInvalidIndex;
+		m_rgunSlotTail[i] = k_unInvalidIndex;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Set the wheel's clock going and set aside room for the timers
+//			we're expecting.  Only before anything is armed.
+//-----------------------------------------------------------------------------
+void CTimerWheel::Init( uint64 ulTickCount, uint32 unExpectedTimers )
+{
+	m_ulTickCount = ulTickCount;
+	m_vecTimers.reserve( unExpectedTimers );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Take a timer off the free list, or make a new one, and link it in
+//-----------------------------------------------------------------------------
+TimerHandle_t CTimerWheel::Arm( uint64 ulDeadlineTick, ITimerListener *pListener, uint64 ulContext )
+{
+	uint32 unIndex = m_unFirstFree;
+	if ( unIndex == k_unInvalidIndex )
+	{
+		Timer_t timer;
+		timer.m_unGeneration = 1;
+		timer.m_unSlot = k_unInvalidIndex;
+		unIndex = (uint32)m_vecTimers.size();
+		m_vecTimers.push_back( timer );
+	}
+	else
+	{
+		m_unFirstFree = m_vecTimers[unIndex].m_unNext;
+	}
+
+	Timer_t &timer = m_vecTimers[unIndex];
+	timer.m_ulDeadlineTick = MAX( ulDeadlineTick, m_ulTickCount + 1 );
+	timer.m_pListener = pListener;
+	timer.m_ulContext = ulContext;
+	Link( unIndex );
+	++m_cArmed;
+
+	return ( (uint64)timer.m_unGeneration << 32 ) | unIndex;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Unlink a timer, if the handle is still its
+//-----------------------------------------------------------------------------
+bool CTimerWheel::Cancel( TimerHandle_t hTimer )
+{
+	uint32 unIndex = (uint32)hTimer;
+	uint32 unGeneration = (uint32)( hTimer >> 32 );
+	if ( hTimer == k_hTimerInvalid || unIndex >= m_vecTimers.size() )
+		return false;
+
+	Timer_t &timer = m_vecTimers[unIndex];
+	if ( timer.m_unGeneration != unGeneration || timer.m_unSlot == k_unInvalidIndex )
+		return false;
+
+	Unlink( unIndex );
+	Free( unIndex );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Tick by tick up to ulTickCount.  Every time a level comes round to
+//			its first slot, the current slot of the level above is spread out
+//			over it.  With nothing armed there's nothing to visit, so the wheel
+//			just jumps.
+//-----------------------------------------------------------------------------
+void CTimerWheel::Advance( uint64 ulTickCount )
+{
+	while ( m_ulTickCount < ulTickCount )
+	{
+		if ( !m_cArmed )
+		{
+			m_ulTickCount = ulTickCount;
+			break;
+		}
+
+		++m_ulTickCount;
+		for ( uint32 unLevel = 1; unLevel < TIMER_WHEEL_LEVELS; ++unLevel )
+		{
+			if ( ( m_ulTickCount >> ( TIMER_WHEEL_SLOT_BITS * ( unLevel - 1 ) ) ) & ( TIMER_WHEEL_SLOTS - 1 ) )
+				break;
+			Cascade( unLevel );
+		}
+		Expire();
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: The finest level whose turn reaches a deadline holds it, in the
+//			slot the deadline falls in.  A deadline beyond the top level's
+//			reach goes as far out as it can, and is placed again once that
+//			slot comes round.
+//-----------------------------------------------------------------------------
+uint32 CTimerWheel::GetSlotForDeadline( uint64 ulDeadlineTick ) const
+{
+	ulDeadlineTick = MAX( ulDeadlineTick, m_ulTickCount );
+	uint64 ulDelta = ulDeadlineTick - m_ulTickCount;
+	for ( uint32 unLevel = 0; unLevel < TIMER_WHEEL_LEVELS; ++unLevel )
+	{
+		if ( ulDelta < ( 1ull << ( TIMER_WHEEL_SLOT_BITS * ( unLevel + 1 ) ) ) )
+			return unLevel * TIMER_WHEEL_SLOTS + (uint32)( ( ulDeadlineTick >> ( TIMER_WHEEL_SLOT_BITS * unLevel ) ) & ( TIMER_WHEEL_SLOTS - 1 ) );
+	}
+
+	uint32 unTopLevel = TIMER_WHEEL_LEVELS - 1;
+	uint64 ulFurthestTick = m_ulTickCount + ( 1ull << ( TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS ) ) - 1;
+	return unTopLevel * TIMER_WHEEL_SLOTS + (uint32)( ( ulFurthestTick >> ( TIMER_WHEEL_SLOT_BITS * unTopLevel ) ) & ( TIMER_WHEEL_SLOTS - 1 ) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Add a timer to the back of the slot its deadline falls in
+//-----------------------------------------------------------------------------
+void CTimerWheel::Link( uint32 unIndex )
+{
+	Timer_t &timer = m_vecTimers[unIndex];
+	uint32 unSlot = GetSlotForDeadline( timer.m_ulDeadlineTick );
+	timer.m_unSlot = unSlot;
+	timer.m_unPrev = m_rgunSlotTail[unSlot];
+	timer.m_unNext = k_unInvalidIndex;
+
+	if ( timer.m_unPrev != k_unInvalidIndex )
+		m_vecTimers[timer.m_unPrev].m_unNext = unIndex;
+	else
+		m_rgunSlotHead[unSlot] = unIndex;
+	m_rgunSlotTail[unSlot] = unIndex;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Take a timer out of its slot
+//-----------------------------------------------------------------------------
+void CTimerWheel::Unlink( uint32 unIndex )
+{
+	Timer_t &timer = m_vecTimers[unIndex];
+	if ( timer.m_unPrev != k_unInvalidIndex )
+		m_vecTimers[timer.m_unPrev].m_unNext = timer.m_unNext;
+	else
+		m_rgunSlotHead[timer.m_unSlot] = timer.m_unNext;
+
+	if ( timer.m_unNext != k_unInvalidIndex )
+		m_vecTimers[timer.m_unNext].m_unPrev = timer.m_unPrev;
+	else
+		m_rgunSlotTail[timer.m_unSlot] = timer.m_unPrev;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Put an unlinked timer on the free list, making its handle stale
+//-----------------------------------------------------------------------------
+void CTimerWheel::Free( uint32 unIndex )
+{
+	Timer_t &timer = m_vecTimers[unIndex];
+	if ( !++timer.m_unGeneration )
+		timer.m_unGeneration = 1;
+	timer.m_unSlot = k_unInvalidIndex;
+	timer.m_pListener = NULL;
+	timer.m_unNext = m_unFirstFree;
+	m_unFirstFree = unIndex;
+	--m_cArmed;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Everything in the slot is due within a turn of the level below,
+//			so placing it again puts it somewhere finer
+//-----------------------------------------------------------------------------
+void CTimerWheel::Cascade( uint32 unLevel )
+{
+	uint32 unSlot = unLevel * TIMER_WHEEL_SLOTS + (uint32)( ( m_ulTickCount >> ( TIMER_WHEEL_SLOT_BITS * unLevel ) ) & ( TIMER_WHEEL_SLOTS - 1 ) );
+	uint32 unIndex = m_rgunSlotHead[unSlot];
+	m_rgunSlotHead[unSlot] = k_unInvalidIndex;
+	m_rgunSlotTail[unSlot] = k_unInvalidIndex;
+
+	while ( unIndex != k_unInvalidIndex )
+	{
+		uint32 unNext = m_vecTimers[unIndex].m_unNext;
+		Link( unIndex );
+		unIndex = unNext;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Fire everything in the current slot.  Taken one at a time off the
+//			front, so a listener can cancel others in the slot or arm new ones
+//			(which always land on a later tick).
+//-----------------------------------------------------------------------------
+void CTimerWheel::Expire()
+{
+	uint32 unSlot = (uint32)( m_ulTickCount & ( TIMER_WHEEL_SLOTS - 1 ) );
+	while ( m_rgunSlotHead[unSlot] != k_unInvalidIndex )
+	{
+		uint32 unIndex = m_rgunSlotHead[unSlot];
+		ITimerListener *pListener = m_vecTimers[unIndex].m_pListener;
+		uint64 ulContext = m_vecTimers[unIndex].m_ulContext;
+		Unlink( unIndex );
+		Free( unIndex );
+
+		pListener->OnTimerExpired( ulContext, m_ulTickCount );
+	}
+}
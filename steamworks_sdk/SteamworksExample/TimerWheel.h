@@ -0,0 +1,106 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Hierarchical timer wheel, for deadlines that are mostly cancelled
+//			or pushed back before they come due
+//
+//=============================================================================
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <vector>
+
+// Each level of the wheel has 1 << TIMER_WHEEL_SLOT_BITS slots, each covering that many times
+// the ticks of a slot on the level below
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS ( 1 << TIMER_WHEEL_SLOT_BITS )
+#define TIMER_WHEEL_LEVELS 4
+
+// Handle to an armed timer.  Goes stale once the timer fires or is cancelled, and a stale
+// handle is safe to cancel.
+typedef uint64 TimerHandle_t;
+const TimerHandle_t k_hTimerInvalid = 0;
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Told when a timer comes due.  Its handle is already stale, so the
+//			listener is free to arm it again.
+//-----------------------------------------------------------------------------
+class ITimerListener
+{
+public:
+	virtual void OnTimerExpired( uint64 ulContext, uint64 ulTickCount ) = 0;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Timers on a hierarchy of wheels, the finest with a slot per tick
+//			and each one above a slot per turn of the one below.  Arming,
+//			cancelling and firing a timer are each a list link or unlink, and
+//			advancing visits one slot per tick plus a slot of the next level
+//			each turn, however many timers there are.  Deadlines further out
+//			than the top level reaches wait in its furthest slot and go round
+//			again.  Not thread safe, each server has its own.
+//-----------------------------------------------------------------------------
+class CTimerWheel
+{
+public:
+	CTimerWheel();
+
+	// Start the wheel at ulTickCount, with room for unExpectedTimers before it has to grow
+	void Init( uint64 ulTickCount, uint32 unExpectedTimers );
+
+	// Tell pListener ulContext once the wheel reaches ulDeadlineTick.  A deadline that's
+	// already passed fires on the next tick.
+	TimerHandle_t Arm( uint64 ulDeadlineTick, ITimerListener *pListener, uint64 ulContext );
+
+	// Stop a timer, false if it had already fired or been cancelled
+	bool Cancel( TimerHandle_t hTimer );
+
+	// Move the wheel on to ulTickCount, firing every timer due by then in deadline order
+	void Advance( uint64 ulTickCount );
+
+	uint64 GetTickCount() const { return m_ulTickCount; }
+	uint32 GetArmedCount() const { return m_cArmed; }
+
+private:
+	static const uint32 k_unInvalidIndex = 0xFFFFFFFF;
+
+	struct Timer_t
+	{
+		uint64 m_ulDeadlineTick;
+		ITimerListener *m_pListener;
+		uint64 m_ulContext;
+		uint32 m_unGeneration;		// Bumped each time the timer is freed, so stale handles can be told apart
+		uint32 m_unSlot;			// Slot it's linked into, or k_unInvalidIndex when free
+		uint32 m_unPrev;
+		uint32 m_unNext;			// Next in its slot, or on the free list
+	};
+
+	// Which slot, across all the levels, a deadline goes in from where the wheel is now
+	uint32 GetSlotForDeadline( uint64 ulDeadlineTick ) const;
+
+	void Link( uint32 unIndex );
+	void Unlink( uint32 unIndex );
+	void Free( uint32 unIndex );
+
+	// Move the timers in a level's current slot down to finer slots
+	void Cascade( uint32 unLevel );
+
+	// Fire the timers in the finest level's current slot
+	void Expire();
+
+	std::vector< Timer_t > m_vecTimers;
+	uint32 m_unFirstFree;
+	uint32 m_cArmed;
+
+	// First and last timer in each slot, level by level.  Timers join the back of a slot, so ones
+	// due on the same tick fire in the order they were armed.
+	uint32 m_rgunSlotHead[ TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS ];
+	uint32 m_rgunSlotTail[ TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS ];
+
+	// Every timer due by this tick has fired
+	uint64 m_ulTickCount;
+};
+
+#endif // TIMERWHEEL_H
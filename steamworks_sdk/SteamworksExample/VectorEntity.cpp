@@ -8,6 +8,7 @@
 
 #include "stdafx.h"
 #include "VectorEntity.h"
+#include "IntegrationKernel.h"
 #include "stdlib.h"
 #include <math.h>
 
@@ -15,30 +16,19 @@
 //-----------------------------------------------------------------------------
 // Purpose: Constructor
 //-----------------------------------------------------------------------------
-CVectorEntity::CVectorEntity( IGameEngine *pGameEngine, uint32 uCollisionRadius ) 
+CVectorEntity::CVectorEntity( IGameEngine *pGameEngine, uint32 uCollisionRadius, CVectorEntityStatePool *pStatePool ) 
 {
-	m_uCollisionRadius = uCollisionRadius;
 	m_pGameEngine = pGameEngine;
-	m_flRotationDeltaNextFrame = 0.0;
-	m_flAccumulatedRotation = 0.0;
-	m_flXAccel = 0.0;
-	m_flYAccel = 0.0;
-	m_flXAccelLastFrame = 0.0;
-	m_flYAccelLastFrame = 0.0;
-	m_flXPos = 0.0;
-	m_flYPos = 0.0;
-	m_flXVelocity = 0.0;
-	m_flYVelocity = 0.0;
-	m_bDisableCollisions = false;
-	m_flRotationDeltaLastFrame = 0.0;
-
-	// we should have at least one frame Run before
-	// anyone asks for a delta, so this shouldn't cause
-	// a large initial delta to our starting position, in theory
-	m_flXPosLastFrame = 0;
-	m_flYPosLastFrame = 0;
-
-	m_flMaximumVelocity = DEFAULT_MAXIMUM_VELOCITY;
+	m_pStatePool = pStatePool ? pStatePool : GetDefaultVectorEntityStatePool();
+	m_pSharedVertexes = NULL;
+	m_cSharedVertexes = 0;
+	m_dwSharedColor = 0;
+
+	// The slot comes back zeroed with the default maximum velocity. We should have at least
+	// one frame Run before anyone asks for a delta, so the zero last frame position shouldn't
+	// cause a large initial delta to our starting position, in theory
+	m_iStateSlot = m_pStatePool->AllocSlot();
+	m_pStatePool->m_vecCollisionRadius[m_iStateSlot] = (float)uCollisionRadius;
 }
 
 //-----------------------------------------------------------------------------
@@ -46,7 +36,19 @@ CVectorEntity::CVectorEntity( IGameEngine *pGameEngine, uint32 uCollisionRadius
 //-----------------------------------------------------------------------------
 CVectorEntity::~CVectorEntity()
 {
-	
+	m_pStatePool->FreeSlot( m_iStateSlot );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Set or clear a flag on our state slot
+//-----------------------------------------------------------------------------
+void CVectorEntity::SetStateFlag( uint8 unFlag, bool bSet )
+{
+	if ( bSet )
+		m_pStatePool->m_vecFlags[m_iStateSlot] |= unFlag;
+	else
+		m_pStatePool->m_vecFlags[m_iStateSlot] &= ~unFlag;
 }
 
 
@@ -72,6 +74,22 @@ void CVectorEntity::AddLine( float xPos0, float yPos0, float xPos1, float yPos1,
 void CVectorEntity::ClearVertexes()
 {
 	m_VecVertexes.clear();
+	m_pSharedVertexes = NULL;
+	m_cSharedVertexes = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Draw a static geometry table rather than our own lines, so entities
+//			that spawn all the time (photon beams, debris) don't build a copy of
+//			the same geometry each time
+//-----------------------------------------------------------------------------
+void CVectorEntity::SetSharedGeometry( const VectorEntityVertex_t *pVertexes, uint32 cVertexes, DWORD dwColor )
+{
+	m_VecVertexes.clear();
+	m_pSharedVertexes = pVertexes;
+	m_cSharedVertexes = cVertexes;
+	m_dwSharedColor = dwColor;
 }
 
 //-----------------------------------------------------------------------------
@@ -79,8 +97,8 @@ void CVectorEntity::ClearVertexes()
 //-----------------------------------------------------------------------------
 void CVectorEntity::SetPosition( float xPos, float yPos )
 {
-	m_flXPos = xPos;
-	m_flYPos = yPos;
+	m_pStatePool->m_vecXPos[m_iStateSlot] = xPos;
+	m_pStatePool->m_vecYPos[m_iStateSlot] = yPos;
 }
 
 
@@ -89,7 +107,7 @@ void CVectorEntity::SetPosition( float xPos, float yPos )
 //-----------------------------------------------------------------------------
 void CVectorEntity::SetRotationDeltaNextFrame( float flRotationInRadians )
 {
-	m_flRotationDeltaNextFrame = flRotationInRadians;
+	m_pStatePool->m_vecRotationDeltaNextFrame[m_iStateSlot] = flRotationInRadians;
 }
 
 
@@ -98,8 +116,8 @@ void CVectorEntity::SetRotationDeltaNextFrame( float flRotationInRadians )
 //-----------------------------------------------------------------------------
 void CVectorEntity::SetAcceleration( float flXAccel, float flYAccel )
 {
-	m_flXAccel = flXAccel;
-	m_flYAccel = flYAccel;
+	m_pStatePool->m_vecXAccel[m_iStateSlot] = flXAccel;
+	m_pStatePool->m_vecYAccel[m_iStateSlot] = flYAccel;
 }
 
 
@@ -108,64 +126,29 @@ void CVectorEntity::SetAcceleration( float flXAccel, float flYAccel )
 //-----------------------------------------------------------------------------
 void CVectorEntity::RunFrame()
 {
-	// Accumulate the rotation so we know our current rotation total at all times
-	m_flAccumulatedRotation += m_flRotationDeltaNextFrame;
-	m_flRotationDeltaLastFrame = m_flRotationDeltaNextFrame;
-	m_flRotationDeltaNextFrame = 0.0f;
-
-	m_flXPosLastFrame = m_flXPos;
-	m_flYPosLastFrame = m_flYPos;
+	// A batch integrated pool moves everyone at once after all the RunFrame calls
+	if ( m_pStatePool->BIsBatchIntegrated() )
+		return;
 
-	// If the accumulated rotation is > 2pi (360) then wrap it (same for negative direction)
-	// This prevents the value getting really large and losing precision
-	int nInfiniteLoopProtector = 0;
-	while ( m_flAccumulatedRotation >= 2.0f*PI_VALUE && ++nInfiniteLoopProtector < 100 )
-		m_flAccumulatedRotation -= 2.0f*PI_VALUE;
-	nInfiniteLoopProtector = 0;
-	while ( m_flAccumulatedRotation <= -2.0f*PI_VALUE && ++nInfiniteLoopProtector < 100 )
-		m_flAccumulatedRotation += 2.0f*PI_VALUE;
+	IntegrationParams_t params;
+	GetIntegrationParams( m_pGameEngine, &params );
+	IntegrateVectorEntities( m_pStatePool, m_iStateSlot, 1, params );
+}
 
 
-	// Update our acceleration, velocity, and finally position
+//-----------------------------------------------------------------------------
+// Purpose: Get the parameters for a frame of integration under a game engine
+//-----------------------------------------------------------------------------
+void CVectorEntity::GetIntegrationParams( IGameEngine *pGameEngine, IntegrationParams_t *pParams )
+{
 	// Note: The min here is so we don't get massive acceleration if frames for some reason don't run for a bit
-	float ulElapsedSeconds = MIN( (float)m_pGameEngine->GetGameTicksFrameDelta() / 1000.0f, 0.1f );
-	m_flXVelocity += m_flXAccel * ulElapsedSeconds;
-	m_flYVelocity += m_flYAccel * ulElapsedSeconds;
-
-	// Make sure velocity does not exceed maximum allowed
-
-	float flVelocity = (float)sqrt( m_flXVelocity*m_flXVelocity + m_flYVelocity*m_flYVelocity );
-
-	if ( flVelocity > m_flMaximumVelocity )
-	{
-		float flRatio = m_flMaximumVelocity / flVelocity;
-
-		m_flXVelocity = m_flXVelocity * flRatio;
-		m_flYVelocity = m_flYVelocity * flRatio;
-	}
-
-	m_flXPos += m_flXVelocity * ulElapsedSeconds;
-	m_flYPos += m_flYVelocity * ulElapsedSeconds;
-
-	// Clear acceleration values, child classes should keep reseting it as appropriate each frame
-	m_flXAccelLastFrame = m_flXAccel;
-	m_flYAccelLastFrame = m_flYAccel;
-	m_flXAccel = 0;
-	m_flYAccel = 0;
+	pParams->m_flElapsedSeconds = MIN( (float)pGameEngine->GetGameTicksFrameDelta() / 1000.0f, 0.1f );
+	pParams->m_flViewportWidth = (float)pGameEngine->GetViewportWidth();
+	pParams->m_flViewportHeight = (float)pGameEngine->GetViewportHeight();
 
-	// Check for wrapping around the screen
-	float width = (float)m_pGameEngine->GetViewportWidth();
-	float height = (float)m_pGameEngine->GetViewportHeight();
-
-	if ( m_flXPos > width )
-		m_flXPos -= width;
-	if ( m_flXPos < 0 )
-		m_flXPos += width;
-
-	if ( m_flYPos > height )
-		m_flYPos -= height;
-	if ( m_flYPos < 0 )
-		m_flYPos += height;
+	// The sun is always at the center of the screen
+	pParams->m_flXGravityCenter = (float)pGameEngine->GetViewportWidth()/2;
+	pParams->m_flYGravityCenter = (float)pGameEngine->GetViewportHeight()/2;
 }
 
 
@@ -174,52 +157,10 @@ void CVectorEntity::RunFrame()
 //-----------------------------------------------------------------------------
 void CVectorEntity::Render()
 {
-	// Compute values which will be used for rotation below
-	float flSinRotation = (float)sin(m_flAccumulatedRotation);
-	float flCosRotation = (float)cos(m_flAccumulatedRotation);
-
-	if ( m_VecVertexes.size() < 2 )
-		return;
-
-	// Iterate our vector of vertexes 2 at a time drawing lines
-	for( size_t i=0; i < m_VecVertexes.size() - 1; ++i )
-	{
-		DWORD dwColor0, dwColor1;
-		float xPos0, yPos0, xPos1, yPos1;
-		float xPrime0, yPrime0, xPrime1, yPrime1;
-
-		// Grab the first point and apply rotation and translation
-		xPos0 = m_VecVertexes[i].x;
-		yPos0 = m_VecVertexes[i].y;
-		dwColor0 = m_VecVertexes[i].color;
-
-		// Apply any needed rotation
-		xPrime0 = flCosRotation*xPos0 - flSinRotation*yPos0;
-		yPrime0 = flSinRotation*xPos0 + flCosRotation*yPos0;
-
-		// Apply translation to current position
-		xPrime0 += m_flXPos;
-		yPrime0 += m_flYPos;
-
-		// Next vertex, we use 2 per iteration
-		++i;
-
-		// Grab the second point and apply rotation and translation
-		xPos1 = m_VecVertexes[i].x;
-		yPos1 = m_VecVertexes[i].y;
-		dwColor1 = m_VecVertexes[i].color;
-
-		// Apply any needed rotation
-		xPrime1 = flCosRotation*xPos1 - flSinRotation*yPos1;
-		yPrime1 = flSinRotation*xPos1 + flCosRotation*yPos1;
-
-		// Apply translation to current position
-		xPrime1 += m_flXPos;
-		yPrime1 += m_flYPos;
-
-		// Have the game engine draw the actual line (it batches these operations)
-		m_pGameEngine->BDrawLine( xPrime0, yPrime0, dwColor0, xPrime1, yPrime1, dwColor1 );
-	}
+	if ( m_pSharedVertexes )
+		DrawLines( m_pSharedVertexes, m_cSharedVertexes, true, m_dwSharedColor );
+	else
+		DrawLines( m_VecVertexes.data(), m_VecVertexes.size(), false, 0 );
 }
 
 //-----------------------------------------------------------------------------
@@ -227,45 +168,61 @@ void CVectorEntity::Render()
 //-----------------------------------------------------------------------------
 void CVectorEntity::Render(DWORD overrideColor)
 {
+	if ( m_pSharedVertexes )
+		DrawLines( m_pSharedVertexes, m_cSharedVertexes, true, overrideColor );
+	else
+		DrawLines( m_VecVertexes.data(), m_VecVertexes.size(), true, overrideColor );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Draw our geometry rotated and moved to where we are
+//-----------------------------------------------------------------------------
+void CVectorEntity::DrawLines( const VectorEntityVertex_t *pVertexes, size_t cVertexes, bool bOverrideColor, DWORD dwOverrideColor )
+{
+	if ( cVertexes < 2 )
+		return;
+
 	// Compute values which will be used for rotation below
-	float flSinRotation = (float)sin(m_flAccumulatedRotation);
-	float flCosRotation = (float)cos(m_flAccumulatedRotation);
+	float flSinRotation = (float)sin( GetAccumulatedRotation() );
+	float flCosRotation = (float)cos( GetAccumulatedRotation() );
+	float flXPos = GetXPos();
+	float flYPos = GetYPos();
 
-	// Iterate our vector of vertexes 2 at a time drawing lines
-	for( size_t i=0; i < m_VecVertexes.size() - 1; ++i )
+	// Iterate our vertexes 2 at a time drawing lines
+	for( size_t i=0; i < cVertexes - 1; ++i )
 	{
 		DWORD dwColor0, dwColor1;
 		float xPos0, yPos0, xPos1, yPos1;
 		float xPrime0, yPrime0, xPrime1, yPrime1;
 
 		// Grab the first point and apply rotation and translation
-		xPos0 = m_VecVertexes[i].x;
-		yPos0 = m_VecVertexes[i].y;
-		dwColor0 = overrideColor;
+		xPos0 = pVertexes[i].x;
+		yPos0 = pVertexes[i].y;
+		dwColor0 = bOverrideColor ? dwOverrideColor : pVertexes[i].color;
 
 		// Apply any needed rotation
 		xPrime0 = flCosRotation*xPos0 - flSinRotation*yPos0;
 		yPrime0 = flSinRotation*xPos0 + flCosRotation*yPos0;
 
 		// Apply translation to current position
-		xPrime0 += m_flXPos;
-		yPrime0 += m_flYPos;
+		xPrime0 += flXPos;
+		yPrime0 += flYPos;
 
 		// Next vertex, we use 2 per iteration
 		++i;
 
 		// Grab the second point and apply rotation and translation
-		xPos1 = m_VecVertexes[i].x;
-		yPos1 = m_VecVertexes[i].y;
-		dwColor1 = overrideColor;
+		xPos1 = pVertexes[i].x;
+		yPos1 = pVertexes[i].y;
+		dwColor1 = bOverrideColor ? dwOverrideColor : pVertexes[i].color;
 
 		// Apply any needed rotation
 		xPrime1 = flCosRotation*xPos1 - flSinRotation*yPos1;
 		yPrime1 = flSinRotation*xPos1 + flCosRotation*yPos1;
 
 		// Apply translation to current position
-		xPrime1 += m_flXPos;
-		yPrime1 += m_flYPos;
+		xPrime1 += flXPos;
+		yPrime1 += flYPos;
 
 		// Have the game engine draw the actual line (it batches these operations)
 		m_pGameEngine->BDrawLine( xPrime0, yPrime0, dwColor0, xPrime1, yPrime1, dwColor1 );
@@ -281,18 +238,23 @@ bool CVectorEntity::BCollidesWith ( CVectorEntity * pTarget )
 	// Note: Yes, this is a lame way to do collision detection just using a set radius.
 	//       I don't care for the moment, just want it running!
 
-	if ( m_bDisableCollisions )
-		return false;
-	else if ( pTarget->BCollisionDetectionDisabled() )
-		return false;
+	float xPos, yPos, flRadius;
+	float xTargetPos, yTargetPos, flTargetRadius;
+	GetCollisionCircle( &xPos, &yPos, &flRadius );
+	pTarget->GetCollisionCircle( &xTargetPos, &yTargetPos, &flTargetRadius );
 
-	// Compute distance between the center of the two objects
-	float distance = (float)sqrt( pow( m_flXPos - pTarget->GetXPos(), 2 ) + pow( m_flYPos - pTarget->GetYPos(), 2 ) );
+	return BCirclesOverlap( xPos, yPos, flRadius, xTargetPos, yTargetPos, flTargetRadius );
+}
 
-	if ( distance < m_uCollisionRadius + pTarget->GetCollisionRadius() )
-		return true;
 
-	return false;
+//-----------------------------------------------------------------------------
+// Purpose: Get the circle used for collisions
+//-----------------------------------------------------------------------------
+void CVectorEntity::GetCollisionCircle( float *pflXPos, float *pflYPos, float *pflRadius )
+{
+	*pflXPos = GetXPos();
+	*pflYPos = GetYPos();
+	*pflRadius = BCollisionDetectionDisabled() ? COLLISION_RADIUS_DISABLED : (float)GetCollisionRadius();
 }
 
 //-----------------------------------------------------------------------------
@@ -300,5 +262,5 @@ bool CVectorEntity::BCollidesWith ( CVectorEntity * pTarget )
 //-----------------------------------------------------------------------------
 float CVectorEntity::GetDistanceTraveledLastFrame()
 {
-	return (float)sqrt( pow( m_flXPos - m_flXPosLastFrame, 2 ) + pow( m_flYPos - m_flYPosLastFrame, 2 ) );
+	return (float)sqrt( pow( GetXPos() - m_pStatePool->m_vecXPosLastFrame[m_iStateSlot], 2 ) + pow( GetYPos() - m_pStatePool->m_vecYPosLastFrame[m_iStateSlot], 2 ) );
 }
@@ -10,6 +10,9 @@
 #define VECTORENTITY_H
 
 #include "GameEngine.h"
+#include "VectorEntityStatePool.h"
+#include "CollisionKernel.h"
+#include "IntegrationKernel.h"
 #include <vector>
 
 struct VectorEntityVertex_t
@@ -18,22 +21,34 @@ struct VectorEntityVertex_t
 	DWORD color;
 };
 
+// One line of a static geometry table for SetSharedGeometry(), the color comes from the entity
+#define VECTORENTITY_LINE( xPos0, yPos0, xPos1, yPos1 ) { (xPos0), (yPos0), 0 }, { (xPos1), (yPos1), 0 }
+
 #define DEFAULT_MAXIMUM_VELOCITY 450.0f
 
 #define PI_VALUE 3.14159265f
 
+//-----------------------------------------------------------------------------
+// Purpose: The simulation state of a vector entity (position, velocity, etc...)
+//			lives in a slot in a CVectorEntityStatePool, the object itself is a
+//			handle to that slot plus the geometry used to render it.
+//-----------------------------------------------------------------------------
 class CVectorEntity
 {
 public:
-	// Constructor
-	CVectorEntity( IGameEngine *pGameEngine, uint32 uCollisionRadius );
+	// Constructor, a NULL pool means the default (client side) pool
+	CVectorEntity( IGameEngine *pGameEngine, uint32 uCollisionRadius, CVectorEntityStatePool *pStatePool = NULL );
 	
 	// Destructor
 	virtual ~CVectorEntity();
 
-	// Run a frame
+	// Run a frame, subclasses run their own logic first (set acceleration, rotation...) then call
+	// down to integrate.  In a batch integrated pool this leaves integration to the pool.
 	virtual void RunFrame();
 
+	// Get the parameters for a frame of integration under a game engine
+	static void GetIntegrationParams( IGameEngine *pGameEngine, IntegrationParams_t *pParams );
+
 	// Render the sun field
 	virtual void Render();
 
@@ -43,30 +58,34 @@ public:
 	// Check if the entity is colliding with another given entity
 	bool BCollidesWith( CVectorEntity * pTarget );
 
+	// Get the circle used for collisions, the radius is COLLISION_RADIUS_DISABLED if collision
+	// detection is disabled for the entity
+	void GetCollisionCircle( float *pflXPos, float *pflYPos, float *pflRadius );
+
 	// Get the rotation value that is to be applied next frame
-	float GetRotationDeltaNextFrame() { return m_flRotationDeltaNextFrame; }
+	float GetRotationDeltaNextFrame() { return m_pStatePool->m_vecRotationDeltaNextFrame[m_iStateSlot]; }
 
 	// Get the rotation value that was applied last frame
-	float GetRotationDeltaLastFrame() { return m_flRotationDeltaLastFrame; }
+	float GetRotationDeltaLastFrame() { return m_pStatePool->m_vecRotationDeltaLastFrame[m_iStateSlot]; }
 
 	// Get the cumulative rotation for this entity
-	float GetAccumulatedRotation() { return m_flAccumulatedRotation; }
+	float GetAccumulatedRotation() { return m_pStatePool->m_vecAccumulatedRotation[m_iStateSlot]; }
 
 	// Get the acceleration to be applied next frame
-	float GetXAcceleration() { return m_flXAccel; }
-	float GetYAcceleration() { return m_flYAccel; }
+	float GetXAcceleration() { return m_pStatePool->m_vecXAccel[m_iStateSlot]; }
+	float GetYAcceleration() { return m_pStatePool->m_vecYAccel[m_iStateSlot]; }
 
 	// Get the acceleration applied last frame
-	float GetXAccelerationLastFrame() { return m_flXAccelLastFrame; }
-	float GetYAccelerationLastFrame() { return m_flYAccelLastFrame; }
+	float GetXAccelerationLastFrame() { return m_pStatePool->m_vecXAccelLastFrame[m_iStateSlot]; }
+	float GetYAccelerationLastFrame() { return m_pStatePool->m_vecYAccelLastFrame[m_iStateSlot]; }
 
 	// Get the current velocity
-	float GetXVelocity() { return m_flXVelocity; }
-	float GetYVelocity() { return m_flYVelocity; }
+	float GetXVelocity() { return m_pStatePool->m_vecXVelocity[m_iStateSlot]; }
+	float GetYVelocity() { return m_pStatePool->m_vecYVelocity[m_iStateSlot]; }
 
 	// Get the current position of the object
-	float GetXPos() { return m_flXPos; }
-	float GetYPos() { return m_flYPos; }
+	float GetXPos() { return m_pStatePool->m_vecXPos[m_iStateSlot]; }
+	float GetYPos() { return m_pStatePool->m_vecYPos[m_iStateSlot]; }
 
 	// Get the distance traveled each frame
 	float GetDistanceTraveledLastFrame();
@@ -77,11 +96,23 @@ public:
 	// Clear all lines in the entity
 	void ClearVertexes();
 
+	// Draw geometry shared by every entity of a type, in the given color, instead of lines added to
+	// this entity.  The vertexes aren't copied so they have to outlive the entity (a static table).
+	void SetSharedGeometry( const VectorEntityVertex_t *pVertexes, uint32 cVertexes, DWORD dwColor );
+
 	// Set the objects current position
 	void SetPosition(float xPos, float yPos);
 
 	// Set the velocity of the entity (normally you should just set acceleration and this will be computed)
-	void SetVelocity(float xVelocity, float yVelocity) { m_flXVelocity = xVelocity; m_flYVelocity = yVelocity; }
+	void SetVelocity(float xVelocity, float yVelocity) { m_pStatePool->m_vecXVelocity[m_iStateSlot] = xVelocity; m_pStatePool->m_vecYVelocity[m_iStateSlot] = yVelocity; }
+
+	// Leave the entity where it is when it would be integrated, for an owner that has stopped running
+	// frames but whose pool integrates everything in a batch
+	void SetIntegrationPaused( bool bPaused ) { SetStateFlag( VECTORENTITY_FLAG_INTEGRATION_PAUSED, bPaused ); }
+
+	// Pool and slot our state lives in
+	CVectorEntityStatePool *GetStatePool() { return m_pStatePool; }
+	uint32 GetStateSlot() { return m_iStateSlot; }
 
 protected:
 
@@ -91,68 +122,49 @@ protected:
 	// Set the acceleration to be applied next frame
 	void SetAcceleration( float xAccel, float yAccel );
 	// Set the cumulative rotation for this entity (overriding any existing value)
-	void SetAccumulatedRotation( float flRotation ) { m_flAccumulatedRotation = flRotation; }
+	void SetAccumulatedRotation( float flRotation ) { m_pStatePool->m_vecAccumulatedRotation[m_iStateSlot] = flRotation; }
 	
 	// Reset velocity of the entity
-	void ResetVelocity() { m_flXVelocity = 0; m_flYVelocity = 0; }
+	void ResetVelocity() { SetVelocity( 0, 0 ); }
 
 	// Get the collision radius for the entity
-	uint32 GetCollisionRadius() { return m_uCollisionRadius; }
+	uint32 GetCollisionRadius() { return (uint32)m_pStatePool->m_vecCollisionRadius[m_iStateSlot]; }
 
 	// Enable/Disable collision detection for this entity
-	void SetCollisionDetectionDisabled( bool bDisabled ) { m_bDisableCollisions = bDisabled; }
+	void SetCollisionDetectionDisabled( bool bDisabled ) { SetStateFlag( VECTORENTITY_FLAG_COLLISIONS_DISABLED, bDisabled ); }
 
 	// Check whether collision detection has been disabled for the entity
-	bool BCollisionDetectionDisabled() { return m_bDisableCollisions; }
+	bool BCollisionDetectionDisabled() { return ( m_pStatePool->m_vecFlags[m_iStateSlot] & VECTORENTITY_FLAG_COLLISIONS_DISABLED ) != 0; }
 
 	// Set a maximum velocity other than the default
-	void SetMaximumVelocity( float flMaximumVelocity ) { m_flMaximumVelocity = flMaximumVelocity; }
+	void SetMaximumVelocity( float flMaximumVelocity ) { m_pStatePool->m_vecMaximumVelocity[m_iStateSlot] = flMaximumVelocity; }
+
+	// Set or clear one of the VECTORENTITY_FLAG_* bits for our slot
+	void SetStateFlag( uint8 unFlag, bool bSet );
 
 protected:
 	// Game engine instance we are running under
 	IGameEngine *m_pGameEngine;
 
 private:
-	// Vector of points (always built 2 at a time so it's actually lines)
-	std::vector< VectorEntityVertex_t > m_VecVertexes;
+	// Draw lines between pairs of vertexes, in their own colors or all in dwOverrideColor
+	void DrawLines( const VectorEntityVertex_t *pVertexes, size_t cVertexes, bool bOverrideColor, DWORD dwOverrideColor );
 
-	// Previous position
-	float m_flXPosLastFrame;
-	float m_flYPosLastFrame;
+	// Handles own a slot, they can't be copied
+	CVectorEntity( const CVectorEntity & );
+	CVectorEntity &operator=( const CVectorEntity & );
 
-	// current position (position is at the center of the object)
-	float m_flXPos;
-	float m_flYPos;
-
-	// maximum velocity the object can have in either x/y 
-	float m_flMaximumVelocity;
-
-	// acceleration to be applied next frame
-	float m_flXAccel;
-	float m_flYAccel;
-
-	// acceleration applied last frame
-	float m_flXAccelLastFrame;
-	float m_flYAccelLastFrame;
-
-	// current velocity (affected by acceleration changes)
-	float m_flXVelocity;
-	float m_flYVelocity;
-
-	// rotation to apply this frame (in radians)
-	float m_flRotationDeltaNextFrame;
-
-	// rotation which was applied last frame
-	float m_flRotationDeltaLastFrame;
-
-	// total cumulative rotation that has been applied to this entity
-	float m_flAccumulatedRotation;
+	// Vector of points (always built 2 at a time so it's actually lines)
+	std::vector< VectorEntityVertex_t > m_VecVertexes;
 
-	// radius to use for collisions, this is applied from the center of the object out
-	uint32 m_uCollisionRadius;
+	// Geometry shared with other entities and the color to draw it in, used instead of m_VecVertexes if set
+	const VectorEntityVertex_t *m_pSharedVertexes;
+	uint32 m_cSharedVertexes;
+	DWORD m_dwSharedColor;
 
-	// bool to disable collision detection for this object
-	bool m_bDisableCollisions;
+	// Pool holding our simulation state, and our slot in it
+	CVectorEntityStatePool *m_pStatePool;
+	uint32 m_iStateSlot;
 };
 
 #endif // VECTORENTITY_H
\ No newline at end of file
@@ -0,0 +1,146 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Structure-of-arrays storage for the per-frame state of vector
+//			entities (position, velocity, acceleration, rotation, etc...)
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "VectorEntityStatePool.h"
+#include "VectorEntity.h"
+#include "IntegrationKernel.h"
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CVectorEntityStatePool::CVectorEntityStatePool( uint32 unInitialCapacity )
+{
+	m_bBatchIntegrated = false;
+	m_bBatchOpen = false;
+
+	Reserve( unInitialCapacity );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Make room for a number of slots up front
+//-----------------------------------------------------------------------------
+void CVectorEntityStatePool::Reserve( uint32 unSlots )
+{
+	m_vecXPos.reserve( unSlots );
+	m_vecYPos.reserve( unSlots );
+	m_vecXPosLastFrame.reserve( unSlots );
+	m_vecYPosLastFrame.reserve( unSlots );
+	m_vecXVelocity.reserve( unSlots );
+	m_vecYVelocity.reserve( unSlots );
+	m_vecMaximumVelocity.reserve( unSlots );
+	m_vecXAccel.reserve( unSlots );
+	m_vecYAccel.reserve( unSlots );
+	m_vecXAccelLastFrame.reserve( unSlots );
+	m_vecYAccelLastFrame.reserve( unSlots );
+	m_vecRotationDeltaNextFrame.reserve( unSlots );
+	m_vecRotationDeltaLastFrame.reserve( unSlots );
+	m_vecAccumulatedRotation.reserve( unSlots );
+	m_vecCollisionRadius.reserve( unSlots );
+	m_vecExpireTickCount.reserve( unSlots );
+	m_vecFlags.reserve( unSlots );
+	m_vecFreeSlots.reserve( unSlots );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Get a slot with all of its state cleared
+//-----------------------------------------------------------------------------
+uint32 CVectorEntityStatePool::AllocSlot()
+{
+	uint32 iSlot;
+	if ( !m_vecFreeSlots.empty() )
+	{
+		iSlot = m_vecFreeSlots.back();
+		m_vecFreeSlots.pop_back();
+	}
+	else
+	{
+		iSlot = GetSlotCount();
+		m_vecXPos.push_back( 0.0f );
+		m_vecYPos.push_back( 0.0f );
+		m_vecXPosLastFrame.push_back( 0.0f );
+		m_vecYPosLastFrame.push_back( 0.0f );
+		m_vecXVelocity.push_back( 0.0f );
+		m_vecYVelocity.push_back( 0.0f );
+		m_vecMaximumVelocity.push_back( 0.0f );
+		m_vecXAccel.push_back( 0.0f );
+		m_vecYAccel.push_back( 0.0f );
+		m_vecXAccelLastFrame.push_back( 0.0f );
+		m_vecYAccelLastFrame.push_back( 0.0f );
+		m_vecRotationDeltaNextFrame.push_back( 0.0f );
+		m_vecRotationDeltaLastFrame.push_back( 0.0f );
+		m_vecAccumulatedRotation.push_back( 0.0f );
+		m_vecCollisionRadius.push_back( 0.0f );
+		m_vecExpireTickCount.push_back( 0 );
+		m_vecFlags.push_back( 0 );
+	}
+
+	m_vecXPos[iSlot] = 0.0f;
+	m_vecYPos[iSlot] = 0.0f;
+	m_vecXPosLastFrame[iSlot] = 0.0f;
+	m_vecYPosLastFrame[iSlot] = 0.0f;
+	m_vecXVelocity[iSlot] = 0.0f;
+	m_vecYVelocity[iSlot] = 0.0f;
+	m_vecMaximumVelocity[iSlot] = DEFAULT_MAXIMUM_VELOCITY;
+	m_vecXAccel[iSlot] = 0.0f;
+	m_vecYAccel[iSlot] = 0.0f;
+	m_vecXAccelLastFrame[iSlot] = 0.0f;
+	m_vecYAccelLastFrame[iSlot] = 0.0f;
+	m_vecRotationDeltaNextFrame[iSlot] = 0.0f;
+	m_vecRotationDeltaLastFrame[iSlot] = 0.0f;
+	m_vecAccumulatedRotation[iSlot] = 0.0f;
+	m_vecCollisionRadius[iSlot] = 0.0f;
+	m_vecExpireTickCount[iSlot] = 0;
+	m_vecFlags[iSlot] = m_bBatchOpen ? ( VECTORENTITY_FLAG_IN_USE | VECTORENTITY_FLAG_SPAWNED ) : VECTORENTITY_FLAG_IN_USE;
+
+	return iSlot;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Release a slot for reuse
+//-----------------------------------------------------------------------------
+void CVectorEntityStatePool::FreeSlot( uint32 iSlot )
+{
+	if ( iSlot >= GetSlotCount() || !BIsSlotInUse( iSlot ) )
+	{
+		OutputDebugString( "Freeing a vector entity state slot that isn't in use\n" );
+		return;
+	}
+
+	m_vecFlags[iSlot] = 0;
+	m_vecFreeSlots.push_back( iSlot );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Integrate all our entities in one pass, then close the batch so the
+//			ones spawned during it take part in the next
+//-----------------------------------------------------------------------------
+void CVectorEntityStatePool::IntegrateBatch( const IntegrationParams_t &params )
+{
+	IntegrateVectorEntities( this, 0, GetSlotCount(), params );
+
+	uint32 unSlots = GetSlotCount();
+	for ( uint32 i = 0; i < unSlots; ++i )
+		m_vecFlags[i] &= ~VECTORENTITY_FLAG_SPAWNED;
+
+	m_bBatchOpen = false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Pool used by entities that aren't owned by a game server
+//-----------------------------------------------------------------------------
+CVectorEntityStatePool *GetDefaultVectorEntityStatePool()
+{
+	static CVectorEntityStatePool s_DefaultPool;
+	return &s_DefaultPool;
+}
@@ -0,0 +1,126 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Structure-of-arrays storage for the per-frame state of vector
+//			entities (position, velocity, acceleration, rotation, etc...)
+//
+//=============================================================================
+
+#ifndef VECTORENTITYSTATEPOOL_H
+#define VECTORENTITYSTATEPOOL_H
+
+#include <vector>
+
+struct IntegrationParams_t;
+
+// Per slot flags
+#define VECTORENTITY_FLAG_IN_USE					0x01
+#define VECTORENTITY_FLAG_COLLISIONS_DISABLED		0x02
+#define VECTORENTITY_FLAG_AFFECTED_BY_GRAVITY		0x04
+#define VECTORENTITY_FLAG_SPAWNED					0x08	// Allocated during an open batch, not integrated until the next one
+#define VECTORENTITY_FLAG_INTEGRATION_PAUSED		0x10	// Left where it is by integration (a disabled ship)
+
+// Slot index meaning "no slot"
+#define VECTORENTITY_INVALID_SLOT 0xFFFFFFFF
+
+//-----------------------------------------------------------------------------
+// Purpose: Holds the simulation state for a set of entities, one array per
+//			field.  A CVectorEntity is a handle to one slot in a pool, so a pass
+//			over every entity's position (or velocity, or timer) walks one
+//			contiguous array instead of hopping between heap objects.
+//
+//			Each game server owns its own pool, so matches running on
+//			different threads never share one.  The arrays may be reallocated
+//			when a slot is allocated, so don't hold pointers into them across
+//			AllocSlot().
+//
+//			A batch integrated pool moves all its entities in one pass: their
+//			RunFrame only runs their own logic (thrust, firing, spin), then the
+//			owner calls IntegrateBatch() once.  Entities spawned between
+//			BeginBatch() and IntegrateBatch() sit the pass out, just as they
+//			would have missed their owner's RunFrame integrating one at a time.
+//-----------------------------------------------------------------------------
+class CVectorEntityStatePool
+{
+public:
+	// Constructor, capacity is only a hint, the pool grows as needed
+	CVectorEntityStatePool( uint32 unInitialCapacity = 64 );
+
+	// Make room for at least unSlots slots, so allocating that many won't grow the arrays
+	void Reserve( uint32 unSlots );
+
+	// Get a cleared slot
+	uint32 AllocSlot();
+
+	// Release a slot for reuse
+	void FreeSlot( uint32 iSlot );
+
+	// Number of slots (in use or not), valid indices are [0, GetSlotCount())
+	uint32 GetSlotCount() { return (uint32)m_vecFlags.size(); }
+
+	// Number of slots currently in use
+	uint32 GetActiveSlotCount() { return GetSlotCount() - (uint32)m_vecFreeSlots.size(); }
+
+	// Is the given slot in use?
+	bool BIsSlotInUse( uint32 iSlot ) { return ( m_vecFlags[iSlot] & VECTORENTITY_FLAG_IN_USE ) != 0; }
+
+	// Integrate everything in one pass from IntegrateBatch() rather than in each entity's RunFrame
+	void SetBatchIntegrated( bool bBatchIntegrated ) { m_bBatchIntegrated = bBatchIntegrated; }
+	bool BIsBatchIntegrated() { return m_bBatchIntegrated; }
+
+	// Start running entity logic for a batch, anything allocated from now on waits for the next one
+	void BeginBatch() { m_bBatchOpen = true; }
+
+	// Integrate every entity that was in use when the batch began
+	void IntegrateBatch( const IntegrationParams_t &params );
+
+	// Current position (position is at the center of the object)
+	std::vector< float > m_vecXPos;
+	std::vector< float > m_vecYPos;
+
+	// Previous position
+	std::vector< float > m_vecXPosLastFrame;
+	std::vector< float > m_vecYPosLastFrame;
+
+	// Current velocity (affected by acceleration changes)
+	std::vector< float > m_vecXVelocity;
+	std::vector< float > m_vecYVelocity;
+
+	// Maximum velocity the object can have
+	std::vector< float > m_vecMaximumVelocity;
+
+	// Acceleration to be applied next frame
+	std::vector< float > m_vecXAccel;
+	std::vector< float > m_vecYAccel;
+
+	// Acceleration applied last frame
+	std::vector< float > m_vecXAccelLastFrame;
+	std::vector< float > m_vecYAccelLastFrame;
+
+	// Rotation to apply next frame, rotation applied last frame, and total rotation (in radians)
+	std::vector< float > m_vecRotationDeltaNextFrame;
+	std::vector< float > m_vecRotationDeltaLastFrame;
+	std::vector< float > m_vecAccumulatedRotation;
+
+	// Radius to use for collisions, applied from the center of the object out
+	std::vector< float > m_vecCollisionRadius;
+
+	// Tick count at which the entity expires, 0 if it doesn't (photon beams)
+	std::vector< uint64 > m_vecExpireTickCount;
+
+	// VECTORENTITY_FLAG_* bits
+	std::vector< uint8 > m_vecFlags;
+
+private:
+	// Slots available for reuse
+	std::vector< uint32 > m_vecFreeSlots;
+
+	// See SetBatchIntegrated() and BeginBatch()
+	bool m_bBatchIntegrated;
+	bool m_bBatchOpen;
+};
+
+
+// Pool used by entities that aren't owned by a game server (the client's view of the world)
+CVectorEntityStatePool *GetDefaultVectorEntityStatePool();
+
+#endif // VECTORENTITYSTATEPOOL_H
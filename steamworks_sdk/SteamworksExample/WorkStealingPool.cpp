@@ -0,0 +1,233 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Small work-stealing thread pool used to tick many game server
+//			matches in one process
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "WorkStealingPool.h"
+
+#if defined(POSIX) && !defined(OSX)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Pin the calling thread to a single core, so a worker (and therefore
+//			the jobs homed on it) keeps its caches warm between frames.  Worker
+//			N goes on the Nth core the process is allowed to run on, wrapping
+//			round if there are more workers than cores.
+//-----------------------------------------------------------------------------
+static void PinCurrentThreadToCore( uint32 iCore )
+{
+#if defined(_WIN32)
+	DWORD_PTR dwProcessMask = 0;
+	DWORD_PTR dwSystemMask = 0;
+	if ( !GetProcessAffinityMask( GetCurrentProcess(), &dwProcessMask, &dwSystemMask ) || !dwProcessMask )
+		return;
+
+	uint32 cAllowed = 0;
+	for ( uint32 i = 0; i < sizeof(DWORD_PTR) * 8; ++i )
+	{
+		if ( dwProcessMask & ( (DWORD_PTR)1 << i ) )
+			++cAllowed;
+	}
+
+	uint32 iAllowed = iCore % cAllowed;
+	for ( uint32 i = 0; i < sizeof(DWORD_PTR) * 8; ++i )
+	{
+		if ( !( dwProcessMask & ( (DWORD_PTR)1 << i ) ) || iAllowed-- )
+			continue;
+
+		if ( !SetThreadAffinityMask( GetCurrentThread(), (DWORD_PTR)1 << i ) )
+			OutputDebugString( "Couldn't pin a pool worker to its core\n" );
+		return;
+	}
+#elif defined(POSIX) && !defined(OSX)
+	cpu_set_t allowed;
+	CPU_ZERO( &allowed );
+	if ( sched_getaffinity( 0, sizeof( allowed ), &allowed ) != 0 || !CPU_COUNT( &allowed ) )
+		return;
+
+	uint32 iAllowed = iCore % (uint32)CPU_COUNT( &allowed );
+	for ( int i = 0; i < CPU_SETSIZE; ++i )
+	{
+		if ( !CPU_ISSET( i, &allowed ) || iAllowed-- )
+			continue;
+
+		cpu_set_t cpuset;
+		CPU_ZERO( &cpuset );
+		CPU_SET( i, &cpuset );
+		int nError = pthread_setaffinity_np( pthread_self(), sizeof( cpuset ), &cpuset );
+		if ( nError != 0 )
+		{
+			char rgchBuffer[128];
+			sprintf_safe( rgchBuffer, "Couldn't pin a pool worker to core %d (error %d)\n", i, nError );
+			OutputDebugString( rgchBuffer );
+		}
+		return;
+	}
+#else
+	// No hard affinity on OSX, the scheduler will mostly keep us put anyway
+	(void)iCore;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CWorkStealingPool::CWorkStealingPool( uint32 unThreads )
+{
+	m_unJobsQueued = 0;
+	m_unJobsOutstanding = 0;
+	m_ulStolenJobs = 0;
+	m_bShuttingDown = false;
+
+	uint32 unHardwareThreads = std::thread::hardware_concurrency();
+	if ( unThreads == 0 )
+		unThreads = unHardwareThreads ? unHardwareThreads : 1;
+
+	// Create all the queues before any thread starts, workers look at each others queues
+	for ( uint32 i = 0; i < unThreads; ++i )
+		m_vecWorkers.push_back( new Worker_t );
+
+	for ( uint32 i = 0; i < unThreads; ++i )
+		m_vecWorkers[i]->m_Thread = std::thread( &CWorkStealingPool::WorkerThread, this, i );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destructor
+//-----------------------------------------------------------------------------
+CWorkStealingPool::~CWorkStealingPool()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_WakeMutex );
+		m_bShuttingDown = true;
+	}
+	m_WakeCondition.notify_all();
+
+	// Every thread has to be gone before any queue is, a worker still on its way to sleep after
+	// its last job may be looking through the others' queues for one to steal
+	for ( size_t i = 0; i < m_vecWorkers.size(); ++i )
+	{
+		if ( m_vecWorkers[i]->m_Thread.joinable() )
+			m_vecWorkers[i]->m_Thread.join();
+	}
+	for ( size_t i = 0; i < m_vecWorkers.size(); ++i )
+		delete m_vecWorkers[i];
+	m_vecWorkers.clear();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Queue a job to a worker
+//-----------------------------------------------------------------------------
+void CWorkStealingPool::QueueJob( uint32 iHomeWorker, IPoolJob *pJob )
+{
+	iHomeWorker %= GetWorkerCount();
+
+	QueuedJob_t job;
+	job.m_pJob = pJob;
+	job.m_iHomeWorker = iHomeWorker;
+
+	++m_unJobsOutstanding;
+	{
+		Worker_t *pWorker = m_vecWorkers[iHomeWorker];
+		std::lock_guard<std::mutex> lock( pWorker->m_Mutex );
+		pWorker->m_Jobs.push_back( job );
+	}
+
+	// Bump the queued count under the wake mutex so a worker can't check it and go
+	// to sleep between our increment and our notify
+	{
+		std::lock_guard<std::mutex> lock( m_WakeMutex );
+		++m_unJobsQueued;
+	}
+	m_WakeCondition.notify_all();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Wait for all queued work to complete
+//-----------------------------------------------------------------------------
+void CWorkStealingPool::WaitForAll()
+{
+	std::unique_lock<std::mutex> lock( m_DoneMutex );
+	while ( m_unJobsOutstanding != 0 )
+		m_DoneCondition.wait( lock );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Take the oldest job from our own queue, otherwise steal the newest
+//			job from whichever other worker we find first
+//-----------------------------------------------------------------------------
+bool CWorkStealingPool::BPopOrStealJob( uint32 iWorker, QueuedJob_t *pJob )
+{
+	{
+		Worker_t *pWorker = m_vecWorkers[iWorker];
+		std::lock_guard<std::mutex> lock( pWorker->m_Mutex );
+		if ( !pWorker->m_Jobs.empty() )
+		{
+			*pJob = pWorker->m_Jobs.front();
+			pWorker->m_Jobs.pop_front();
+			return true;
+		}
+	}
+
+	// Start looking at our neighbor so thieves spread out instead of all hitting worker 0
+	uint32 unWorkers = GetWorkerCount();
+	for ( uint32 i = 1; i < unWorkers; ++i )
+	{
+		Worker_t *pVictim = m_vecWorkers[( iWorker + i ) % unWorkers];
+		std::lock_guard<std::mutex> lock( pVictim->m_Mutex );
+		if ( !pVictim->m_Jobs.empty() )
+		{
+			*pJob = pVictim->m_Jobs.back();
+			pVictim->m_Jobs.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Worker thread body
+//-----------------------------------------------------------------------------
+void CWorkStealingPool::WorkerThread( uint32 iWorker )
+{
+	PinCurrentThreadToCore( iWorker );
+
+	while ( true )
+	{
+		QueuedJob_t job;
+		if ( BPopOrStealJob( iWorker, &job ) )
+		{
+			--m_unJobsQueued;
+			if ( job.m_iHomeWorker != iWorker )
+				++m_ulStolenJobs;
+
+			job.m_pJob->RunJob( iWorker );
+
+			if ( --m_unJobsOutstanding == 0 )
+			{
+				std::lock_guard<std::mutex> lock( m_DoneMutex );
+				m_DoneCondition.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock( m_WakeMutex );
+		while ( m_unJobsQueued == 0 && !m_bShuttingDown )
+			m_WakeCondition.wait( lock );
+
+		if ( m_bShuttingDown )
+			return;
+	}
+}
@@ -0,0 +1,96 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Small work-stealing thread pool used to tick many game server
+//			matches in one process
+//
+//=============================================================================
+
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+//-----------------------------------------------------------------------------
+// Purpose: A unit of work for the pool.  iWorker is the index of the worker
+//			that actually ran the job, which may differ from the worker it was
+//			queued to if it was stolen.
+//-----------------------------------------------------------------------------
+class IPoolJob
+{
+public:
+	virtual ~IPoolJob() {}
+	virtual void RunJob( uint32 iWorker ) = 0;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Fixed set of worker threads, each with its own job queue.  Jobs are
+//			queued to a preferred ("home") worker so the same job tends to stay
+//			on the same core from frame to frame.  A worker that runs out of
+//			work steals from the back of another worker's queue, so one slow
+//			job doesn't hold up everything queued behind it.
+//-----------------------------------------------------------------------------
+class CWorkStealingPool
+{
+public:
+	// Constructor, 0 threads means one per hardware thread
+	CWorkStealingPool( uint32 unThreads = 0 );
+
+	// Destructor, stops and joins all workers
+	~CWorkStealingPool();
+
+	// Number of workers in the pool
+	uint32 GetWorkerCount() { return (uint32)m_vecWorkers.size(); }
+
+	// Queue a job to the given worker (wrapped to the worker count)
+	void QueueJob( uint32 iHomeWorker, IPoolJob *pJob );
+
+	// Block until every queued job has run
+	void WaitForAll();
+
+	// How many jobs ran somewhere other than the worker they were queued to
+	uint64 GetStolenJobCount() { return m_ulStolenJobs; }
+
+private:
+	struct QueuedJob_t
+	{
+		IPoolJob *m_pJob;
+		uint32 m_iHomeWorker;
+	};
+
+	struct Worker_t
+	{
+		std::mutex m_Mutex;
+		std::deque< QueuedJob_t > m_Jobs;
+		std::thread m_Thread;
+	};
+
+	// Thread body for worker iWorker
+	void WorkerThread( uint32 iWorker );
+
+	// Pop a job from our own queue (front), or steal from another (back)
+	bool BPopOrStealJob( uint32 iWorker, QueuedJob_t *pJob );
+
+	std::vector< Worker_t * > m_vecWorkers;
+
+	// Signals workers that work was queued or we are shutting down
+	std::mutex m_WakeMutex;
+	std::condition_variable m_WakeCondition;
+
+	// Signals WaitForAll that outstanding work hit zero
+	std::mutex m_DoneMutex;
+	std::condition_variable m_DoneCondition;
+
+	// Jobs sitting in some queue, and jobs queued but not yet finished
+	std::atomic<uint32> m_unJobsQueued;
+	std::atomic<uint32> m_unJobsOutstanding;
+	std::atomic<uint64> m_ulStolenJobs;
+	std::atomic<bool> m_bShuttingDown;
+};
+
+#endif // WORKSTEALINGPOOL_H
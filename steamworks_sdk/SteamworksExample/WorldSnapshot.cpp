@@ -0,0 +1,383 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Packing world snapshots into bits, keeping a history of recent
+//			ones, and delta encoding one snapshot against another
+//
+//=============================================================================
+
+#include "stdafx.h"
+#include "WorldSnapshot.h"
+#include "VectorEntity.h"
+
+// The delta is coded in groups of this many bytes
+#define WORLD_SNAPSHOT_GROUP_SIZE 8
+
+// Write or read one field of the update struct pData with the CBitWriter writer or CBitReader reader
+#define WRITE_FLOAT_FIELD( Name, flMin, flMax, cBits ) writer.WriteQuantizedFloat( pData->Get##Name(), flMin, flMax, cBits );
+#define WRITE_INT_FIELD( Name, nMin, nMax ) writer.WriteClampedInt( (int64)pData->Get##Name(), nMin, nMax );
+#define WRITE_UINT64_FIELD( Name ) writer.WriteUint64( pData->Get##Name() );
+#define WRITE_BOOL_FIELD( Name ) writer.WriteBool( pData->Get##Name() );
+#define WRITE_FIELDS( FIELDS ) FIELDS( WRITE_FLOAT_FIELD, WRITE_INT_FIELD, WRITE_UINT64_FIELD, WRITE_BOOL_FIELD )
+
+#define READ_FLOAT_FIELD( Name, flMin, flMax, cBits ) pData->Set##Name( reader.ReadQuantizedFloat( flMin, flMax, cBits ) );
+#define READ_INT_FIELD( Name, nMin, nMax ) pData->Set##Name( (decltype( pData->Get##Name() ))reader.ReadClampedInt( nMin, nMax ) );
+#define READ_UINT64_FIELD( Name ) pData->Set##Name( reader.ReadUint64() );
+#define READ_BOOL_FIELD( Name ) pData->Set##Name( reader.ReadBool() );
+#define READ_FIELDS( FIELDS ) FIELDS( READ_FLOAT_FIELD, READ_INT_FIELD, READ_UINT64_FIELD, READ_BOOL_FIELD )
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Pack a photon beam, an inactive one is all zeroes
+//-----------------------------------------------------------------------------
+static void PackPhotonBeam( CBitWriter &writer, ServerPhotonBeamUpdateData_t *pData )
+{
+	writer.WriteBool( pData->GetActive() );
+	if ( pData->GetActive() )
+	{
+		WRITE_FIELDS( WORLD_SNAPSHOT_PHOTON_BEAM_FIELDS );
+	}
+	else
+	{
+		writer.WriteZeroBits( WORLD_SNAPSHOT_PHOTON_BEAM_BITS - 1 );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Unpack a photon beam
+//-----------------------------------------------------------------------------
+static void UnpackPhotonBeam( CBitReader &reader, ServerPhotonBeamUpdateData_t *pData )
+{
+	pData->SetActive( reader.ReadBool() );
+	if ( pData->GetActive() )
+	{
+		READ_FIELDS( WORLD_SNAPSHOT_PHOTON_BEAM_FIELDS );
+	}
+	else
+	{
+		reader.SkipBits( WORLD_SNAPSHOT_PHOTON_BEAM_BITS - 1 );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Pack a ship and its photon beams
+//-----------------------------------------------------------------------------
+static void PackShip( CBitWriter &writer, ServerShipUpdateData_t *pData )
+{
+	WRITE_FIELDS( WORLD_SNAPSHOT_SHIP_FIELDS );
+
+	for ( int i = 0; i < MAX_PHOTON_BEAMS_PER_SHIP; ++i )
+		PackPhotonBeam( writer, pData->AccessPhotonBeamData( i ) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Unpack a ship and its photon beams
+//-----------------------------------------------------------------------------
+static void UnpackShip( CBitReader &reader, ServerShipUpdateData_t *pData )
+{
+	READ_FIELDS( WORLD_SNAPSHOT_SHIP_FIELDS );
+
+	for ( int i = 0; i < MAX_PHOTON_BEAMS_PER_SHIP; ++i )
+		UnpackPhotonBeam( reader, pData->AccessPhotonBeamData( i ) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Pack a lane, the player in it and their ship.  An empty lane is all
+//			zeroes.
+//-----------------------------------------------------------------------------
+static void PackLane( CBitWriter &writer, ServerSpaceWarUpdateData_t *pUpdateData, uint32 iSlot )
+{
+	if ( iSlot == WORLD_SNAPSHOT_EMPTY_LANE )
+	{
+		writer.WriteZeroBits( WORLD_SNAPSHOT_LANE_BITS );
+		return;
+	}
+
+	// Slot numbers go out one up, so zero can mean empty
+	writer.WriteBits( iSlot + 1, WORLD_SNAPSHOT_SLOT_BITS );
+
+	ServerPlayerUpdateData_t *pData = pUpdateData->AccessPlayerUpdateData( iSlot );
+	WRITE_FIELDS( WORLD_SNAPSHOT_PLAYER_FIELDS );
+
+	if ( pData->GetActive() )
+		PackShip( writer, pData->AccessShipUpdateData() );
+	else
+		writer.WriteZeroBits( WORLD_SNAPSHOT_SHIP_BITS );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Unpack a lane, returns false if it names a slot that doesn't exist
+//-----------------------------------------------------------------------------
+static bool BUnpackLane( CBitReader &reader, ServerSpaceWarUpdateData_t *pUpdateData )
+{
+	uint32 unSlot = reader.ReadBits( WORLD_SNAPSHOT_SLOT_BITS );
+	if ( unSlot == 0 )
+	{
+		reader.SkipBits( WORLD_SNAPSHOT_LANE_BITS - WORLD_SNAPSHOT_SLOT_BITS );
+		return true;
+	}
+
+	if ( unSlot > pUpdateData->GetPlayerSlotCount() )
+		return false;
+
+	ServerPlayerUpdateData_t *pData = pUpdateData->AccessPlayerUpdateData( unSlot - 1 );
+	pData->SetIncluded( true );
+	READ_FIELDS( WORLD_SNAPSHOT_PLAYER_FIELDS );
+
+	if ( pData->GetActive() )
+		UnpackShip( reader, pData->AccessShipUpdateData() );
+	else
+		reader.SkipBits( WORLD_SNAPSHOT_SHIP_BITS );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Pack a world update for one client.  Every lane takes the same
+//			number of bits whether it's in use or not, so snapshots with the
+//			same slot and lane counts line up byte for byte.
+//-----------------------------------------------------------------------------
+uint32 PackWorldSnapshot( ServerSpaceWarUpdateData_t *pUpdateData, const uint32 *rgiLaneSlots, uint32 unLanes, uint8 *pubPacked, uint32 cubPacked )
+{
+	CBitWriter writer( pubPacked, cubPacked );
+
+	ServerSpaceWarUpdateData_t *pData = pUpdateData;
+	WRITE_FIELDS( WORLD_SNAPSHOT_HEADER_FIELDS );
+	writer.WriteClampedInt( unLanes, 0, MAX_PLAYERS_PER_SERVER_LIMIT );
+	writer.ByteAlign();
+
+	uint32 unPlayerSlots = MIN( pUpdateData->GetPlayerSlotCount(), (uint32)MAX_PLAYERS_PER_SERVER_LIMIT );
+	for ( uint32 i = 0; i < unPlayerSlots; ++i )
+		writer.WriteBool( pUpdateData->GetPlayerActive( i ) );
+	writer.ByteAlign();
+
+	for ( uint32 iLane = 0; iLane < unLanes; ++iLane )
+	{
+		uint32 iSlot = rgiLaneSlots[iLane];
+		PackLane( writer, pUpdateData, iSlot < unPlayerSlots ? iSlot : WORLD_SNAPSHOT_EMPTY_LANE );
+		writer.ByteAlign();
+	}
+
+	if ( writer.BOverflowed() )
+	{
+		OutputDebugString( "PackWorldSnapshot ran out of space\n" );
+		return 0;
+	}
+
+	return writer.GetBytesWritten();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Unpack a world update into a MsgServerUpdateWorld_t
+//-----------------------------------------------------------------------------
+bool BUnpackWorldSnapshot( const uint8 *pubPacked, uint32 cubPacked, std::vector< uint8 > &vecUpdateWorld )
+{
+	CBitReader reader( pubPacked, cubPacked );
+
+	ServerSpaceWarUpdateData_t header;
+	ServerSpaceWarUpdateData_t *pData = &header;
+	READ_FIELDS( WORLD_SNAPSHOT_HEADER_FIELDS );
+	uint32 unLanes = (uint32)reader.ReadClampedInt( 0, MAX_PLAYERS_PER_SERVER_LIMIT );
+	reader.ByteAlign();
+
+	// The size has to be exactly what the slot and lane counts say
+	uint32 unPlayerSlots = header.GetPlayerSlotCount();
+	if ( reader.BOverflowed() || unLanes > unPlayerSlots || cubPacked != GetPackedWorldSnapshotSize( unPlayerSlots, unLanes ) )
+		return false;
+
+	vecUpdateWorld.resize( MsgServerUpdateWorld_t::GetMessageSize( unPlayerSlots ) );
+	memset( &vecUpdateWorld[0], 0, vecUpdateWorld.size() );
+	MsgServerUpdateWorld_t *pMsg = new( &vecUpdateWorld[0] ) MsgServerUpdateWorld_t;
+	ServerSpaceWarUpdateData_t *pUpdateData = pMsg->AccessUpdateData();
+	*pUpdateData = header;
+
+	// There's nothing more to know about an inactive slot, so it counts as included
+	for ( uint32 i = 0; i < unPlayerSlots; ++i )
+	{
+		bool bActive = reader.ReadBool();
+		pUpdateData->SetPlayerActive( i, bActive );
+		pUpdateData->AccessPlayerUpdateData( i )->SetIncluded( !bActive );
+	}
+	reader.ByteAlign();
+
+	for ( uint32 iLane = 0; iLane < unLanes; ++iLane )
+	{
+		if ( !BUnpackLane( reader, pUpdateData ) )
+			return false;
+		reader.ByteAlign();
+	}
+
+	return !reader.BOverflowed();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+CWorldSnapshotHistory::CWorldSnapshotHistory()
+{
+	Clear();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Forget every snapshot, keeping the buffers for reuse
+//-----------------------------------------------------------------------------
+void CWorldSnapshotHistory::Clear()
+{
+	for ( uint32 i = 0; i < WORLD_SNAPSHOT_HISTORY_SIZE; ++i )
+	{
+		m_rgSnapshots[i].m_unSequence = WORLD_SNAPSHOT_NONE;
+		m_rgSnapshots[i].m_vecData.clear();
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Remember a snapshot
+//-----------------------------------------------------------------------------
+void CWorldSnapshotHistory::AddSnapshot( uint32 unSequence, const uint8 *pubData, uint32 cubData )
+{
+	WorldSnapshot_t &snapshot = m_rgSnapshots[ unSequence % WORLD_SNAPSHOT_HISTORY_SIZE ];
+	snapshot.m_unSequence = unSequence;
+	snapshot.m_vecData.assign( pubData, pubData + cubData );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Find a snapshot by sequence number
+//-----------------------------------------------------------------------------
+const std::vector< uint8 > *CWorldSnapshotHistory::FindSnapshot( uint32 unSequence )
+{
+	if ( unSequence == WORLD_SNAPSHOT_NONE )
+		return NULL;
+
+	WorldSnapshot_t &snapshot = m_rgSnapshots[ unSequence % WORLD_SNAPSHOT_HISTORY_SIZE ];
+	if ( snapshot.m_unSequence != unSequence )
+		return NULL;
+
+	return &snapshot.m_vecData;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Encode a snapshot against a baseline.
+//
+//			The snapshot is XORed with the baseline and split into groups of 8
+//			bytes.  The encoding is a bitmask with one bit per group set if any
+//			byte in it changed, then for each changed group a mask of which of
+//			its bytes changed followed by those bytes.  Anything that didn't
+//			change since the baseline (player names, inactive photon beams, a
+//			ship sitting still) costs one bit per group, and a float that only
+//			changed a little usually keeps its high bytes.
+//-----------------------------------------------------------------------------
+uint32 EncodeWorldSnapshotDelta( const uint8 *pubSnapshot, const uint8 *pubBaseline, uint32 cubSnapshot, uint8 *pubEncoded )
+{
+	uint32 unGroups = ( cubSnapshot + WORLD_SNAPSHOT_GROUP_SIZE - 1 ) / WORLD_SNAPSHOT_GROUP_SIZE;
+	uint32 cubGroupMask = ( unGroups + 7 ) / 8;
+	memset( pubEncoded, 0, cubGroupMask );
+	uint32 iWrite = cubGroupMask;
+
+	for ( uint32 iGroup = 0; iGroup < unGroups; ++iGroup )
+	{
+		uint32 iFirstByte = iGroup * WORLD_SNAPSHOT_GROUP_SIZE;
+		uint32 unBytes = MIN( (uint32)WORLD_SNAPSHOT_GROUP_SIZE, cubSnapshot - iFirstByte );
+
+		uint8 rgubDelta[WORLD_SNAPSHOT_GROUP_SIZE];
+		uint8 ubByteMask = 0;
+		for ( uint32 i = 0; i < unBytes; ++i )
+		{
+			rgubDelta[i] = pubSnapshot[iFirstByte + i] ^ ( pubBaseline ? pubBaseline[iFirstByte + i] : 0 );
+			if ( rgubDelta[i] )
+				ubByteMask |= (uint8)( 1 << i );
+		}
+
+		if ( !ubByteMask )
+			continue;
+
+		pubEncoded[ iGroup / 8 ] |= (uint8)( 1 << ( iGroup % 8 ) );
+		pubEncoded[ iWrite++ ] = ubByteMask;
+		for ( uint32 i = 0; i < unBytes; ++i )
+		{
+			if ( rgubDelta[i] )
+				pubEncoded[ iWrite++ ] = rgubDelta[i];
+		}
+	}
+	return iWrite;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Encode a snapshot against a baseline onto the end of a vector
+//-----------------------------------------------------------------------------
+void EncodeWorldSnapshotDelta( const uint8 *pubSnapshot, const uint8 *pubBaseline, uint32 cubSnapshot, std::vector< uint8 > &vecEncoded )
+{
+	uint32 iStart = (uint32)vecEncoded.size();
+	vecEncoded.resize( iStart + GetWorldSnapshotDeltaMaxSize( cubSnapshot ) );
+	vecEncoded.resize( iStart + EncodeWorldSnapshotDelta( pubSnapshot, pubBaseline, cubSnapshot, &vecEncoded[iStart] ) );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Largest encoding, the group bitmask then every group changed
+//-----------------------------------------------------------------------------
+uint32 GetWorldSnapshotDeltaMaxSize( uint32 cubSnapshot )
+{
+	uint32 unGroups = ( cubSnapshot + WORLD_SNAPSHOT_GROUP_SIZE - 1 ) / WORLD_SNAPSHOT_GROUP_SIZE;
+	return ( unGroups + 7 ) / 8 + unGroups + cubSnapshot;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Decode a snapshot from its encoding and baseline
+//-----------------------------------------------------------------------------
+bool BDecodeWorldSnapshotDelta( const uint8 *pubEncoded, uint32 cubEncoded, const uint8 *pubBaseline, uint32 cubSnapshot, uint8 *pubSnapshot )
+{
+	uint32 unGroups = ( cubSnapshot + WORLD_SNAPSHOT_GROUP_SIZE - 1 ) / WORLD_SNAPSHOT_GROUP_SIZE;
+	uint32 cubGroupMask = ( unGroups + 7 ) / 8;
+	if ( cubEncoded < cubGroupMask )
+		return false;
+
+	if ( pubBaseline )
+		memcpy( pubSnapshot, pubBaseline, cubSnapshot );
+	else
+		memset( pubSnapshot, 0, cubSnapshot );
+
+	const uint8 *pubGroupMask = pubEncoded;
+	uint32 iRead = cubGroupMask;
+	for ( uint32 iGroup = 0; iGroup < unGroups; ++iGroup )
+	{
+		if ( !( pubGroupMask[ iGroup / 8 ] & ( 1 << ( iGroup % 8 ) ) ) )
+			continue;
+
+		if ( iRead >= cubEncoded )
+			return false;
+
+		uint32 iFirstByte = iGroup * WORLD_SNAPSHOT_GROUP_SIZE;
+		uint32 unBytes = MIN( (uint32)WORLD_SNAPSHOT_GROUP_SIZE, cubSnapshot - iFirstByte );
+		uint8 ubByteMask = pubEncoded[iRead++];
+
+		// A byte past the end of the snapshot can't have changed
+		if ( ubByteMask >> unBytes )
+			return false;
+
+		for ( uint32 i = 0; i < unBytes; ++i )
+		{
+			if ( !( ubByteMask & ( 1 << i ) ) )
+				continue;
+
+			if ( iRead >= cubEncoded )
+				return false;
+
+			pubSnapshot[iFirstByte + i] ^= pubEncoded[iRead++];
+		}
+	}
+
+	// Nothing should be left over
+	return iRead == cubEncoded;
+}
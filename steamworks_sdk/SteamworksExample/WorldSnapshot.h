@@ -0,0 +1,162 @@
+//====== Copyright 1996-2024, Valve Corporation, All rights reserved. =======
+//
+// Purpose: Packing world snapshots into bits, keeping a history of recent
+//			ones, and delta encoding one snapshot against another
+//
+//=============================================================================
+
+#ifndef WORLDSNAPSHOT_H
+#define WORLDSNAPSHOT_H
+
+#include <vector>
+#include "SpaceWar.h"
+#include "Messages.h"
+#include "BitBuffer.h"
+
+// How many recent snapshots each side remembers as possible delta baselines.  At
+// SERVER_UPDATE_SEND_RATE this is about half a second, a client that hasn't acked anything
+// in that long gets a full snapshot.
+#define WORLD_SNAPSHOT_HISTORY_SIZE 32
+
+// Sequence number meaning "no snapshot", a delta against it is a full snapshot
+#define WORLD_SNAPSHOT_NONE 0
+
+// Lane with no player in it, see PackWorldSnapshot
+#define WORLD_SNAPSHOT_EMPTY_LANE 0xffffffff
+
+// Packed layout of a world snapshot.  Each list gives the accessor name of a field on its update
+// struct and how to pack it, the pack and unpack code and the record sizes are all generated from
+// these lists, so a field only has to be added in one place:
+//	FLOAT_FIELD( Name, min, max, bits )	quantized to bits over [min, max], see QuantizeFloat
+//	INT_FIELD( Name, min, max )			clamped to [min, max], in just enough bits for the range
+//	UINT64_FIELD( Name )				all 64 bits
+//	BOOL_FIELD( Name )					one bit
+// The lists are expanded where PI_VALUE is defined (VectorEntity.h).
+
+// ServerSpaceWarUpdateData_t, once at the start of the snapshot
+#define WORLD_SNAPSHOT_HEADER_FIELDS( FLOAT_FIELD, INT_FIELD, UINT64_FIELD, BOOL_FIELD ) \
+	INT_FIELD( ServerGameState, k_EServerWaitingForPlayers, k_EServerExiting ) \
+	INT_FIELD( PlayerWhoWon, 0, MAX_PLAYERS_PER_SERVER_LIMIT - 1 ) \
+	INT_FIELD( PlayerSlotCount, 0, MAX_PLAYERS_PER_SERVER_LIMIT ) \
+	INT_FIELD( ServerTime, 0, 0xffffffff )
+
+// ServerPlayerUpdateData_t, for the player in each lane along with their ship.  Whether each
+// slot is active is sent separately, as one bit per slot.
+#define WORLD_SNAPSHOT_PLAYER_FIELDS( FLOAT_FIELD, INT_FIELD, UINT64_FIELD, BOOL_FIELD ) \
+	INT_FIELD( Score, 0, 0xffffffff ) \
+	UINT64_FIELD( SteamID )
+
+// ServerShipUpdateData_t.  Positions are already normalized to the viewport and velocities are
+// capped well under 512 (see SetMaximumVelocity).  The thruster level and turn speed aren't
+// filled in by the server, so aren't packed.
+#define WORLD_SNAPSHOT_SHIP_FIELDS( FLOAT_FIELD, INT_FIELD, UINT64_FIELD, BOOL_FIELD ) \
+	FLOAT_FIELD( XPosition, 0.0f, 1.0f, 16 ) \
+	FLOAT_FIELD( YPosition, 0.0f, 1.0f, 16 ) \
+	FLOAT_FIELD( XVelocity, -512.0f, 512.0f, 16 ) \
+	FLOAT_FIELD( YVelocity, -512.0f, 512.0f, 16 ) \
+	FLOAT_FIELD( XAcceleration, -256.0f, 256.0f, 12 ) \
+	FLOAT_FIELD( YAcceleration, -256.0f, 256.0f, 12 ) \
+	FLOAT_FIELD( Rotation, -2.0f*PI_VALUE, 2.0f*PI_VALUE, 16 ) \
+	FLOAT_FIELD( RotationDeltaLastFrame, -PI_VALUE, PI_VALUE, 14 ) \
+	BOOL_FIELD( Exploding ) \
+	BOOL_FIELD( Disabled ) \
+	BOOL_FIELD( ForwardThrustersActive ) \
+	BOOL_FIELD( ReverseThrustersActive ) \
+	INT_FIELD( Decoration, 0, 7 ) \
+	INT_FIELD( Weapon, 0, 3 ) \
+	INT_FIELD( Power, 0, 3 ) \
+	INT_FIELD( ShieldStrength, 0, 511 ) \
+	INT_FIELD( InputSequence, 0, 0xffffffff ) \
+	INT_FIELD( InputSteps, 0, SHIP_INPUT_STEPS_MAX ) \
+	INT_FIELD( ThrustSteps, 0, SHIP_THRUST_RAMP_STEPS )
+
+// ServerPhotonBeamUpdateData_t, for each of a ship's beams.  Active is a bit of its own ahead
+// of these, and only active beams have them packed.
+#define WORLD_SNAPSHOT_PHOTON_BEAM_FIELDS( FLOAT_FIELD, INT_FIELD, UINT64_FIELD, BOOL_FIELD ) \
+	FLOAT_FIELD( XPosition, 0.0f, 1.0f, 16 ) \
+	FLOAT_FIELD( YPosition, 0.0f, 1.0f, 16 ) \
+	FLOAT_FIELD( XVelocity, -512.0f, 512.0f, 16 ) \
+	FLOAT_FIELD( YVelocity, -512.0f, 512.0f, 16 ) \
+	FLOAT_FIELD( Rotation, -2.0f*PI_VALUE, 2.0f*PI_VALUE, 16 )
+
+// Bits each field in the lists above takes
+#define WORLD_SNAPSHOT_FLOAT_FIELD_BITS( Name, flMin, flMax, cBits ) + ( cBits )
+#define WORLD_SNAPSHOT_INT_FIELD_BITS( Name, nMin, nMax ) + BitsForRange( (uint64)( (int64)( nMax ) - (int64)( nMin ) ) )
+#define WORLD_SNAPSHOT_UINT64_FIELD_BITS( Name ) + 64
+#define WORLD_SNAPSHOT_BOOL_FIELD_BITS( Name ) + 1
+#define WORLD_SNAPSHOT_FIELD_BITS( FIELDS ) ( 0 FIELDS( WORLD_SNAPSHOT_FLOAT_FIELD_BITS, WORLD_SNAPSHOT_INT_FIELD_BITS, WORLD_SNAPSHOT_UINT64_FIELD_BITS, WORLD_SNAPSHOT_BOOL_FIELD_BITS ) )
+
+// Bits to hold a player slot number or lane count
+#define WORLD_SNAPSHOT_SLOT_BITS BitsForRange( MAX_PLAYERS_PER_SERVER_LIMIT )
+
+// Bits in each packed record, the photon beam's Active bit and the lane's slot number included
+#define WORLD_SNAPSHOT_PHOTON_BEAM_BITS ( 1 + WORLD_SNAPSHOT_FIELD_BITS( WORLD_SNAPSHOT_PHOTON_BEAM_FIELDS ) )
+#define WORLD_SNAPSHOT_SHIP_BITS ( WORLD_SNAPSHOT_FIELD_BITS( WORLD_SNAPSHOT_SHIP_FIELDS ) + MAX_PHOTON_BEAMS_PER_SHIP * WORLD_SNAPSHOT_PHOTON_BEAM_BITS )
+#define WORLD_SNAPSHOT_LANE_BITS ( WORLD_SNAPSHOT_SLOT_BITS + WORLD_SNAPSHOT_FIELD_BITS( WORLD_SNAPSHOT_PLAYER_FIELDS ) + WORLD_SNAPSHOT_SHIP_BITS )
+
+// The header (with the lane count), the active bits and each lane are padded to whole bytes, so a
+// lane's bytes sit in the same spot in every snapshot with the same slot and lane counts and delta
+// encode well
+#define WORLD_SNAPSHOT_HEADER_BYTES ( ( WORLD_SNAPSHOT_FIELD_BITS( WORLD_SNAPSHOT_HEADER_FIELDS ) + WORLD_SNAPSHOT_SLOT_BITS + 7 ) / 8 )
+#define WORLD_SNAPSHOT_LANE_BYTES ( ( WORLD_SNAPSHOT_LANE_BITS + 7 ) / 8 )
+
+//-----------------------------------------------------------------------------
+// Purpose: Ring of the most recent snapshots, indexed by sequence number.  The
+//			server keeps the snapshots it sent each client, the client the ones it got, so
+//			both sides can find the baseline a delta was encoded against.
+//-----------------------------------------------------------------------------
+class CWorldSnapshotHistory
+{
+public:
+	// Constructor
+	CWorldSnapshotHistory();
+
+	// Forget every snapshot
+	void Clear();
+
+	// Remember a snapshot, replacing whatever was in its spot in the ring
+	void AddSnapshot( uint32 unSequence, const uint8 *pubData, uint32 cubData );
+
+	// Get a snapshot if we still have it, NULL otherwise
+	const std::vector< uint8 > *FindSnapshot( uint32 unSequence );
+
+private:
+	struct WorldSnapshot_t
+	{
+		uint32 m_unSequence;
+		std::vector< uint8 > m_vecData;
+	};
+
+	WorldSnapshot_t m_rgSnapshots[WORLD_SNAPSHOT_HISTORY_SIZE];
+};
+
+
+// Packed size of a snapshot with the given number of player slots and lanes
+inline uint32 GetPackedWorldSnapshotSize( uint32 unPlayerSlots, uint32 unLanes ) { return WORLD_SNAPSHOT_HEADER_BYTES + ( unPlayerSlots + 7 ) / 8 + unLanes * WORLD_SNAPSHOT_LANE_BYTES; }
+
+// Pack an update for one client.  Every slot's Active bit is packed, but the score, SteamID and
+// ship only of the players in rgiLaneSlots (WORLD_SNAPSHOT_EMPTY_LANE for an unused lane), see
+// CRelevancyFilter.  pubPacked must have GetPackedWorldSnapshotSize() bytes.  Returns the number
+// of bytes written.
+uint32 PackWorldSnapshot( ServerSpaceWarUpdateData_t *pUpdateData, const uint32 *rgiLaneSlots, uint32 unLanes, uint8 *pubPacked, uint32 cubPacked );
+
+// Unpack a snapshot into vecUpdateWorld as a MsgServerUpdateWorld_t, returns false if it's
+// malformed.  Slots that were in a lane, and inactive ones, unpack with GetIncluded() set.
+bool BUnpackWorldSnapshot( const uint8 *pubPacked, uint32 cubPacked, std::vector< uint8 > &vecUpdateWorld );
+
+// Append the encoding of a snapshot against a baseline of the same size to vecEncoded.  Only the
+// bytes that differ from the baseline are written, a NULL baseline is all zeroes.
+void EncodeWorldSnapshotDelta( const uint8 *pubSnapshot, const uint8 *pubBaseline, uint32 cubSnapshot, std::vector< uint8 > &vecEncoded );
+
+// The same, written straight into pubEncoded, which must have GetWorldSnapshotDeltaMaxSize()
+// bytes.  Returns the number of bytes written.
+uint32 EncodeWorldSnapshotDelta( const uint8 *pubSnapshot, const uint8 *pubBaseline, uint32 cubSnapshot, uint8 *pubEncoded );
+
+// Most bytes the encoding of a snapshot of the given size can take, when every byte changed
+uint32 GetWorldSnapshotDeltaMaxSize( uint32 cubSnapshot );
+
+// Rebuild a snapshot from its encoding and the baseline it was encoded against, returns false
+// if the encoding is malformed
+bool BDecodeWorldSnapshotDelta( const uint8 *pubEncoded, uint32 cubEncoded, const uint8 *pubBaseline, uint32 cubSnapshot, uint8 *pubSnapshot );
+
+#endif // WORLDSNAPSHOT_H
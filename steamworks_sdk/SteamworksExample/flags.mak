@@ -58,12 +58,18 @@ RELEASE_MACROS := NDEBUG RELEASE
 
 MCUFLAGS := 
 
+ifeq ($(DEDICATED),1)
+# The headless dedicated server doesn't touch SDL at all
+CFLAGS += -g -DPOSIX -DGNUC -DDEDICATED_SERVER
+CXXFLAGS += -g -DPOSIX -DGNUC -DDEDICATED_SERVER
+else
 CFLAGS += -g -DPOSIX -DSDL $(shell $(SDL_CONFIG) --cflags) -DGNUC
 CXXFLAGS += -g -DPOSIX -DSDL $(shell $(SDL_CONFIG) --cflags) -DGNUC
 
 # Valve uses SDL3 internally (the default if USE_SDL2 is not specified)
 # The zip version of the SDK uses the SDL2 package from the runtime SDK
 CXXFLAGS += -DUSE_SDL2
+endif
 
 DEBUG_CFLAGS := -O0
 RELEASE_CFLAGS := -O3
@@ -72,7 +78,11 @@ RELEASE_CXXFLAGS := $(RELEASE_CFLAGS)
 
 MACOS_FRAMEWORKS := 
 
-LDFLAGS := $(shell $(SDL_CONFIG) --libs) -lSDL2_ttf -lfreetype -lz -lGL -lopenal
+ifeq ($(DEDICATED),1)
+LDFLAGS := -lpthread
+else
+LDFLAGS := $(shell $(SDL_CONFIG) --libs) -lSDL2_ttf -lfreetype -lz -lGL -lopenal -lpthread
+endif
 DEBUG_LDFLAGS := 
 RELEASE_LDGLAGS :=
 
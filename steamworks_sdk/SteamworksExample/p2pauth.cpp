@@ -9,16 +9,18 @@
 #include "stdafx.h"
 #include "SpaceWarClient.h"
 #include "p2pauth.h"
+#include "SpaceWarTransport.h"
 
 //-----------------------------------------------------------------------------
 // Purpose: constructor
 //-----------------------------------------------------------------------------
-CP2PAuthPlayer::CP2PAuthPlayer( IGameEngine *pGameEngine, CSteamID steamID, HSteamNetConnection hServerConn )
+CP2PAuthPlayer::CP2PAuthPlayer( IGameEngine *pGameEngine, ISpaceWarTransport *pTransport, CSteamID steamID, HSteamNetConnection hServerConn )
 : m_CallbackBeginAuthResponse( this, &CP2PAuthPlayer::OnBeginAuthResponse )
 , m_steamID( steamID )
 , m_hServerConnection( hServerConn )
 {
 	m_pGameEngine = pGameEngine;
+	m_pTransport = pTransport;
 	m_bSentTicket = false;
 	m_bSubmittedHisTicket = false;
 	m_bHaveAnswer = false;
@@ -70,7 +72,7 @@ void CP2PAuthPlayer::StartAuthPlayer()
 	msg.SetSteamID( m_steamID.ConvertToUint64() );
 
 	int64 nIgnoreMessageID;
-	if ( SteamNetworkingSockets()->SendMessageToConnection( m_hServerConnection, &msg, sizeof(msg), k_nSteamNetworkingSend_Reliable, &nIgnoreMessageID ) == k_EResultOK )
+	if ( SendMessageToConnectionOnLane( m_pTransport, m_hServerConnection, &msg, sizeof(msg), k_nSteamNetworkingSend_Reliable, k_ESpaceWarLaneControl, &nIgnoreMessageID ) == k_EResultOK )
 	{
 		m_bSentTicket = true;
 	}
@@ -177,13 +179,14 @@ CSteamID CP2PAuthPlayer::GetSteamID()
 //-----------------------------------------------------------------------------
 // Purpose: constructor
 //-----------------------------------------------------------------------------
-CP2PAuthedGame::CP2PAuthedGame( IGameEngine *pGameEngine )
+CP2PAuthedGame::CP2PAuthedGame( IGameEngine *pGameEngine, ISpaceWarTransport *pTransport )
 {
 	m_pGameEngine = pGameEngine;
+	m_pTransport = pTransport;
 	m_hConnServer = k_HSteamNetConnection_Invalid;
 
 	// no players yet
-	for ( int i = 0; i < MAX_PLAYERS_PER_SERVER; i++ )
+	for ( int i = 0; i < MAX_PLAYERS_PER_SERVER_LIMIT; i++ )
 	{
 		m_rgpP2PAuthPlayer[i] = NULL;
 	}
@@ -209,7 +212,7 @@ void CP2PAuthedGame::PlayerDisconnect( int iSlot )
 //-----------------------------------------------------------------------------
 void CP2PAuthedGame::EndGame()
 {
-	for ( int i = 0; i < MAX_PLAYERS_PER_SERVER; i++ )
+	for ( int i = 0; i < MAX_PLAYERS_PER_SERVER_LIMIT; i++ )
 	{
 		if ( m_rgpP2PAuthPlayer[i] )
 		{
@@ -229,7 +232,7 @@ void CP2PAuthedGame::InternalInitPlayer( int iSlot, CSteamID steamID, bool bStar
 	char rgch[128];
 	sprintf( rgch, "P2P:: StartAuthPlayer slot=%d account=%d \n", iSlot, steamID.GetAccountID() );
 	OutputDebugString( rgch );
-	m_rgpP2PAuthPlayer[iSlot] = new CP2PAuthPlayer( m_pGameEngine, steamID, m_hConnServer );
+	m_rgpP2PAuthPlayer[iSlot] = new CP2PAuthPlayer( m_pGameEngine, m_pTransport, steamID, m_hConnServer );
 	if ( bStartAuthProcess )
 		m_rgpP2PAuthPlayer[iSlot]->StartAuthPlayer();
 }
@@ -242,7 +245,7 @@ void CP2PAuthedGame::InternalInitPlayer( int iSlot, CSteamID steamID, bool bStar
 //-----------------------------------------------------------------------------
 void CP2PAuthedGame::RegisterPlayer( int iSlot, CSteamID steamID )
 {
-	if (iSlot < MAX_PLAYERS_PER_SERVER)
+	if (iSlot < MAX_PLAYERS_PER_SERVER_LIMIT)
 		InternalInitPlayer( iSlot, steamID, false );
 }
 //-----------------------------------------------------------------------------
@@ -251,7 +254,7 @@ void CP2PAuthedGame::RegisterPlayer( int iSlot, CSteamID steamID )
 //-----------------------------------------------------------------------------
 void CP2PAuthedGame::StartAuthPlayer( int iSlot, CSteamID steamID )
 {
-	if (iSlot < MAX_PLAYERS_PER_SERVER)
+	if (iSlot < MAX_PLAYERS_PER_SERVER_LIMIT)
 		InternalInitPlayer( iSlot, steamID, true );
 }
 
@@ -262,7 +265,7 @@ void CP2PAuthedGame::StartAuthPlayer( int iSlot, CSteamID steamID )
 void CP2PAuthedGame::HandleP2PSendingTicket( const void *pMessage )
 {
 	const MsgP2PSendingTicket_t *pMsg = (const MsgP2PSendingTicket_t*)pMessage;
-	for ( int i = 0; i < MAX_PLAYERS_PER_SERVER; i++ )
+	for ( int i = 0; i < MAX_PLAYERS_PER_SERVER_LIMIT; i++ )
 	{
 		if ( m_rgpP2PAuthPlayer[i] && m_rgpP2PAuthPlayer[i]->GetSteamID() == pMsg->GetSteamID() )
 		{
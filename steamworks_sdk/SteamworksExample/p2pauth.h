@@ -9,6 +9,7 @@
 
 const int k_cMaxSockets = 16;
 class CP2PAuthPlayer;
+class ISpaceWarTransport;
 
 bool SendAuthTicketToConnection( CSteamID steamIDFrom, HSteamNetConnection hConnectionTo, uint32 cubTicket, uint8 *pubTicket );
 
@@ -18,7 +19,7 @@ bool SendAuthTicketToConnection( CSteamID steamIDFrom, HSteamNetConnection hConn
 class CP2PAuthPlayer
 {
 public:
-	CP2PAuthPlayer( IGameEngine *pGameEngine, CSteamID steamID, HSteamNetConnection hServerConn );
+	CP2PAuthPlayer( IGameEngine *pGameEngine, ISpaceWarTransport *pTransport, CSteamID steamID, HSteamNetConnection hServerConn );
 	~CP2PAuthPlayer();
 	void EndGame();
 	void StartAuthPlayer();
@@ -51,6 +52,7 @@ private:
 	EAuthSessionResponse m_eAuthSessionResponse;
 
 	IGameEngine *m_pGameEngine;
+	ISpaceWarTransport *m_pTransport;
 };
 
 //-----------------------------------------------------------------------------
@@ -59,7 +61,7 @@ private:
 class CP2PAuthedGame
 {
 public:
-	CP2PAuthedGame( IGameEngine *pGameEngine );
+	CP2PAuthedGame( IGameEngine *pGameEngine, ISpaceWarTransport *pTransport );
 	void PlayerDisconnect( int iSlot );
 	void EndGame();
 	void StartAuthPlayer( int iSlot, CSteamID steamID );
@@ -68,7 +70,8 @@ public:
 	CSteamID GetSteamID();
 	void InternalInitPlayer( int iSlot, CSteamID steamID, bool bStartAuthProcess );
 
-	CP2PAuthPlayer *m_rgpP2PAuthPlayer[MAX_PLAYERS_PER_SERVER];
+	CP2PAuthPlayer *m_rgpP2PAuthPlayer[MAX_PLAYERS_PER_SERVER_LIMIT];
 	IGameEngine *m_pGameEngine;
+	ISpaceWarTransport *m_pTransport;
 	HSteamNetConnection m_hConnServer;
 };
@@ -7,11 +7,13 @@
 
 #include "stdafx.h"
 #include "voicechat.h"
+#include "SpaceWarTransport.h"
 
 
-CVoiceChat::CVoiceChat( IGameEngine *pGameEngine )
+CVoiceChat::CVoiceChat( IGameEngine *pGameEngine, ISpaceWarTransport *pTransport )
 {
 	m_pGameEngine = pGameEngine;
+	m_pTransport = pTransport;
 	m_bIsActive = false;
 	m_ulLastTimeTalked = 0;
 	m_hVoiceLoopback = 0;
@@ -52,7 +54,7 @@ void CVoiceChat::RunFrame()
 				memcpy( buffer, &msg, sizeof(msg) );
 
 				// Send a message to the server with the data, server will broadcast this data on to all other clients.
-				SteamNetworkingSockets()->SendMessageToConnection( m_hConnServer, buffer, sizeof(msg)+nBytesWritten, k_nSteamNetworkingSend_UnreliableNoDelay, nullptr );
+				SendMessageToConnectionOnLane( m_pTransport, m_hConnServer, buffer, sizeof(msg)+nBytesWritten, k_nSteamNetworkingSend_UnreliableNoDelay, k_ESpaceWarLaneVoice, nullptr );
 
 				m_ulLastTimeTalked = m_pGameEngine->GetGameTickCount();
 
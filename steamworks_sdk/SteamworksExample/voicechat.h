@@ -13,6 +13,8 @@
 #include "Messages.h"
 #include "steam/isteamnetworkingsockets.h"
 
+class ISpaceWarTransport;
+
 typedef struct VoiceChatConnection_s
 {
 	uint64 ulLastReceiveVoiceTime;
@@ -24,7 +26,7 @@ class CVoiceChat
 {
 public:
 
-	CVoiceChat( IGameEngine *pGameEngine );
+	CVoiceChat( IGameEngine *pGameEngine, ISpaceWarTransport *pTransport );
 	~CVoiceChat();
 
 	bool StartVoiceChat();
@@ -46,6 +48,9 @@ private:
 
 	// Pointer to engine instance (so we can play sound)
 	IGameEngine *m_pGameEngine;
+
+	// What m_hConnServer is a connection on
+	ISpaceWarTransport *m_pTransport;
 	
 	// map of voice chat sessions with other players
 	std::map< uint64, VoiceChatConnection_t > m_MapConnections;